@@ -0,0 +1,141 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/logger.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Sustained throughput of the file back-ends. Producers block once the sink's
+// queue is full, so this measures the rate at which the consumer can format
+// and write records. The bytes_per_item counter is the size of the output
+// per record, which shows the compression ratio of the gzip back-end.
+
+namespace
+{
+    struct temp_file
+    {
+        temp_file()
+        {
+            const int fd = ::mkstemp(path);
+            if (fd == -1)
+                std::abort();
+            ::close(fd);
+        }
+
+        ~temp_file()
+        {
+            ::unlink(path);
+        }
+
+        std::size_t size() const
+        {
+            struct ::stat st;
+            return ::stat(path, &st) == 0 ? std::size_t(st.st_size) : 0;
+        }
+
+        char path[32] = "/tmp/xtr.bench.XXXXXX";
+    };
+
+    void log_records(benchmark::State& state, xtr::logger& log)
+    {
+        xtr::sink s = log.get_sink("Name");
+
+        std::size_t n = 0;
+        for (auto _ : state)
+        {
+            XTR_LOG(
+                s,
+                "Order {} filled: qty={} price={} venue={}",
+                n++,
+                100,
+                42.5,
+                "XLON");
+        }
+
+        s.sync();
+
+        state.SetItemsProcessed(std::int64_t(state.iterations()));
+    }
+
+    void set_bytes_per_item(benchmark::State& state, std::size_t nbytes)
+    {
+        state.counters["bytes_per_item"] =
+            double(nbytes) / double(state.iterations());
+    }
+
+    void file_throughput_devnull(benchmark::State& state)
+    {
+        FILE* fp = std::fopen("/dev/null", "w");
+        {
+            xtr::logger log(
+                fp,
+                fp,
+                std::chrono::system_clock(),
+                xtr::null_command_path);
+            log_records(state, log);
+        }
+        std::fclose(fp);
+    }
+
+    void file_throughput_disk(benchmark::State& state)
+    {
+        temp_file f;
+        {
+            xtr::logger log(
+                f.path,
+                std::chrono::system_clock(),
+                xtr::null_command_path);
+            log_records(state, log);
+        }
+        set_bytes_per_item(state, f.size());
+    }
+
+#if defined(XTR_ENABLE_ZLIB)
+    void file_throughput_gzip(benchmark::State& state)
+    {
+        temp_file f;
+        {
+            xtr::logger log(
+                xtr::gzip_tag{},
+                f.path,
+                std::chrono::system_clock(),
+                xtr::null_command_path);
+            log_records(state, log);
+        }
+        set_bytes_per_item(state, f.size());
+    }
+#endif
+}
+
+BENCHMARK(file_throughput_devnull)->UseRealTime();
+BENCHMARK(file_throughput_disk)->UseRealTime();
+#if defined(XTR_ENABLE_ZLIB)
+BENCHMARK(file_throughput_gzip)->UseRealTime();
+#endif
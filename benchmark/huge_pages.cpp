@@ -0,0 +1,79 @@
+#include "xtr/logger.hpp"
+#include "xtr/detail/mirrored_memory_mapping.hpp"
+#include "xtr/detail/pagesize.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compares sinks backed by normal pages against sinks backed by huge pages.
+// Records are logged to state.range(0) sinks in turn, each with a 2MiB queue,
+// so that both the producer and consumer touch many pages. If the benchmark
+// library was built with libpfm then TLB misses may be counted directly by
+// passing --benchmark_perf_counters=dTLB-load-misses,dTLB-store-misses.
+
+namespace
+{
+    bool huge_pages_available()
+    {
+#if defined(MAP_HUGETLB)
+        const xtr::detail::mirrored_memory_mapping m(
+            xtr::detail::huge_page_size, -1, 0, MAP_HUGETLB);
+        return m.huge_pages();
+#else
+        return false;
+#endif
+    }
+
+    void many_sinks(benchmark::State& state, xtr::page_type_t page_type)
+    {
+        if (page_type == xtr::page_type_t::huge && !huge_pages_available())
+        {
+            state.SkipWithError("Huge pages are unavailable");
+            return;
+        }
+
+        xtr::logger log{
+            [](xtr::log_level_t, const char*, std::size_t size)
+            {
+                return ::ssize_t(size);
+            },
+            [](const char*, std::size_t)
+            {
+            }};
+
+        const auto nsinks = std::size_t(state.range(0));
+        std::vector<xtr::sink> sinks;
+        sinks.reserve(nsinks);
+        for (std::size_t i = 0; i < nsinks; ++i)
+        {
+            sinks.push_back(
+                log.get_sink(
+                    "Name" + std::to_string(i),
+                    xtr::detail::huge_page_size,
+                    page_type));
+        }
+
+        std::size_t n = 0;
+        std::size_t i = 0;
+        for (auto _ : state)
+        {
+            XTR_LOG(sinks[i], "Test {} {} {}", n++, 42.0, "C string");
+            if (++i == nsinks)
+                i = 0;
+        }
+
+        for (auto& s : sinks)
+            s.sync();
+
+        state.SetItemsProcessed(std::int64_t(state.iterations()));
+    }
+}
+
+BENCHMARK_CAPTURE(many_sinks, normal_pages, xtr::page_type_t::normal)
+    ->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
+BENCHMARK_CAPTURE(many_sinks, huge_pages, xtr::page_type_t::huge)
+    ->Arg(4)->Arg(16)->Arg(64)->UseRealTime();
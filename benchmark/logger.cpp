@@ -1,13 +1,16 @@
 #include "xtr/logger.hpp"
+#include "xtr/detail/string_table.hpp"
 
 #include <benchmark/benchmark.h>
 
+#include <cstddef>
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
 #include <ctime>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include <pthread.h>
 #include <sched.h>
@@ -19,6 +22,10 @@ namespace
     void set_thread_attrs(pthread_t thread, int cpu)
     {
         cpu_set_t cpus;
+        // Threads are left unpinned on machines without the given CPU, so
+        // that the benchmarks can at least be compared on the same machine
+        if (::sched_getaffinity(0, sizeof(cpus), &cpus) != 0 || !CPU_ISSET(cpu, &cpus))
+            return;
         CPU_ZERO(&cpus);
         CPU_SET(cpu, &cpus);
         if (::pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0)
@@ -102,3 +109,89 @@ LOG_BENCH(logger_benchmark_c_str, XTR_LOG(p, "Test {}", "Hello"), 32)
 LOG_BENCH(logger_benchmark_str_view, XTR_LOG(p, "Test {}", std::string_view{"Hello"}), 32)
 LOG_BENCH(logger_benchmark_str, XTR_LOG(p, "Test {}", s), 32)
 LOG_BENCH(logger_benchmark_non_blocking, XTR_TRY_LOG(p, "Test"), 8)
+
+const std::string s64(64, 'x');
+const std::string s256(256, 'x');
+const std::string s1024(1024, 'x');
+const std::string s4096(4096, 'x');
+
+LOG_BENCH(logger_benchmark_str_64, XTR_LOG(p, "Test {}", s64), 96)
+LOG_BENCH(logger_benchmark_str_256, XTR_LOG(p, "Test {}", s256), 288)
+LOG_BENCH(logger_benchmark_str_1024, XTR_LOG(p, "Test {}", s1024), 1056)
+LOG_BENCH(logger_benchmark_str_4096, XTR_LOG(p, "Test {}", s4096), 4128)
+LOG_BENCH(logger_benchmark_c_str_64, XTR_LOG(p, "Test {}", s64.c_str()), 96)
+LOG_BENCH(logger_benchmark_c_str_256, XTR_LOG(p, "Test {}", s256.c_str()), 288)
+LOG_BENCH(logger_benchmark_c_str_1024, XTR_LOG(p, "Test {}", s1024.c_str()), 1056)
+LOG_BENCH(logger_benchmark_c_str_4096, XTR_LOG(p, "Test {}", s4096.c_str()), 4128)
+
+// Measures copying string arguments into the string table in isolation from
+// the consumer, which dominates the logger benchmarks of long strings when
+// the producer and consumer share a CPU. The table never runs out of space,
+// so the buffer is never consulted.
+
+namespace
+{
+    struct unused_buffer
+    {
+        struct span
+        {
+            std::byte* end() const noexcept
+            {
+                return nullptr;
+            }
+
+            std::size_t size() const noexcept
+            {
+                return 0;
+            }
+        };
+
+        void writer_pause() noexcept
+        {
+        }
+
+        span write_span() noexcept
+        {
+            return {};
+        }
+
+        std::size_t capacity() const noexcept
+        {
+            return 0;
+        }
+    };
+
+    template<typename String>
+    void string_table(benchmark::State& state, String (*make)(const std::string&))
+    {
+        const std::string s(std::size_t(state.range(0)), 'x');
+        const String arg = make(s);
+        std::vector<std::byte> table(s.size() + 1);
+        unused_buffer buf;
+
+        for (auto _ : state)
+        {
+            std::byte* pos = table.data();
+            std::byte* end = table.data() + table.size();
+            auto result =
+                xtr::detail::build_string_table<void()>(pos, end, buf, arg);
+            benchmark::DoNotOptimize(result);
+            benchmark::ClobberMemory();
+        }
+
+        state.SetBytesProcessed(std::int64_t(state.iterations()) * state.range(0));
+    }
+
+    std::string make_str(const std::string& s)
+    {
+        return s;
+    }
+
+    const char* make_c_str(const std::string& s)
+    {
+        return s.c_str();
+    }
+}
+
+BENCHMARK_CAPTURE(string_table, str, make_str)->RangeMultiplier(4)->Range(4, 4096);
+BENCHMARK_CAPTURE(string_table, c_str, make_c_str)->RangeMultiplier(4)->Range(4, 4096);
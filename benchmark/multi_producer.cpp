@@ -0,0 +1,223 @@
+#include "xtr/logger.hpp"
+#include "xtr/detail/latency_histogram.hpp"
+#include "xtr/detail/tsc.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Benchmarks for multiple producers, end-to-end latency and sustained
+// throughput. Unlike the benchmarks in logger.cpp threads are not pinned, as
+// the number of producer threads varies.
+
+namespace
+{
+    ::ssize_t discard(xtr::log_level_t, const char*, std::size_t size)
+    {
+        return ::ssize_t(size);
+    }
+
+    void discard_error(const char*, std::size_t)
+    {
+    }
+
+    // Benchmark threads cannot share state created by one of the threads, so
+    // the multi-producer benchmarks use loggers that live for the duration of
+    // the program.
+    xtr::logger& one_consumer_logger()
+    {
+        static xtr::logger log{discard, discard_error};
+        return log;
+    }
+
+    xtr::logger& two_consumer_logger()
+    {
+        static struct two_consumers
+        {
+            two_consumers()
+            {
+                log.add_consumer_threads(1);
+            }
+
+            xtr::logger log{discard, discard_error};
+        } tc;
+        return tc.log;
+    }
+
+    const std::string str{"std::string"};
+
+    struct log_int
+    {
+        template<typename Sink>
+        void operator()(Sink& s, std::size_t n) const
+        {
+            XTR_LOG(s, "Test {}", n);
+        }
+    };
+
+    struct log_mixed
+    {
+        template<typename Sink>
+        void operator()(Sink& s, std::size_t n) const
+        {
+            XTR_LOG(
+                s,
+                "Test {} {} {} {} {}",
+                n,
+                42.0,
+                "C string",
+                std::string_view{"std::string_view"},
+                str);
+        }
+    };
+
+    // Each producer thread logs to state.range(0) sinks in turn. Producers
+    // are never synchronized with the consumer while being timed, so once
+    // the queues fill this measures throughput under back-pressure.
+    template<typename LogFunction>
+    void multi_producer(
+        benchmark::State& state,
+        xtr::logger& (*get_logger)(),
+        LogFunction log)
+    {
+        const auto nsinks = std::size_t(state.range(0));
+        std::vector<xtr::sink> sinks(nsinks);
+        for (std::size_t i = 0; i < nsinks; ++i)
+        {
+            get_logger().register_sink(
+                sinks[i],
+                "Producer" + std::to_string(state.thread_index()) +
+                "." + std::to_string(i));
+        }
+
+        std::size_t n = 0;
+        std::size_t i = 0;
+        for (auto _ : state)
+        {
+            log(sinks[i], n++);
+            if (++i == nsinks)
+                i = 0;
+        }
+
+        state.SetItemsProcessed(std::int64_t(state.iterations()));
+
+        for (auto& s : sinks)
+            s.sync();
+    }
+
+    // All producer threads log to the same shared sink, for comparison with
+    // multi_producer using one sink per thread.
+    template<typename LogFunction>
+    void shared_sink(benchmark::State& state, LogFunction log)
+    {
+        static xtr::shared_sink s = one_consumer_logger().get_shared_sink("Shared");
+
+        std::size_t n = 0;
+        for (auto _ : state)
+            log(s, n++);
+
+        state.SetItemsProcessed(std::int64_t(state.iterations()));
+
+        if (state.thread_index() == 0)
+            s.sync();
+    }
+
+    // Measures the time from a record being logged to the record being
+    // passed to the output function, by logging the TSC and comparing it
+    // to the TSC read in the output function. If state.range(0) is non-zero
+    // then records are logged at most once every state.range(0)
+    // nanoseconds, otherwise as quickly as possible.
+    void end_to_end_latency(benchmark::State& state)
+    {
+        xtr::detail::latency_histogram hist;
+
+        xtr::logger log{
+            [&hist](xtr::log_level_t, const char* buf, std::size_t size)
+            {
+                const std::uint64_t now = xtr::detail::tsc::now().ticks;
+                // The logged TSC is the last field, before the newline
+                const std::string_view line(buf, size - 1);
+                const std::size_t pos = line.rfind(' ');
+                std::uint64_t ticks = 0;
+                if (pos != std::string_view::npos)
+                    std::from_chars(line.data() + pos + 1, line.end(), ticks);
+                hist.record(now - ticks);
+                return ::ssize_t(size);
+            },
+            discard_error};
+
+        xtr::sink p = log.get_sink("Name");
+
+        const double ns_per_tick = 1e9 / double(xtr::detail::get_tsc_hz());
+        const auto gap_ticks = std::uint64_t(double(state.range(0)) / ns_per_tick);
+        std::uint64_t next = 0;
+
+        for (auto _ : state)
+        {
+            std::uint64_t now;
+            while ((now = xtr::detail::tsc::now().ticks) < next)
+                ;
+            next = now + gap_ticks;
+            XTR_LOG(p, "{}", xtr::detail::tsc::now().ticks);
+        }
+
+        p.sync();
+
+        const auto ns =
+            [&](std::uint64_t ticks)
+            {
+                return double(ticks) * ns_per_tick;
+            };
+
+        state.counters["p50_ns"] = ns(hist.value_at_percentile(50.0));
+        state.counters["p90_ns"] = ns(hist.value_at_percentile(90.0));
+        state.counters["p99_ns"] = ns(hist.value_at_percentile(99.0));
+        state.counters["p99.9_ns"] = ns(hist.value_at_percentile(99.9));
+        state.counters["max_ns"] = ns(hist.max());
+    }
+
+    // Measures the sustained rate at which records may be logged to a sink
+    // with a queue of state.range(0) bytes, writing to /dev/null, once the
+    // queue is full and the producer is limited by the consumer.
+    template<typename LogFunction>
+    void sustained_throughput(benchmark::State& state, LogFunction log)
+    {
+        FILE* fp = std::fopen("/dev/null", "w");
+        xtr::logger lg{fp, fp};
+
+        xtr::sink p = lg.get_sink("Name", std::size_t(state.range(0)));
+
+        std::size_t n = 0;
+        for (auto _ : state)
+            log(p, n++);
+
+        p.sync();
+
+        state.SetItemsProcessed(std::int64_t(state.iterations()));
+    }
+}
+
+BENCHMARK_CAPTURE(multi_producer, int_one_consumer, &one_consumer_logger, log_int{})
+    ->Arg(1)->Arg(4)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(multi_producer, int_two_consumers, &two_consumer_logger, log_int{})
+    ->Arg(1)->Arg(4)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(multi_producer, mixed_one_consumer, &one_consumer_logger, log_mixed{})
+    ->Arg(1)->Arg(4)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(multi_producer, mixed_two_consumers, &two_consumer_logger, log_mixed{})
+    ->Arg(1)->Arg(4)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_CAPTURE(shared_sink, int, log_int{})->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_CAPTURE(shared_sink, mixed, log_mixed{})->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK(end_to_end_latency)->Arg(0)->Arg(1000)->UseRealTime();
+
+BENCHMARK_CAPTURE(sustained_throughput, int, log_int{})
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->UseRealTime();
+BENCHMARK_CAPTURE(sustained_throughput, mixed, log_mixed{})
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->UseRealTime();
@@ -0,0 +1,67 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/synchronized_ring_buffer.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstring>
+
+// Measures the queue operations made by log statements and the consumer in
+// isolation from formatting, with the writer and reader on the same thread.
+
+namespace
+{
+    using ring_buffer = xtr::detail::synchronized_ring_buffer<>;
+
+    void ring_buffer_write(benchmark::State& state)
+    {
+        ring_buffer buf(64 * 1024);
+        std::size_t n = 0;
+
+        for (auto _ : state)
+        {
+            const ring_buffer::span s = buf.write_span_spec(16);
+            std::memset(s.begin(), 1, 16);
+            buf.reduce_writable(16);
+            if (++n % 2048 == 0)
+                buf.reduce_readable(buf.read_span().size());
+        }
+    }
+
+    void ring_buffer_write_read(benchmark::State& state)
+    {
+        ring_buffer buf(64 * 1024);
+
+        for (auto _ : state)
+        {
+            const ring_buffer::span s = buf.write_span(16);
+            std::memset(s.begin(), 1, 16);
+            buf.reduce_writable(16);
+            const ring_buffer::span r = buf.read_span();
+            benchmark::DoNotOptimize(*r.begin());
+            buf.reduce_readable(r.size());
+        }
+    }
+}
+
+BENCHMARK(ring_buffer_write);
+BENCHMARK(ring_buffer_write_read);
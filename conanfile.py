@@ -28,7 +28,8 @@ class XtrConan(ConanFile):
     generators = "make"
     exports_sources = ["src/*", "include/*", "Makefile"]
     exports = ["docs/libxtr.3", "docs/libxtr-quickstart.3",
-               "docs/libxtr-userguide.3", "docs/xtrctl.1", "LICENSE"]
+               "docs/libxtr-userguide.3", "docs/xtrctl.1", "docs/xtrdecode.1",
+               "LICENSE"]
 
     def configure(self):
         minimal_cpp_standard = "20"
@@ -57,11 +58,13 @@ class XtrConan(ConanFile):
         env_build_vars["LTO"] = str(int(bool(self.options.enable_lto)))
         autotools.make(vars=env_build_vars)
         autotools.make(vars=env_build_vars, target="xtrctl")
+        autotools.make(vars=env_build_vars, target="xtrdecode")
 
     def package(self):
         self.copy("*.hpp", dst="include", src="include")
         self.copy("*/libxtr.a", dst="lib", src="build", keep_path=False)
         self.copy("*/xtrctl", dst="bin", src="build", keep_path=False)
+        self.copy("*/xtrdecode", dst="bin", src="build", keep_path=False)
         self.copy("libxtr.3", dst="man/man3", src="docs", keep_path=False)
         self.copy(
             "libxtr-quickstart.3",
@@ -74,6 +77,7 @@ class XtrConan(ConanFile):
             src="docs",
             keep_path=False)
         self.copy("xtrctl.1", dst="man/man1", src="docs", keep_path=False)
+        self.copy("xtrdecode.1", dst="man/man1", src="docs", keep_path=False)
         self.copy("LICENSE", "licenses")
 
     def package_info(self):
@@ -0,0 +1,69 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_BINARY_DECODER_HPP
+#define XTR_DETAIL_BINARY_DECODER_HPP
+
+#include "xtr/log_level.hpp"
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace xtr::detail
+{
+    class binary_decoder;
+}
+
+// Decodes log records written in the binary format described in
+// binary_format.hpp, producing the same text that the logger would have
+// written had the binary output format not been selected.
+class xtr::detail::binary_decoder
+{
+public:
+    explicit binary_decoder(
+        log_level_style_t lstyle = default_log_level_style)
+    :
+        lstyle_(lstyle)
+    {
+    }
+
+    // Decodes all complete records in [buf, buf + size), appending the
+    // decoded log lines to mbuf. Returns the number of bytes consumed, any
+    // remaining bytes are an incomplete record and should be passed again
+    // once more data is available. Throws std::runtime_error if the data is
+    // not valid.
+    std::size_t decode(
+        const char* buf,
+        std::size_t size,
+        fmt::memory_buffer& mbuf);
+
+private:
+    struct reader;
+
+    bool decode_log(reader& r, fmt::memory_buffer& mbuf);
+
+    log_level_style_t lstyle_;
+    std::vector<std::string> formats_;
+};
+
+#endif
@@ -0,0 +1,189 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_BINARY_ENCODER_HPP
+#define XTR_DETAIL_BINARY_ENCODER_HPP
+
+#include "binary_format.hpp"
+#include "string_ref.hpp"
+#include "tsc.hpp"
+#include "xtr/log_level.hpp"
+#include "xtr/timespec.hpp"
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+namespace xtr::detail
+{
+    class binary_encoder;
+
+    template<typename T>
+    void binary_put(fmt::memory_buffer& mbuf, const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const char* const p = reinterpret_cast<const char*>(&value);
+        mbuf.append(p, p + sizeof(T));
+    }
+
+    inline void binary_put_string(
+        fmt::memory_buffer& mbuf,
+        binary_arg_type type,
+        std::string_view s)
+    {
+        binary_put(mbuf, type);
+        binary_put(mbuf, std::uint32_t(s.size()));
+        mbuf.append(s.data(), s.data() + s.size());
+    }
+}
+
+// Encodes log records in the binary format described in binary_format.hpp.
+// Arguments of types that can be reconstructed by the decoder are written
+// in their native representation, deferring formatting to the decoder,
+// while arguments of other types (e.g. types with user-defined formatters)
+// are formatted on the consumer thread and written as strings.
+class xtr::detail::binary_encoder
+{
+public:
+    // Encodes a log record, appending it to mbuf. A header record and a
+    // format record are written before the log record if required.
+    template<typename Timestamp, typename... Args>
+    void encode(
+        fmt::memory_buffer& mbuf,
+        std::string_view fmt,
+        log_level_t level,
+        const Timestamp& ts,
+        const std::string& name,
+        const Args&... args)
+    {
+        // +1 for the timestamp
+        static_assert(sizeof...(Args) + 1 <= UINT8_MAX);
+        begin(mbuf, fmt, level, name, std::uint8_t(sizeof...(Args) + 1));
+        encode_arg(mbuf, ts);
+        (encode_arg(mbuf, args), ...);
+    }
+
+    // Forgets all previously written format records, causing the header and
+    // format records to be written again. Called when the output changes or
+    // if a record could not be written in full.
+    void reset() noexcept;
+
+private:
+    void begin(
+        fmt::memory_buffer& mbuf,
+        std::string_view fmt,
+        log_level_t level,
+        const std::string& name,
+        std::uint8_t nargs);
+
+    template<typename T>
+    static void encode_arg(fmt::memory_buffer& mbuf, const T& value);
+
+    std::unordered_map<const char*, std::uint32_t> ids_;
+};
+
+template<typename T>
+void xtr::detail::binary_encoder::encode_arg(
+    fmt::memory_buffer& mbuf,
+    const T& value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        binary_put(mbuf, binary_arg_type::boolean);
+        binary_put(mbuf, std::uint8_t(value));
+    }
+    else if constexpr (std::is_same_v<T, char>)
+    {
+        binary_put(mbuf, binary_arg_type::character);
+        binary_put(mbuf, value);
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+    {
+        binary_put(mbuf, binary_arg_type::int64);
+        binary_put(mbuf, std::int64_t(value));
+    }
+    else if constexpr (std::is_integral_v<T>)
+    {
+        binary_put(mbuf, binary_arg_type::uint64);
+        binary_put(mbuf, std::uint64_t(value));
+    }
+    else if constexpr (std::is_same_v<T, float>)
+    {
+        binary_put(mbuf, binary_arg_type::float32);
+        binary_put(mbuf, value);
+    }
+    else if constexpr (std::is_same_v<T, double>)
+    {
+        binary_put(mbuf, binary_arg_type::float64);
+        binary_put(mbuf, value);
+    }
+    else if constexpr (
+        std::is_same_v<T, std::nullptr_t> ||
+        (std::is_pointer_v<T> && std::is_void_v<std::remove_pointer_t<T>>))
+    {
+        binary_put(mbuf, binary_arg_type::pointer);
+        binary_put(mbuf, std::uint64_t(reinterpret_cast<std::uintptr_t>(value)));
+    }
+    else if constexpr (std::is_same_v<T, string_ref<const char*>>)
+    {
+        binary_put_string(mbuf, binary_arg_type::string_ref, value.str);
+    }
+    else if constexpr (std::is_same_v<T, string_ref<std::string_view>>)
+    {
+        binary_put_string(mbuf, binary_arg_type::string_ref, value.str);
+    }
+    else if constexpr (
+        std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+    {
+        binary_put_string(mbuf, binary_arg_type::string, value);
+    }
+    else if constexpr (std::is_same_v<T, xtr::timespec> || std::is_same_v<T, tsc>)
+    {
+        std::timespec ts;
+        if constexpr (std::is_same_v<T, tsc>)
+            ts = tsc::to_timespec(value);
+        else
+            ts = value;
+        binary_put(mbuf, binary_arg_type::timespec);
+        binary_put(mbuf, std::int64_t(ts.tv_sec));
+        binary_put(mbuf, std::int64_t(ts.tv_nsec));
+    }
+    else
+    {
+        // The length is written after the value has been formatted
+        binary_put(mbuf, binary_arg_type::string);
+        const std::size_t len_pos = mbuf.size();
+        binary_put(mbuf, std::uint32_t(0));
+        fmt::format_to(std::back_inserter(mbuf), "{}", value);
+        const auto len =
+            std::uint32_t(mbuf.size() - len_pos - sizeof(std::uint32_t));
+        std::memcpy(mbuf.data() + len_pos, &len, sizeof(len));
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_BINARY_FORMAT_HPP
+#define XTR_DETAIL_BINARY_FORMAT_HPP
+
+#include <cstdint>
+
+// Binary log files consist of a sequence of records, each beginning with a
+// single byte identifying the record type. All integers are written in the
+// byte order of the host that produced the file.
+//
+// Header record, written at the start of each output stream and whenever the
+// output is changed, reopened or an error occurs. Decoders must discard all
+// previously defined formats when a header record is read:
+//
+//    +-----+-------------+-------------------+
+//    | 'X' | "TRB"       | version (uint32)  |
+//    +-----+-------------+-------------------+
+//
+// Format record, written the first time a format string is used:
+//
+//    +-----+-----------------+---------------------+-----------------+
+//    | 'F' | id (uint32)     | length (uint32)     | format string   |
+//    +-----+-----------------+---------------------+-----------------+
+//
+// Log record, referring to a previously written format record. The first
+// argument is always the timestamp:
+//
+//    +-----+-----------------+--------------+---------------------+
+//    | 'L' | format id       | level        | name length         |
+//    |     | (uint32)        | (uint8)      | (uint32)            |
+//    +-----+-----------------+--------------+---------------------+
+//    | name                  | argument     | arguments...        |
+//    |                       | count (uint8)|                     |
+//    +-----------------------+--------------+---------------------+
+//
+// Each argument is a single byte binary_arg_type followed by the value (see
+// below). Strings are written as a uint32 length followed by the string data.
+
+namespace xtr::detail
+{
+    inline constexpr char binary_magic[4] = {'X', 'T', 'R', 'B'};
+
+    inline constexpr std::uint32_t binary_version = 1;
+
+    enum class binary_record_type : char
+    {
+        header = 'X',
+        format = 'F',
+        log = 'L'
+    };
+
+    enum class binary_arg_type : char
+    {
+        boolean = 'b', // uint8
+        character = 'c', // char
+        int64 = 'i', // int64
+        uint64 = 'u', // uint64
+        float32 = 'f', // float
+        float64 = 'd', // double
+        pointer = 'p', // uint64
+        string = 's', // uint32 length, data
+        string_ref = 'r', // uint32 length, data (sanitized when decoded)
+        timespec = 't' // int64 seconds, int64 nanoseconds
+    };
+}
+
+#endif
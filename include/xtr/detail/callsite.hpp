@@ -0,0 +1,125 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_CALLSITE_HPP
+#define XTR_DETAIL_CALLSITE_HPP
+
+#include "xtr/log_level.hpp"
+
+#include <atomic>
+
+namespace xtr::detail
+{
+    class callsite;
+    struct callsite_registry;
+
+    // Adds the callsite to the callsite registry, applying any enable or
+    // disable commands already received to it, and returns true if the
+    // callsite is enabled.
+    bool register_callsite(callsite& cs) noexcept;
+}
+
+// Describes a log statement. Each log macro declares a static callsite, so
+// that individual log statements may be enabled or disabled at run time via
+// xtrctl. Callsites add themselves to the callsite registry the first time
+// they are executed (rather than being collected into a linker section) so
+// that callsites in inline functions and shared libraries are supported,
+// after which checking whether the callsite is enabled costs a single relaxed
+// load. Registered callsites are chained through an intrusive list so that
+// registration never allocates.
+//
+// The registry refers to each callsite for the lifetime of the process, so
+// shared libraries containing executed log statements must not be unloaded
+// (e.g. via dlclose).
+class xtr::detail::callsite
+{
+public:
+    constexpr callsite(
+        const char* file,
+        unsigned line,
+        log_level_t level,
+        const char* format) noexcept
+    :
+        file_(file),
+        line_(line),
+        level_(level),
+        format_(format)
+    {
+    }
+
+    callsite(const callsite&) = delete;
+    callsite& operator=(const callsite&) = delete;
+
+    bool enabled() noexcept
+    {
+        const state s = state_.load(std::memory_order_relaxed);
+        if (s == state::enabled) [[likely]]
+            return true;
+        return s == state::unregistered && register_callsite(*this);
+    }
+
+    // Only valid for registered callsites
+    bool disabled() const noexcept
+    {
+        return state_.load(std::memory_order_relaxed) == state::disabled;
+    }
+
+    void set_enabled(bool enabled) noexcept
+    {
+        state_.store(
+            enabled ? state::enabled : state::disabled,
+            std::memory_order_relaxed);
+    }
+
+    const char* file() const noexcept
+    {
+        return file_;
+    }
+
+    unsigned line() const noexcept
+    {
+        return line_;
+    }
+
+    log_level_t level() const noexcept
+    {
+        return level_;
+    }
+
+    const char* format() const noexcept
+    {
+        return format_;
+    }
+
+private:
+    enum class state : unsigned char {unregistered, enabled, disabled};
+
+    friend bool register_callsite(callsite&) noexcept;
+    friend struct callsite_registry;
+
+    const char* file_;
+    unsigned line_;
+    log_level_t level_;
+    const char* format_;
+    callsite* next_ = nullptr;
+    std::atomic<state> state_{state::unregistered};
+};
+
+#endif
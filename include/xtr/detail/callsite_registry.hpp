@@ -0,0 +1,43 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_CALLSITE_REGISTRY_HPP
+#define XTR_DETAIL_CALLSITE_REGISTRY_HPP
+
+#include <functional>
+
+namespace xtr::detail
+{
+    class callsite;
+    struct pattern;
+
+    // Enables or disables every callsite whose location, formatted as
+    // "file:line", matches the given pattern. The pattern is retained and
+    // also applied to callsites registered later, so that log statements that
+    // have not yet been executed may be disabled. If multiple patterns match
+    // a callsite then the most recent takes effect.
+    void set_callsites_enabled(const pattern& pat, bool enabled);
+
+    // Invokes func for each registered callsite, i.e. each log statement that
+    // has been executed at least once.
+    void for_each_callsite(const std::function<void(const callsite&)>& func);
+}
+
+#endif
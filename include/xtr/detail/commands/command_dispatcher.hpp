@@ -112,6 +112,13 @@ public:
         return !pollfds_.empty();
     }
 
+    // Prevents the socket from being removed on destruction, e.g. in a
+    // child process sharing the socket with its parent
+    void release_path() noexcept
+    {
+        path_.clear();
+    }
+
 private:
     void process_socket_read(pollfd& pfd) noexcept;
     void process_socket_write(pollfd& pfd) noexcept;
@@ -55,6 +55,35 @@ namespace xtr::detail
             << si.buf_nbytes / 1024 << "K used, "
             << si.dropped_count << " dropped";
     }
+
+    inline std::ostream& operator<<(std::ostream& os, const callsite_info& ci)
+    {
+        return os
+            << ci.file << ":" << ci.line
+            << " (" << ci.level << ") "
+            << (ci.enabled ? "enabled" : "disabled") << ": "
+            << ci.format;
+    }
+
+    inline std::ostream& operator<<(std::ostream& os, const latency_summary& ls)
+    {
+        return os
+            << ls.count << " calls, "
+            << "p50 " << ls.p50 << "ns, "
+            << "p90 " << ls.p90 << "ns, "
+            << "p99 " << ls.p99 << "ns, "
+            << "p99.9 " << ls.p999 << "ns, "
+            << "p99.99 " << ls.p9999 << "ns, "
+            << "max " << ls.max << "ns";
+    }
+
+    inline std::ostream& operator<<(std::ostream& os, const sink_latency& sl)
+    {
+        return os
+            << sl.name << "\n"
+            << "  enqueue: " << sl.enqueue << "\n"
+            << "  blocked: " << sl.blocked;
+    }
 }
 
 #endif
@@ -23,7 +23,24 @@
 
 namespace xtr::detail
 {
-    enum class message_id {status, set_level, sink_info, success, error, reopen};
+    enum class message_id
+    {
+        status,
+        set_level,
+        sink_info,
+        success,
+        error,
+        reopen,
+        latency,
+        sink_latency,
+        stats,
+        sink_stats,
+        consumer_stats,
+        callsites,
+        callsite_info,
+        set_callsite,
+        recover
+    };
 }
 
 #endif
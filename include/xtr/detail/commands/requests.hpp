@@ -47,6 +47,44 @@ namespace xtr::detail
     {
         static constexpr auto frame_id = frame_id_t(message_id::reopen);
     };
+
+    struct latency
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::latency);
+
+        struct pattern pattern;
+    };
+
+    struct stats
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::stats);
+
+        struct pattern pattern;
+    };
+
+    // Callsites are matched by location, formatted as "file:line"
+    struct callsites
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::callsites);
+
+        struct pattern pattern;
+    };
+
+    struct set_callsite
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::set_callsite);
+
+        bool enabled;
+        struct pattern pattern;
+    };
+
+    // Path of a directory containing recovery files, see logger::recover
+    struct recover
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::recover);
+
+        char path[256];
+    };
 }
 
 #endif
@@ -26,6 +26,11 @@ namespace xtr::detail
     struct status;
     struct set_level;
     struct reopen;
+    struct latency;
+    struct stats;
+    struct callsites;
+    struct set_callsite;
+    struct recover;
 }
 
 #endif
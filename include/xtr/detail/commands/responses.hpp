@@ -24,6 +24,8 @@
 #include "message_id.hpp"
 #include "xtr/log_level.hpp"
 
+#include <cstddef>
+#include <cstdint>
 #include <ostream>
 
 namespace xtr::detail
@@ -39,6 +41,68 @@ namespace xtr::detail
         char name[128];
     };
 
+    // Latencies are in nanoseconds
+    struct latency_summary
+    {
+        std::uint64_t count;
+        std::uint64_t p50;
+        std::uint64_t p90;
+        std::uint64_t p99;
+        std::uint64_t p999;
+        std::uint64_t p9999;
+        std::uint64_t max;
+    };
+
+    struct sink_latency
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::sink_latency);
+
+        latency_summary enqueue;
+        latency_summary blocked;
+        char name[128];
+    };
+
+    // Counts are cumulative since the sink was registered
+    struct sink_stats
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::sink_stats);
+
+        std::size_t buf_capacity;
+        std::size_t buf_nbytes;
+        std::size_t peak_nbytes;
+        std::uint64_t bytes_consumed;
+        std::uint64_t records_consumed;
+        std::uint64_t dropped_count;
+        char name[128];
+    };
+
+    // Sent once, after all sink_stats frames. Times are in nanoseconds and
+    // counts are cumulative since the logger was created. If the logger has
+    // more than one consumer thread then format_ns is the total for all
+    // consumer threads.
+    struct consumer_stats
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::consumer_stats);
+
+        std::uint64_t elapsed_ns;
+        std::uint64_t format_ns;
+        std::uint64_t write_ns;
+        std::uint64_t flush_count;
+        std::uint64_t sync_count;
+    };
+
+    // File and format are truncated if necessary
+    struct callsite_info
+    {
+        static constexpr auto frame_id = frame_id_t(message_id::callsite_info);
+
+        log_level_t level;
+        unsigned line;
+        bool enabled;
+        char file[224];
+        char format[256];
+    };
+
     struct success
     {
         static constexpr auto frame_id = frame_id_t(message_id::success);
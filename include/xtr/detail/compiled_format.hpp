@@ -0,0 +1,173 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_COMPILED_FORMAT_HPP
+#define XTR_DETAIL_COMPILED_FORMAT_HPP
+
+#include <fmt/format.h>
+
+// Compiled format strings are built on the type returned by FMT_COMPILE, so
+// require a {fmt} version in which FMT_COMPILE is available to format_to and
+// formatted_size. Log statements are formatted at run time with other
+// versions.
+#if FMT_VERSION >= 80000
+#define XTR_USE_COMPILED_FORMAT 1
+#include <fmt/compile.h>
+#endif
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace xtr
+{
+    struct timespec;
+
+    namespace detail
+    {
+        struct tsc;
+
+        template<typename T>
+        struct string_ref;
+    }
+}
+
+namespace xtr::detail
+{
+#if defined(XTR_USE_COMPILED_FORMAT)
+    // {fmt} recognises a compiled format string by its base class, which is
+    // not public in every {fmt} version, so compiled_format instead derives
+    // from the type returned by FMT_COMPILE (and so from that base). The
+    // string is defined by an inline variable so that the type is the same
+    // in every translation unit.
+    inline constexpr auto fmt_compiled_string = FMT_COMPILE("");
+
+    using compiled_string_base =
+        std::remove_const_t<decltype(fmt_compiled_string)>;
+#else
+    struct compiled_string_base {};
+#endif
+
+    // Wraps a pointer to a format string with static storage duration (see
+    // XTR_LOG_TAGS_IMPL) so that {fmt} may parse the format string at compile
+    // time, as with FMT_COMPILE, rather than each time a record is formatted.
+    // The conversions below hide those of compiled_string_base.
+    template<auto Format>
+    struct compiled_format : compiled_string_base
+    {
+        using char_type = char;
+
+        constexpr operator std::string_view() const noexcept
+        {
+            return *Format;
+        }
+
+        constexpr explicit operator fmt::basic_string_view<char>() const noexcept
+        {
+            const std::string_view s = *Format;
+            return {s.data(), s.size()};
+        }
+    };
+
+    // Returns true if any replacement field in the given format string has
+    // a format spec, e.g. "{:>10}".
+    constexpr bool has_format_specs(std::string_view s) noexcept
+    {
+        for (std::size_t i = 0; i < s.size(); ++i)
+        {
+            if (s[i] != '{')
+                continue;
+            if (i + 1 < s.size() && s[i + 1] == '{')
+            {
+                ++i;
+                continue;
+            }
+            for (++i; i < s.size() && s[i] != '}'; ++i)
+            {
+                if (s[i] == ':')
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename T>
+    struct is_xtr_format_arg : std::false_type {};
+
+    template<>
+    struct is_xtr_format_arg<xtr::timespec> : std::true_type {};
+
+    template<>
+    struct is_xtr_format_arg<tsc> : std::true_type {};
+
+    template<typename T>
+    struct is_xtr_format_arg<string_ref<T>> : std::true_type {};
+
+#if defined(XTR_USE_COMPILED_FORMAT)
+    // Types formatted by {fmt} itself rather than by a formatter
+    // specialization. Any other type (including enums, which {fmt} versions
+    // treat differently) is conservatively treated as user defined.
+    template<typename T, typename U = std::remove_cvref_t<T>>
+    inline constexpr bool is_builtin_format_arg_v =
+        (std::is_arithmetic_v<U> &&
+         !std::is_same_v<U, wchar_t> &&
+         !std::is_same_v<U, char8_t> &&
+         !std::is_same_v<U, char16_t> &&
+         !std::is_same_v<U, char32_t>) ||
+        std::is_same_v<U, const char*> ||
+        std::is_same_v<U, char*> ||
+        std::is_same_v<U, std::string> ||
+        std::is_same_v<U, std::string_view> ||
+        std::is_same_v<U, fmt::string_view> ||
+        std::is_same_v<U, const void*> ||
+        std::is_same_v<U, void*> ||
+        std::is_same_v<U, std::nullptr_t>;
+
+    // Compiled formatting invokes formatters differently to run-time
+    // formatting (custom formatters must be usable with any format context,
+    // and their parse functions are invoked at compile time), so user
+    // defined types are always formatted at run time. XTR's own formatters
+    // ignore format specs, which is an error if parsed at compile time, so
+    // are only compiled if the format string has no specs.
+    template<typename Format, typename... Args>
+    constexpr bool use_compiled_format() noexcept
+    {
+        if constexpr (!std::is_base_of_v<compiled_string_base, Format>)
+            return false;
+        else if constexpr ((is_builtin_format_arg_v<Args> && ...))
+            return true;
+        else if constexpr (
+            !((is_builtin_format_arg_v<Args> || is_xtr_format_arg<Args>::value) && ...))
+            return false;
+        else
+            return !has_format_specs(Format{});
+    }
+
+    template<typename Format, typename... Args>
+    inline constexpr bool use_compiled_format_v =
+        use_compiled_format<Format, Args...>();
+#else
+    template<typename Format, typename... Args>
+    inline constexpr bool use_compiled_format_v = false;
+#endif
+}
+
+#endif
@@ -22,14 +22,31 @@
 #define XTR_DETAIL_CONSUMER_HPP
 
 #include "xtr/log_level.hpp"
+#include "xtr/output_format.hpp"
+#include "xtr/timespec.hpp"
+#include "xtr/wait_strategy.hpp"
+#include "binary_encoder.hpp"
 #include "commands/command_dispatcher_fwd.hpp"
 #include "commands/requests_fwd.hpp"
+#include "print.hpp"
+#include "recovery.hpp"
+#include "tsc.hpp"
+#include "waiter.hpp"
 
+#include <fmt/format.h>
+
+#include <atomic>
+#include <chrono>
 #include <ctime>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <unistd.h>
@@ -41,6 +58,7 @@ namespace xtr
     namespace detail
     {
         class consumer;
+        class consumer_process;
     }
 }
 
@@ -57,6 +75,26 @@ private:
         sink* p;
         std::string name;
         std::size_t dropped_count = 0;
+        std::size_t peak_nbytes = 0;
+        std::uint64_t bytes_consumed = 0;
+        std::uint64_t records_consumed = 0;
+    };
+
+    // State shared by the consumers of a logger with more than one consumer
+    // thread. The first consumer (the primary) owns the back-end, control
+    // commands and command socket, while each additional consumer (a shard)
+    // drains its own subset of sinks, formatting log records in parallel
+    // with the other consumers. Shards either write to the primary's
+    // back-end, whose functions are only invoked while holding the mutex,
+    // or to a back-end of their own (see set_backend). The mutex also
+    // protects the sink lists of the shards. nreopens is incremented when
+    // the primary's back-end is reopened, so that shards with their own
+    // back-ends reopen them too.
+    struct shard_group
+    {
+        std::mutex mutex;
+        std::vector<consumer*> shards;
+        std::atomic<std::uint64_t> nreopens{0};
     };
 
 public:
@@ -78,39 +116,379 @@ public:
         ReopenFunction&& rf,
         CloseFunction&& cf,
         log_level_style_t ls,
-        sink* control)
+        sink* control,
+        detail::waiter* w)
     :
-        out(std::forward<OutputFunction>(of)),
         err(std::forward<ErrorFunction>(ef)),
         flush(std::forward<FlushFunction>(ff)),
         sync(std::forward<SyncFunction>(sf)),
         reopen(std::forward<ReopenFunction>(rf)),
         close(std::forward<CloseFunction>(cf)),
         lstyle(ls),
-        sinks_({{control, "control", 0}})
+        sinks_({{control, "control", 0}}),
+        waiter_(w)
     {
+        set_output(std::forward<OutputFunction>(of));
     }
 
+    // Constructs a shard of the given primary consumer, see shard_group. May
+    // only be called from the primary consumer's thread.
+    consumer(consumer& primary, sink* control, detail::waiter* w);
+
     void add_sink(sink& p, const std::string& name);
 
+    // Gives a shard its own back-end, so that it writes log records in
+    // parallel with the other consumers rather than to the primary's
+    // back-end while holding the shard group mutex. Errors are still
+    // reported via the primary's error function. May only be called before
+    // the shard is started.
+    template<
+        typename OutputFunction,
+        typename FlushFunction,
+        typename SyncFunction,
+        typename ReopenFunction,
+        typename CloseFunction>
+    void set_backend(
+        OutputFunction&& of,
+        FlushFunction&& ff,
+        SyncFunction&& sf,
+        ReopenFunction&& rf,
+        CloseFunction&& cf)
+    {
+        set_output(std::forward<OutputFunction>(of));
+        flush = std::forward<FlushFunction>(ff);
+        sync = std::forward<SyncFunction>(sf);
+        reopen = std::forward<ReopenFunction>(rf);
+        close = std::forward<CloseFunction>(cf);
+        err =
+            [group = group_, primary = primary_](const char* buf, std::size_t size)
+            {
+                std::scoped_lock lock{group->mutex};
+                primary->err(buf, size);
+            };
+        own_backend_ = true;
+    }
+
+    // Sets the output function. Functions accepting a log level are invoked
+    // once per log record, while functions accepting only a buffer and size
+    // are invoked once per batch of records (see write_batch).
+    template<typename OutputFunction>
+    void set_output(OutputFunction&& of)
+    {
+        if constexpr (
+            std::is_invocable_v<
+                OutputFunction, log_level_t, const char*, std::size_t>)
+        {
+            out = std::forward<OutputFunction>(of);
+            out_batch = nullptr;
+        }
+        else
+        {
+            out_batch = std::forward<OutputFunction>(of);
+            out = nullptr;
+        }
+        encoder.reset();
+    }
+
+    // Writes any batched log records to out_batch. Called after each span of
+    // records read from a sink has been processed, and before each command
+    // is run (as commands may flush, close or replace the output).
+    void write_batch(const std::string& name) noexcept;
+
+    // Runs a command sent to the consumer by a sink (see trampolineN). If
+    // the consumer is sharded then the command is run while holding the
+    // shard group mutex, as commands may modify the back-end or sinks.
+    template<typename Func>
+    void command(Func& func, std::string& name)
+    {
+        write_batch(name);
+        // Commands recovered from the queue of an exited process refer to
+        // objects that no longer exist, so are skipped
+        if (recovering_) [[unlikely]]
+            return;
+        const auto lock = lock_backend();
+        func(*this, name);
+    }
+
+    // Returns the consumer owning the back-end functions, i.e. the primary
+    // consumer if this consumer is a shard without its own back-end,
+    // otherwise this consumer. If the back-end is shared (see
+    // shared_backend) then the back-end functions may only be invoked while
+    // holding the lock returned by lock_backend.
+    consumer& backend() noexcept
+    {
+        return primary_ != nullptr && !own_backend_ ? *primary_ : *this;
+    }
+
+    // Returns true if the consumer writes to a back-end that is shared with
+    // other consumers.
+    bool shared_backend() const noexcept
+    {
+        return group_ != nullptr && !own_backend_;
+    }
+
+    std::unique_lock<std::mutex> lock_backend()
+    {
+        if (group_ != nullptr) [[unlikely]]
+            return std::unique_lock<std::mutex>(group_->mutex);
+        return {};
+    }
+
+    // As lock_backend, but only locks if the back-end is shared
+    std::unique_lock<std::mutex> lock_output()
+    {
+        if (shared_backend()) [[unlikely]]
+            return std::unique_lock<std::mutex>(group_->mutex);
+        return {};
+    }
+
+    // Called on the primary consumer before shards are created.
+    void enable_sharding();
+
+    // Writes any log records left in the recovery files in the given
+    // directory by processes that have exited (see detail/recovery.hpp) to
+    // the back-end, then removes the files. Each file is processed by a
+    // child process, so that a corrupt record cannot crash the consumer.
+    // Returns false with errno set if the directory cannot be read,
+    // otherwise sets nfiles to the number of files recovered. May only be
+    // called on the primary consumer.
+    bool recover(const std::string& dir, std::size_t& nfiles) noexcept;
+
+    // Forks the consumer process (see detail/consumer_process.hpp),
+    // returning false with errno set if this is not possible. In the child
+    // the consumer is run until the consumer process exits, so this function
+    // does not return. May only be called on the primary consumer.
+    bool start_process(
+        consumer_process& p,
+        std::function<std::timespec()> clock) noexcept;
+
+    // Formats or encodes (depending on the output format) a log record and
+    // either writes it to the back-end or, if the output is batched, appends
+    // it to the batch buffer. Timestamps of type const char* are the text
+    // timestamps produced by the consumer for the basic log macros, in
+    // which case the binary encoder is given the raw timestamp instead.
+    template<typename Format, typename Timestamp, typename... Args>
+    void print(
+        fmt::memory_buffer& mbuf,
+        const Format& fmt,
+        log_level_t level,
+        Timestamp ts,
+        const std::string& name,
+        const Args&... args)
+    {
+        if (output_format == output_format_t::binary) [[unlikely]]
+        {
+            if constexpr (std::is_convertible_v<Timestamp, const char*>)
+                encode(mbuf, fmt, level, xtr::timespec{ts_}, name, args...);
+            else
+                encode(mbuf, fmt, level, ts, name, args...);
+            return;
+        }
+        if (shared_backend()) [[unlikely]]
+        {
+            // Records are always batched by sharded consumers, with the end
+            // of each record recorded so that they can be written separately
+            // if the back-end is not batched.
+            const auto err_locked =
+                [this](const char* buf, std::size_t size)
+                {
+                    const auto lock = lock_backend();
+                    backend().err(buf, size);
+                };
+            if (detail::format_record(batch_, err_locked, lstyle, fmt, level, ts, name, args...))
+                records_.emplace_back(batch_.size(), level);
+        }
+        else if (out_batch)
+            detail::format_record(batch_, err, lstyle, fmt, level, ts, name, args...);
+        else
+        {
+            mbuf.clear();
+            if (detail::format_record(mbuf, err, lstyle, fmt, level, ts, name, args...))
+                output(level, mbuf.data(), mbuf.size(), ts, name);
+        }
+    }
+
+    // As print, but for log records whose first argument is the timestamp.
+    template<typename Format, typename Timestamp, typename... Args>
+    void print_ts(
+        fmt::memory_buffer& mbuf,
+        const Format& fmt,
+        log_level_t level,
+        const std::string& name,
+        Timestamp ts,
+        const Args&... args)
+    {
+        print(mbuf, fmt, level, ts, name, args...);
+    }
+
     std::function<::ssize_t(log_level_t level, const char* buf, std::size_t size)> out;
+    std::function<::ssize_t(const char* buf, std::size_t size)> out_batch;
     std::function<void(const char* buf, std::size_t size)> err;
     std::function<void()> flush;
     std::function<void()> sync;
     std::function<bool()> reopen;
     std::function<void()> close;
     log_level_style_t lstyle;
+    output_format_t output_format = output_format_t::text;
+    wait_strategy wstrategy = busy_wait_strategy;
+    detail::binary_encoder encoder;
     bool destroy = false;
+    // Number of calls made to flush and sync by the consumer and by sinks,
+    // reported by the stats command.
+    std::uint64_t nflushes = 0;
+    std::uint64_t nsyncs = 0;
 
 private:
+    template<typename Timestamp, typename... Args>
+    void encode(
+        fmt::memory_buffer& mbuf,
+        std::string_view fmt,
+        log_level_t level,
+        const Timestamp& ts,
+        const std::string& name,
+        const Args&... args)
+    {
+        // Format ids are allocated by the encoder as records are written, so
+        // if the back-end is shared then records are encoded and written one
+        // at a time while holding the lock (the encoder being shared).
+        const auto lock = lock_output();
+        consumer& b = backend();
+        lstyle = b.lstyle;
+        output_format = b.output_format;
+#if __cpp_exceptions
+        const std::size_t batch_size = batch_.size();
+        try
+        {
+#endif
+            if (b.out_batch && !shared_backend())
+            {
+                b.encoder.encode(batch_, fmt, level, ts, name, args...);
+                return;
+            }
+            mbuf.clear();
+            b.encoder.encode(mbuf, fmt, level, ts, name, args...);
+            b.output(level, mbuf.data(), mbuf.size(), ts, name);
+#if __cpp_exceptions
+        }
+        catch (const std::exception& e)
+        {
+            // Discard any partially encoded record
+            batch_.resize(batch_size);
+            b.output_error(ts, name, e.what());
+        }
+#endif
+    }
+
+    // Writes to out_batch if the output is batched, otherwise to out.
+    template<typename Timestamp>
+    void output(
+        log_level_t level,
+        const char* buf,
+        std::size_t size,
+        const Timestamp& ts,
+        const std::string& name)
+    {
+#if __cpp_exceptions
+        try
+        {
+#endif
+            const auto start = detail::tsc::now();
+            const ::ssize_t result =
+                out_batch ? out_batch(buf, size) : out(level, buf, size);
+            write_ticks_ += detail::tsc::now().ticks - start.ticks;
+            if (result == -1)
+                return output_error(ts, name, "Write error");
+            if (std::size_t(result) != size)
+                return output_error(ts, name, "Short write");
+#if __cpp_exceptions
+        }
+        catch (const std::exception& e)
+        {
+            output_error(ts, name, e.what());
+        }
+#endif
+    }
+
+    // If binary output is in use then format definitions may have been lost,
+    // so the encoder is reset in order to make the next record
+    // self-describing.
+    template<typename Timestamp>
+    [[gnu::cold, gnu::noinline]] void output_error(
+        const Timestamp& ts,
+        const std::string& name,
+        const char* reason)
+    {
+        encoder.reset();
+        detail::report_error(err, lstyle, ts, name, reason);
+    }
+
+    template<typename Func>
+    void for_each_sink(Func&& func);
+
+    // Called at the start of each loop over sinks if no data was read by the
+    // previous loop, idle_count being the number of consecutive such loops.
+    void wait_for_input(std::size_t idle_count) noexcept;
+
     void status_handler(int fd, detail::status&);
     void set_level_handler(int fd, detail::set_level&);
     void reopen_handler(int fd, detail::reopen&);
+    // Reopens the back-end of a shard with its own back-end, see
+    // shard_group::nreopens
+    void reopen_backend() noexcept;
+    void latency_handler(int fd, detail::latency&);
+    void stats_handler(int fd, detail::stats&);
+    void callsites_handler(int fd, detail::callsites&);
+    void set_callsite_handler(int fd, detail::set_callsite&);
+    void recover_handler(int fd, detail::recover&);
+
+    // Called by the consumer process at the start of each loop over sinks,
+    // returns false if the consumer process should exit.
+    bool poll_process(bool idle) noexcept;
+
+    void recover_file(
+        const char* path,
+        int fd,
+        const detail::recovery_header& hdr) noexcept;
+    friend void detail::recovery_process_init() noexcept;
+    // Runs recover_child with a new consumer, see recovery_process_init
+    [[noreturn]] static void recover_process(
+        int pipe_fd,
+        int fd,
+        const detail::recovery_header& hdr,
+        log_level_style_t ls,
+        output_format_t format,
+        std::timespec ts) noexcept;
+    [[noreturn]] void recover_child(
+        int pipe_fd,
+        int fd,
+        const detail::recovery_header& hdr) noexcept;
 
+    std::timespec ts_{};
+    fmt::memory_buffer batch_;
+    std::vector<std::pair<std::size_t, log_level_t>> records_;
     std::vector<sink_handle> sinks_;
     std::unique_ptr<
         detail::command_dispatcher,
         detail::command_dispatcher_deleter> cmds_;
+    std::shared_ptr<shard_group> group_;
+    consumer* primary_ = nullptr;
+    // Set if this consumer is a shard with its own back-end, see set_backend
+    bool own_backend_ = false;
+    // The value of shard_group::nreopens when the back-end was last reopened
+    std::uint64_t nreopens_ = 0;
+    detail::waiter* waiter_;
+    // Time spent formatting log records and writing to the back-end,
+    // reported by the stats command. If the consumer is sharded then these
+    // are only accessed while holding the shard group mutex.
+    std::uint64_t format_ticks_ = 0;
+    std::uint64_t write_ticks_ = 0;
+    std::chrono::steady_clock::time_point start_time_ =
+        std::chrono::steady_clock::now();
+    // Only set in the process created by recover_file
+    bool recovering_ = false;
+    // Set once the consumer process has been started, in both the
+    // application and the consumer process
+    consumer_process* process_ = nullptr;
 };
 
 #endif
@@ -0,0 +1,235 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_CONSUMER_PROCESS_HPP
+#define XTR_DETAIL_CONSUMER_PROCESS_HPP
+
+#include "file_descriptor.hpp"
+#include "memory_mapping.hpp"
+#include "synchronized_ring_buffer.hpp"
+#include "waiter.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+// A logger's consumer may be moved into a separate process by calling
+// logger::start_consumer_process, after which the queues of sinks created by
+// logger::get_sink (remote sinks) are placed in an arena of memory shared
+// with that process, which reads, formats and writes their log records. The
+// application only writes records to the queues, and a crash of the
+// application cannot lose records that have been written, as the consumer
+// process drains the queues of an application that has exited before
+// exiting itself.
+//
+// Log records contain pointers to code in the application (the trampoline
+// of each record), so the consumer process is created by forking the
+// logger's consumer thread rather than by running a separate executable.
+// Only the forking thread exists in the child, so any lock held by another
+// thread at the time of the fork (e.g. by a formatter or the back-end) is
+// never released there. logger::start_consumer_process therefore refuses
+// to fork unless the only threads are the calling thread, which is blocked
+// waiting for the fork, the consumer thread itself and any thread estimating
+// the TSC frequency. The supported order is to start the consumer process
+// immediately after constructing the logger, before creating other threads;
+// threads created afterwards may use remote sinks as usual.
+//
+// The arena begins with a process_control block, followed by a region for
+// each remote sink consisting of a page-aligned remote_queue header followed
+// by the queue and its mirror. The application allocates regions and
+// publishes them by advancing process_control::used, and the consumer
+// process attaches each region as a proxy sink. Regions are not reused, but
+// the pages of a queue are released when its sink is closed.
+//
+// Commands posted to a remote sink are run by the consumer process, so may
+// not refer to memory in the application. Synchronisation therefore uses
+// remote_sync_command, which waits on a counter in the remote_queue header.
+
+namespace xtr
+{
+    class logger;
+    class sink;
+
+    namespace detail
+    {
+        class consumer;
+        struct process_control;
+        struct remote_queue;
+        struct remote_sync_command;
+        class consumer_process;
+    }
+}
+
+struct xtr::detail::process_control
+{
+    // Wakes the consumer process, shared by all remote sinks
+    waiter w{/*process_shared=*/true};
+    // Bytes of the arena allocated by the application
+    alignas(cacheline_size) std::atomic<std::size_t> used{};
+    // Incremented by the application to request that the consumer process
+    // reopens its back-end
+    std::atomic<std::uint32_t> nreopens{};
+    // Set by the application when the logger is destroyed, after which the
+    // consumer process exits once all remote sinks have been closed
+    std::atomic<bool> shutdown{};
+};
+
+struct xtr::detail::remote_queue
+{
+    synchronized_ring_buffer<>::control_block ctl;
+    // Incremented by the consumer process each time that a
+    // remote_sync_command is run
+    alignas(cacheline_size) std::atomic<std::uint32_t> nsynced{};
+    // Only accessed by the application
+    std::uint32_t nsync_requests = 0;
+    logger* owner;
+    consumer_process* process;
+    // Written by the application before the region is published
+    std::size_t capacity;
+    char name[1024];
+};
+
+// Command posted to a remote sink by sink::sync, sink::close and
+// sink::set_name
+struct xtr::detail::remote_sync_command
+{
+    void operator()(consumer& c, std::string& name) const noexcept;
+
+    remote_queue* queue;
+    bool destroy;
+    // If true the sink is renamed to remote_queue::name
+    bool rename;
+};
+
+class xtr::detail::consumer_process
+{
+public:
+    // Creates the arena, which is reserved but not allocated
+    consumer_process();
+
+    consumer_process(const consumer_process&) = delete;
+    consumer_process& operator=(const consumer_process&) = delete;
+
+    // Requests that the consumer process exits, then waits for it to exit
+    ~consumer_process();
+
+    process_control& control() noexcept
+    {
+        return *control_;
+    }
+
+    // Returns true if the calling process has exactly the given number of
+    // threads, not counting any thread estimating the TSC frequency
+    static bool is_fork_safe(long nthreads) noexcept;
+
+    // Returns the address of the queue of the given region
+    static std::byte* queue_begin(remote_queue& q) noexcept;
+
+    // The following functions are called by the application.
+
+    // Called by consumer::start_process after forking
+    void started(::pid_t pid) noexcept;
+
+    // Allocates a region for a queue of at least the given capacity,
+    // returning nullptr if the arena is exhausted. Calls must be serialised
+    // by the caller.
+    remote_queue* allocate(
+        logger& owner,
+        const std::string& name,
+        std::size_t capacity,
+        int numa_node) noexcept;
+
+    // Waits until the consumer process has run the remote_sync_command with
+    // the given sequence number, or has exited.
+    void wait_synced(const remote_queue& q, std::uint32_t target) noexcept;
+
+    // Called by sink::close once the consumer process has released the
+    // queue of the given region
+    static void release_pages(remote_queue& q) noexcept;
+
+    void request_reopen() noexcept;
+
+    // The following functions are called by the consumer process.
+
+    // Called by consumer::start_process in the child after forking, where
+    // app_pid is the process id of the application
+    void attached(::pid_t app_pid) noexcept;
+
+    bool is_child() const noexcept
+    {
+        return child_;
+    }
+
+    // Returns the next region published by the application, if any
+    remote_queue* next_queue() noexcept;
+
+    // Creates a proxy sink for the queue of the given region, returning
+    // nullptr on failure
+    sink* attach(remote_queue& q) noexcept;
+
+    // Destroys the given sink if it is a proxy
+    void release(sink& s) noexcept;
+
+    bool has_proxies() const noexcept
+    {
+        return !proxies_.empty();
+    }
+
+    bool reopen_requested() noexcept;
+
+    bool shutdown_requested() const noexcept
+    {
+        return control_->shutdown.load();
+    }
+
+    // Returns true if the application has exited. The parent process id is
+    // only read every few calls unless the consumer is idle.
+    bool application_exited(bool idle) noexcept;
+
+private:
+    // Reserved length of the arena, which is mapped with MAP_NORESERVE
+    static constexpr std::size_t arena_length = std::size_t(16) << 30;
+
+    memory_mapping arena_;
+    process_control* control_;
+    // Read end of a pipe whose only write end is held by the consumer
+    // process, so that the application can detect that it has exited
+    file_descriptor alive_fd_;
+    file_descriptor alive_wfd_;
+    // The process id of the consumer process in the application, and of the
+    // application in the consumer process
+    ::pid_t pid_ = -1;
+    bool child_ = false;
+    // Application data
+    std::size_t allocated_;
+    // Consumer process data
+    std::size_t attached_;
+    std::uint32_t nreopens_ = 0;
+    std::size_t npolls_ = 0;
+    bool app_exited_ = false;
+    std::vector<std::unique_ptr<sink>> proxies_;
+};
+
+#endif
@@ -0,0 +1,110 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_GZIP_FILE_HPP
+#define XTR_DETAIL_GZIP_FILE_HPP
+
+#if defined(XTR_ENABLE_ZLIB)
+
+#if defined(__has_include)
+#if !__has_include(<zlib.h>)
+#error "XTR_ENABLE_ZLIB is defined but zlib.h was not found"
+#endif
+#endif
+
+#include "file_descriptor.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+struct z_stream_s;
+
+namespace xtr::detail
+{
+    class gzip_file;
+
+    // Only defined if the library was built with XTR_ENABLE_ZLIB. Called by
+    // the gzip constructor of the logger so that linking an application
+    // built with XTR_ENABLE_ZLIB against a library built without it fails
+    // with an undefined reference to this function.
+    void library_built_with_XTR_ENABLE_ZLIB() noexcept;
+}
+
+// Writes log data to a file compressed with zlib in gzip format. Data is
+// compressed by the consumer thread as it is written, with compressed data
+// being written to the file when the output buffer is full. At each flush
+// point a zlib sync flush is performed, so that all data written so far can
+// be decompressed by a reader of the file (e.g. tail -f file | zcat), while
+// preserving the compression history. Syncing, reopening or closing the file
+// finishes the current gzip member so that the file is a complete gzip file,
+// with the next write beginning a new member (concatenated members are
+// decompressed as a single stream by gzip and zcat).
+class xtr::detail::gzip_file
+{
+public:
+    static constexpr std::size_t buffer_size = 64 * 1024;
+    static constexpr int default_level = 1;
+
+    explicit gzip_file(const char* path, int level = default_level);
+
+    gzip_file(const gzip_file&) = delete;
+
+    gzip_file& operator=(const gzip_file&) = delete;
+
+    ~gzip_file();
+
+    // Returns size if the data was compressed, or -1 (with errno set) if
+    // compressed data could not be written to the file.
+    ::ssize_t write(const char* buf, std::size_t size);
+
+    // Performs a sync flush and writes all compressed data.
+    void flush();
+
+    // Finishes the current member then calls fdatasync.
+    void sync();
+
+    // Finishes the current member then reopens the file.
+    bool reopen();
+
+    // Finishes the current member then closes the file.
+    void close();
+
+private:
+    bool open();
+    bool deflate(int flush);
+    bool finish();
+    bool write_out();
+
+    std::string path_;
+    file_descriptor fd_;
+    std::unique_ptr<::z_stream_s> stream_;
+    std::vector<unsigned char> out_;
+    std::size_t out_size_ = 0; // Compressed data in out_
+    bool pending_ = false; // Set if the current member is unfinished
+    bool dirty_ = false; // Set if data has been written since the last flush
+};
+
+#endif
+
+#endif
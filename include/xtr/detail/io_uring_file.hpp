@@ -0,0 +1,141 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_IO_URING_FILE_HPP
+#define XTR_DETAIL_IO_URING_FILE_HPP
+
+#include "file_descriptor.hpp"
+#include "memory_mapping.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace xtr::detail
+{
+    class io_uring_file;
+}
+
+// Writes log data to a file via io_uring, so that the consumer thread does
+// not block while writes and fdatasync calls are in progress. Data passed to
+// write is copied into one of a fixed set of buffers (registered with the
+// kernel if permitted by RLIMIT_MEMLOCK) and submitted, with the caller only
+// blocking if every buffer is in use. Each write is given an explicit file
+// offset, so data reaches the file in order even if writes complete out of
+// order. If io_uring is unavailable then pwrite(2) and fdatasync(2) are used
+// instead.
+//
+// Errors from asynchronous operations cannot be returned by the call that
+// submitted them, so are returned by the next call to write.
+class xtr::detail::io_uring_file
+{
+public:
+    static constexpr std::size_t default_buffer_count = 16;
+    static constexpr std::size_t default_buffer_size = 64 * 1024;
+
+    explicit io_uring_file(
+        const char* path,
+        std::size_t buffer_count = default_buffer_count,
+        std::size_t buffer_size = default_buffer_size);
+
+    io_uring_file(const io_uring_file&) = delete;
+
+    io_uring_file& operator=(const io_uring_file&) = delete;
+
+    ~io_uring_file();
+
+    // Returns size if the data was submitted, or -1 (with errno set) if an
+    // error occurred, either for this call or a previous asynchronous
+    // operation.
+    ::ssize_t write(const char* buf, std::size_t size);
+
+    // Reaps completed operations, does not block.
+    void flush();
+
+    // Submits an fdatasync, ordered after all previously submitted writes.
+    void sync();
+
+    // Waits for all outstanding operations then reopens the file.
+    bool reopen();
+
+    // Waits for all outstanding operations then closes the file.
+    void close();
+
+    bool uses_io_uring() const noexcept
+    {
+        return ring_fd_.is_open();
+    }
+
+    bool uses_registered_buffers() const noexcept
+    {
+        return registered_;
+    }
+
+private:
+    static constexpr std::uint64_t sync_tag = ~std::uint64_t(0);
+
+    struct pending_write
+    {
+        ::off_t offset;
+        std::uint32_t length;
+        std::uint32_t written;
+    };
+
+    bool open();
+    void setup_ring(std::size_t buffer_count, std::size_t buffer_size);
+    void* next_sqe() noexcept;
+    void prepare_write(std::uint32_t index);
+    void prepare_sync();
+    bool submit(unsigned min_complete);
+    void reap();
+    void wait_all();
+    std::byte* buffer(std::uint32_t index) noexcept;
+
+    std::string path_;
+    file_descriptor fd_;
+    ::off_t offset_ = 0;
+    int error_ = 0;
+
+    file_descriptor ring_fd_;
+    memory_mapping sq_ring_;
+    memory_mapping cq_ring_;
+    memory_mapping sqes_;
+    memory_mapping buffers_;
+    std::size_t buffer_size_ = 0;
+    bool registered_ = false;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    void* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+    unsigned to_submit_ = 0;
+    std::size_t inflight_ = 0;
+    std::size_t max_inflight_ = 0;
+    std::vector<pending_write> writes_;
+    std::vector<std::uint32_t> free_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_LATENCY_HISTOGRAM_HPP
+#define XTR_DETAIL_LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace xtr::detail
+{
+    class latency_histogram;
+    struct latency_stats;
+}
+
+// A log-linear (HDR-style) histogram of latencies, measured in TSC ticks.
+// Each power of two is divided into sub_bucket_count buckets, so recorded
+// values are accurate to within 1/sub_bucket_count of their true value.
+// Values may only be recorded by a single thread, while any thread may
+// read the histogram without locking.
+class xtr::detail::latency_histogram
+{
+public:
+    static constexpr std::size_t sub_bucket_bits = 4;
+    static constexpr std::size_t sub_bucket_count = 1 << sub_bucket_bits;
+    static constexpr std::size_t bucket_count =
+        (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+    static constexpr std::size_t bucket_index(std::uint64_t value) noexcept
+    {
+        if (value < sub_bucket_count)
+            return std::size_t(value);
+        // Values with a bit width of w are placed into a bucket by their top
+        // sub_bucket_bits + 1 bits
+        const std::size_t w = std::size_t(std::bit_width(value));
+        const std::size_t top = std::size_t(value >> (w - sub_bucket_bits - 1));
+        return (w - sub_bucket_bits) * sub_bucket_count + top - sub_bucket_count;
+    }
+
+    // Returns the lowest value that is placed into the given bucket
+    static constexpr std::uint64_t bucket_lowest(std::size_t index) noexcept
+    {
+        if (index < sub_bucket_count)
+            return index;
+        const std::size_t w = index / sub_bucket_count + sub_bucket_bits;
+        const std::uint64_t top = index % sub_bucket_count + sub_bucket_count;
+        return top << (w - sub_bucket_bits - 1);
+    }
+
+    // Returns the highest value that is placed into the given bucket
+    static constexpr std::uint64_t bucket_highest(std::size_t index) noexcept
+    {
+        if (index < sub_bucket_count)
+            return index;
+        const std::size_t w = index / sub_bucket_count + sub_bucket_bits;
+        return
+            bucket_lowest(index) + (std::uint64_t(1) << (w - sub_bucket_bits - 1)) - 1;
+    }
+
+    // As there is only one writer, counts are incremented with a load and a
+    // store rather than with a (more expensive) atomic read-modify-write
+    void record(std::uint64_t value) noexcept
+    {
+        auto& bucket = buckets_[bucket_index(value)];
+        bucket.store(
+            bucket.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        count_.store(
+            count_.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed)) [[unlikely]]
+            max_.store(value, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count() const noexcept
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t max() const noexcept
+    {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    // Returns the highest value that percentile percent (0-100) of recorded
+    // values are less than or equal to, or zero if no values are recorded.
+    std::uint64_t value_at_percentile(double percentile) const noexcept;
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+    std::atomic<std::uint64_t> count_{};
+    std::atomic<std::uint64_t> max_{};
+};
+
+// Producer latency statistics for a sink, see sink::enable_latency_stats.
+// The enqueue histogram records the time taken by every log call, while
+// the blocked histogram records the time taken by log calls that had to
+// wait for space to become available in the sink's queue.
+struct xtr::detail::latency_stats
+{
+    latency_histogram enqueue;
+    latency_histogram blocked;
+};
+
+#endif
@@ -0,0 +1,137 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_LIMITERS_HPP
+#define XTR_DETAIL_LIMITERS_HPP
+
+#include "clock_ids.hpp"
+#include "get_time.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+namespace xtr::detail
+{
+    class every_n_limiter;
+    class first_n_limiter;
+    class rate_limiter;
+}
+
+// Per-callsite state for the limited log macros (XTR_LOG_EVERY_N etc). Each
+// limiter is a static variable at the callsite, so may be shared by several
+// threads. allow() returns true if the log statement should be written, and
+// suppressed() returns the number of statements suppressed since it was
+// last called, which is reported by the macros before the next statement
+// that is written. Suppressing a statement never writes to the sink.
+
+// Allows the first of every N statements
+class xtr::detail::every_n_limiter
+{
+public:
+    bool allow(std::uint64_t n) noexcept
+    {
+        assert(n > 0);
+        return count_.fetch_add(1, std::memory_order_relaxed) % n == 0;
+    }
+
+    // Statements are suppressed at a fixed ratio, so are not reported
+    static constexpr std::uint64_t suppressed() noexcept
+    {
+        return 0;
+    }
+
+private:
+    std::atomic<std::uint64_t> count_{0};
+};
+
+// Allows the first N statements
+class xtr::detail::first_n_limiter
+{
+public:
+    bool allow(std::uint64_t n) noexcept
+    {
+        // Once the limit is reached the count is only read
+        return
+            count_.load(std::memory_order_relaxed) < n &&
+            count_.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+
+    // No statements are written after the limit is reached, so suppressed
+    // statements cannot be reported
+    static constexpr std::uint64_t suppressed() noexcept
+    {
+        return 0;
+    }
+
+private:
+    std::atomic<std::uint64_t> count_{0};
+};
+
+// Allows on average N statements per second, with bursts of up to N
+// statements. Implemented using the generic cell rate algorithm, where the
+// theoretical arrival time (tat) of the next statement is advanced by the
+// interval between statements each time that a statement is allowed.
+class xtr::detail::rate_limiter
+{
+public:
+    bool allow(std::uint64_t per_second) noexcept
+    {
+        const auto ts = get_time<XTR_CLOCK_MONOTONIC_FAST>();
+        return allow(per_second, ts.tv_sec * second + ts.tv_nsec);
+    }
+
+    bool allow(std::uint64_t per_second, std::int64_t now) noexcept
+    {
+        assert(per_second > 0);
+        const std::int64_t interval =
+            std::max<std::int64_t>(second / std::int64_t(per_second), 1);
+        std::int64_t tat = tat_.load(std::memory_order_relaxed);
+        do
+        {
+            if (tat - now > second - interval)
+            {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (
+            !tat_.compare_exchange_weak(
+                tat,
+                std::max(tat, now) + interval,
+                std::memory_order_relaxed));
+        return true;
+    }
+
+    std::uint64_t suppressed() noexcept
+    {
+        if (suppressed_.load(std::memory_order_relaxed) == 0) [[likely]]
+            return 0;
+        return suppressed_.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::int64_t second = 1000000000;
+
+    std::atomic<std::int64_t> tat_{0};
+    std::atomic<std::uint64_t> suppressed_{0};
+};
+
+#endif
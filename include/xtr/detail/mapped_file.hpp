@@ -0,0 +1,103 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_MAPPED_FILE_HPP
+#define XTR_DETAIL_MAPPED_FILE_HPP
+
+#include "file_descriptor.hpp"
+#include "memory_mapping.hpp"
+
+#include <cstddef>
+#include <string>
+
+#include <sys/types.h>
+
+namespace xtr::detail
+{
+    class mapped_file;
+}
+
+// Writes log data to a file by copying it into a shared memory mapping of the
+// file, so that writing does not usually require a system call. The mapping
+// is a window of window_size bytes which slides along the file as data is
+// written; when the window is full, the blocks for the next window are
+// allocated with fallocate(2), the file is extended to the end of the next
+// window, writeback of the retired window is started with msync(2) and the
+// retired window is unmapped, dropping its pages from the consumer's address
+// space.
+//
+// While the file is open its size is rounded up to the end of the window,
+// with the unwritten remainder of the window containing zero bytes. The
+// file is truncated to the size of the data written when it is closed or
+// reopened, and any zero bytes left at the end of the file by a crash (up to
+// one window's worth) are removed when it is opened.
+//
+// The file must not be truncated by other processes while open, as writing
+// to the mapping beyond the end of the file raises SIGBUS.
+class xtr::detail::mapped_file
+{
+public:
+    static constexpr std::size_t default_window_size = 16 * 1024 * 1024;
+
+    explicit mapped_file(
+        const char* path,
+        std::size_t window_size = default_window_size);
+
+    mapped_file(const mapped_file&) = delete;
+
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file();
+
+    // Returns size if the data was copied into the mapping, or -1 (with errno
+    // set) if the file could not be extended or mapped.
+    ::ssize_t write(const char* buf, std::size_t size);
+
+    // Data written is immediately visible to readers of the file, so there
+    // is nothing to flush.
+    void flush() noexcept
+    {
+    }
+
+    // Writes the current window and the file's metadata to disk.
+    void sync();
+
+    // Trims and closes the file then reopens it.
+    bool reopen();
+
+    // Trims and closes the file.
+    void close();
+
+private:
+    bool open();
+    bool advance_window();
+    void retire_window(int flags) noexcept;
+
+    std::string path_;
+    file_descriptor fd_;
+    memory_mapping window_;
+    std::size_t window_size_;
+    ::off_t window_offset_ = 0; // File offset of the start of window_
+    ::off_t offset_ = 0; // File offset at which the next write begins
+    ::off_t size_ = 0; // File size, rounded up to the end of the window
+    ::off_t allocated_ = 0; // File offset up to which blocks are allocated
+};
+
+#endif
@@ -34,6 +34,15 @@
 // This is done via mmap(2). Apparently VirtualAlloc2 can acheive this on
 // Windows via MEM_RESERVE_PLACEHOLDER and MEM_REPLACE_PLACEHOLDER:
 // https://docs.microsoft.com/en-us/windows/win32/api/memoryapi/nf-memoryapi-virtualalloc2
+//
+// On Linux, if MAP_HUGETLB is passed in flags and fd is -1 then the mapping is
+// backed by huge pages via memfd_create(2) with MFD_HUGETLB. If huge pages are
+// unavailable (or length is not a multiple of the huge page size) then normal
+// pages are used instead.
+//
+// If numa_node is not -1 then pages are allocated preferentially on the given
+// NUMA node, with MAP_POPULATE (if passed) deferred until the memory policy has
+// been set.
 
 namespace xtr::detail
 {
@@ -53,6 +62,19 @@ public:
         std::size_t offset = 0, // must be multiple of page size
         int flags = 0);
 
+    mirrored_memory_mapping(
+        std::size_t length,
+        int fd,
+        std::size_t offset,
+        int flags,
+        int numa_node);
+
+    // Mirrors the length bytes at addr, which must be part of an existing
+    // shared mapping, onto the length bytes following them (replacing
+    // whatever was mapped there). Ownership of both halves is taken, so both
+    // are unmapped on destruction. Only implemented on Linux.
+    mirrored_memory_mapping(void* addr, std::size_t length);
+
     ~mirrored_memory_mapping();
 
     void* get()
@@ -75,8 +97,22 @@ public:
         return !!m_;
     }
 
+    // Returns true if the mapping is backed by huge pages
+    bool huge_pages() const
+    {
+        return huge_pages_;
+    }
+
+    // Returns the NUMA node the mapping was bound to, or -1 if none
+    int numa_node() const
+    {
+        return numa_node_;
+    }
+
 private:
     memory_mapping m_;
+    bool huge_pages_ = false;
+    int numa_node_ = -1;
 };
 
 #endif
@@ -0,0 +1,41 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_NUMA_HPP
+#define XTR_DETAIL_NUMA_HPP
+
+#include <cstddef>
+#include <thread>
+
+namespace xtr::detail
+{
+    // Sets the memory policy of the given range to prefer allocating pages
+    // on the given NUMA node. Pages that have already been allocated are not
+    // moved. Does nothing on platforms other than Linux.
+    void set_preferred_numa_node(
+        void* addr, std::size_t length, int node) noexcept;
+
+    // Sets the affinity of the given thread to the CPUs of the given NUMA
+    // node.
+    void bind_thread_to_numa_node(
+        std::thread::native_handle_type thread, int node);
+}
+
+#endif
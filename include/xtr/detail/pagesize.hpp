@@ -26,6 +26,9 @@
 namespace xtr::detail
 {
     std::size_t align_to_page_size(std::size_t length);
+
+    // Only 2MiB huge pages are used, as they are supported by all x86-64 CPUs
+    inline constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
 }
 
 #endif
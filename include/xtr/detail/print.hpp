@@ -22,6 +22,7 @@
 #define XTR_DETAIL_PRINT_HPP
 
 #include "xtr/log_level.hpp"
+#include "compiled_format.hpp"
 
 #include <fmt/format.h>
 
@@ -34,7 +35,6 @@ namespace xtr::detail
 {
     template<typename ErrorFunction,typename Timestamp>
     [[gnu::cold, gnu::noinline]] void report_error(
-        fmt::memory_buffer& mbuf,
         const ErrorFunction& err,
         log_level_style_t lstyle,
         Timestamp ts,
@@ -42,7 +42,10 @@ namespace xtr::detail
         const char* reason)
     {
         using namespace std::literals::string_view_literals;
-        mbuf.clear();
+        // A separate buffer is used as the buffer being formatted into may
+        // hold other log records that are waiting to be written (see
+        // format_record).
+        fmt::memory_buffer mbuf;
 #if FMT_VERSION >= 80000
         fmt::format_to(
             std::back_inserter(mbuf),
@@ -63,69 +66,72 @@ namespace xtr::detail
         err(mbuf.data(), mbuf.size());
     }
 
+    // Formats a log record, appending it to mbuf. If formatting fails then
+    // mbuf is restored to its original size, the error is reported and false
+    // is returned. The format string may either be a compiled_format, in
+    // which case it may be parsed at compile time (see
+    // use_compiled_format_v), or a run-time string.
     template<
-        typename OutputFunction,
         typename ErrorFunction,
+        typename Format,
         typename Timestamp,
         typename... Args>
-    void print(
+    bool format_record(
         fmt::memory_buffer& mbuf,
-        const OutputFunction& out,
         [[maybe_unused]] const ErrorFunction& err,
         log_level_style_t lstyle,
-        std::string_view fmt,
+        const Format& fmt,
         log_level_t level,
         Timestamp ts,
         const std::string& name,
         const Args&... args)
     {
+        [[maybe_unused]] const std::size_t size = mbuf.size();
 #if __cpp_exceptions
         try
         {
 #endif
-            mbuf.clear();
 #if FMT_VERSION >= 80000
+            if constexpr (
+                use_compiled_format_v<Format, const char*, Timestamp, std::string, Args...>)
+            {
+                fmt::format_to(
+                    std::back_inserter(mbuf),
+                    fmt,
+                    lstyle(level),
+                    ts,
+                    name,
+                    args...);
+            }
+            else
+            {
+                fmt::format_to(
+                    std::back_inserter(mbuf),
+                    fmt::runtime(std::string_view(fmt)),
+                    lstyle(level),
+                    ts,
+                    name,
+                    args...);
+            }
+#else
             fmt::format_to(
-                std::back_inserter(mbuf),
-                fmt::runtime(fmt),
+                mbuf,
+                std::string_view(fmt),
                 lstyle(level),
                 ts,
                 name,
                 args...);
-#else
-            fmt::format_to(mbuf, fmt, lstyle(level), ts, name, args...);
 #endif
-            const auto result = out(level, mbuf.data(), mbuf.size());
-            if (result == -1)
-                return report_error(mbuf, err, lstyle, ts, name, "Write error");
-            if (std::size_t(result) != mbuf.size())
-                return report_error(mbuf, err, lstyle, ts, name, "Short write");
 #if __cpp_exceptions
         }
         catch (const std::exception& e)
         {
-            report_error(mbuf, err, lstyle, ts, name, e.what());
+            mbuf.resize(size);
+            report_error(err, lstyle, ts, name, e.what());
+            return false;
         }
 #endif
-    }
-
-    template<
-        typename OutputFunction,
-        typename ErrorFunction,
-        typename Timestamp,
-        typename... Args>
-    void print_ts(
-        fmt::memory_buffer& mbuf,
-        const OutputFunction& out,
-        const ErrorFunction& err,
-        log_level_style_t lstyle,
-        std::string_view fmt,
-        log_level_t level,
-        const std::string& name,
-        Timestamp ts,
-        const Args&... args)
-    {
-        print(mbuf, out, err, lstyle, fmt, level, ts, name, args...);
+        return true;
     }
 }
 
@@ -0,0 +1,188 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_RECOVERY_HPP
+#define XTR_DETAIL_RECOVERY_HPP
+
+#include "file_descriptor.hpp"
+#include "memory_mapping.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <sys/types.h>
+
+// Recoverable sinks have queues backed by a file, named xtr.<pid>.<n>.buf in
+// a private subdirectory of the recovery directory (see
+// logger::set_recovery_directory), rather than by anonymous memory. The first page of the file is a recovery_header, and the
+// remainder is the queue itself. If the process dies without closing the sink
+// then the file remains, and records that were queued but not yet consumed
+// may be recovered by a later run of the same program (see
+// consumer::recover).
+//
+// Log records contain pointers to code (the trampoline of each record) and
+// to the queue itself (e.g. string tables), so records can only be
+// processed by the same executable, with the queue mapped at the same
+// address. Code pointers are rebased using the load address of the
+// executable recorded in the header.
+//
+// Recovery runs trampolines, so may crash, and so is done by a separate
+// process. The consumer is multithreaded, so rather than running anything
+// after a fork (when locks held by other threads could never be released),
+// consumer::recover_file starts a new instance of the executable with the
+// recovery_env_var environment variable set, calling only async-signal-safe
+// functions between fork and exec. recovery_process_init then recovers the
+// file and exits. It is a constructor function with the highest priority
+// available to applications, so runs before the static initialisers of the
+// executable (which may e.g. open files or start threads), and main is
+// never run.
+//
+// Recovery maps the queue at the address recorded in the file and calls
+// code pointers read from it, so files are only trusted if they are regular
+// files owned by the effective user and not writable by other users, in a
+// directory that is only accessible by the effective user. The environment
+// variable is read with secure_getenv, so is ignored by set-user-ID and
+// set-group-ID programs.
+//
+// Producers are unaffected, as the position of the end of the written data
+// is found when recovering by scanning records: the consumer zeroes each
+// span of records after it has been consumed, then records the number of
+// bytes consumed in the header, so the first zero function pointer after
+// that position marks the end of the written data.
+
+namespace xtr::detail
+{
+    struct recovery_header;
+    class recovery_file;
+
+    // Identifies the executable, so that a recovery file is only processed
+    // by the program that wrote it.
+    struct executable_image
+    {
+        std::uintptr_t base;
+        std::size_t size;
+        std::uint32_t build_id_size;
+        unsigned char build_id[32];
+    };
+
+    executable_image get_executable_image() noexcept;
+
+    bool same_executable(
+        const executable_image& a,
+        const executable_image& b) noexcept;
+
+    // Returns the path of the subdirectory of dir in which recovery files
+    // are kept, xtr.<euid>.recovery.
+    std::string recovery_subdirectory(const std::string& dir);
+
+    // Opens a recovery subdirectory, creating it (with mode 0700) first if
+    // create is true. Returns an invalid file descriptor and sets errno if
+    // the directory cannot be opened, or to EACCES if it is a symbolic link,
+    // is not owned by the effective user or is accessible by other users.
+    file_descriptor open_recovery_subdirectory(
+        const char* path,
+        bool create) noexcept;
+
+    // Returns true if the open file is of the given type (e.g. S_IFREG), is
+    // owned by the effective user and has none of the given permission bits
+    // set.
+    bool is_owned_by_user(
+        int fd,
+        ::mode_t type,
+        ::mode_t excluded) noexcept;
+
+    // Opens the recovery file at the given path and reads its header,
+    // returning an invalid file descriptor if the file is not a recovery file
+    // written by the current executable in a process that has since exited,
+    // or is not owned by the effective user (see is_owned_by_user).
+    file_descriptor open_recovery_file(const char* path, recovery_header& hdr);
+
+    // Maps the queue of a recovery file at the address that it was mapped at
+    // by the process that wrote it, returning false if that is not possible.
+    // The mapping is never unmapped, so this is only intended to be called
+    // by a process created to recover the file.
+    bool map_recovered_queue(int fd, const recovery_header& hdr) noexcept;
+
+    // Set in the environment of processes started by consumer::recover_file
+    // to the descriptors and consumer state needed by recovery_process_init
+    inline constexpr char recovery_env_var[] = "XTR_RECOVERY_PROCESS";
+
+    // Run before main and before the static initialisers of the executable
+    // in every process (as a constructor function), recovers a file and exits
+    // if recovery_env_var is set
+    void recovery_process_init() noexcept;
+}
+
+struct xtr::detail::recovery_header
+{
+    static constexpr std::uint64_t magic_value = 0x3176636552525458; // XTRRecv1
+
+    std::uint64_t magic;
+    std::int64_t pid;
+    std::uint64_t capacity;
+    // Address of the queue in the process that created the file
+    std::uint64_t address;
+    executable_image image;
+    char name[128];
+    // Number of bytes consumed, written by the consumer via std::atomic_ref
+    // (the header is also read with pread, so has no atomic members)
+    alignas(64) std::uint64_t nread;
+};
+
+class xtr::detail::recovery_file
+{
+public:
+    // Creates a recovery file in the given directory for a queue of the given
+    // length in bytes, which must be a multiple of the page size.
+    recovery_file(
+        const std::string& dir,
+        const std::string& name,
+        std::size_t length);
+
+    recovery_file(const recovery_file&) = delete;
+    recovery_file& operator=(const recovery_file&) = delete;
+
+    // Removes the file, the sink having been closed
+    ~recovery_file();
+
+    int fd() const noexcept
+    {
+        return fd_.get();
+    }
+
+    // Offset of the queue in the file
+    static std::size_t queue_offset() noexcept;
+
+    // Called after the queue has been mapped
+    void set_address(const void* addr) noexcept;
+
+    // Called by the consumer after consuming [begin, end)
+    void consumed(std::byte* begin, std::byte* end) noexcept;
+
+private:
+    std::string path_;
+    file_descriptor fd_;
+    memory_mapping header_map_;
+    recovery_header* header_;
+};
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_ROTATING_FILE_HPP
+#define XTR_DETAIL_ROTATING_FILE_HPP
+
+#include "xtr/rotation_policy.hpp"
+#include "file_descriptor.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace xtr::detail
+{
+    class rotating_file;
+}
+
+// Writes log data to a file, rotating the file according to a
+// rotation_policy. Rotation is performed by the consumer thread between
+// writes, so a batch of log records is never split between files. The file
+// that replaces the rotated file is created (and, if the policy has a size
+// limit, allocated with fallocate(2)) in advance at path.next, by flush
+// (which the consumer calls when idle) or by the first rotation. Rotating
+// then only requires renaming files: rotated files are shifted up by one,
+// the current file is linked to path.1 and path.next is renamed over path,
+// so that path always exists.
+//
+// If rotation fails then writing continues to the current file, with
+// rotation being attempted again once a further rotation_retry_bytes have
+// been written or rotation_retry_interval has passed, whichever is first. A
+// failed rotation leaves the rotated files as they were after the shift
+// (with path.1 removed), so retrying does not shift them again.
+//
+// Disk blocks allocated in advance for a file but not used are released
+// before the file is rotated or closed.
+class xtr::detail::rotating_file
+{
+public:
+    static constexpr std::size_t buffer_size = 64 * 1024;
+    static constexpr std::size_t rotation_retry_bytes = buffer_size;
+    static constexpr std::chrono::seconds rotation_retry_interval{1};
+
+    rotating_file(const char* path, const rotation_policy& policy);
+
+    rotating_file(const rotating_file&) = delete;
+
+    rotating_file& operator=(const rotating_file&) = delete;
+
+    ~rotating_file();
+
+    // Returns size if the data was written or buffered, or -1 (with errno
+    // set) if an error occurred.
+    ::ssize_t write(const char* buf, std::size_t size);
+
+    // Writes any buffered data, then creates the next file if necessary.
+    void flush();
+
+    void sync();
+
+    bool reopen();
+
+    // Closes the file and removes the next file.
+    void close();
+
+    std::size_t rotation_count() const noexcept
+    {
+        return nrotations_;
+    }
+
+private:
+    bool open();
+    bool open_next() noexcept;
+    bool rotate();
+    void release_space() noexcept;
+    bool write_buffer() noexcept;
+    bool write_all(const char* buf, std::size_t size) noexcept;
+    std::string rotated_path(std::size_t index) const;
+
+    bool rotation_due(std::size_t size) const noexcept
+    {
+        return
+            (policy_.max_bytes != 0 && size_ + size > policy_.max_bytes) ||
+            (policy_.max_age.count() != 0 &&
+                std::chrono::steady_clock::now() - opened_ >= policy_.max_age);
+    }
+
+    bool rotation_retry_due() const noexcept
+    {
+        return
+            size_ >= retry_size_ ||
+            std::chrono::steady_clock::now() >= retry_time_;
+    }
+
+    bool rotates() const noexcept
+    {
+        return policy_.max_bytes != 0 || policy_.max_age.count() != 0;
+    }
+
+    std::string path_;
+    std::string next_path_;
+    rotation_policy policy_;
+    file_descriptor fd_;
+    file_descriptor next_fd_;
+    std::vector<char> buf_;
+    std::size_t size_ = 0; // Size of the file including buffered data
+    std::size_t nrotations_ = 0;
+    std::chrono::steady_clock::time_point opened_;
+    // Set when a rotation fails, see rotation_retry_due
+    std::size_t retry_size_ = 0;
+    std::chrono::steady_clock::time_point retry_time_;
+};
+
+#endif
@@ -21,15 +21,24 @@
 #ifndef XTR_DETAIL_SANITIZE_HPP
 #define XTR_DETAIL_SANITIZE_HPP
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 namespace xtr::detail
 {
+    inline bool is_safe_char(char c) noexcept
+    {
+        return c >= ' ' && c <= '~' && c != '\\';
+    }
+
     // Transforms non-printable characters and backslash to hex (\xFF).
     // Backslash is treated like this to prevent terminal escape
     // sequence injection attacks.
     template<typename OutputIterator>
     void sanitize_char_to(OutputIterator& pos, char c)
     {
-        if (c >= ' ' && c <= '~' && c != '\\') [[likely]]
+        if (is_safe_char(c)) [[likely]]
         {
             *pos++ = c;
         }
@@ -42,6 +51,56 @@ namespace xtr::detail
             *pos++ = hex[c & 0xF];
         }
     }
+
+    // Returns a pointer to the first character in [begin, end) that would be
+    // transformed by sanitize_char_to, or end if there are none. If AVX2 or
+    // SSE2 is available then 32 or 16 characters are checked at a time.
+    inline const char* find_unsafe_char(const char* begin, const char* end) noexcept
+    {
+#if defined(__AVX2__)
+        const __m256i lo = _mm256_set1_epi8(' ' - 1);
+        const __m256i hi = _mm256_set1_epi8('~' + 1);
+        const __m256i bs = _mm256_set1_epi8('\\');
+        for (; end - begin >= 32; begin += 32)
+        {
+            const __m256i v =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            // Comparisons are signed, so characters above 0x7F are negative
+            // and fail the first comparison
+            const __m256i safe =
+                _mm256_andnot_si256(
+                    _mm256_cmpeq_epi8(v, bs),
+                    _mm256_and_si256(
+                        _mm256_cmpgt_epi8(v, lo),
+                        _mm256_cmpgt_epi8(hi, v)));
+            const auto mask = unsigned(_mm256_movemask_epi8(safe));
+            if (mask != 0xFFFFFFFF)
+                return begin + __builtin_ctz(~mask);
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i lo128 = _mm_set1_epi8(' ' - 1);
+        const __m128i hi128 = _mm_set1_epi8('~' + 1);
+        const __m128i bs128 = _mm_set1_epi8('\\');
+        for (; end - begin >= 16; begin += 16)
+        {
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            const __m128i safe =
+                _mm_andnot_si128(
+                    _mm_cmpeq_epi8(v, bs128),
+                    _mm_and_si128(
+                        _mm_cmpgt_epi8(v, lo128),
+                        _mm_cmplt_epi8(v, hi128)));
+            const auto mask = unsigned(_mm_movemask_epi8(safe));
+            if (mask != 0xFFFF)
+                return begin + __builtin_ctz(~mask);
+        }
+#endif
+        while (begin != end && is_safe_char(*begin))
+            ++begin;
+        return begin;
+    }
 }
 
 #endif
@@ -24,7 +24,12 @@
 #include "sanitize.hpp"
 
 #include <fmt/core.h>
+#if FMT_VERSION >= 80000
+#include <fmt/compile.h>
+#endif
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <string_view>
 
@@ -51,6 +56,35 @@ namespace xtr::detail
         const char* str;
     };
 
+    // Writes [begin, end) to pos, sanitized as per sanitize_char_to, copying
+    // runs of characters that do not need to be transformed in bulk.
+    template<typename OutputIterator>
+    OutputIterator sanitize_to(
+        OutputIterator pos,
+        const char* begin,
+        const char* end)
+    {
+        for (;;)
+        {
+            const char* run_end = find_unsafe_char(begin, end);
+#if FMT_VERSION >= 80000
+            // Formatting a string_view with a compiled format string appends
+            // it to the output buffer in bulk, via the public API
+            pos =
+                fmt::format_to(
+                    pos,
+                    FMT_COMPILE("{}"),
+                    fmt::string_view(begin, std::size_t(run_end - begin)));
+#else
+            pos = std::copy(begin, run_end, pos);
+#endif
+            if (run_end == end)
+                return pos;
+            sanitize_char_to(pos, *run_end);
+            begin = run_end + 1;
+        }
+    }
+
     string_ref(const char*) -> string_ref<const char*>;
     string_ref(const std::string&) -> string_ref<const char*>;
     string_ref(const std::string_view&) -> string_ref<std::string_view>;
@@ -82,10 +116,11 @@ namespace fmt
         template<typename FormatContext>
         auto format(xtr::detail::string_ref<const char*> ref, FormatContext &ctx)
         {
-            auto pos = ctx.out();
-            while (*ref.str != '\0')
-                xtr::detail::sanitize_char_to(pos, *ref.str++);
-            return pos;
+            return
+                xtr::detail::sanitize_to(
+                    ctx.out(),
+                    ref.str,
+                    ref.str + std::strlen(ref.str));
         }
     };
 
@@ -101,10 +136,11 @@ namespace fmt
         template<typename FormatContext>
         auto format(const xtr::detail::string_ref<std::string_view> ref, FormatContext &ctx)
         {
-            auto pos = ctx.out();
-            for (const char c : ref.str)
-                xtr::detail::sanitize_char_to(pos, c);
-            return pos;
+            return
+                xtr::detail::sanitize_to(
+                    ctx.out(),
+                    ref.str.data(),
+                    ref.str.data() + ref.str.size());
         }
     };
 }
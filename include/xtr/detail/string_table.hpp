@@ -21,13 +21,13 @@
 #ifndef XTR_DETAIL_STRING_TABLE_HPP
 #define XTR_DETAIL_STRING_TABLE_HPP
 
-#include "pause.hpp"
 #include "is_c_string.hpp"
 #include "string_ref.hpp"
 #include "tags.hpp"
 
 #include <concepts>
 #include <cstddef>
+#include <cstring>
 #include <string>
 #include <string_view>
 #include <type_traits>
@@ -51,20 +51,57 @@ namespace xtr::detail
         return std::forward<T>(value);
     }
 
-    template<typename Tags, typename Buffer, typename String>
-    requires
-        std::same_as<String, std::string> ||
-        std::same_as<String, std::string_view>
+    // Strings of up to 64 bytes, which are typical of log arguments, are
+    // copied inline by two (possibly overlapping) fixed size copies, as
+    // calling memcpy costs more than the copy itself.
+    inline void copy_string(
+        std::byte* dst,
+        const char* src,
+        std::size_t length) noexcept
+    {
+        if (length > 64)
+        {
+            std::memcpy(dst, src, length);
+        }
+        else if (length >= 32)
+        {
+            std::memcpy(dst, src, 32);
+            std::memcpy(dst + length - 32, src + length - 32, 32);
+        }
+        else if (length >= 16)
+        {
+            std::memcpy(dst, src, 16);
+            std::memcpy(dst + length - 16, src + length - 16, 16);
+        }
+        else if (length >= 8)
+        {
+            std::memcpy(dst, src, 8);
+            std::memcpy(dst + length - 8, src + length - 8, 8);
+        }
+        else if (length >= 4)
+        {
+            std::memcpy(dst, src, 4);
+            std::memcpy(dst + length - 4, src + length - 4, 4);
+        }
+        else
+        {
+            for (std::size_t i = 0; i < length; ++i)
+                dst[i] = std::byte(src[i]);
+        }
+    }
+
+    template<typename Tags, typename Buffer>
     string_ref<const char*> build_string_table(
         std::byte*& pos,
         std::byte*& end,
         Buffer& buf,
-        const String& sv)
+        const char* str,
+        std::size_t length)
     {
-        std::byte* str_end = pos + sv.length();
+        std::byte* str_end = pos + length;
         while (end < str_end + 1) [[unlikely]]
         {
-            detail::pause();
+            buf.writer_pause();
             const auto s = buf.write_span();
             if (s.end() < str_end + 1) [[unlikely]]
             {
@@ -74,13 +111,27 @@ namespace xtr::detail
             end = s.end();
         }
         const char* result = reinterpret_cast<char*>(pos);
-        const char* str = sv.data();
-        while (pos != str_end)
-            new (pos++) char(*str++);
-        new (pos++) char('\0');
+        copy_string(pos, str, length);
+        new (str_end) char('\0');
+        pos = str_end + 1;
         return string_ref(result);
     }
 
+    template<typename Tags, typename Buffer, typename String>
+    requires
+        std::same_as<String, std::string> ||
+        std::same_as<String, std::string_view>
+    string_ref<const char*> build_string_table(
+        std::byte*& pos,
+        std::byte*& end,
+        Buffer& buf,
+        const String& sv)
+    {
+        return build_string_table<Tags>(pos, end, buf, sv.data(), sv.length());
+    }
+
+    // The length of the string is found up front (strlen is vectorized by
+    // the C library) so that capacity only needs to be checked once.
     template<typename Tags, typename Buffer>
     string_ref<const char*> build_string_table(
         std::byte*& pos,
@@ -88,23 +139,34 @@ namespace xtr::detail
         Buffer& buf,
         const char* str)
     {
-        const char* result = reinterpret_cast<char*>(pos);
-        do
-        {
-            while (pos == end) [[unlikely]]
-            {
-                detail::pause();
-                const auto s = buf.write_span();
-                if (s.end() == end) [[unlikely]]
-                {
-                    if (s.size() == buf.capacity() || is_non_blocking_v<Tags>)
-                        return string_ref("<truncated>");
-                }
-                end = s.end();
-            }
-            new (pos++) char(*str);
-        } while (*str++ != '\0');
-        return string_ref(result);
+        return build_string_table<Tags>(pos, end, buf, str, std::strlen(str));
+    }
+
+    // Returns the number of bytes that build_string_table writes to the
+    // string table for the given value, allowing space for the table to be
+    // reserved up front.
+    template<typename T>
+    requires
+        (!is_c_string<T>::value &&
+         !std::same_as<std::remove_cvref_t<T>, std::string> &&
+         !std::same_as<std::remove_cvref_t<T>, std::string_view>)
+    constexpr std::size_t string_table_size(const T&) noexcept
+    {
+        return 0;
+    }
+
+    template<typename String>
+    requires
+        std::same_as<String, std::string> ||
+        std::same_as<String, std::string_view>
+    std::size_t string_table_size(const String& sv) noexcept
+    {
+        return sv.length() + 1;
+    }
+
+    inline std::size_t string_table_size(const char* str) noexcept
+    {
+        return std::strlen(str) + 1;
     }
 }
 
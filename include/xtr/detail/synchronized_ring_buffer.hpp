@@ -46,6 +46,14 @@ namespace xtr::detail
     inline constexpr int srb_flags = 0;
 #endif
 
+    // May be added to the flags passed to synchronized_ring_buffer to request
+    // that the buffer is backed by huge pages, see mirrored_memory_mapping.
+#if defined(MAP_HUGETLB)
+    inline constexpr int srb_huge_pages = MAP_HUGETLB;
+#else
+    inline constexpr int srb_huge_pages = 0;
+#endif
+
     template<std::size_t Capacity>
     class synchronized_ring_buffer;
 
@@ -162,6 +170,20 @@ public:
 
     static constexpr bool is_dynamic = Capacity == dynamic_capacity;
 
+    // Counters shared by the reader and writer, each on its own cache line.
+    // The counters are normally part of the buffer, but may instead be placed
+    // alongside the buffer's memory in a mapping shared by two processes, see
+    // the adopting constructor.
+    struct control_block
+    {
+        // Written by the writer only
+        alignas(cacheline_size) std::atomic<size_type> nwritten{};
+        // Written by the reader only
+        alignas(cacheline_size) std::atomic<size_type> nread_plus_capacity{};
+        // Written by both the reader and writer
+        alignas(cacheline_size) std::atomic<size_type> dropped_count{};
+    };
+
 public:
     synchronized_ring_buffer(
         int fd = -1,
@@ -170,7 +192,7 @@ public:
     requires (!is_dynamic)
     {
         m_ = mirrored_memory_mapping{capacity(), fd, offset, flags};
-        nread_plus_capacity_ = wrnread_plus_capacity_ = capacity();
+        ctl_->nread_plus_capacity = wrnread_plus_capacity_ = capacity();
         wrbase_ = begin();
     }
 
@@ -178,33 +200,47 @@ public:
         size_type min_capacity,
         int fd = -1,
         std::size_t offset = 0,
-        int flags = srb_flags)
+        int flags = srb_flags,
+        int numa_node = -1)
     requires is_dynamic
     :
-        m_(
-            align_to_page_size(
-#if defined(__cpp_lib_int_pow2) && __cpp_lib_int_pow2 >= 202002L
-                std::bit_ceil(min_capacity)),
-#else
-                std::ceil2(min_capacity)),
-#endif
-            fd,
-            offset,
-            flags)
+        m_(mapping_length(min_capacity, flags), fd, offset, flags, numa_node)
     {
         assert(capacity() <= std::numeric_limits<size_type>::max());
         wrbase_ = begin();
         wrcapacity_ = capacity();
-        nread_plus_capacity_ = wrnread_plus_capacity_ = capacity();
+        ctl_->nread_plus_capacity = wrnread_plus_capacity_ = capacity();
+    }
+
+    // Adopts the given mapping, using the given control block rather than
+    // the buffer's own. The control block must have been initialised with
+    // init_control_block, and may be adopted by both a reader and a writer
+    // in different processes.
+    synchronized_ring_buffer(mirrored_memory_mapping m, control_block& ctl)
+    requires is_dynamic
+    :
+        wrctl_(&ctl),
+        ctl_(&ctl),
+        m_(std::move(m))
+    {
+        wrbase_ = begin();
+        wrcapacity_ = capacity();
+        wrnread_plus_capacity_ = ctl.nread_plus_capacity.load();
+        wrnwritten_ = ctl.nwritten.load();
+    }
+
+    static void init_control_block(control_block& ctl, size_type capacity)
+    {
+        ctl.nwritten = 0;
+        ctl.nread_plus_capacity = capacity;
+        ctl.dropped_count = 0;
     }
 
     void clear() noexcept
     {
-        nwritten_ = 0;
+        init_control_block(*ctl_, capacity());
         wrnread_plus_capacity_ = capacity();
         wrnwritten_ = 0;
-        nread_plus_capacity_ = capacity();
-        dropped_count_ = 0;
     }
 
     constexpr size_type capacity() const noexcept
@@ -225,7 +261,7 @@ public:
         if constexpr (!is_speculative_v<Tags>)
         {
             wrnread_plus_capacity_ =
-                nread_plus_capacity_.load(std::memory_order_acquire);
+                wrctl_->nread_plus_capacity.load(std::memory_order_acquire);
         }
 
         size_type sz = wrnread_plus_capacity_ - wrnwritten_;
@@ -234,10 +270,10 @@ public:
         while (sz < minsize) [[unlikely]]
         {
             if constexpr (!is_non_blocking_v<Tags>)
-                pause();
+                writer_pause();
 
             wrnread_plus_capacity_ =
-                nread_plus_capacity_.load(std::memory_order_acquire);
+                wrctl_->nread_plus_capacity.load(std::memory_order_acquire);
             sz = wrnread_plus_capacity_ - wrnwritten_;
 
             if constexpr (is_non_blocking_v<Tags>)
@@ -246,7 +282,7 @@ public:
 
         if (is_non_blocking_v<Tags> && sz < minsize) [[unlikely]]
         {
-            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            wrctl_->dropped_count.fetch_add(1, std::memory_order_relaxed);
             return span{};
         }
 
@@ -264,13 +300,24 @@ public:
 
     void reduce_writable(size_type nbytes) noexcept
     {
-        assert(nbytes <= nread_plus_capacity_.load() - nwritten_.load());
+        assert(nbytes <= wrctl_->nread_plus_capacity.load() - wrctl_->nwritten.load());
         // This release pairs with the acquire in read_span(). No reads or writes
         // in the current thread can be reordered after this store.
-        nwritten_.fetch_add(nbytes, std::memory_order_release);
+        wrctl_->nwritten.fetch_add(nbytes, std::memory_order_release);
         wrnwritten_ += nbytes;
     }
 
+    // Returns true if the reader had read everything written before the
+    // last nbytes passed to reduce_writable, i.e. if writing them made the
+    // buffer non-empty. May only be called by the writer.
+    bool was_empty(size_type nbytes) const noexcept
+    {
+        const size_type nr =
+            wrctl_->nread_plus_capacity.load(std::memory_order_relaxed) -
+            wrcapacity();
+        return wrnwritten_ - nr <= nbytes;
+    }
+
     const_span read_span() const noexcept
     {
         return const_cast<synchronized_ring_buffer<Capacity>&>(*this).read_span();
@@ -281,11 +328,11 @@ public:
         // read_span() returns a contiguous span of bytes currently available to
         // be read from the buffer.
         const size_type nr =
-            nread_plus_capacity_.load(std::memory_order_relaxed) - capacity();
+            ctl_->nread_plus_capacity.load(std::memory_order_relaxed) - capacity();
         const auto b = begin() + clamp(nr, capacity());
         // This acquire pairs with the release in reduce_writable(). No reads or
         // writes in the current thread can be reordered before this load.
-        const size_type sz = nwritten_.load(std::memory_order_acquire) - nr;
+        const size_type sz = ctl_->nwritten.load(std::memory_order_acquire) - nr;
         // span must always begin in the first mapping
         assert(b >= begin());
         assert(b < end());
@@ -296,9 +343,9 @@ public:
     {
         // This release pairs with the acquire in write_span(). No reads or writes
         // in the current thread can be reordered after this store.
-        nread_plus_capacity_.fetch_add(nbytes, std::memory_order_release);
+        ctl_->nread_plus_capacity.fetch_add(nbytes, std::memory_order_release);
 #if !defined(XTR_THREAD_SANITIZER_ENABLED)
-        assert(nread_plus_capacity_.load() - nwritten_.load() <= capacity());
+        assert(ctl_->nread_plus_capacity.load() - ctl_->nwritten.load() <= capacity());
 #endif
     }
 
@@ -324,7 +371,86 @@ public:
 
     std::size_t dropped_count() noexcept
     {
-        return dropped_count_.exchange(0, std::memory_order_relaxed);
+        return ctl_->dropped_count.exchange(0, std::memory_order_relaxed);
+    }
+
+    // Called by the writer while waiting for space to become available.
+    void writer_pause() noexcept
+    {
+        ++wrpause_count_;
+        pause();
+    }
+
+    // Returns the number of times that writer_pause has been called, may
+    // only be called by the writer.
+    std::size_t writer_pause_count() const noexcept
+    {
+        return wrpause_count_;
+    }
+
+    // Returns true if the buffer is backed by huge pages
+    bool huge_pages() const noexcept
+    {
+        return m_.huge_pages();
+    }
+
+    // Returns the NUMA node the buffer was bound to, or -1 if none
+    int numa_node() const noexcept
+    {
+        return m_.numa_node();
+    }
+
+    // The following functions are used by writers that reserve space
+    // themselves rather than via write_span/reduce_writable, allowing the
+    // buffer to be written by multiple threads (see shared_sink). Such
+    // writers must not use write_span or reduce_writable.
+
+    // Returns the position in the first mapping of the given byte count
+    iterator position(size_type n) noexcept
+    {
+        return begin() + clamp(n, capacity());
+    }
+
+    size_type nread_plus_capacity() const noexcept
+    {
+        // This acquire pairs with the release in reduce_readable()
+        return wrctl_->nread_plus_capacity.load(std::memory_order_acquire);
+    }
+
+    size_type nwritten() const noexcept
+    {
+        return wrctl_->nwritten.load();
+    }
+
+    // Advances the count of bytes written from expected to desired if it is
+    // equal to expected, otherwise expected is set to the current count.
+    // Sequentially consistent so that writers publishing each other's
+    // writes cannot miss a write, see shared_sink::publish.
+    bool publish(size_type& expected, size_type desired) noexcept
+    {
+        return wrctl_->nwritten.compare_exchange_strong(expected, desired);
+    }
+
+    void add_dropped() noexcept
+    {
+        wrctl_->dropped_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Returns the length of the mapping created for a buffer of at least
+    // min_capacity bytes, which is the capacity of the buffer
+    static std::size_t mapping_length(size_type min_capacity, int flags)
+    {
+        const std::size_t length =
+#if defined(__cpp_lib_int_pow2) && __cpp_lib_int_pow2 >= 202002L
+            std::bit_ceil(min_capacity);
+#else
+            std::ceil2(min_capacity);
+#endif
+        // Huge page backed buffers are rounded up to a whole number of huge
+        // pages, even if huge pages turn out to be unavailable
+        if (flags & srb_huge_pages)
+            return align(length, huge_page_size);
+        return align_to_page_size(length);
     }
 
 private:
@@ -364,25 +490,24 @@ private:
     struct empty{};
     using capacity_type = std::conditional_t<is_dynamic, size_type, empty>;
 
-    // Shared, but written by the writer only:
-    alignas(cacheline_size) std::atomic<size_type> nwritten_{};
-    // Writer data, wrbase shadows m_.get() and wrcapacity shadows m_.length()
-    // to reduce the number of cache lines accessed while also avoiding false
-    // sharing (otherwise m_ would need to be cache-line aligned to avoid false
-    // sharing):
+    // Writer data, wrbase shadows m_.get(), wrcapacity shadows m_.length()
+    // and wrctl shadows ctl_ to reduce the number of cache lines accessed
+    // while also avoiding false sharing (otherwise m_ would need to be
+    // cache-line aligned to avoid false sharing):
     alignas(cacheline_size) std::byte* wrbase_{};
+    control_block* wrctl_ = &local_ctl_;
     [[no_unique_address]] capacity_type wrcapacity_;
     size_type wrnread_plus_capacity_;
     size_type wrnwritten_{};
+    std::size_t wrpause_count_{};
 
-    // Shared, but written by the reader only:
-    alignas(cacheline_size) std::atomic<size_type> nread_plus_capacity_{};
     // Reader data, note that the first member of mirrored_memory_mapping
     // is a pointer to the mapping:
+    alignas(cacheline_size) control_block* ctl_ = &local_ctl_;
     mirrored_memory_mapping m_;
 
-    // Written by both the reader and writer
-    alignas(cacheline_size) std::atomic<size_type> dropped_count_{};
+    // Counters used unless a control block was adopted
+    control_block local_ctl_;
 };
 
 #endif
@@ -22,9 +22,11 @@
 #define XTR_DETAIL_TRAMPOLINES_HPP
 
 #include "align.hpp"
+#include "compiled_format.hpp"
 
 #include <fmt/format.h>
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <memory>
@@ -46,7 +48,7 @@ namespace xtr::detail
         const char* timestamp,
         std::string& name) noexcept
     {
-        print(mbuf, st.out, st.err, st.lstyle, *Format, Level, timestamp, name);
+        st.print(mbuf, compiled_format<Format>{}, Level, timestamp, name);
         return buf + sizeof(void(*)());
     }
 
@@ -82,9 +84,9 @@ namespace xtr::detail
         // thread such as adding a new producer or modifying the output stream.
         auto& func = *reinterpret_cast<Func*>(func_pos);
         if constexpr (std::is_same_v<decltype(Format), std::nullptr_t>)
-            func(st, name);
+            st.command(func, name);
         else
-            func(mbuf, st.out, st.err, st.lstyle, *Format, Level, timestamp, name);
+            func(mbuf, st, compiled_format<Format>{}, Level, timestamp, name);
 
         static_assert(noexcept(func.~Func()));
         std::destroy_at(std::addressof(func));
@@ -130,13 +132,67 @@ namespace xtr::detail
         assert(std::uintptr_t(func_pos) % alignof(Func) == 0);
 
         auto& func = *reinterpret_cast<Func*>(func_pos);
-        func(mbuf, st.out, st.err, st.lstyle, *Format, Level, timestamp, name);
+        func(mbuf, st, compiled_format<Format>{}, Level, timestamp, name);
 
         static_assert(noexcept(func.~Func()));
         std::destroy_at(std::addressof(func));
 
         return buf + *reinterpret_cast<const std::size_t*>(size_pos);
     }
+
+    // Shared record---written by one of several producers sharing a queue
+    // (see shared_sink). A header containing the record size is written in
+    // front of a zero-capture, fixed-size capture or string capture record.
+    // The size is written last, signalling that the record is complete:
+    //
+    //    +---------------------------+
+    //    | function pointer (fptr_t) |---> trampoline_shared<...>
+    //    +---------------------------+          |
+    //    | record size (size_t)      |          | [ trampoline invokes
+    //    +---------------------------+          |   inner trampoline ]
+    //    | function pointer (fptr_t) | <--------+
+    //    +---------------------------+
+    //    / inner record              /
+    //    +---------------------------+
+    //
+    // After the record is processed it is zeroed, so that a size read by a
+    // producer at any position of a later record is zero until that record
+    // is complete.
+    template<typename State>
+    std::byte* trampoline_shared(
+        fmt::memory_buffer& mbuf,
+        std::byte* buf,
+        State& st,
+        const char* timestamp,
+        std::string& name) noexcept
+    {
+        using fptr_t =
+            std::byte* (*)(
+                fmt::memory_buffer&,
+                std::byte*,
+                State&,
+                const char*,
+                std::string&) noexcept;
+
+        const auto size_pos = buf + sizeof(fptr_t);
+        const std::size_t size = *reinterpret_cast<const std::size_t*>(size_pos);
+
+        const auto inner = size_pos + sizeof(std::size_t);
+        (*reinterpret_cast<const fptr_t*>(inner))(mbuf, inner, st, timestamp, name);
+
+        // If the sink was closed by the record then the queue may no longer
+        // exist. Shared sinks cannot be reopened, so zeroing is unnecessary.
+        if (!st.destroy)
+        {
+            for (auto pos = buf; pos != buf + size; pos += sizeof(std::size_t))
+            {
+                std::atomic_ref(*reinterpret_cast<std::size_t*>(pos))
+                    .store(0, std::memory_order_relaxed);
+            }
+        }
+
+        return buf + size;
+    }
 }
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "xtr/timespec.hpp"
 
+#include <atomic>
 #include <cstdint>
 #include <ctime>
 
@@ -12,17 +13,49 @@ namespace xtr::detail
 {
     struct tsc;
 
+    struct tsc_calibration;
+
     std::uint64_t read_tsc_hz() noexcept;
+    std::uint64_t read_kernel_tsc_hz() noexcept;
     std::uint64_t estimate_tsc_hz() noexcept;
+    std::uint64_t estimate_tsc_hz(
+        std::uint64_t tsc0, std::int64_t nanos0) noexcept;
 
-    inline std::uint64_t get_tsc_hz() noexcept
-    {
-        __extension__ static std::uint64_t tsc_hz =
-            read_tsc_hz() ?: estimate_tsc_hz();
-        return tsc_hz;
-    }
+    // Begins calibrating the TSC frequency if it has not already begun. The
+    // frequency is read from CPUID, the kernel or a cache file (in that
+    // order) if possible, otherwise it is estimated by a background thread.
+    void start_tsc_calibration() noexcept;
+
+    // Returns the TSC frequency. If the frequency is still being estimated
+    // then the estimate is derived from the time elapsed since calibration
+    // began, so it is refined by each call; at least 1ms must have elapsed,
+    // and the calling thread will sleep until it has.
+    std::uint64_t get_tsc_hz() noexcept;
+
+    // Returns the TSC frequency if calibration has completed, otherwise zero.
+    std::uint64_t calibrated_tsc_hz() noexcept;
+
+    // Returns true if a background thread started by start_tsc_calibration
+    // is estimating the TSC frequency. The thread may still exist briefly
+    // after this returns false.
+    bool estimating_tsc_hz() noexcept;
 }
 
+struct xtr::detail::tsc_calibration
+{
+    static tsc_calibration& instance() noexcept;
+
+    // Non-zero once calibration has completed
+    std::atomic<std::uint64_t> tsc_hz{0};
+    // True while the background thread is estimating the frequency
+    std::atomic<bool> estimating{false};
+    std::uint64_t tsc0 = 0;
+    std::int64_t nanos0 = 0;
+
+private:
+    tsc_calibration() noexcept;
+};
+
 struct xtr::detail::tsc
 {
     inline static tsc now() noexcept
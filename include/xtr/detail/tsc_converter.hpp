@@ -0,0 +1,108 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_TSC_CONVERTER_HPP
+#define XTR_DETAIL_TSC_CONVERTER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace xtr::detail
+{
+    class tsc_converter;
+}
+
+// Converts TSC ticks to wall clock time. Pairs of (TSC, wall clock) samples
+// are taken periodically and a least-squares fit over the most recent samples
+// gives the TSC rate relative to the wall clock, correcting for drift between
+// the two. Rather than jumping to the fitted line when a sample is taken, the
+// conversion is anchored at the current time and its slope is chosen so that
+// it meets the fitted line one sample interval later, so converted timestamps
+// are continuous and monotonic. If the wall clock is stepped (e.g. by
+// settimeofday) then the conversion is reset.
+//
+// Conversion is a 64x64->128 bit integer multiply and shift. Instances are
+// not thread safe, tsc::to_timespec uses one instance per thread.
+class xtr::detail::tsc_converter
+{
+public:
+    static constexpr std::size_t max_samples = 16;
+    static constexpr unsigned shift = 32;
+    // Errors larger than this are corrected by resetting rather than slewing
+    static constexpr std::int64_t max_slew_nanos = 1000000;
+
+    // Returns the wall clock time at the given TSC value as nanoseconds
+    // since the epoch, taking a new sample first if one is due.
+    std::int64_t to_nanos(std::uint64_t ticks)
+    {
+        if (ticks >= next_sample_ticks_) [[unlikely]]
+            sample();
+        return convert(ticks);
+    }
+
+    std::int64_t convert(std::uint64_t ticks) const noexcept
+    {
+        __extension__ typedef __int128 int128;
+        const auto delta = std::int64_t(ticks - base_ticks_);
+        return
+            base_nanos_ + std::int64_t((int128(delta) * int128(mult_)) >> shift);
+    }
+
+    // Reads the TSC and wall clock and calls add_sample.
+    void sample();
+
+    // Adds a sample and updates the conversion. tsc_hz is used as the TSC
+    // frequency until two samples are available, and the next sample is due
+    // interval_ticks after this one.
+    void add_sample(
+        std::uint64_t ticks,
+        std::int64_t nanos,
+        std::uint64_t tsc_hz,
+        std::uint64_t interval_ticks) noexcept;
+
+    std::uint64_t mult() const noexcept
+    {
+        return mult_;
+    }
+
+    std::size_t sample_count() const noexcept
+    {
+        return nsamples_ < max_samples ? nsamples_ : max_samples;
+    }
+
+private:
+    struct sample_point
+    {
+        std::uint64_t ticks;
+        std::int64_t nanos;
+    };
+
+    void reset(const sample_point& s, double nanos_per_tick) noexcept;
+
+    std::array<sample_point, max_samples> samples_;
+    std::size_t nsamples_ = 0;
+    std::uint64_t base_ticks_ = 0;
+    std::int64_t base_nanos_ = 0;
+    std::uint64_t mult_ = 0;
+    std::uint64_t next_sample_ticks_ = 0;
+};
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_DETAIL_WAITER_HPP
+#define XTR_DETAIL_WAITER_HPP
+
+#include "synchronized_ring_buffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace xtr::detail
+{
+    class waiter;
+}
+
+// Allows a consumer to sleep while all of its sinks are empty, and sinks to
+// wake the consumer when written to. The sleeping flag is only written by the
+// consumer when it goes to sleep and by the first sink to wake it, so while
+// the consumer is awake notify is a read of a cache line shared by all sinks.
+class xtr::detail::waiter
+{
+public:
+    waiter() = default;
+
+    // A process shared waiter may be placed in memory shared by two
+    // processes, see detail/consumer_process.hpp
+    explicit waiter(bool process_shared) noexcept
+    :
+        process_shared_(process_shared)
+    {
+    }
+
+    // Called after a write that may have made a sink non-empty. The fence
+    // pairs with the fence in prepare_wait, so either the consumer sees the
+    // write or the write sees the sleeping flag.
+    void notify() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        notify_relaxed();
+    }
+
+    // Called by sinks after a write to a sink that the consumer had not yet
+    // emptied. The consumer does not sleep while the sink holds the earlier
+    // write, so the fence is omitted, see wait.
+    void notify_relaxed() noexcept
+    {
+        if (sleeping_.load(std::memory_order_relaxed) != 0) [[unlikely]]
+            wake();
+    }
+
+    // Called by the consumer before checking that all sinks are empty. If
+    // any sink is not empty then cancel_wait must be called, otherwise wait.
+    void prepare_wait() noexcept
+    {
+        sleeping_.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void cancel_wait() noexcept
+    {
+        sleeping_.store(0, std::memory_order_relaxed);
+    }
+
+    // Sleeps until woken by notify or until the timeout expires. Sinks only
+    // issue a fence when a write makes a sink non-empty, so a write may fail
+    // to wake the consumer only if the consumer empties the sink and goes to
+    // sleep in the instant between the write and the sink checking whether
+    // the sink was empty, in which case it is read after the timeout.
+    void wait(std::chrono::microseconds timeout) noexcept;
+
+private:
+    [[gnu::cold, gnu::noinline]] void wake() noexcept;
+
+    alignas(cacheline_size) std::atomic<std::uint32_t> sleeping_{0};
+    bool process_shared_ = false;
+};
+
+#endif
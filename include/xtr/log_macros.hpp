@@ -21,7 +21,9 @@
 #ifndef XTR_LOG_MACROS_HPP
 #define XTR_LOG_MACROS_HPP
 
+#include "detail/callsite.hpp"
 #include "detail/get_time.hpp"
+#include "detail/limiters.hpp"
 #include "detail/string.hpp"
 #include "detail/tags.hpp"
 #include "detail/tsc.hpp"
@@ -268,6 +270,71 @@
         xtr::detail::tsc::now(),            \
         __VA_ARGS__)
 
+/**
+ * Limited variant of @ref XTR_LOG, logs only the first of every N
+ * invocations of the log statement (the count is shared by all threads
+ * executing the statement). Invocations that are not logged cost a single
+ * atomic increment and do not write to the sink.
+ *
+ * @arg N: The number of invocations per invocation that is logged.
+ */
+#define XTR_LOG_EVERY_N(SINK, N, ...) \
+    XTR_LOG_LIMITED(xtr::detail::every_n_limiter, N, info, SINK, __VA_ARGS__)
+
+/**
+ * Log level variant of @ref XTR_LOG_EVERY_N. Invocations dropped due to the
+ * sink's log level are not counted.
+ *
+ * @arg LEVEL: The unqualified log level name, for example simply "info" or "error".
+ * @arg N: The number of invocations per invocation that is logged.
+ */
+#define XTR_LOGL_EVERY_N(LEVEL, SINK, N, ...) \
+    XTR_LOGL_LIMITED(xtr::detail::every_n_limiter, N, LEVEL, SINK, __VA_ARGS__)
+
+/**
+ * Limited variant of @ref XTR_LOG, logs only the first N invocations of the
+ * log statement (the count is shared by all threads executing the
+ * statement). Once N invocations have been logged, further invocations cost
+ * a single load and do not write to the sink.
+ *
+ * @arg N: The number of invocations to log.
+ */
+#define XTR_LOG_FIRST_N(SINK, N, ...) \
+    XTR_LOG_LIMITED(xtr::detail::first_n_limiter, N, info, SINK, __VA_ARGS__)
+
+/**
+ * Log level variant of @ref XTR_LOG_FIRST_N. Invocations dropped due to the
+ * sink's log level are not counted.
+ *
+ * @arg LEVEL: The unqualified log level name, for example simply "info" or "error".
+ * @arg N: The number of invocations to log.
+ */
+#define XTR_LOGL_FIRST_N(LEVEL, SINK, N, ...) \
+    XTR_LOGL_LIMITED(xtr::detail::first_n_limiter, N, LEVEL, SINK, __VA_ARGS__)
+
+/**
+ * Rate limited variant of @ref XTR_LOG, logs at most PER_SECOND invocations
+ * of the log statement per second on average, allowing bursts of up to
+ * PER_SECOND invocations (the limit is shared by all threads executing the
+ * statement). Invocations that are not logged do not write to the sink,
+ * instead they are counted and the count is logged as "N messages
+ * suppressed" before the next invocation that is logged.
+ *
+ * @arg PER_SECOND: The maximum number of invocations to log per second.
+ */
+#define XTR_LOG_RATE_LIMITED(SINK, PER_SECOND, ...) \
+    XTR_LOG_LIMITED(xtr::detail::rate_limiter, PER_SECOND, info, SINK, __VA_ARGS__)
+
+/**
+ * Log level variant of @ref XTR_LOG_RATE_LIMITED. Invocations dropped due to
+ * the sink's log level are not counted.
+ *
+ * @arg LEVEL: The unqualified log level name, for example simply "info" or "error".
+ * @arg PER_SECOND: The maximum number of invocations to log per second.
+ */
+#define XTR_LOGL_RATE_LIMITED(LEVEL, SINK, PER_SECOND, ...) \
+    XTR_LOGL_LIMITED(xtr::detail::rate_limiter, PER_SECOND, LEVEL, SINK, __VA_ARGS__)
+
 #define XTR_XSTR(s) XTR_STR(s)
 #define XTR_STR(s) #s
 
@@ -288,21 +355,76 @@
             }                                                                       \
         }))
 
+#define XTR_LOGL_LIMITED(LIMITER, LIMIT, LEVEL, SINK, ...)                          \
+    (__extension__                                                                  \
+        ({                                                                          \
+            if constexpr (                                                          \
+                xtr::log_level_t::LEVEL != xtr::log_level_t::debug ||               \
+                !XTR_NDEBUG)                                                        \
+            {                                                                       \
+                if ((SINK).level() >= xtr::log_level_t::LEVEL)                      \
+                    XTR_LOG_LIMITED(LIMITER, LIMIT, LEVEL, SINK, __VA_ARGS__);      \
+                if constexpr (xtr::log_level_t::LEVEL == xtr::log_level_t::fatal)   \
+                {                                                                   \
+                    (SINK).sync();                                                  \
+                    std::abort();                                                   \
+                }                                                                   \
+            }                                                                       \
+        }))
+
+// The limiter is a static variable so that its state is per-callsite. The
+// callsite is checked before the limiter, so that statements disabled at run
+// time are not counted. The suppressed messages count is logged as part of
+// the statement, so is enabled and disabled with it.
+#define XTR_LOG_LIMITED(LIMITER, LIMIT, LEVEL, SINK, ...) \
+    (__extension__({ XTR_LOG_LIMITED_IMPL(LIMITER, LIMIT, LEVEL, SINK, __VA_ARGS__); }))
+
+#define XTR_LOG_LIMITED_IMPL(LIMITER, LIMIT, LEVEL, SINK, FORMAT, ...)              \
+    (__extension__                                                                  \
+        ({                                                                          \
+            XTR_CALLSITE(LEVEL, FORMAT);                                            \
+            static constexpr auto xtr_suppressed_fmt =                              \
+                XTR_FORMAT_STRING("{} messages suppressed");                        \
+            static constinit LIMITER xtr_limiter;                                   \
+            using xtr::nocopy;                                                      \
+            if (xtr_callsite.enabled() && xtr_limiter.allow(LIMIT))                 \
+            {                                                                       \
+                if (const std::uint64_t xtr_n = xtr_limiter.suppressed())           \
+                {                                                                   \
+                    (SINK).template log<                                            \
+                        &xtr_suppressed_fmt,                                        \
+                        xtr::log_level_t::LEVEL,                                    \
+                        void(void())>(xtr_n);                                       \
+                }                                                                   \
+                (SINK).template log<&xtr_fmt, xtr::log_level_t::LEVEL, void(void())>(__VA_ARGS__); \
+            }                                                                       \
+        }))
+
 #define XTR_LOG_TAGS(TAGS, LEVEL, SINK, ...) \
     (__extension__({ XTR_LOG_TAGS_IMPL(TAGS, LEVEL, SINK, __VA_ARGS__); }))
 
-// '{}{} {} ' in the format string is for the level, timestamp and sink name
 #define XTR_LOG_TAGS_IMPL(TAGS, LEVEL, SINK, FORMAT, ...)                           \
     (__extension__                                                                  \
         ({                                                                          \
-            static constexpr auto xtr_fmt =                                         \
-                xtr::detail::string{"{}{} {} "} +                                   \
-                xtr::detail::rcut<                                                  \
-                    xtr::detail::rindex(__FILE__, '/') + 1>(__FILE__) +             \
-                xtr::detail::string{":"} +                                          \
-                xtr::detail::string{XTR_XSTR(__LINE__) ": " FORMAT "\n"};           \
+            XTR_CALLSITE(LEVEL, FORMAT);                                            \
             using xtr::nocopy;                                                      \
-            (SINK).log<&xtr_fmt, xtr::log_level_t::LEVEL, void(TAGS)>(__VA_ARGS__); \
+            if (xtr_callsite.enabled()) [[likely]]                                  \
+                (SINK).template log<&xtr_fmt, xtr::log_level_t::LEVEL, void(TAGS)>(__VA_ARGS__); \
         }))
 
+// Declares the format string and callsite of a log statement. The callsite
+// is a static variable so that the statement may be disabled at run time via
+// xtrctl.
+#define XTR_CALLSITE(LEVEL, FORMAT)                                                 \
+    static constexpr auto xtr_fmt = XTR_FORMAT_STRING(FORMAT);                      \
+    static constinit xtr::detail::callsite xtr_callsite{                            \
+        __FILE__, __LINE__, xtr::log_level_t::LEVEL, FORMAT}
+
+// '{}{} {} ' in the format string is for the level, timestamp and sink name
+#define XTR_FORMAT_STRING(FORMAT)                                                   \
+    (xtr::detail::string{"{}{} {} "} +                                              \
+     xtr::detail::rcut<xtr::detail::rindex(__FILE__, '/') + 1>(__FILE__) +          \
+     xtr::detail::string{":"} +                                                     \
+     xtr::detail::string{XTR_XSTR(__LINE__) ": " FORMAT "\n"})
+
 #endif
@@ -25,12 +25,23 @@
 #include "detail/align.hpp"
 #include "detail/clock_ids.hpp"
 #include "detail/consumer.hpp"
+#include "detail/consumer_process.hpp"
+#include "detail/gzip_file.hpp"
+#include "detail/io_uring_file.hpp"
 #include "detail/is_c_string.hpp"
+#include "detail/mapped_file.hpp"
+#include "detail/rotating_file.hpp"
 #include "detail/string_ref.hpp"
 #include "detail/throw.hpp"
+#include "detail/waiter.hpp"
 #include "log_macros.hpp"
 #include "log_level.hpp"
+#include "output_format.hpp"
+#include "rotation_policy.hpp"
+#include "shared_sink.hpp"
 #include "sink.hpp"
+#include "tags.hpp"
+#include "wait_strategy.hpp"
 
 #include <fmt/format.h>
 
@@ -42,6 +53,7 @@
 #include <cstdio>
 #include <cstdint>
 #include <ctime>
+#include <memory>
 #include <mutex>
 #include <new>
 #include <stdexcept>
@@ -81,10 +93,12 @@ namespace xtr
 
 namespace xtr::detail
 {
+    // Output to streams is batched, so that each batch of log records is
+    // written with a single call to fwrite.
     inline auto make_output_func(FILE* stream)
     {
         return
-            [stream](log_level_t, const char* buf, std::size_t size)
+            [stream](const char* buf, std::size_t size)
             {
                 return std::fwrite(buf, 1, size, stream);
             };
@@ -146,6 +160,14 @@ namespace xtr::detail
         std::invoke(std::forward<F>(f), std::forward<Args>(args)...);
     };
 #endif
+
+    // Output functions either accept a log level, in which case they are
+    // invoked once per log record, or accept only a buffer and size, in which
+    // case they are invoked once per batch of log records.
+    template<typename F>
+    concept output_function =
+        invocable<F, log_level_t, const char*, std::size_t> ||
+        invocable<F, const char*, std::size_t>;
 }
 
 /**
@@ -224,6 +246,163 @@ public:
     {
     }
 
+    /**
+     * @anchor io-uring-constructor
+     *
+     * io_uring constructor. As the @ref logger::logger "path constructor",
+     * except that the file is written to via io_uring (see
+     * <a href="guide.html#io-uring-back-end">io_uring back-end</a> in the
+     * user guide). Writes and fdatasync calls are submitted to the kernel
+     * asynchronously, so that the background thread does not block on disk
+     * I/O unless all of the back-end's buffers are in use. If io_uring is not
+     * supported then the file is written to using pwrite(2).
+     *
+     * @arg tag: Selects this constructor, pass `xtr::io_uring_tag{}`.
+     * @arg path: The path of a file to write log statements to.
+     * @arg clock: Please refer to the @ref clock_arg "description"
+     *             above.
+     * @arg command_path: Please refer to the @ref command_path_arg
+     *                    "description" above.
+     * @arg level_style: The log level style that will be used to prefix each log
+     *                   statement\---please refer to the @ref log_level_style_t
+     *                   documentation for details.
+     */
+    template<typename Clock = std::chrono::system_clock>
+    logger(
+        [[maybe_unused]] io_uring_tag tag,
+        const char* path,
+        Clock&& clock = Clock(),
+        std::string command_path = default_command_path(),
+        log_level_style_t level_style = default_log_level_style)
+    :
+        logger(
+            std::make_shared<detail::io_uring_file>(path),
+            stderr,
+            std::forward<Clock>(clock),
+            std::move(command_path),
+            level_style)
+    {
+    }
+
+    /**
+     * @anchor mmap-constructor
+     *
+     * Memory-mapped file constructor. As the @ref logger::logger
+     * "path constructor", except that the file is written to via a shared
+     * memory mapping (see
+     * <a href="guide.html#memory-mapped-back-end">memory-mapped back-end</a>
+     * in the user guide). Log data is copied directly into a window mapped
+     * over the end of the file, so that neither writing nor flushing requires
+     * a system call except when the window is advanced (the file being
+     * extended one window at a time).
+     *
+     * @arg tag: Selects this constructor, pass `xtr::mmap_tag{}`.
+     * @arg path: The path of a file to write log statements to.
+     * @arg clock: Please refer to the @ref clock_arg "description"
+     *             above.
+     * @arg command_path: Please refer to the @ref command_path_arg
+     *                    "description" above.
+     * @arg level_style: The log level style that will be used to prefix each log
+     *                   statement\---please refer to the @ref log_level_style_t
+     *                   documentation for details.
+     */
+    template<typename Clock = std::chrono::system_clock>
+    logger(
+        [[maybe_unused]] mmap_tag tag,
+        const char* path,
+        Clock&& clock = Clock(),
+        std::string command_path = default_command_path(),
+        log_level_style_t level_style = default_log_level_style)
+    :
+        logger(
+            std::make_shared<detail::mapped_file>(path),
+            stderr,
+            std::forward<Clock>(clock),
+            std::move(command_path),
+            level_style)
+    {
+    }
+
+    /**
+     * @anchor rotation-constructor
+     *
+     * Rotation constructor. As the @ref logger::logger "path constructor",
+     * except that the file is rotated by the background thread according to
+     * the given policy (see
+     * <a href="guide.html#built-in-rotation">built-in rotation</a> in the
+     * user guide), so that an external tool such as logrotate is not
+     * required.
+     *
+     * @arg policy: When to rotate the file and how many rotated files to
+     *              keep\---please refer to the @ref rotation_policy
+     *              documentation for details.
+     * @arg path: The path of a file to write log statements to.
+     * @arg clock: Please refer to the @ref clock_arg "description"
+     *             above.
+     * @arg command_path: Please refer to the @ref command_path_arg
+     *                    "description" above.
+     * @arg level_style: The log level style that will be used to prefix each log
+     *                   statement\---please refer to the @ref log_level_style_t
+     *                   documentation for details.
+     */
+    template<typename Clock = std::chrono::system_clock>
+    logger(
+        const rotation_policy& policy,
+        const char* path,
+        Clock&& clock = Clock(),
+        std::string command_path = default_command_path(),
+        log_level_style_t level_style = default_log_level_style)
+    :
+        logger(
+            std::make_shared<detail::rotating_file>(path, policy),
+            stderr,
+            std::forward<Clock>(clock),
+            std::move(command_path),
+            level_style)
+    {
+    }
+
+#if defined(XTR_ENABLE_ZLIB)
+    /**
+     * @anchor gzip-constructor
+     *
+     * gzip constructor. As the @ref logger::logger "path constructor",
+     * except that the file is compressed in gzip format by the background
+     * thread (see
+     * <a href="guide.html#compressed-back-end">compressed back-end</a> in the
+     * user guide). Only available if XTR_ENABLE_ZLIB is defined, in which
+     * case the library must also have been built with XTR_ENABLE_ZLIB and
+     * the application must be linked with zlib.
+     *
+     * @arg tag: Selects this constructor, pass `xtr::gzip_tag{}`.
+     * @arg path: The path of a file to write log statements to.
+     * @arg clock: Please refer to the @ref clock_arg "description"
+     *             above.
+     * @arg command_path: Please refer to the @ref command_path_arg
+     *                    "description" above.
+     * @arg level_style: The log level style that will be used to prefix each log
+     *                   statement\---please refer to the @ref log_level_style_t
+     *                   documentation for details.
+     */
+    template<typename Clock = std::chrono::system_clock>
+    logger(
+        [[maybe_unused]] gzip_tag tag,
+        const char* path,
+        Clock&& clock = Clock(),
+        std::string command_path = default_command_path(),
+        log_level_style_t level_style = default_log_level_style)
+    :
+        logger(
+            std::make_shared<detail::gzip_file>(path),
+            stderr,
+            std::forward<Clock>(clock),
+            std::move(command_path),
+            level_style)
+    {
+        detail::library_built_with_XTR_ENABLE_ZLIB();
+    }
+#endif
+
     /**
      * Stream constructor.
      *
@@ -334,6 +513,12 @@ public:
      *           returning anything less than the number of bytes given by the
      *           length argument is considered an error, resulting in the 'err'
      *           function being invoked with a "Short write" error string.
+     *           Alternatively a function accepting only the buffer and length
+     *           arguments may be given, in which case output is batched: the
+     *           function is invoked once for each batch of log lines read
+     *           from a sink, with the buffer holding the batch (please refer
+     *           to the <a href="guide.html#batched-output">batched output</a>
+     *           section of the user guide for details).
      * @arg err: @anchor err_arg
      *           A function accepting a const char* buffer of formatted log
      *           data and a std::size_t argument specifying the length of the
@@ -354,7 +539,7 @@ public:
         typename Clock = std::chrono::system_clock>
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
     requires
-        detail::invocable<OutputFunction, log_level_t, const char*, std::size_t> &&
+        detail::output_function<OutputFunction> &&
         detail::invocable<ErrorFunction, const char*, std::size_t>
 #endif
     logger(
@@ -421,7 +606,7 @@ public:
         typename Clock = std::chrono::system_clock>
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
     requires
-        detail::invocable<OutputFunction, log_level_t, const char*, std::size_t> &&
+        detail::output_function<OutputFunction> &&
         detail::invocable<ErrorFunction, const char*, std::size_t> &&
         detail::invocable<FlushFunction> &&
         detail::invocable<SyncFunction> &&
@@ -439,6 +624,9 @@ public:
         std::string command_path = default_command_path(),
         log_level_style_t level_style = default_log_level_style)
     {
+        detail::start_tsc_calibration();
+        clock_ = make_clock(std::forward<Clock>(clock));
+        control_.waiter_ = &waiter_;
         // The consumer thread must be started after control_ has been
         // constructed
         consumer_ =
@@ -452,8 +640,9 @@ public:
                     std::forward<ReopenFunction>(reopen),
                     std::forward<CloseFunction>(close),
                     level_style,
-                    &control_),
-                make_clock(std::forward<Clock>(clock)));
+                    &control_,
+                    &waiter_),
+                clock_);
         // Passing control_ to the consumer is equivalent to calling
         // register_sink, so mark it as open.
         control_.open_ = true;
@@ -477,6 +666,55 @@ public:
         return consumer_.native_handle();
     }
 
+    /**
+     *  Returns the native handle for the specified consumer thread, where
+     *  index zero is the logger's original consumer thread and indexes one
+     *  and above are threads created by @ref add_consumer_threads.
+     *
+     *  @pre index must be less than the number of consumer threads.
+     */
+    std::thread::native_handle_type consumer_thread_native_handle(
+        std::size_t index);
+
+    /**
+     *  Sets the CPU affinity of the specified consumer thread (see @ref
+     *  consumer_thread_native_handle for a description of index) to the
+     *  CPUs of the given NUMA node. Only supported on Linux.
+     *
+     *  @pre index must be less than the number of consumer threads.
+     */
+    void set_consumer_thread_numa_node(int numa_node, std::size_t index = 0);
+
+    /**
+     *  Starts the specified number of additional consumer threads. Sinks
+     *  registered after this function returns are distributed across all
+     *  consumer threads in a round-robin fashion, with each thread reading
+     *  and formatting log records from its own sinks (please refer to the
+     *  <a href="guide.html#multiple-consumer-threads">multiple consumer
+     *  threads</a> section of the user guide for details).
+     *
+     *  @note The clock passed to the logger constructor will be invoked
+     *        concurrently from all consumer threads.
+     */
+    void add_consumer_threads(std::size_t count);
+
+    /**
+     *  As @ref add_consumer_threads, but each additional consumer thread
+     *  writes to a file of its own rather than to the logger's back-end,
+     *  so that threads write as well as format log records in parallel.
+     *  The files are named by appending the index of the consumer thread
+     *  (see @ref consumer_thread_native_handle) to the given path, e.g.
+     *  "path.1", "path.2", and are opened in append mode before any
+     *  threads are started.
+     *
+     *  @note Records from a given sink are written to a single file in the
+     *        order in which they were logged, but no ordering is defined
+     *        between files. Files are reopened along with the logger's
+     *        back-end when requested via the
+     *        <a href="xtrctl.html#rotating-log-files">xtrctl</a> tool.
+     */
+    void add_consumer_threads(std::size_t count, const char* path);
+
     /**
      *  Creates a sink with the specified name. Note that each call to this
      *  function creates a new sink; if repeated calls are made with the
@@ -486,6 +724,53 @@ public:
      */
     [[nodiscard]] sink get_sink(std::string name);
 
+    /**
+     *  Creates a sink with the specified name and queue capacity. The
+     *  capacity is given in bytes and is rounded up to a power of two that
+     *  is a multiple of the page size. A larger queue allows a sink to
+     *  absorb bursts of log statements without blocking (or, for the
+     *  non-blocking log macros, dropping statements) while the consumer
+     *  thread catches up, at the cost of memory. Sinks created by the
+     *  single argument overload have a capacity of
+     *  @ref sink::default_capacity.
+     *
+     *  If page_type is page_type_t::huge then the queue is backed by huge
+     *  pages and the capacity is rounded up to a multiple of the huge page
+     *  size (2MiB). If huge pages are unavailable then normal pages are
+     *  used instead.
+     *
+     *  If numa_node is not @ref no_numa_node then the pages of the queue
+     *  are allocated on the given NUMA node where possible, regardless of
+     *  which thread creates the sink. To place the queue on the node of the
+     *  calling thread pass @ref numa_node_of_cpu().
+     *
+     *  @param name: The name for the given sink.
+     *  @param capacity: The minimum capacity of the sink's queue in bytes.
+     *  @param page_type: The type of memory page backing the sink's queue.
+     *  @param numa_node: The NUMA node to allocate the sink's queue on.
+     */
+    [[nodiscard]] sink get_sink(
+        std::string name,
+        std::size_t capacity,
+        page_type_t page_type = page_type_t::normal,
+        int numa_node = no_numa_node);
+
+    /**
+     *  Creates a shared sink with the specified name, which may be written
+     *  to by any number of threads concurrently (see @ref shared_sink).
+     *  The remaining parameters are as for @ref get_sink.
+     *
+     *  @param name: The name for the given sink.
+     *  @param capacity: The minimum capacity of the sink's queue in bytes.
+     *  @param page_type: The type of memory page backing the sink's queue.
+     *  @param numa_node: The NUMA node to allocate the sink's queue on.
+     */
+    [[nodiscard]] shared_sink get_shared_sink(
+        std::string name,
+        std::size_t capacity = sink::default_capacity,
+        page_type_t page_type = page_type_t::normal,
+        int numa_node = no_numa_node);
+
     /**
      *  Registers the sink with the logger. Note that the sink name does not
      *  need to be unique; if repeated calls are made with the same name,
@@ -518,17 +803,19 @@ public:
     void set_output_function(Func&& f) noexcept
     {
         static_assert(
-            std::is_convertible_v<
-                std::invoke_result_t<Func, log_level_t, const char*, std::size_t>,
-                ::ssize_t>,
-            "Output function type must be of type ssize_t(const char*, size_t) "
+            std::is_invocable_r_v<
+                ::ssize_t, Func, log_level_t, const char*, std::size_t> ||
+            std::is_invocable_r_v<::ssize_t, Func, const char*, std::size_t>,
+            "Output function type must be of type "
+            "ssize_t(log_level_t, const char*, size_t) or "
+            "ssize_t(const char*, size_t) "
             "(returning the number of bytes written or -1 on error)");
         post(
             [f = std::forward<Func>(f)](auto& c, auto&)
             {
                 c.flush();
                 c.close();
-                c.out = std::move(f);
+                c.set_output(std::move(f));
             });
         control_.sync();
     }
@@ -605,6 +892,14 @@ public:
         control_.close();
     }
 
+    /**
+     * Sets the strategy used by the logger's consumer threads to wait for
+     * input when all sinks are empty\---please refer to the @ref
+     * wait_strategy documentation for details. The default strategy is
+     * @ref busy_wait_strategy.
+     */
+    void set_wait_strategy(const wait_strategy& strategy) noexcept;
+
     /**
      * Sets the logger command path\---please refer to the 'command_path' argument
      * @ref command_path_arg "description" above for details.
@@ -617,7 +912,105 @@ public:
      */
     void set_log_level_style(log_level_style_t level_style) noexcept;
 
+    /**
+     * Sets the logger output format\---please refer to the @ref output_format_t
+     * documentation for details.
+     */
+    void set_output_format(output_format_t format) noexcept;
+
+    /**
+     * Sets the directory in which the queues of sinks subsequently created
+     * by @ref get_sink are placed. Such queues are backed by files in the
+     * directory rather than by anonymous memory, so that log records that
+     * have not been written by the consumer thread when the process dies
+     * may be recovered by calling @ref recover (please refer to the
+     * <a href="guide.html#crash-recovery">crash recovery</a> section of the
+     * user guide for details). Each file is removed when its sink is
+     * closed. Passing an empty string disables the use of recovery files
+     * for subsequently created sinks, which is the default.
+     *
+     * A directory on a memory backed file system, such as /dev/shm, should
+     * be used, as otherwise the kernel may write queue pages back to disk.
+     * Files are created in a subdirectory named xtr.<euid>.recovery, which
+     * is created if necessary and must only be accessible by the effective
+     * user.
+     *
+     * @throws std::system_error if the subdirectory cannot be created, or is
+     *         not a directory owned by the effective user with mode 0700.
+     */
+    void set_recovery_directory(std::string path);
+
+    /**
+     * Writes any log records left in the recovery files in the given
+     * directory (in the subdirectory described by @ref
+     * set_recovery_directory) by processes that have exited to the output,
+     * then removes the files. Only files created by the same executable as
+     * the calling process, and owned by the effective user and not writable
+     * by other users, are recovered. Returns the number of files recovered.
+     *
+     * @throws std::system_error if the directory cannot be read, or the
+     *         subdirectory is accessible by other users.
+     */
+    std::size_t recover(const std::string& path);
+
+    /**
+     * Moves the consumer of sinks subsequently created by @ref get_sink
+     * into a separate process, named xtrd, which is forked from the consumer
+     * thread. The queues of such sinks are placed in memory shared with the
+     * consumer process, which reads, formats and writes their log records,
+     * so that the application only writes records to the queues. If the
+     * application exits or crashes then the consumer process writes the
+     * records remaining in the queues before exiting. Please refer to the
+     * <a href="guide.html#consumer-process">consumer process</a> section of
+     * the user guide for details and limitations. Calling this function more
+     * than once has no effect. Only supported on Linux.
+     *
+     * @pre The process must not have any threads other than the calling
+     *      thread and the logger's consumer thread (a thread started by the
+     *      logger to calibrate the TSC is ignored). The supported order is
+     *      therefore to call this function immediately after constructing
+     *      the logger early in main, before any other threads or loggers are
+     *      created (including by @ref add_consumer_threads). Threads created
+     *      afterwards may create and use sinks as usual.
+     *
+     * @throws std::runtime_error if other threads exist.
+     * @throws std::system_error if the consumer process cannot be created.
+     */
+    void start_consumer_process();
+
 private:
+    // Used by the io_uring, memory-mapped file, rotation and gzip constructors
+    template<typename File, typename Clock>
+    logger(
+        std::shared_ptr<File> file,
+        FILE* err_stream,
+        Clock&& clock,
+        std::string command_path,
+        log_level_style_t level_style)
+    :
+        logger(
+            [file](const char* buf, std::size_t size)
+            {
+                return file->write(buf, size);
+            },
+            detail::make_error_func(err_stream),
+            [file, err_stream]()
+            {
+                file->flush();
+                std::fflush(err_stream);
+            },
+            [file](){ file->sync(); },
+            [file](){ return file->reopen(); },
+            [file](){ file->close(); },
+            std::forward<Clock>(clock),
+            std::move(command_path),
+            level_style)
+    {
+    }
+
+    // Implements add_consumer_threads, path may be null
+    void start_shards(std::size_t count, const char* path);
+
     template<typename Func>
     void post(Func&& f)
     {
@@ -646,8 +1039,22 @@ private:
     }
 
     sink control_; // aligned to cache line so first to avoid extra padding
+    detail::waiter waiter_;
+    // See start_consumer_process. Declared before consumer_ so that the
+    // consumer process is waited for after the consumer thread has been
+    // joined. Protected by control_mutex_.
+    std::unique_ptr<detail::consumer_process> process_;
     jthread consumer_;
     std::mutex control_mutex_;
+    std::function<std::timespec()> clock_;
+    // Control sinks, waiters and threads of any additional consumers, see
+    // add_consumer_threads. Protected by control_mutex_.
+    std::vector<std::unique_ptr<sink>> shard_controls_;
+    std::vector<std::unique_ptr<detail::waiter>> shard_waiters_;
+    std::vector<jthread> shard_consumers_;
+    std::size_t next_consumer_ = 0;
+    // See set_recovery_directory. Protected by control_mutex_.
+    std::string recovery_dir_;
 
     friend sink;
 };
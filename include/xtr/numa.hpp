@@ -0,0 +1,43 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_NUMA_HPP
+#define XTR_NUMA_HPP
+
+namespace xtr
+{
+    /**
+     * When passed to the numa_node argument of @ref logger::get_sink or
+     * @ref sink::sink indicates that the sink's queue should not be bound
+     * to a NUMA node, i.e. pages are allocated according to the default
+     * policy (usually on the node of the thread that first touches them).
+     */
+    inline constexpr int no_numa_node = -1;
+
+    /**
+     * Returns the NUMA node of the specified CPU, or if cpu is -1 then the
+     * NUMA node of the CPU that the calling thread is running on. Returns
+     * @ref no_numa_node if the node cannot be determined, or on platforms
+     * other than Linux.
+     */
+    int numa_node_of_cpu(int cpu = -1);
+}
+
+#endif
@@ -0,0 +1,38 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_OUTPUT_FORMAT_HPP
+#define XTR_OUTPUT_FORMAT_HPP
+
+namespace xtr
+{
+    /**
+     * Output formats, passed to @ref logger::set_output_format. The text
+     * format is the default. If the binary format is selected then log
+     * records are written to the back-end in a compact binary encoding,
+     * with formatting deferred until the log is decoded by the
+     * <a href="xtrdecode.html">xtrdecode</a> tool\---please see the
+     * <a href="guide.html#binary-output">binary output</a> section of the
+     * user guide for details.
+     */
+    enum class output_format_t {text, binary};
+}
+
+#endif
@@ -0,0 +1,37 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_PAGE_TYPE_HPP
+#define XTR_PAGE_TYPE_HPP
+
+namespace xtr
+{
+    /**
+     * Page types, passed to @ref logger::get_sink and @ref sink::sink to
+     * select the memory pages backing a sink's queue. Normal pages are the
+     * default. If huge pages are selected then the queue is backed by 2MiB
+     * huge pages, reducing TLB misses when a program has many large sinks.
+     * Please see the <a href="guide.html#huge-pages">huge pages</a> section of
+     * the user guide for details.
+     */
+    enum class page_type_t {normal, huge};
+}
+
+#endif
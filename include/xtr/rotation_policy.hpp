@@ -0,0 +1,59 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_ROTATION_POLICY_HPP
+#define XTR_ROTATION_POLICY_HPP
+
+#include <chrono>
+#include <cstddef>
+
+namespace xtr
+{
+    /**
+     * Determines when the log file written to by a logger created with the
+     * @ref rotation-constructor "rotation constructor" is rotated, and how
+     * many rotated files are kept\---please see the
+     * <a href="guide.html#built-in-rotation">built-in rotation</a> section of
+     * the user guide for details.
+     */
+    struct rotation_policy
+    {
+        /**
+         * The file is rotated before a write that would make it larger than
+         * max_bytes. Zero disables size-based rotation.
+         */
+        std::size_t max_bytes = 0;
+
+        /**
+         * The file is rotated before the first write made once it has been
+         * open for max_age. Zero disables time-based rotation.
+         */
+        std::chrono::nanoseconds max_age{};
+
+        /**
+         * The number of rotated files to keep, named path.1 (the most
+         * recent) to path.<keep>. If zero then the file is discarded when
+         * it is rotated.
+         */
+        std::size_t keep = 0;
+    };
+}
+
+#endif
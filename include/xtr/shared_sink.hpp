@@ -0,0 +1,382 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_SHARED_SINK_HPP
+#define XTR_SHARED_SINK_HPP
+
+#include "detail/align.hpp"
+#include "detail/pause.hpp"
+#include "detail/string_table.hpp"
+#include "detail/synchronized_ring_buffer.hpp"
+#include "detail/tags.hpp"
+#include "detail/trampolines.hpp"
+#include "log_level.hpp"
+#include "numa.hpp"
+#include "page_type.hpp"
+#include "sink.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace xtr
+{
+    class shared_sink;
+    class logger;
+}
+
+/**
+ * Shared log sink class. A shared sink may be written to by any number of
+ * threads concurrently, for use where creating a sink per thread is
+ * impractical, such as by short-lived tasks running on a thread pool.
+ * Shared sinks are created by calling @ref logger::get_shared_sink and may
+ * be used with the XTR_LOG macros in the same way as a @ref sink.
+ *
+ * Each log statement reserves space for its record in the sink's queue
+ * using an atomic compare-and-swap, so log statements are slower than
+ * those made to a sink, particularly when contended. Log statements are
+ * thread safe, but @ref close, @ref sync and @ref set_name must not be
+ * called concurrently with each other or with the destructor.
+ */
+class xtr::shared_sink
+{
+private:
+    using fptr_t = sink::fptr_t;
+    using ring_buffer = sink::ring_buffer;
+    using size_type = ring_buffer::size_type;
+
+public:
+    shared_sink(const shared_sink&) = delete;
+
+    shared_sink& operator=(const shared_sink&) = delete;
+
+    /**
+     * Shared sink destructor. When a shared sink is destructed it is
+     * automatically closed.
+     */
+    ~shared_sink();
+
+    /**
+     *  Closes the shared sink. After this function returns the sink is
+     *  closed and log() functions may not be called on the sink. Unlike a
+     *  @ref sink, a shared sink cannot be re-opened.
+     */
+    void close();
+
+    /**
+     *  Synchronizes all log calls previously made by any thread to this
+     *  sink to back-end storage, see @ref sink::sync.
+     */
+    void sync()
+    {
+        sync(/*destroy=*/false);
+    }
+
+    /**
+     *  Sets the sink's name to the specified value.
+     */
+    void set_name(std::string name);
+
+    /**
+     *  Logs the given format string and arguments. This function is not
+     *  intended to be used directly, instead one of the XTR_LOG macros
+     *  should be used.
+     */
+    template<auto Format, auto Level, typename Tags = void(), typename... Args>
+    void log(Args&&... args) noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...));
+
+    /**
+     *  Sets the log level of the sink to the specified level (see @ref log_level_t).
+     */
+    void set_level(log_level_t l)
+    {
+        sink_.set_level(l);
+    }
+
+    /**
+     *  Returns the current log level (see @ref log_level_t).
+     */
+    log_level_t level() const
+    {
+        return sink_.level();
+    }
+
+private:
+    // Size of the header written in front of each record, see
+    // detail::trampoline_shared
+    static constexpr size_type header_size = sizeof(fptr_t) + sizeof(std::size_t);
+
+    // Buffer passed to build_string_table, the space for the string table
+    // having already been reserved; strings that do not fit (because the
+    // record would be larger than the queue) are truncated.
+    struct string_table_buffer
+    {
+        void writer_pause() noexcept
+        {
+        }
+
+        ring_buffer::span write_span() const noexcept
+        {
+            return s;
+        }
+
+        size_type capacity() const noexcept
+        {
+            return s.size();
+        }
+
+        ring_buffer::span s;
+    };
+
+    shared_sink(
+        logger& owner,
+        std::string name,
+        std::size_t capacity,
+        page_type_t page_type,
+        int numa_node);
+
+    template<auto Format, auto Level, typename Tags, typename... Args>
+    void post_with_str_table(Args&&... args)
+        noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...));
+
+    template<
+        auto Format = nullptr,
+        auto Level = 0,
+        typename Tags = void(),
+        typename Func>
+    void post(Func&& func) noexcept(XTR_NOTHROW_INGESTIBLE(Func, func));
+
+    template<typename Tags>
+    std::byte* reserve(size_type size) noexcept;
+
+    void commit(std::byte* record, size_type size) noexcept;
+
+    // Written in place of a record that could not be completed
+    static std::byte* discard(
+        fmt::memory_buffer&,
+        std::byte* buf,
+        detail::consumer&,
+        const char*,
+        std::string&) noexcept
+    {
+        return buf;
+    }
+
+    // Commits a reserved record as a discarded record when destructed,
+    // unless record has been set to nullptr
+    struct discard_guard
+    {
+        ~discard_guard()
+        {
+            if (record != nullptr) [[unlikely]]
+            {
+                ss->sink_.copy(record + header_size, &discard);
+                ss->commit(record, size);
+            }
+        }
+
+        shared_sink* ss;
+        std::byte* record;
+        size_type size;
+    };
+
+    void publish() noexcept;
+
+    void sync(bool destroy);
+
+    // The sink is registered with the consumer as normal, only the way in
+    // which its queue is written to differs.
+    sink sink_;
+    // Count of bytes reserved in the sink's queue, which is ahead of the
+    // count of bytes written while records are being written.
+    alignas(detail::cacheline_size) std::atomic<size_type> nreserved_{};
+
+    friend logger;
+};
+
+template<auto Format, auto Level, typename Tags, typename... Args>
+void xtr::shared_sink::log(Args&&... args)
+    noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...))
+{
+    constexpr bool is_str =
+        std::disjunction_v<
+            detail::is_c_string<decltype(std::forward<Args>(args))>...,
+            std::is_same<std::remove_cvref_t<Args>, std::string_view>...,
+            std::is_same<std::remove_cvref_t<Args>, std::string>...>;
+    if constexpr (sizeof...(Args) == 0)
+    {
+        constexpr size_type size = header_size + sizeof(fptr_t);
+        std::byte* record = reserve<Tags>(size);
+        if (detail::is_non_blocking_v<Tags> && record == nullptr) [[unlikely]]
+            return;
+        sink_.copy(
+            record + header_size,
+            &detail::trampoline0<Format, Level, detail::consumer>);
+        commit(record, size);
+    }
+    else if constexpr (is_str)
+    {
+        post_with_str_table<Format, Level, Tags>(std::forward<Args>(args)...);
+    }
+    else
+    {
+        post<Format, Level, Tags>(
+            sink_.make_lambda<Tags>(std::forward<Args>(args)...));
+    }
+}
+
+template<auto Format, auto Level, typename Tags, typename... Args>
+void xtr::shared_sink::post_with_str_table(Args&&... args)
+    noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...))
+{
+    using lambda_t =
+        decltype(
+            sink_.make_lambda<Tags>(
+                detail::build_string_table<Tags>(
+                    std::declval<std::byte*&>(),
+                    std::declval<std::byte*&>(),
+                    std::declval<string_table_buffer&>(),
+                    std::forward<Args>(args))...));
+
+    // The position of the record is not known until space is reserved, so
+    // the worst case padding before the lambda is reserved.
+    constexpr size_type fixed_size =
+        header_size + sizeof(fptr_t) + sizeof(std::size_t) +
+        (alignof(lambda_t) > alignof(std::size_t) ?
+            alignof(lambda_t) - alignof(std::size_t) : 0) +
+        sizeof(lambda_t);
+
+    const size_type size =
+        std::min(
+            detail::align(
+                fixed_size + (detail::string_table_size(args) + ...),
+                alignof(fptr_t)),
+            sink_.buf_.capacity());
+
+    std::byte* record = reserve<Tags>(size);
+    if (detail::is_non_blocking_v<Tags> && record == nullptr) [[unlikely]]
+        return;
+
+    const auto pos = record + header_size;
+    const auto size_pos = pos + sizeof(fptr_t);
+
+    auto func_pos = size_pos + sizeof(size_t);
+    if constexpr (alignof(lambda_t) > alignof(size_t))
+        func_pos = detail::align<alignof(lambda_t)>(func_pos);
+
+    // str_cur and str_end are mutated by build_string_table as the
+    // table is built
+    auto str_cur = func_pos + sizeof(lambda_t);
+    auto str_end = record + size;
+    string_table_buffer table{{str_cur, str_end}};
+
+    // If copying the arguments throws then the reserved space must still
+    // be committed, otherwise no further records could be published
+    discard_guard guard{this, record, size};
+
+    sink_.copy(
+        func_pos,
+        sink_.make_lambda<Tags>(
+            detail::build_string_table<Tags>(
+                str_cur,
+                str_end,
+                table,
+                std::forward<Args>(args))...));
+    guard.record = nullptr;
+
+    sink_.copy(pos, &detail::trampolineS<Format, Level, detail::consumer, lambda_t>);
+    const auto next = detail::align<alignof(fptr_t)>(str_cur);
+    sink_.copy(size_pos, size_type(next - pos));
+    commit(record, size);
+}
+
+template<auto Format, auto Level, typename Tags, typename Func>
+void xtr::shared_sink::post(Func&& func)
+    noexcept(XTR_NOTHROW_INGESTIBLE(Func, func))
+{
+    // As in post_with_str_table, the worst case padding is reserved
+    constexpr size_type size =
+        header_size + sizeof(fptr_t) +
+        (alignof(Func) > alignof(fptr_t) ?
+            alignof(Func) - alignof(fptr_t) : 0) +
+        detail::align(sizeof(Func), alignof(fptr_t));
+
+    std::byte* record = reserve<Tags>(size);
+    if (detail::is_non_blocking_v<Tags> && record == nullptr) [[unlikely]]
+        return;
+
+    const auto pos = record + header_size;
+    auto func_pos = pos + sizeof(fptr_t);
+    if constexpr (alignof(Func) > alignof(fptr_t))
+        func_pos = detail::align<alignof(Func)>(func_pos);
+
+    // As in post_with_str_table, the reserved space is committed even if
+    // copying the function throws
+    discard_guard guard{this, record, size};
+    sink_.copy(func_pos, std::forward<Func>(func));
+    guard.record = nullptr;
+
+    sink_.copy(pos, &detail::trampolineN<Format, Level, detail::consumer, Func>);
+    commit(record, size);
+}
+
+template<typename Tags>
+std::byte* xtr::shared_sink::reserve(size_type size) noexcept
+{
+    assert(size <= sink_.buf_.capacity());
+
+    // This acquire pairs with the release by the producer that reserved
+    // the previous record, so that the count of bytes read loaded below is
+    // at least the count that producer checked against.
+    size_type nreserved = nreserved_.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        if (nreserved + size <= sink_.buf_.nread_plus_capacity()) [[likely]]
+        {
+            if (nreserved_.compare_exchange_weak(
+                    nreserved,
+                    nreserved + size,
+                    std::memory_order_acq_rel,
+                    std::memory_order_acquire))
+            {
+                std::byte* record = sink_.buf_.position(nreserved);
+                sink_.copy(record, &detail::trampoline_shared<detail::consumer>);
+                return record;
+            }
+        }
+        else if constexpr (detail::is_non_blocking_v<Tags>)
+        {
+            sink_.buf_.add_dropped();
+            return nullptr;
+        }
+        else
+        {
+            detail::pause();
+            nreserved = nreserved_.load(std::memory_order_acquire);
+        }
+    }
+}
+
+#endif
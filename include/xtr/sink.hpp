@@ -21,16 +21,23 @@
 #ifndef XTR_SINK_HPP
 #define XTR_SINK_HPP
 
-#include "detail/pause.hpp"
-#include "detail/print.hpp"
 #include "detail/string_table.hpp"
+#include "detail/latency_histogram.hpp"
+#include "detail/recovery.hpp"
 #include "detail/synchronized_ring_buffer.hpp"
 #include "detail/tags.hpp"
 #include "detail/trampolines.hpp"
+#include "detail/tsc.hpp"
+#include "detail/waiter.hpp"
 #include "log_level.hpp"
+#include "numa.hpp"
+#include "page_type.hpp"
 
 #include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -38,11 +45,14 @@
 namespace xtr
 {
     class sink;
+    class shared_sink;
     class logger;
 
     namespace detail
     {
         class consumer;
+        class consumer_process;
+        struct remote_queue;
     }
 }
 
@@ -84,13 +94,32 @@ private:
             std::string& name) noexcept;
 
 public:
+    /**
+     * The capacity in bytes of the queue of sinks created without an
+     * explicit capacity.
+     */
+    static constexpr std::size_t default_capacity = 64 * 1024;
+
     sink() = default;
 
+    /**
+     * Capacity constructor. Creates a sink that is not connected to a
+     * logger, with a queue of at least the specified capacity in bytes,
+     * backed by the specified page type and optionally bound to a NUMA node
+     * (see @ref logger::get_sink for details). The sink may be connected to
+     * a logger by calling @ref logger::register_sink.
+     */
+    explicit sink(
+        std::size_t capacity,
+        page_type_t page_type = page_type_t::normal,
+        int numa_node = no_numa_node);
+
     /**
      * Sink copy constructor. When a sink is copied it is automatically
      * registered with the same logger object as the source sink, using
      * the same sink name. The sink name may be modified by calling @ref
-     * set_name.
+     * set_name. The queue of the new sink has the same capacity, page
+     * type and NUMA node as that of the source sink.
      */
     sink(const sink& other);
 
@@ -164,8 +193,41 @@ public:
         return level_.load(std::memory_order_relaxed);
     }
 
+    /**
+     *  Enables producer latency statistics for the sink. Once enabled, the
+     *  time taken by each log call (including any time spent waiting for
+     *  space in a full queue) is measured using the time stamp counter and
+     *  recorded in a histogram, which may be queried using the xtrctl
+     *  latency command\---please see the <a href="guide.html#latency-statistics">
+     *  latency statistics</a> section of the user guide for details.
+     *  Statistics are not copied when the sink is copied.
+     */
+    void enable_latency_stats();
+
 private:
-    sink(logger& owner, std::string name);
+    sink(
+        logger& owner,
+        std::string name,
+        std::size_t capacity,
+        page_type_t page_type,
+        int numa_node,
+        std::unique_ptr<detail::recovery_file> recovery = nullptr);
+
+    // Creates a sink whose queue is the queue of the given region of the
+    // consumer process arena, see detail/consumer_process.hpp
+    explicit sink(detail::remote_queue& q);
+
+    static std::unique_ptr<detail::recovery_file> make_recovery_file(
+        const std::string& dir,
+        const std::string& name,
+        std::size_t capacity,
+        page_type_t page_type);
+
+    static int buffer_flags(page_type_t page_type) noexcept;
+
+    template<auto Format, auto Level, typename Tags, typename... Args>
+    void log_timed(detail::latency_stats& stats, Args&&... args)
+        noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...));
 
     template<auto Format, auto Level, typename Tags = void()>
     void log_impl() noexcept;
@@ -194,21 +256,92 @@ private:
 
     void sync(bool destruct);
 
-    using ring_buffer = detail::synchronized_ring_buffer<64 * 1024>;
+    void remote_sync(bool destruct, bool rename);
+
+    // State shared between a thread calling sync and the consumer
+    struct sync_state
+    {
+        void wait();
+
+        std::condition_variable cv;
+        std::mutex m;
+        bool notified = false; // protected by m
+    };
+
+    // Command posted to the consumer by sync
+    struct sync_command
+    {
+        void operator()(detail::consumer& c, const std::string&) const noexcept;
+
+        sync_state* state;
+        bool destroy;
+    };
+
+    // Wakes the consumer if it is sleeping, see detail::waiter
+    void notify() noexcept
+    {
+        if (waiter_ != nullptr)
+            waiter_->notify();
+    }
+
+    // As above, after a write of nbytes to the queue. Only a write
+    // that made the queue non-empty needs a fence, as the consumer does not
+    // sleep while the queue holds an earlier write.
+    void notify(std::size_t nbytes) noexcept
+    {
+        if (waiter_ == nullptr)
+            return;
+        if (buf_.was_empty(nbytes))
+            waiter_->notify();
+        else
+            waiter_->notify_relaxed();
+    }
+
+    using ring_buffer = detail::synchronized_ring_buffer<>;
 
-    ring_buffer buf_;
+    ring_buffer buf_{default_capacity};
     std::atomic<log_level_t> level_{log_level_t::info};
     bool open_ = false;
+    detail::waiter* waiter_ = nullptr;
+    // Only written by the producer, so the producer may read this with
+    // relaxed ordering, while the consumer must use acquire ordering.
+    std::atomic<detail::latency_stats*> stats_{};
+    // Only set if the queue is backed by a recovery file, see
+    // logger::set_recovery_directory
+    std::unique_ptr<detail::recovery_file> recovery_;
+    // Only set if the queue is consumed by the consumer process, see
+    // logger::start_consumer_process
+    detail::remote_queue* remote_ = nullptr;
 
     friend detail::consumer;
+    friend detail::consumer_process;
     friend logger;
+    friend shared_sink;
 };
 
 template<auto Format, auto Level, typename Tags, typename... Args>
 void xtr::sink::log(Args&&... args)
     noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...))
 {
+    if (auto stats = stats_.load(std::memory_order_relaxed)) [[unlikely]]
+        log_timed<Format, Level, Tags>(*stats, std::forward<Args>(args)...);
+    else
+        log_impl<Format, Level, Tags>(std::forward<Args>(args)...);
+}
+
+template<auto Format, auto Level, typename Tags, typename... Args>
+void xtr::sink::log_timed(detail::latency_stats& stats, Args&&... args)
+    noexcept((XTR_NOTHROW_INGESTIBLE(Args, args) && ...))
+{
+    // Log calls that paused while waiting for space in the queue are
+    // recorded as blocked
+    const std::size_t pause_count = buf_.writer_pause_count();
+    const auto start = detail::tsc::now();
     log_impl<Format, Level, Tags>(std::forward<Args>(args)...);
+    const std::uint64_t ticks = detail::tsc::now().ticks - start.ticks;
+    stats.enqueue.record(ticks);
+    if (buf_.writer_pause_count() != pause_count) [[unlikely]]
+        stats.blocked.record(ticks);
 }
 
 template<auto Format, auto Level, typename Tags>
@@ -222,6 +355,7 @@ void xtr::sink::log_impl() noexcept
         return;
     copy(s.begin(), &detail::trampoline0<Format, Level, detail::consumer>);
     buf_.reduce_writable(sizeof(fptr_t));
+    notify(sizeof(fptr_t));
 }
 
 template<auto Format, auto Level, typename Tags, typename... Args>
@@ -269,7 +403,7 @@ void xtr::sink::post_with_str_table(Args&&... args)
     while (s.size() < size) [[unlikely]]
     {
         if constexpr (!detail::is_non_blocking_v<Tags>)
-            detail::pause();
+            buf_.writer_pause();
         s = buf_.write_span<Tags>();
         if (detail::is_non_blocking_v<Tags> && s.empty()) [[unlikely]]
             return;
@@ -295,6 +429,7 @@ void xtr::sink::post_with_str_table(Args&&... args)
 
     copy(size_pos, total_size);
     buf_.reduce_writable(total_size);
+    notify(total_size);
 }
 
 template<typename T>
@@ -333,7 +468,7 @@ void xtr::sink::post(Func&& func)
     while ((s.size() < size)) [[unlikely]]
     {
         if constexpr (!detail::is_non_blocking_v<Tags>)
-            detail::pause();
+            buf_.writer_pause();
         s = buf_.write_span<Tags>();
         if (detail::is_non_blocking_v<Tags> && s.empty()) [[unlikely]]
             return;
@@ -343,6 +478,7 @@ void xtr::sink::post(Func&& func)
     copy(func_pos, std::forward<Func>(func));
 
     buf_.reduce_writable(size);
+    notify(size);
 }
 
 template<typename Tags, typename... Args>
@@ -355,10 +491,8 @@ auto xtr::sink::make_lambda(Args&&... args)
     return
         [... args = std::forward<Args>(args)](
             fmt::memory_buffer& mbuf,
-            const auto& out,
-            const auto& err,
-            log_level_style_t lstyle,
-            std::string_view fmt,
+            auto& st,
+            const auto& fmt,
             log_level_t level,
             [[maybe_unused]] const char* ts,
             const std::string& name) mutable noexcept
@@ -367,30 +501,9 @@ auto xtr::sink::make_lambda(Args&&... args)
             // forwarded into the lambda, they were still captured by copy,
             // so there is no point in moving them out of the lambda.
             if constexpr (detail::is_timestamp_v<Tags>)
-            {
-                xtr::detail::print_ts(
-                    mbuf,
-                    out,
-                    err,
-                    lstyle,
-                    fmt,
-                    level,
-                    name,
-                    args...);
-            }
+                st.print_ts(mbuf, fmt, level, name, args...);
             else
-            {
-                xtr::detail::print(
-                    mbuf,
-                    out,
-                    err,
-                    lstyle,
-                    fmt,
-                    level,
-                    ts,
-                    name,
-                    args...);
-            }
+                st.print(mbuf, fmt, level, ts, name, args...);
         };
 }
 
@@ -25,6 +25,39 @@ namespace xtr
 {
     struct non_blocking_tag;
     struct timestamp_tag;
+
+    /**
+     * Passed as the first argument to the
+     * @ref io-uring-constructor "io_uring constructor" of @ref logger to
+     * select the io_uring file back-end.
+     */
+    struct io_uring_tag
+    {
+        explicit io_uring_tag() = default;
+    };
+
+    /**
+     * Passed as the first argument to the
+     * @ref mmap-constructor "memory-mapped file constructor" of @ref logger
+     * to select the memory-mapped file back-end.
+     */
+    struct mmap_tag
+    {
+        explicit mmap_tag() = default;
+    };
+
+#if defined(XTR_ENABLE_ZLIB)
+    /**
+     * Passed as the first argument to the
+     * @ref gzip-constructor "gzip constructor" of @ref logger to select the
+     * gzip compressed file back-end. Only available if XTR_ENABLE_ZLIB is
+     * defined.
+     */
+    struct gzip_tag
+    {
+        explicit gzip_tag() = default;
+    };
+#endif
 }
 
 #endif
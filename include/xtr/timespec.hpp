@@ -1,7 +1,10 @@
 #ifndef XTR_TIMESPEC_HPP
 #define XTR_TIMESPEC_HPP
 
+#include <algorithm>
+#include <cstddef>
 #include <ctime>
+#include <limits>
 
 #include <fmt/chrono.h>
 
@@ -23,6 +26,47 @@ namespace xtr
     };
 }
 
+namespace xtr::detail
+{
+    // Writes the given timestamp as YYYY-MM-DD HH:MM:SS.uuuuuu. Timestamps
+    // usually change by less than a second between calls, so the date and
+    // time portion is cached (per thread) and only re-rendered when the
+    // second changes; otherwise only the microsecond digits are written.
+    template<typename OutputIterator>
+    OutputIterator format_timestamp(OutputIterator out, const std::timespec& ts)
+    {
+        struct cache
+        {
+            std::time_t sec = std::numeric_limits<std::time_t>::min();
+            std::size_t size = 0;
+            char buf[24];
+        };
+
+        thread_local cache c;
+
+        if (ts.tv_sec != c.sec) [[unlikely]]
+        {
+            std::tm temp;
+            const auto result =
+                fmt::format_to_n(
+                    c.buf,
+                    sizeof(c.buf),
+                    "{:%Y-%m-%d %T}",
+                    *::gmtime_r(&ts.tv_sec, &temp));
+            c.size = std::min(result.size, sizeof(c.buf));
+            c.sec = ts.tv_sec;
+        }
+
+        char usec[7] = {'.'};
+        auto n = unsigned(ts.tv_nsec / 1000);
+        for (std::size_t i = 6; i > 0; --i, n /= 10)
+            usec[i] = char('0' + n % 10);
+
+        out = std::copy_n(c.buf, c.size, out);
+        return std::copy_n(usec, sizeof(usec), out);
+    }
+}
+
 template<>
 struct fmt::formatter<xtr::timespec>
 {
@@ -35,13 +79,7 @@ struct fmt::formatter<xtr::timespec>
     template<typename FormatContext>
     auto format(const xtr::timespec ts, FormatContext &ctx)
     {
-        std::tm temp;
-        return
-            fmt::format_to(
-                ctx.out(),
-                "{:%Y-%m-%d %T}.{:06}",
-                *::gmtime_r(&ts.tv_sec, &temp),
-                ts.tv_nsec / 1000);
+        return xtr::detail::format_timestamp(ctx.out(), ts);
     }
 };
 
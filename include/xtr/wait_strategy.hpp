@@ -0,0 +1,63 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef XTR_WAIT_STRATEGY_HPP
+#define XTR_WAIT_STRATEGY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+namespace xtr
+{
+    /**
+     * Determines how a logger's consumer thread waits for input when all
+     * sinks are empty, passed to @ref logger::set_wait_strategy. Each time
+     * the consumer thread finds all sinks empty it first spins (polling the
+     * sinks again immediately) up to spin_count times, then executes a
+     * pause instruction between polls up to pause_count times, then sleeps
+     * until woken by a sink being written to (or until max_sleep has
+     * elapsed, whichever is sooner)\---please see the
+     * <a href="guide.html#wait-strategies">wait strategies</a> section of
+     * the user guide for details.
+     */
+    struct wait_strategy
+    {
+        std::size_t spin_count;
+        std::size_t pause_count;
+        std::chrono::microseconds max_sleep;
+    };
+
+    /**
+     * The default wait strategy. The consumer thread never sleeps,
+     * minimising latency at the cost of occupying a CPU core.
+     */
+    inline constexpr wait_strategy busy_wait_strategy{
+        std::numeric_limits<std::size_t>::max(), 0, {}};
+
+    /**
+     * A wait strategy that spins and pauses briefly before sleeping, so
+     * that an idle consumer thread uses little CPU time.
+     */
+    inline constexpr wait_strategy adaptive_wait_strategy{
+        1000, 1000, std::chrono::milliseconds{10}};
+}
+
+#endif
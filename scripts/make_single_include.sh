@@ -11,6 +11,8 @@ echo '#define XTR_LOGGER_HPP\n' >> $target
 for file in \
     include/xtr/timespec.hpp \
     include/xtr/tags.hpp \
+    include/xtr/wait_strategy.hpp \
+    include/xtr/rotation_policy.hpp \
     include/xtr/detail/throw.hpp \
     include/xtr/detail/retry.hpp \
     include/xtr/detail/align.hpp \
@@ -19,22 +21,42 @@ for file in \
     include/xtr/detail/is_c_string.hpp \
     include/xtr/detail/file_descriptor.hpp \
     include/xtr/detail/memory_mapping.hpp \
+    include/xtr/detail/numa.hpp \
     include/xtr/detail/mirrored_memory_mapping.hpp \
+    include/xtr/detail/recovery.hpp \
+    include/xtr/detail/io_uring_file.hpp \
+    include/xtr/detail/gzip_file.hpp \
+    include/xtr/detail/mapped_file.hpp \
+    include/xtr/detail/rotating_file.hpp \
     include/xtr/detail/pause.hpp \
     include/xtr/detail/sanitize.hpp \
     include/xtr/detail/string_ref.hpp \
     include/xtr/detail/tags.hpp \
     include/xtr/detail/synchronized_ring_buffer.hpp \
+    include/xtr/detail/waiter.hpp \
+    include/xtr/detail/consumer_process.hpp \
+    include/xtr/detail/latency_histogram.hpp \
+    include/xtr/detail/rundir.hpp \
     include/xtr/detail/tsc.hpp \
+    include/xtr/detail/tsc_converter.hpp \
     include/xtr/detail/clock_ids.hpp \
     include/xtr/detail/get_time.hpp \
+    include/xtr/detail/limiters.hpp \
     include/xtr/log_level.hpp \
+    include/xtr/detail/callsite.hpp \
+    include/xtr/detail/compiled_format.hpp \
     include/xtr/detail/print.hpp \
+    include/xtr/output_format.hpp \
+    include/xtr/detail/binary_format.hpp \
+    include/xtr/detail/binary_encoder.hpp \
     include/xtr/detail/string.hpp \
     include/xtr/detail/string_table.hpp \
     include/xtr/detail/trampolines.hpp \
     include/xtr/detail/strzcpy.hpp \
+    include/xtr/numa.hpp \
+    include/xtr/page_type.hpp \
     include/xtr/sink.hpp \
+    include/xtr/shared_sink.hpp \
     include/xtr/detail/commands/frame.hpp \
     include/xtr/detail/commands/pattern.hpp \
     include/xtr/detail/commands/message_id.hpp \
@@ -48,6 +70,7 @@ for file in \
     include/xtr/detail/commands/matcher.hpp \
     include/xtr/detail/commands/regex_matcher.hpp \
     include/xtr/detail/commands/wildcard_matcher.hpp \
+    include/xtr/detail/callsite_registry.hpp \
     include/xtr/detail/consumer.hpp \
     include/xtr/command_path.hpp \
     include/xtr/log_macros.hpp \
@@ -57,20 +80,33 @@ do
 done
 
 grep -hEv '^ *//|^#include "' \
+    src/binary_encoder.cpp \
+    src/callsite.cpp \
     src/command_dispatcher.cpp \
     src/command_path.cpp \
     src/consumer.cpp \
+    src/consumer_process.cpp \
     src/file_descriptor.cpp \
+    src/gzip_file.cpp \
+    src/io_uring_file.cpp \
+    src/latency_histogram.cpp \
     src/logger.cpp \
     src/log_level.cpp \
+    src/mapped_file.cpp \
     src/matcher.cpp \
     src/memory_mapping.cpp \
     src/mirrored_memory_mapping.cpp \
+    src/numa.cpp \
     src/pagesize.cpp \
+    src/recovery.cpp \
     src/regex_matcher.cpp \
+    src/rotating_file.cpp \
+    src/shared_sink.cpp \
     src/sink.cpp \
     src/throw.cpp \
     src/tsc.cpp \
+    src/tsc_converter.cpp \
+    src/waiter.cpp \
     src/wildcard_matcher.cpp  >> $target
 echo '#endif' >> $target
 
@@ -0,0 +1,253 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/binary_decoder.hpp"
+#include "xtr/detail/binary_format.hpp"
+#include "xtr/detail/string_ref.hpp"
+#include "xtr/detail/throw.hpp"
+#include "xtr/timespec.hpp"
+
+#if __has_include(<fmt/args.h>)
+#include <fmt/args.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <string_view>
+
+struct xtr::detail::binary_decoder::reader
+{
+    using arg_store = fmt::dynamic_format_arg_store<fmt::format_context>;
+
+    // All get functions return false if insufficient data is available,
+    // i.e. if the record being read is incomplete.
+    template<typename T>
+    bool get(T& value)
+    {
+        if (std::size_t(end - pos) < sizeof(T))
+            return false;
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool get(std::string_view& s)
+    {
+        std::uint32_t len;
+        if (!get(len) || std::size_t(end - pos) < len)
+            return false;
+        s = std::string_view(pos, len);
+        pos += len;
+        return true;
+    }
+
+    template<typename T>
+    bool push(arg_store& args)
+    {
+        T value;
+        if (!get(value))
+            return false;
+        args.push_back(value);
+        return true;
+    }
+
+    bool get_arg(arg_store& args);
+
+    const char* pos;
+    const char* end;
+};
+
+XTR_FUNC
+bool xtr::detail::binary_decoder::reader::get_arg(arg_store& args)
+{
+    binary_arg_type type;
+    if (!get(type))
+        return false;
+
+    switch (type)
+    {
+    case binary_arg_type::boolean:
+    {
+        std::uint8_t value;
+        if (!get(value))
+            return false;
+        args.push_back(value != 0);
+        return true;
+    }
+    case binary_arg_type::character:
+        return push<char>(args);
+    case binary_arg_type::int64:
+        return push<std::int64_t>(args);
+    case binary_arg_type::uint64:
+        return push<std::uint64_t>(args);
+    case binary_arg_type::float32:
+        return push<float>(args);
+    case binary_arg_type::float64:
+        return push<double>(args);
+    case binary_arg_type::pointer:
+    {
+        std::uint64_t value;
+        if (!get(value))
+            return false;
+        args.push_back(reinterpret_cast<const void*>(std::uintptr_t(value)));
+        return true;
+    }
+    case binary_arg_type::string:
+        return push<std::string_view>(args);
+    case binary_arg_type::string_ref:
+    {
+        std::string_view value;
+        if (!get(value))
+            return false;
+        args.push_back(string_ref<std::string_view>(value));
+        return true;
+    }
+    case binary_arg_type::timespec:
+    {
+        std::int64_t sec;
+        std::int64_t nsec;
+        if (!get(sec) || !get(nsec))
+            return false;
+        std::timespec ts{};
+        ts.tv_sec = std::time_t(sec);
+        ts.tv_nsec = long(nsec);
+        args.push_back(xtr::timespec{ts});
+        return true;
+    }
+    }
+
+    throw_runtime_error("Invalid argument type");
+}
+
+XTR_FUNC
+std::size_t xtr::detail::binary_decoder::decode(
+    const char* buf,
+    std::size_t size,
+    fmt::memory_buffer& mbuf)
+{
+    reader r{buf, buf + size};
+    std::size_t nconsumed = 0;
+
+    while (r.pos != r.end)
+    {
+        binary_record_type type;
+        r.get(type);
+
+        switch (type)
+        {
+        case binary_record_type::header:
+        {
+            char magic[sizeof(binary_magic) - 1];
+            std::uint32_t version;
+            if (!r.get(magic) || !r.get(version))
+                return nconsumed;
+            if (std::memcmp(magic, binary_magic + 1, sizeof(magic)) != 0)
+                throw_runtime_error("Invalid header");
+            if (version != binary_version)
+                throw_runtime_error("Unsupported version or byte order");
+            formats_.clear();
+            break;
+        }
+        case binary_record_type::format:
+        {
+            std::uint32_t id;
+            std::string_view fmt;
+            if (!r.get(id) || !r.get(fmt))
+                return nconsumed;
+            if (id != formats_.size())
+                throw_runtime_error("Invalid format id");
+            formats_.emplace_back(fmt);
+            break;
+        }
+        case binary_record_type::log:
+            if (!decode_log(r, mbuf))
+                return nconsumed;
+            break;
+        default:
+            throw_runtime_error("Invalid record type");
+        }
+
+        nconsumed = std::size_t(r.pos - buf);
+    }
+
+    return nconsumed;
+}
+
+XTR_FUNC
+bool xtr::detail::binary_decoder::decode_log(
+    reader& r,
+    fmt::memory_buffer& mbuf)
+{
+    std::uint32_t id;
+    std::uint8_t level;
+    std::string_view name;
+    std::uint8_t nargs;
+
+    if (!r.get(id) || !r.get(level) || !r.get(name) || !r.get(nargs))
+        return false;
+
+    if (id >= formats_.size())
+        throw_runtime_error("Undefined format id");
+
+    if (level > std::uint8_t(log_level_t::debug) || nargs == 0)
+        throw_runtime_error("Invalid log record");
+
+    // Arguments are pushed in the order expected by the format strings
+    // produced by the log macros: level, timestamp, sink name then the
+    // remaining arguments. The timestamp is the first encoded argument.
+    reader::arg_store args;
+    args.push_back(lstyle_(log_level_t(level)));
+    const char* const ts_pos = r.pos;
+    if (!r.get_arg(args))
+        return false;
+    args.push_back(name);
+    for (std::uint8_t i = 1; i < nargs; ++i)
+    {
+        if (!r.get_arg(args))
+            return false;
+    }
+
+#if __cpp_exceptions
+    const std::size_t mbuf_size = mbuf.size();
+    try
+    {
+#endif
+        fmt::vformat_to(std::back_inserter(mbuf), formats_[id], args);
+#if __cpp_exceptions
+    }
+    catch (const std::exception& e)
+    {
+        // Mirror the error reporting of the logger
+        mbuf.resize(mbuf_size);
+        reader ts_reader{ts_pos, r.end};
+        reader::arg_store eargs;
+        eargs.push_back(lstyle_(log_level_t::error));
+        ts_reader.get_arg(eargs);
+        eargs.push_back(name);
+        eargs.push_back(e.what());
+        fmt::vformat_to(
+            std::back_inserter(mbuf), "{}{} {}: Error: {}\n", eargs);
+    }
+#endif
+
+    return true;
+}
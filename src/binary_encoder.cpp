@@ -0,0 +1,64 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/binary_encoder.hpp"
+
+#include <iterator>
+
+XTR_FUNC
+void xtr::detail::binary_encoder::reset() noexcept
+{
+    ids_.clear();
+}
+
+XTR_FUNC
+void xtr::detail::binary_encoder::begin(
+    fmt::memory_buffer& mbuf,
+    std::string_view fmt,
+    log_level_t level,
+    const std::string& name,
+    std::uint8_t nargs)
+{
+    // A header is written before the first record following construction or
+    // a reset, which is exactly when no formats have been written.
+    if (ids_.empty())
+    {
+        mbuf.append(std::begin(binary_magic), std::end(binary_magic));
+        binary_put(mbuf, binary_version);
+    }
+
+    const auto [it, inserted] =
+        ids_.try_emplace(fmt.data(), std::uint32_t(ids_.size()));
+
+    if (inserted)
+    {
+        binary_put(mbuf, binary_record_type::format);
+        binary_put(mbuf, it->second);
+        binary_put(mbuf, std::uint32_t(fmt.size()));
+        mbuf.append(fmt.data(), fmt.data() + fmt.size());
+    }
+
+    binary_put(mbuf, binary_record_type::log);
+    binary_put(mbuf, it->second);
+    binary_put(mbuf, std::uint8_t(level));
+    binary_put(mbuf, std::uint32_t(name.size()));
+    mbuf.append(name.data(), name.data() + name.size());
+    binary_put(mbuf, nargs);
+}
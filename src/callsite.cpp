@@ -0,0 +1,192 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/callsite.hpp"
+#include "xtr/detail/callsite_registry.hpp"
+#include "xtr/detail/commands/matcher.hpp"
+#include "xtr/detail/commands/pattern.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace xtr::detail
+{
+    struct callsite_rule
+    {
+        // The matcher may refer to the pattern text, so rules are stored in
+        // a list to avoid the pattern being moved
+        struct pattern pattern;
+        std::unique_ptr<matcher> match;
+        bool enabled;
+    };
+
+    struct callsite_registry
+    {
+        static callsite_registry& instance()
+        {
+            static callsite_registry registry;
+            return registry;
+        }
+
+        static bool equal_patterns(const pattern& a, const pattern& b)
+        {
+            return
+                a.type == b.type &&
+                a.ignore_case == b.ignore_case &&
+                std::strcmp(a.text, b.text) == 0;
+        }
+
+        static std::string location(const callsite& cs)
+        {
+            return std::string(cs.file()) + ":" + std::to_string(cs.line());
+        }
+
+        bool rules_enable(const callsite& cs) const noexcept
+        {
+            // Formatted into a fixed size buffer as registration must not
+            // allocate
+            char loc[PATH_MAX + 16];
+            std::snprintf(loc, sizeof(loc), "%s:%u", cs.file(), cs.line());
+
+            for (auto it = rules.rbegin(); it != rules.rend(); ++it)
+            {
+                if ((*it->match)(loc))
+                    return it->enabled;
+            }
+
+            return true;
+        }
+
+        void add(callsite& cs) noexcept
+        {
+            if (tail == nullptr)
+                head = &cs;
+            else
+                tail->next_ = &cs;
+            tail = &cs;
+        }
+
+        static callsite* next(const callsite& cs) noexcept
+        {
+            return cs.next_;
+        }
+
+        std::mutex mutex;
+        // Callsites are only ever appended, so the next pointer of every
+        // callsite other than the tail is immutable
+        callsite* head = nullptr;
+        callsite* tail = nullptr;
+        std::list<callsite_rule> rules;
+    };
+}
+
+XTR_FUNC
+bool xtr::detail::register_callsite(callsite& cs) noexcept
+{
+    auto& reg = callsite_registry::instance();
+    std::scoped_lock lock{reg.mutex};
+
+    // Another thread may have registered the callsite first
+    if (cs.state_.load(std::memory_order_relaxed) != callsite::state::unregistered)
+        return !cs.disabled();
+
+    reg.add(cs);
+
+    const bool enabled = reg.rules_enable(cs);
+    cs.set_enabled(enabled);
+    return enabled;
+}
+
+XTR_FUNC
+void xtr::detail::set_callsites_enabled(const pattern& pat, bool enabled)
+{
+    auto& reg = callsite_registry::instance();
+    std::scoped_lock lock{reg.mutex};
+
+    // A pattern matching every callsite supersedes all previous patterns
+    if (pat.type == pattern_type_t::none)
+        reg.rules.clear();
+
+    // Repeating a pattern replaces the earlier rule rather than adding another,
+    // so that the rule list stays bounded by the number of distinct patterns
+    auto it =
+        std::find_if(
+            reg.rules.begin(),
+            reg.rules.end(),
+            [&](const callsite_rule& r)
+            {
+                return callsite_registry::equal_patterns(r.pattern, pat);
+            });
+
+    if (it != reg.rules.end())
+    {
+        // Move the rule to the end so that it is the most recent
+        reg.rules.splice(reg.rules.end(), reg.rules, it);
+        it->enabled = enabled;
+    }
+    else
+    {
+        it = reg.rules.emplace(reg.rules.end(), pat, nullptr, enabled);
+        it->match = make_matcher(
+            it->pattern.type, it->pattern.text, it->pattern.ignore_case);
+    }
+
+    callsite_rule& rule = *it;
+
+    for (callsite* cs = reg.head; cs != nullptr; cs = reg.next(*cs))
+    {
+        if ((*rule.match)(callsite_registry::location(*cs).c_str()))
+            cs->set_enabled(enabled);
+    }
+}
+
+XTR_FUNC
+void xtr::detail::for_each_callsite(
+    const std::function<void(const callsite&)>& func)
+{
+    auto& reg = callsite_registry::instance();
+
+    // The lock is only held while taking a snapshot of the list, so that it
+    // isn't held while func is invoked, as that would block threads executing
+    // log statements for the first time
+    const callsite* first;
+    const callsite* last;
+    {
+        std::scoped_lock lock{reg.mutex};
+        first = reg.head;
+        last = reg.tail;
+    }
+
+    if (first == nullptr)
+        return;
+
+    for (const callsite* cs = first;; cs = reg.next(*cs))
+    {
+        func(*cs);
+        if (cs == last)
+            break;
+    }
+}
@@ -19,6 +19,7 @@
 // SOFTWARE.
 
 #include "xtr/command_path.hpp"
+#include "xtr/detail/rundir.hpp"
 
 #include <atomic>
 #include <cstdio>
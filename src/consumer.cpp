@@ -19,11 +19,16 @@
 // SOFTWARE.
 
 #include "xtr/detail/consumer.hpp"
+#include "xtr/detail/callsite.hpp"
+#include "xtr/detail/callsite_registry.hpp"
 #include "xtr/detail/commands/command_dispatcher.hpp"
 #include "xtr/detail/commands/matcher.hpp"
 #include "xtr/detail/commands/requests.hpp"
 #include "xtr/detail/commands/responses.hpp"
+#include "xtr/detail/consumer_process.hpp"
+#include "xtr/detail/pause.hpp"
 #include "xtr/detail/strzcpy.hpp"
+#include "xtr/detail/tsc.hpp"
 #include "xtr/command_path.hpp"
 #include "xtr/sink.hpp"
 #include "xtr/timespec.hpp"
@@ -41,8 +46,16 @@ void xtr::detail::consumer::run(std::function<::timespec()> clock) noexcept
     char ts[32] = {};
     bool ts_stale = true;
     std::size_t flush_count = 0;
+    std::size_t idle_count = 0;
+    bool idle = false;
     fmt::memory_buffer mbuf;
 
+    if (primary_ != nullptr)
+    {
+        const auto lock = lock_backend();
+        group_->shards.push_back(this);
+    }
+
     for (std::size_t i = 0; !sinks_.empty(); ++i)
     {
         sink::ring_buffer::span span;
@@ -55,21 +68,42 @@ void xtr::detail::consumer::run(std::function<::timespec()> clock) noexcept
             ts_stale |= true;
             if (cmds_)
                 cmds_->process_commands(/* timeout= */0);
+            if (own_backend_ &&
+                group_->nreopens.load(std::memory_order_relaxed) != nreopens_) [[unlikely]]
+            {
+                reopen_backend();
+            }
+            if (process_ != nullptr && process_->is_child()) [[unlikely]]
+            {
+                if (!poll_process(idle))
+                    break;
+            }
+            if (idle)
+                wait_for_input(++idle_count);
+            else
+                idle_count = 0;
+            idle = true;
         }
 
         if ((span = sinks_[n]->buf_.read_span()).empty())
         {
             // flush if no further data available (all sinks empty)
             if (flush_count != 0 && flush_count-- == 1)
-                flush();
+            {
+                const auto lock = lock_output();
+                ++backend().nflushes;
+                backend().flush();
+            }
             continue;
         }
 
         destroy = false;
+        idle = false;
 
         if (ts_stale)
         {
-            fmt::format_to(ts, "{}", xtr::timespec{clock()});
+            ts_ = clock();
+            *detail::format_timestamp(ts, ts_) = '\0';
             ts_stale = false;
         }
 
@@ -83,47 +117,173 @@ void xtr::detail::consumer::run(std::function<::timespec()> clock) noexcept
         // model.
         std::byte* pos = span.begin();
         std::byte* end = std::min(span.end(), sinks_[n]->buf_.end());
+        // Writes made while processing records (i.e. if the output is not
+        // batched) are excluded from the time spent formatting. If the
+        // back-end is shared then write_ticks_ may be modified by other
+        // consumers, but writes are never made while processing records.
+        const auto format_start = detail::tsc::now();
+        const bool shared = shared_backend();
+        const std::uint64_t write_ticks = shared ? 0 : write_ticks_;
+        std::uint64_t nrecords = 0;
         do
         {
             assert(std::uintptr_t(pos) % alignof(sink::fptr_t) == 0);
             assert(!destroy);
             const sink::fptr_t fptr = *reinterpret_cast<const sink::fptr_t*>(pos);
             pos = fptr(mbuf, pos, *this, ts, sinks_[n].name);
+            ++nrecords;
         } while (pos < end);
+        std::uint64_t format_ticks = detail::tsc::now().ticks - format_start.ticks;
+        if (!shared)
+            format_ticks -= std::min(format_ticks, write_ticks_ - write_ticks);
 
         if (destroy)
         {
+            const auto lock = lock_backend();
+            sink& s = *sinks_[n].p;
             using std::swap;
             swap(sinks_[n], sinks_.back()); // possible self-swap, ok
             sinks_.pop_back();
+            // Proxies of remote sinks are owned by the consumer process
+            if (process_ != nullptr) [[unlikely]]
+                process_->release(s);
             continue;
         }
 
+        // Consumed records must be cleared from recovery files before the
+        // space is released to the producer, see detail/recovery.hpp
+        if (sinks_[n]->recovery_) [[unlikely]]
+            sinks_[n]->recovery_->consumed(span.begin(), pos);
+
         sinks_[n]->buf_.reduce_readable(
             sink::ring_buffer::size_type(pos - span.begin()));
 
+        {
+            const auto lock = lock_backend();
+            sink_handle& s = sinks_[n];
+            s.peak_nbytes = std::max(s.peak_nbytes, std::size_t(span.size()));
+            s.bytes_consumed += std::uint64_t(pos - span.begin());
+            s.records_consumed += nrecords;
+            format_ticks_ += format_ticks;
+        }
+
         std::size_t n_dropped;
         if (sinks_[n]->buf_.read_span().empty() &&
             (n_dropped = sinks_[n]->buf_.dropped_count()) > 0)
         {
-            detail::print(
+            print(
                 mbuf,
-                out,
-                err,
-                lstyle,
                 "{}{} {}: {} messages dropped\n",
                 log_level_t::warning,
                 ts,
                 sinks_[n].name,
                 n_dropped);
+            const auto lock = lock_backend();
             sinks_[n].dropped_count += n_dropped;
         }
 
+        write_batch(sinks_[n].name);
+
         // flushing may be late/early if sinks is modified, doesn't matter
         flush_count = sinks_.size();
     }
 
-    close();
+    const auto lock = lock_backend();
+    if (primary_ != nullptr)
+        std::erase(group_->shards, this);
+    if (primary_ == nullptr || own_backend_)
+        close();
+}
+
+XTR_FUNC
+xtr::detail::consumer::consumer(
+    consumer& primary,
+    sink* control,
+    detail::waiter* w)
+:
+    lstyle(primary.lstyle),
+    output_format(primary.output_format),
+    wstrategy(primary.wstrategy),
+    sinks_({{control, "control", 0}}),
+    group_(primary.group_),
+    primary_(&primary),
+    nreopens_(primary.group_->nreopens.load(std::memory_order_relaxed)),
+    waiter_(w)
+{
+}
+
+XTR_FUNC
+void xtr::detail::consumer::wait_for_input(std::size_t idle_count) noexcept
+{
+    if (idle_count <= wstrategy.spin_count) [[likely]]
+        return;
+
+    if (idle_count - wstrategy.spin_count <= wstrategy.pause_count)
+    {
+        detail::pause();
+        return;
+    }
+
+    // Sinks are checked again after setting the sleeping flag, so that a
+    // sink written to after the previous loop over sinks is not missed
+    waiter_->prepare_wait();
+    for (auto& s : sinks_)
+    {
+        if (!s->buf_.read_span().empty())
+        {
+            waiter_->cancel_wait();
+            return;
+        }
+    }
+    waiter_->wait(wstrategy.max_sleep);
+}
+
+XTR_FUNC
+void xtr::detail::consumer::enable_sharding()
+{
+    if (group_ == nullptr)
+        group_ = std::make_shared<shard_group>();
+}
+
+XTR_FUNC
+void xtr::detail::consumer::write_batch(const std::string& name) noexcept
+{
+    if (batch_.size() == 0)
+        return;
+
+    const xtr::timespec ts{ts_};
+
+    if (!shared_backend()) [[likely]]
+    {
+        output(log_level_t::none, batch_.data(), batch_.size(), ts, name);
+        batch_.clear();
+        return;
+    }
+
+    const auto lock = lock_backend();
+    consumer& b = backend();
+
+    if (b.out_batch)
+    {
+        b.output(log_level_t::none, batch_.data(), batch_.size(), ts, name);
+    }
+    else
+    {
+        std::size_t begin = 0;
+        for (const auto& [end, level] : records_)
+        {
+            b.output(level, batch_.data() + begin, end - begin, ts, name);
+            begin = end;
+        }
+    }
+
+    batch_.clear();
+    records_.clear();
+
+    // Shards take a copy of the primary's configuration whenever the lock
+    // is held, so changes take effect from the next batch.
+    lstyle = b.lstyle;
+    output_format = b.output_format;
 }
 
 XTR_FUNC
@@ -157,6 +317,21 @@ void xtr::detail::consumer::set_command_path(std::string path) noexcept
 
     cmds_->register_callback<detail::reopen>(
         std::bind_front(&consumer::reopen_handler, this));
+
+    cmds_->register_callback<detail::latency>(
+        std::bind_front(&consumer::latency_handler, this));
+
+    cmds_->register_callback<detail::stats>(
+        std::bind_front(&consumer::stats_handler, this));
+
+    cmds_->register_callback<detail::callsites>(
+        std::bind_front(&consumer::callsites_handler, this));
+
+    cmds_->register_callback<detail::set_callsite>(
+        std::bind_front(&consumer::set_callsite_handler, this));
+
+    cmds_->register_callback<detail::recover>(
+        std::bind_front(&consumer::recover_handler, this));
 #else
     // This can be removed when libc++ supports bind_front
     cmds_->register_callback<detail::status>(
@@ -176,9 +351,57 @@ void xtr::detail::consumer::set_command_path(std::string path) noexcept
         {
             reopen_handler(std::forward<decltype(args)>(args)...);
         });
+
+    cmds_->register_callback<detail::latency>(
+        [this](auto&&... args)
+        {
+            latency_handler(std::forward<decltype(args)>(args)...);
+        });
+
+    cmds_->register_callback<detail::stats>(
+        [this](auto&&... args)
+        {
+            stats_handler(std::forward<decltype(args)>(args)...);
+        });
+
+    cmds_->register_callback<detail::callsites>(
+        [this](auto&&... args)
+        {
+            callsites_handler(std::forward<decltype(args)>(args)...);
+        });
+
+    cmds_->register_callback<detail::set_callsite>(
+        [this](auto&&... args)
+        {
+            set_callsite_handler(std::forward<decltype(args)>(args)...);
+        });
+
+    cmds_->register_callback<detail::recover>(
+        [this](auto&&... args)
+        {
+            recover_handler(std::forward<decltype(args)>(args)...);
+        });
 #endif
 }
 
+template<typename Func>
+void xtr::detail::consumer::for_each_sink(Func&& func)
+{
+    const auto lock = lock_backend();
+
+    for (std::size_t i = 1; i < sinks_.size(); ++i)
+        func(sinks_[i]);
+
+    if (group_ != nullptr)
+    {
+        for (consumer* shard : group_->shards)
+        {
+            for (std::size_t i = 1; i < shard->sinks_.size(); ++i)
+                func(shard->sinks_[i]);
+        }
+    }
+}
+
 XTR_FUNC
 void xtr::detail::consumer::status_handler(int fd, detail::status& st)
 {
@@ -196,23 +419,22 @@ void xtr::detail::consumer::status_handler(int fd, detail::status& st)
         return;
     }
 
-    for (std::size_t i = 1; i < sinks_.size(); ++i)
-    {
-        auto& s = sinks_[i];
-
-        if (!(*matcher)(s.name.c_str()))
-            continue;
+    for_each_sink(
+        [&](sink_handle& s)
+        {
+            if (!(*matcher)(s.name.c_str()))
+                return;
 
-        detail::frame<detail::sink_info> sif;
+            detail::frame<detail::sink_info> sif;
 
-        sif->level = s->level();
-        sif->buf_capacity = s->buf_.capacity();
-        sif->buf_nbytes = s->buf_.read_span().size();
-        sif->dropped_count = s.dropped_count;
-        detail::strzcpy(sif->name, s.name);
+            sif->level = s->level();
+            sif->buf_capacity = s->buf_.capacity();
+            sif->buf_nbytes = s->buf_.read_span().size();
+            sif->dropped_count = s.dropped_count;
+            detail::strzcpy(sif->name, s.name);
 
-        cmds_->send(fd, sif);
-    }
+            cmds_->send(fd, sif);
+        });
 }
 
 XTR_FUNC
@@ -238,24 +460,250 @@ void xtr::detail::consumer::set_level_handler(int fd, detail::set_level& sl)
         return;
     }
 
-    for (std::size_t i = 1; i < sinks_.size(); ++i)
+    for_each_sink(
+        [&](sink_handle& s)
+        {
+            if ((*matcher)(s.name.c_str()))
+                s->set_level(sl.level);
+        });
+
+    cmds_->send(fd, detail::frame<detail::success>());
+}
+
+XTR_FUNC
+void xtr::detail::consumer::latency_handler(int fd, detail::latency& lt)
+{
+    lt.pattern.text[sizeof(lt.pattern.text) - 1] = '\0';
+
+    const auto matcher =
+        detail::make_matcher(
+            lt.pattern.type, lt.pattern.text, lt.pattern.ignore_case);
+
+    if (!matcher->valid())
     {
-        auto& s = sinks_[i];
+        detail::frame<detail::error> ef;
+        matcher->error_reason(ef->reason, sizeof(ef->reason));
+        cmds_->send(fd, ef);
+        return;
+    }
 
-        if (!(*matcher)(s.name.c_str()))
-            continue;
+    const double ns_per_tick = 1e9 / double(detail::get_tsc_hz());
+
+    const auto summarise =
+        [=](const detail::latency_histogram& h, detail::latency_summary& ls)
+        {
+            const auto ns =
+                [=](std::uint64_t ticks)
+                {
+                    return std::uint64_t(double(ticks) * ns_per_tick);
+                };
+            ls.count = h.count();
+            ls.p50 = ns(h.value_at_percentile(50.0));
+            ls.p90 = ns(h.value_at_percentile(90.0));
+            ls.p99 = ns(h.value_at_percentile(99.0));
+            ls.p999 = ns(h.value_at_percentile(99.9));
+            ls.p9999 = ns(h.value_at_percentile(99.99));
+            ls.max = ns(h.max());
+        };
+
+    // Sinks without latency statistics enabled are not reported
+    for_each_sink(
+        [&](sink_handle& s)
+        {
+            const auto stats = s->stats_.load(std::memory_order_acquire);
+            if (stats == nullptr || !(*matcher)(s.name.c_str()))
+                return;
+
+            detail::frame<detail::sink_latency> slf;
+
+            summarise(stats->enqueue, slf->enqueue);
+            summarise(stats->blocked, slf->blocked);
+            detail::strzcpy(slf->name, s.name);
+
+            cmds_->send(fd, slf);
+        });
+}
+
+XTR_FUNC
+void xtr::detail::consumer::stats_handler(int fd, detail::stats& st)
+{
+    st.pattern.text[sizeof(st.pattern.text) - 1] = '\0';
+
+    const auto matcher =
+        detail::make_matcher(
+            st.pattern.type, st.pattern.text, st.pattern.ignore_case);
+
+    if (!matcher->valid())
+    {
+        detail::frame<detail::error> ef;
+        matcher->error_reason(ef->reason, sizeof(ef->reason));
+        cmds_->send(fd, ef);
+        return;
+    }
+
+    for_each_sink(
+        [&](sink_handle& s)
+        {
+            if (!(*matcher)(s.name.c_str()))
+                return;
+
+            detail::frame<detail::sink_stats> ssf;
+
+            ssf->buf_capacity = s->buf_.capacity();
+            ssf->buf_nbytes = s->buf_.read_span().size();
+            ssf->peak_nbytes = s.peak_nbytes;
+            ssf->bytes_consumed = s.bytes_consumed;
+            ssf->records_consumed = s.records_consumed;
+            ssf->dropped_count = s.dropped_count;
+            detail::strzcpy(ssf->name, s.name);
 
-        s->set_level(sl.level);
+            cmds_->send(fd, ssf);
+        });
+
+    const double ns_per_tick = 1e9 / double(detail::get_tsc_hz());
+
+    detail::frame<detail::consumer_stats> csf;
+
+    {
+        const auto lock = lock_backend();
+        std::uint64_t format_ticks = format_ticks_;
+        if (group_ != nullptr)
+        {
+            for (consumer* shard : group_->shards)
+                format_ticks += shard->format_ticks_;
+        }
+        csf->format_ns = std::uint64_t(double(format_ticks) * ns_per_tick);
+        csf->write_ns = std::uint64_t(double(write_ticks_) * ns_per_tick);
+        csf->flush_count = nflushes;
+        csf->sync_count = nsyncs;
     }
 
+    csf->elapsed_ns =
+        std::uint64_t(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_time_).count());
+
+    cmds_->send(fd, csf);
+}
+
+XTR_FUNC
+void xtr::detail::consumer::callsites_handler(int fd, detail::callsites& cs)
+{
+    cs.pattern.text[sizeof(cs.pattern.text) - 1] = '\0';
+
+    const auto matcher =
+        detail::make_matcher(
+            cs.pattern.type, cs.pattern.text, cs.pattern.ignore_case);
+
+    if (!matcher->valid())
+    {
+        detail::frame<detail::error> ef;
+        matcher->error_reason(ef->reason, sizeof(ef->reason));
+        cmds_->send(fd, ef);
+        return;
+    }
+
+    std::string location;
+
+    detail::for_each_callsite(
+        [&](const callsite& c)
+        {
+            location = c.file();
+            location += ':';
+            location += std::to_string(c.line());
+
+            if (!(*matcher)(location.c_str()))
+                return;
+
+            detail::frame<detail::callsite_info> cif;
+
+            cif->level = c.level();
+            cif->line = c.line();
+            cif->enabled = !c.disabled();
+            detail::strzcpy(cif->file, std::string_view{c.file()});
+            detail::strzcpy(cif->format, std::string_view{c.format()});
+
+            cmds_->send(fd, cif);
+        });
+}
+
+XTR_FUNC
+void xtr::detail::consumer::set_callsite_handler(
+    int fd,
+    detail::set_callsite& sc)
+{
+    sc.pattern.text[sizeof(sc.pattern.text) - 1] = '\0';
+
+    const auto matcher =
+        detail::make_matcher(
+            sc.pattern.type, sc.pattern.text, sc.pattern.ignore_case);
+
+    if (!matcher->valid())
+    {
+        detail::frame<detail::error> ef;
+        matcher->error_reason(ef->reason, sizeof(ef->reason));
+        cmds_->send(fd, ef);
+        return;
+    }
+
+    detail::set_callsites_enabled(sc.pattern, sc.enabled);
+
     cmds_->send(fd, detail::frame<detail::success>());
 }
 
+XTR_FUNC
+void xtr::detail::consumer::recover_handler(int fd, detail::recover& rc)
+{
+    rc.path[sizeof(rc.path) - 1] = '\0';
+
+    const auto lock = lock_backend();
+
+    std::size_t nfiles;
+    if (!recover(rc.path, nfiles))
+        cmds_->send_error(fd, std::strerror(errno));
+    else
+        cmds_->send(fd, detail::frame<detail::success>());
+}
+
 XTR_FUNC
 void xtr::detail::consumer::reopen_handler(int fd, detail::reopen&)
 {
+    const auto lock = lock_backend();
+
+    // The consumer process is asked to reopen its back-end too, even if
+    // reopening fails here
+    if (process_ != nullptr)
+        process_->request_reopen();
+
+    // Shards with their own back-ends reopen them on their own threads, so
+    // are only woken here
+    if (group_ != nullptr)
+    {
+        group_->nreopens.fetch_add(1, std::memory_order_relaxed);
+        for (consumer* shard : group_->shards)
+        {
+            if (shard->own_backend_)
+                shard->waiter_->notify();
+        }
+    }
+
     if (!reopen())
+    {
         cmds_->send_error(fd, std::strerror(errno));
+    }
     else
+    {
+        encoder.reset();
         cmds_->send(fd, detail::frame<detail::success>());
+    }
+}
+
+XTR_FUNC
+void xtr::detail::consumer::reopen_backend() noexcept
+{
+    nreopens_ = group_->nreopens.load(std::memory_order_relaxed);
+    if (reopen())
+        encoder.reset();
+    else
+        report_error(err, lstyle, xtr::timespec{ts_}, "control", std::strerror(errno));
 }
@@ -0,0 +1,463 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/consumer_process.hpp"
+#include "xtr/detail/commands/command_dispatcher.hpp"
+#include "xtr/detail/consumer.hpp"
+#include "xtr/detail/numa.hpp"
+#include "xtr/detail/pagesize.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/strzcpy.hpp"
+#include "xtr/detail/throw.hpp"
+#include "xtr/detail/tsc.hpp"
+#include "xtr/sink.hpp"
+#include "xtr/timespec.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace xtr::detail
+{
+    // Sleeps until the given counter is woken by wake_counter or until a
+    // timeout expires, if the counter is equal to value
+    inline void wait_counter(
+        const std::atomic<std::uint32_t>& counter,
+        std::uint32_t value) noexcept
+    {
+#if defined(__linux__)
+        const std::timespec ts{.tv_sec=0, .tv_nsec=100'000'000};
+        auto* const addr = reinterpret_cast<const std::uint32_t*>(&counter);
+        ::syscall(SYS_futex, addr, FUTEX_WAIT, value, &ts, nullptr, 0);
+#else
+        (void)counter;
+        (void)value;
+#endif
+    }
+
+    inline void wake_counter(std::atomic<std::uint32_t>& counter) noexcept
+    {
+#if defined(__linux__)
+        auto* const addr = reinterpret_cast<std::uint32_t*>(&counter);
+        ::syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+        (void)counter;
+#endif
+    }
+
+    inline std::size_t remote_queue_header_size() noexcept
+    {
+        return align_to_page_size(sizeof(remote_queue));
+    }
+
+    // Returns the number of threads in the calling process, or -1 if it
+    // cannot be determined
+    inline long thread_count() noexcept
+    {
+#if defined(__linux__)
+        // The thread count is the twentieth field of /proc/self/stat. The
+        // second field is the command name in parentheses, which may itself
+        // contain spaces or parentheses, so fields are counted from the
+        // last closing parenthesis.
+        char buf[1024];
+        FILE* fp = std::fopen("/proc/self/stat", "r");
+        if (fp == nullptr)
+            return -1;
+        const std::size_t n = std::fread(buf, 1, sizeof(buf) - 1, fp);
+        std::fclose(fp);
+        buf[n] = '\0';
+
+        const char* pos = std::strrchr(buf, ')');
+        for (int i = 0; i < 18 && pos != nullptr; ++i)
+            pos = std::strchr(pos + 1, ' ');
+        if (pos == nullptr)
+            return -1;
+        return std::strtol(pos + 1, nullptr, 10);
+#else
+        return -1;
+#endif
+    }
+}
+
+XTR_FUNC
+void xtr::detail::remote_sync_command::operator()(
+    consumer& c,
+    std::string& name) const noexcept
+{
+    // The command is stored in the queue, the pages of which may be released
+    // by the application as soon as the counter is incremented
+    remote_queue* const q = queue;
+
+    if (rename)
+        name.assign(q->name, ::strnlen(q->name, sizeof(q->name)));
+
+    c.destroy = destroy;
+
+    auto& backend = c.backend();
+    ++backend.nflushes;
+    backend.flush();
+    ++backend.nsyncs;
+    backend.sync();
+
+    q->nsynced.fetch_add(1, std::memory_order_release);
+    wake_counter(q->nsynced);
+}
+
+XTR_FUNC
+xtr::detail::consumer_process::consumer_process()
+{
+#if defined(__linux__)
+    arena_ =
+        memory_mapping(
+            nullptr,
+            arena_length,
+            PROT_READ|PROT_WRITE,
+            MAP_SHARED|MAP_ANONYMOUS|MAP_NORESERVE);
+
+    control_ = new (arena_.get()) process_control;
+    allocated_ = attached_ = align_to_page_size(sizeof(process_control));
+    control_->used = allocated_;
+
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC) == -1)
+    {
+        throw_system_error(
+            "xtr::detail::consumer_process::consumer_process: "
+            "Failed to create pipe");
+    }
+    alive_fd_.reset(fds[0]);
+    alive_wfd_.reset(fds[1]);
+#else
+    throw_runtime_error(
+        "xtr::detail::consumer_process::consumer_process: "
+        "Consumer processes are not supported on this platform");
+#endif
+}
+
+XTR_FUNC
+xtr::detail::consumer_process::~consumer_process()
+{
+    if (child_ || pid_ == -1)
+        return;
+
+    control_->shutdown.store(true);
+    control_->w.notify();
+
+    int status;
+    XTR_TEMP_FAILURE_RETRY(::waitpid(pid_, &status, 0));
+}
+
+XTR_FUNC
+bool xtr::detail::consumer_process::is_fork_safe(long nthreads) noexcept
+{
+    // A thread estimating the TSC frequency (see start_tsc_calibration)
+    // holds no locks used by the consumer process, so is not counted. It
+    // exits shortly after estimating_tsc_hz returns false, so the count is
+    // retried for a short time.
+    const auto interval = std::chrono::milliseconds(1);
+    const std::size_t max_iters = 100;
+
+    for (std::size_t i = 0; i < max_iters; ++i)
+    {
+        const long n = thread_count();
+        if (n == nthreads || (n == nthreads + 1 && estimating_tsc_hz()))
+            return true;
+        std::this_thread::sleep_for(interval);
+    }
+
+    return false;
+}
+
+XTR_FUNC
+std::byte* xtr::detail::consumer_process::queue_begin(remote_queue& q) noexcept
+{
+    return reinterpret_cast<std::byte*>(&q) + remote_queue_header_size();
+}
+
+XTR_FUNC
+void xtr::detail::consumer_process::started(::pid_t pid) noexcept
+{
+    pid_ = pid;
+    alive_wfd_.reset();
+}
+
+XTR_FUNC
+xtr::detail::remote_queue* xtr::detail::consumer_process::allocate(
+    logger& owner,
+    const std::string& name,
+    std::size_t capacity,
+    int numa_node) noexcept
+{
+    using ring_buffer = synchronized_ring_buffer<>;
+
+    const std::size_t length = ring_buffer::mapping_length(capacity, 0);
+    const std::size_t region_length = remote_queue_header_size() + length * 2;
+
+    if (region_length > arena_length - allocated_)
+        return nullptr;
+
+    auto* const q =
+        new (static_cast<std::byte*>(arena_.get()) + allocated_) remote_queue;
+    ring_buffer::init_control_block(q->ctl, length);
+    q->owner = &owner;
+    q->process = this;
+    q->capacity = length;
+    strzcpy(q->name, name);
+
+    // As with the queues of other sinks, pages are allocated in advance
+    // rather than on first use by a log statement
+    std::byte* const begin = queue_begin(*q);
+    if (numa_node != -1)
+        set_preferred_numa_node(begin, length, numa_node);
+    const std::size_t page_size = align_to_page_size(1);
+    volatile std::byte* const pages = begin;
+    for (std::size_t i = 0; i < length; i += page_size)
+        pages[i] = std::byte{0};
+
+    allocated_ += region_length;
+    control_->used.store(allocated_, std::memory_order_release);
+
+    return q;
+}
+
+XTR_FUNC
+void xtr::detail::consumer_process::wait_synced(
+    const remote_queue& q,
+    std::uint32_t target) noexcept
+{
+    for (;;)
+    {
+        const std::uint32_t n = q.nsynced.load(std::memory_order_acquire);
+        // Sequence numbers are compared modulo 2^32
+        if (std::int32_t(n - target) >= 0)
+            return;
+
+        wait_counter(q.nsynced, n);
+
+        // If the consumer process has exited then the queue will never be
+        // consumed, so waiting is abandoned
+        ::pollfd pfd{.fd=alive_fd_.get(), .events=POLLIN, .revents=0};
+        if (::poll(&pfd, 1, 0) == 1)
+            return;
+    }
+}
+
+XTR_FUNC
+void xtr::detail::consumer_process::release_pages(remote_queue& q) noexcept
+{
+#if defined(MADV_REMOVE)
+    ::madvise(queue_begin(q), q.capacity, MADV_REMOVE);
+#else
+    (void)q;
+#endif
+}
+
+XTR_FUNC
+void xtr::detail::consumer_process::request_reopen() noexcept
+{
+    control_->nreopens.fetch_add(1);
+    control_->w.notify();
+}
+
+XTR_FUNC
+void xtr::detail::consumer_process::attached(::pid_t app_pid) noexcept
+{
+    child_ = true;
+    pid_ = app_pid;
+    alive_fd_.reset();
+    nreopens_ = control_->nreopens.load();
+
+    // The consumer process is placed in its own session so that signals
+    // sent to the application's process group by the terminal (e.g. by
+    // pressing Ctrl-C) do not prevent it from draining the queues
+    ::setsid();
+#if defined(__linux__)
+    ::prctl(PR_SET_NAME, "xtrd", 0, 0, 0);
+#endif
+}
+
+XTR_FUNC
+xtr::detail::remote_queue* xtr::detail::consumer_process::next_queue() noexcept
+{
+    if (attached_ == control_->used.load(std::memory_order_acquire))
+        return nullptr;
+
+    auto* const q =
+        reinterpret_cast<remote_queue*>(
+            static_cast<std::byte*>(arena_.get()) + attached_);
+    attached_ += remote_queue_header_size() + q->capacity * 2;
+
+    return q;
+}
+
+XTR_FUNC
+xtr::sink* xtr::detail::consumer_process::attach(remote_queue& q) noexcept
+{
+#if __cpp_exceptions
+    try
+    {
+#endif
+        std::unique_ptr<sink> s(new sink(q));
+        // The proxy is only read by the consumer process, which never closes
+        // it via the sink interface
+        s->open_ = false;
+        s->remote_ = nullptr;
+        s->waiter_ = nullptr;
+        return proxies_.emplace_back(std::move(s)).get();
+#if __cpp_exceptions
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+#endif
+}
+
+XTR_FUNC
+void xtr::detail::consumer_process::release(sink& s) noexcept
+{
+    std::erase_if(proxies_, [&](const auto& p) { return p.get() == &s; });
+}
+
+XTR_FUNC
+bool xtr::detail::consumer_process::reopen_requested() noexcept
+{
+    const std::uint32_t n = control_->nreopens.load();
+    return std::exchange(nreopens_, n) != n;
+}
+
+XTR_FUNC
+bool xtr::detail::consumer_process::application_exited(bool idle) noexcept
+{
+    if (!app_exited_ && (idle || ++npolls_ % 1024 == 0))
+        app_exited_ = ::getppid() != pid_;
+    return app_exited_;
+}
+
+XTR_FUNC
+bool xtr::detail::consumer::start_process(
+    consumer_process& p,
+    std::function<std::timespec()> clock) noexcept
+{
+    // Buffered output must be written before forking, as otherwise it would
+    // be written by both processes
+    ++nflushes;
+    flush();
+
+    const ::pid_t app_pid = ::getpid();
+    const ::pid_t pid = ::fork();
+
+    if (pid == -1)
+        return false;
+
+    if (pid != 0)
+    {
+        p.started(pid);
+        process_ = &p;
+        return true;
+    }
+
+    // Only the current thread exists in the child, so the consumer no longer
+    // shares its back-end. Existing sinks and the command socket belong to
+    // the application, so are discarded (without removing the socket), and
+    // remote sinks are attached by poll_process.
+    p.attached(app_pid);
+    group_ = nullptr;
+    if (cmds_)
+    {
+        cmds_->release_path();
+        cmds_.reset();
+    }
+    sinks_.clear();
+    records_.clear();
+    batch_.clear();
+
+    sink control;
+    add_sink(control, "control");
+    waiter_ = &p.control().w;
+    process_ = &p;
+
+    run(std::move(clock));
+
+    // Destructors must not run, as the child shares state (e.g. files) with
+    // the application
+    ::_exit(EXIT_SUCCESS);
+}
+
+XTR_FUNC
+bool xtr::detail::consumer::poll_process(bool idle) noexcept
+{
+    consumer_process& p = *process_;
+
+    // Read before attaching queues, as queues are not allocated by the
+    // application after requesting shutdown
+    const bool shutdown = p.shutdown_requested();
+
+    while (remote_queue* q = p.next_queue())
+    {
+        std::string name(q->name, ::strnlen(q->name, sizeof(q->name)));
+        if (sink* s = p.attach(*q))
+            add_sink(*s, name);
+        else
+            report_error(err, lstyle, xtr::timespec{ts_}, name, "Failed to attach queue");
+    }
+
+    if (p.reopen_requested())
+    {
+        if (reopen())
+            encoder.reset();
+        else
+            report_error(err, lstyle, xtr::timespec{ts_}, "control", std::strerror(errno));
+    }
+
+    if (shutdown)
+        return p.has_proxies();
+
+    // Remote sinks cannot be written to once the application has exited,
+    // so the consumer process exits once they have been drained
+    if (p.application_exited(idle))
+    {
+        return
+            std::any_of(
+                sinks_.begin(),
+                sinks_.end(),
+                [](auto& s) { return !s->buf_.read_span().empty(); });
+    }
+
+    return true;
+}
@@ -0,0 +1,218 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/gzip_file.hpp"
+
+#if defined(XTR_ENABLE_ZLIB)
+
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/throw.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define ZLIB_CONST
+#include <zlib.h>
+
+XTR_FUNC
+void xtr::detail::library_built_with_XTR_ENABLE_ZLIB() noexcept
+{
+}
+
+XTR_FUNC
+xtr::detail::gzip_file::gzip_file(const char* path, int level)
+:
+    path_(path),
+    stream_(std::make_unique<::z_stream_s>()),
+    out_(buffer_size)
+{
+    if (!open())
+    {
+        throw_system_error_fmt(
+            "xtr::detail::gzip_file::gzip_file: "
+            "Failed to open `%s'", path);
+    }
+
+    // Adding 16 to the window size selects the gzip format
+    const int result =
+        ::deflateInit2(
+            stream_.get(),
+            level,
+            Z_DEFLATED,
+            MAX_WBITS + 16,
+            MAX_MEM_LEVEL,
+            Z_DEFAULT_STRATEGY);
+    if (result != Z_OK)
+    {
+        throw_invalid_argument(
+            "xtr::detail::gzip_file::gzip_file: Invalid compression level");
+    }
+}
+
+XTR_FUNC
+xtr::detail::gzip_file::~gzip_file()
+{
+    close();
+    ::deflateEnd(stream_.get());
+}
+
+XTR_FUNC
+bool xtr::detail::gzip_file::open()
+{
+    // Appending to an existing file adds a new gzip member to it
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(path_.c_str(), O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC, 0666)));
+    if (!fd)
+        return false;
+
+    fd_ = std::move(fd);
+
+    return true;
+}
+
+XTR_FUNC
+::ssize_t xtr::detail::gzip_file::write(const char* buf, std::size_t size)
+{
+    if (!fd_)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    pending_ = true;
+    dirty_ = true;
+
+    // avail_in is an unsigned int, so larger buffers are compressed in parts
+    for (std::size_t n = 0; n < size;)
+    {
+        const std::size_t length = std::min(size - n, std::size_t(UINT_MAX));
+        stream_->next_in = reinterpret_cast<const Bytef*>(buf + n);
+        stream_->avail_in = uInt(length);
+        if (!deflate(Z_NO_FLUSH))
+            return -1;
+        n += length;
+    }
+
+    return ::ssize_t(size);
+}
+
+XTR_FUNC
+bool xtr::detail::gzip_file::deflate(int flush)
+{
+    // Compressed data is accumulated in out_ and only written to the file
+    // when out_ is full or at a flush point, as deflate produces small
+    // amounts of output for each call.
+    for (;;)
+    {
+        stream_->next_out = out_.data() + out_size_;
+        stream_->avail_out = uInt(out_.size() - out_size_);
+        ::deflate(stream_.get(), flush);
+        out_size_ = out_.size() - stream_->avail_out;
+        // If space remains then all input has been consumed and, if
+        // flushing, all output produced
+        if (stream_->avail_out != 0)
+            break;
+        if (!write_out())
+            return false;
+    }
+
+    return flush == Z_NO_FLUSH || write_out();
+}
+
+XTR_FUNC
+bool xtr::detail::gzip_file::write_out()
+{
+    const unsigned char* buf = out_.data();
+    std::size_t size = std::exchange(out_size_, 0);
+
+    // Data that could not be written is discarded, as the error is reported
+    // to the caller of write.
+    while (size > 0)
+    {
+        const ::ssize_t result =
+            XTR_TEMP_FAILURE_RETRY(::write(fd_.get(), buf, size));
+        if (result == -1)
+            return false;
+        buf += result;
+        size -= std::size_t(result);
+    }
+
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::gzip_file::flush()
+{
+    if (!fd_ || !dirty_)
+        return;
+
+    dirty_ = false;
+    deflate(Z_SYNC_FLUSH);
+}
+
+XTR_FUNC
+bool xtr::detail::gzip_file::finish()
+{
+    if (!pending_)
+        return true;
+
+    const bool result = deflate(Z_FINISH);
+    ::deflateReset(stream_.get());
+    pending_ = false;
+    dirty_ = false;
+
+    return result;
+}
+
+XTR_FUNC
+void xtr::detail::gzip_file::sync()
+{
+    if (!fd_)
+        return;
+
+    finish();
+    ::fdatasync(fd_.get());
+}
+
+XTR_FUNC
+bool xtr::detail::gzip_file::reopen()
+{
+    if (fd_)
+        finish();
+    return open();
+}
+
+XTR_FUNC
+void xtr::detail::gzip_file::close()
+{
+    if (!fd_)
+        return;
+
+    finish();
+    fd_.reset();
+}
+
+#endif
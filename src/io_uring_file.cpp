@@ -0,0 +1,484 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/io_uring_file.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/throw.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define XTR_IO_URING_ENABLED
+#endif
+
+XTR_FUNC
+xtr::detail::io_uring_file::io_uring_file(
+    const char* path,
+    std::size_t buffer_count,
+    std::size_t buffer_size)
+:
+    path_(path)
+{
+    if (!open())
+    {
+        throw_system_error_fmt(
+            "xtr::detail::io_uring_file::io_uring_file: "
+            "Failed to open `%s'", path);
+    }
+    setup_ring(buffer_count, buffer_size);
+}
+
+XTR_FUNC
+xtr::detail::io_uring_file::~io_uring_file()
+{
+    close();
+    // Close the ring before the buffers are unmapped
+    ring_fd_.reset();
+}
+
+XTR_FUNC
+bool xtr::detail::io_uring_file::open()
+{
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(path_.c_str(), O_WRONLY|O_CREAT|O_CLOEXEC, 0666)));
+    if (!fd)
+        return false;
+
+    // The file is not opened with O_APPEND as each write is given an explicit
+    // offset, see the comment in io_uring_file.hpp.
+    const ::off_t end = ::lseek(fd.get(), 0, SEEK_END);
+    if (end == -1)
+        return false;
+
+    fd_ = std::move(fd);
+    offset_ = end;
+
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::setup_ring(
+    [[maybe_unused]] std::size_t buffer_count,
+    [[maybe_unused]] std::size_t buffer_size)
+{
+#if defined(XTR_IO_URING_ENABLED)
+    if (buffer_count == 0 || buffer_size == 0 || buffer_size > UINT32_MAX)
+        throw_invalid_argument("xtr::detail::io_uring_file::setup_ring: Invalid buffer size or count");
+
+    // Any failure below results in pwrite(2) being used instead of io_uring.
+    ::io_uring_params params{};
+    file_descriptor ring_fd(
+        int(::syscall(__NR_io_uring_setup, unsigned(buffer_count * 2), &params)));
+    if (!ring_fd)
+        return;
+
+    const std::size_t sq_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const std::size_t cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    const int prot = PROT_READ|PROT_WRITE;
+    const int flags = MAP_SHARED|MAP_POPULATE;
+
+    memory_mapping sq_ring;
+    memory_mapping cq_ring;
+    memory_mapping sqes;
+    memory_mapping buffers;
+
+    sq_ring.reset(
+        ::mmap(
+            nullptr,
+            single_mmap ? std::max(sq_size, cq_size) : sq_size,
+            prot,
+            flags,
+            ring_fd.get(),
+            IORING_OFF_SQ_RING),
+        single_mmap ? std::max(sq_size, cq_size) : sq_size);
+    if (!sq_ring)
+        return;
+
+    std::byte* cq = static_cast<std::byte*>(sq_ring.get());
+    if (!single_mmap)
+    {
+        cq_ring.reset(
+            ::mmap(nullptr, cq_size, prot, flags, ring_fd.get(), IORING_OFF_CQ_RING),
+            cq_size);
+        if (!cq_ring)
+            return;
+        cq = static_cast<std::byte*>(cq_ring.get());
+    }
+
+    const std::size_t sqes_size = params.sq_entries * sizeof(::io_uring_sqe);
+    sqes.reset(
+        ::mmap(nullptr, sqes_size, prot, flags, ring_fd.get(), IORING_OFF_SQES),
+        sqes_size);
+    if (!sqes)
+        return;
+
+    const std::size_t buffers_size = buffer_count * buffer_size;
+    buffers.reset(
+        ::mmap(
+            nullptr,
+            buffers_size,
+            prot,
+            MAP_PRIVATE|MAP_ANONYMOUS,
+            -1,
+            0),
+        buffers_size);
+    if (!buffers)
+        return;
+
+    // Registering buffers may fail (e.g. due to RLIMIT_MEMLOCK), in which
+    // case unregistered buffers are used.
+    std::vector<::iovec> iov(buffer_count);
+    for (std::size_t i = 0; i < buffer_count; ++i)
+    {
+        iov[i].iov_base = static_cast<std::byte*>(buffers.get()) + i * buffer_size;
+        iov[i].iov_len = buffer_size;
+    }
+    registered_ =
+        ::syscall(
+            __NR_io_uring_register,
+            ring_fd.get(),
+            IORING_REGISTER_BUFFERS,
+            iov.data(),
+            unsigned(buffer_count)) == 0;
+
+    std::byte* sq = static_cast<std::byte*>(sq_ring.get());
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqes_ = cq + params.cq_off.cqes;
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+    // The number of operations in flight is limited to the size of the
+    // submission queue, which guarantees that the completion queue (which
+    // is at least twice as large) cannot overflow.
+    max_inflight_ = params.sq_entries;
+
+    writes_.resize(buffer_count);
+    free_.resize(buffer_count);
+    for (std::size_t i = 0; i < buffer_count; ++i)
+        free_[i] = std::uint32_t(buffer_count - i - 1);
+
+    buffer_size_ = buffer_size;
+    sq_ring_ = std::move(sq_ring);
+    cq_ring_ = std::move(cq_ring);
+    sqes_ = std::move(sqes);
+    buffers_ = std::move(buffers);
+    ring_fd_ = std::move(ring_fd);
+#endif
+}
+
+XTR_FUNC
+::ssize_t xtr::detail::io_uring_file::write(const char* buf, std::size_t size)
+{
+    if (!fd_)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (!uses_io_uring())
+    {
+        for (std::size_t n = 0; n < size;)
+        {
+            const ::ssize_t result =
+                XTR_TEMP_FAILURE_RETRY(
+                    ::pwrite(fd_.get(), buf + n, size - n, offset_));
+            if (result <= 0)
+                return result == 0 ? ::ssize_t(n) : -1;
+            n += std::size_t(result);
+            offset_ += result;
+        }
+        return ::ssize_t(size);
+    }
+
+    reap();
+
+    if (error_ != 0)
+    {
+        errno = std::exchange(error_, 0);
+        return -1;
+    }
+
+    // Data larger than a buffer is split over multiple buffers
+    for (std::size_t n = 0; n < size;)
+    {
+        while (free_.empty())
+        {
+            if (!submit(/* min_complete= */1))
+                return -1;
+            reap();
+        }
+
+        const std::uint32_t index = free_.back();
+        free_.pop_back();
+
+        const auto length = std::uint32_t(std::min(size - n, buffer_size_));
+        std::memcpy(buffer(index), buf + n, length);
+        writes_[index] = pending_write{offset_, length, 0};
+        offset_ += length;
+        n += length;
+
+        prepare_write(index);
+    }
+
+    if (!submit(/* min_complete= */0))
+        return -1;
+
+    return ::ssize_t(size);
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::flush()
+{
+    if (!uses_io_uring())
+        return;
+
+    reap();
+
+    // Submit any writes resubmitted by reap() following a short write
+    if (to_submit_ > 0 && !submit(/* min_complete= */0))
+        error_ = errno;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::sync()
+{
+    if (!fd_)
+        return;
+
+    if (!uses_io_uring())
+    {
+        ::fdatasync(fd_.get());
+        return;
+    }
+
+    reap();
+
+    while (inflight_ + to_submit_ >= max_inflight_)
+    {
+        if (!submit(/* min_complete= */1))
+        {
+            error_ = errno;
+            return;
+        }
+        reap();
+    }
+
+    prepare_sync();
+
+    if (!submit(/* min_complete= */0))
+        error_ = errno;
+}
+
+XTR_FUNC
+bool xtr::detail::io_uring_file::reopen()
+{
+    wait_all();
+    return open();
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::close()
+{
+    wait_all();
+    fd_.reset();
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::wait_all()
+{
+    if (!uses_io_uring())
+        return;
+
+    reap();
+
+    while (inflight_ + to_submit_ > 0)
+    {
+        if (!submit(/* min_complete= */1))
+        {
+            error_ = errno;
+            return;
+        }
+        reap();
+    }
+}
+
+XTR_FUNC
+std::byte* xtr::detail::io_uring_file::buffer(std::uint32_t index) noexcept
+{
+    return static_cast<std::byte*>(buffers_.get()) + index * buffer_size_;
+}
+
+#if defined(XTR_IO_URING_ENABLED)
+XTR_FUNC
+void* xtr::detail::io_uring_file::next_sqe() noexcept
+{
+    // The kernel only reads the submission queue during io_uring_enter, so
+    // the tail can be advanced here with entries submitted later (the release
+    // store ensures that the entry is visible to the kernel before the tail).
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & sq_mask_;
+    auto* const sqe = static_cast<::io_uring_sqe*>(sqes_.get()) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit_;
+    return sqe;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::prepare_write(std::uint32_t index)
+{
+    const pending_write& w = writes_[index];
+    auto* const sqe = static_cast<::io_uring_sqe*>(next_sqe());
+    sqe->opcode = registered_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd_.get();
+    sqe->off = std::uint64_t(w.offset + w.written);
+    sqe->addr = reinterpret_cast<std::uintptr_t>(buffer(index) + w.written);
+    sqe->len = w.length - w.written;
+    sqe->buf_index = registered_ ? std::uint16_t(index) : 0;
+    sqe->user_data = index;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::prepare_sync()
+{
+    auto* const sqe = static_cast<::io_uring_sqe*>(next_sqe());
+    sqe->opcode = IORING_OP_FSYNC;
+    // Drain ensures that the sync is started only after all previously
+    // submitted writes have completed.
+    sqe->flags = IOSQE_IO_DRAIN;
+    sqe->fd = fd_.get();
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = sync_tag;
+}
+
+XTR_FUNC
+bool xtr::detail::io_uring_file::submit(unsigned min_complete)
+{
+    const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    const int result =
+        XTR_TEMP_FAILURE_RETRY(
+            int(::syscall(
+                __NR_io_uring_enter,
+                ring_fd_.get(),
+                to_submit_,
+                min_complete,
+                flags,
+                nullptr,
+                0)));
+    if (result == -1)
+        return false;
+    to_submit_ -= unsigned(result);
+    inflight_ += unsigned(result);
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::reap()
+{
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head)
+    {
+        const ::io_uring_cqe& cqe =
+            static_cast<const ::io_uring_cqe*>(cqes_)[head & cq_mask_];
+
+        --inflight_;
+
+        if (cqe.user_data == sync_tag)
+        {
+            if (cqe.res < 0)
+                error_ = -cqe.res;
+            continue;
+        }
+
+        const auto index = std::uint32_t(cqe.user_data);
+        pending_write& w = writes_[index];
+
+        if (cqe.res == -EAGAIN || cqe.res == -EINTR)
+        {
+            prepare_write(index);
+            continue;
+        }
+
+        if (cqe.res <= 0)
+        {
+            error_ = cqe.res == 0 ? EIO : -cqe.res;
+            free_.push_back(index);
+            continue;
+        }
+
+        // Short writes are resubmitted
+        w.written += std::uint32_t(cqe.res);
+        if (w.written < w.length)
+            prepare_write(index);
+        else
+            free_.push_back(index);
+    }
+
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+#else
+XTR_FUNC
+void* xtr::detail::io_uring_file::next_sqe() noexcept
+{
+    return nullptr;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::prepare_write(std::uint32_t)
+{
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::prepare_sync()
+{
+}
+
+XTR_FUNC
+bool xtr::detail::io_uring_file::submit(unsigned)
+{
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::io_uring_file::reap()
+{
+}
+#endif
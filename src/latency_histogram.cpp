@@ -0,0 +1,54 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+XTR_FUNC
+std::uint64_t xtr::detail::latency_histogram::value_at_percentile(
+    double percentile) const noexcept
+{
+    // Buckets may be updated while they are being read, so the total is
+    // taken from the buckets rather than from count_.
+    std::uint64_t total = 0;
+    for (const auto& bucket : buckets_)
+        total += bucket.load(std::memory_order_relaxed);
+
+    if (total == 0)
+        return 0;
+
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    const std::uint64_t target =
+        std::max(
+            std::uint64_t(std::ceil(percentile / 100.0 * double(total))),
+            std::uint64_t(1));
+
+    std::uint64_t n = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i)
+    {
+        n += buckets_[i].load(std::memory_order_relaxed);
+        if (n >= target)
+            return std::min(bucket_highest(i), max());
+    }
+
+    return max();
+}
@@ -19,29 +19,194 @@
 // SOFTWARE.
 
 #include "xtr/logger.hpp"
+#include "xtr/detail/numa.hpp"
+#include "xtr/detail/recovery.hpp"
+#include "xtr/detail/throw.hpp"
 
 #include <fmt/chrono.h>
 
+#include <cerrno>
+#include <cstdio>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
+
+#include <unistd.h>
 
 XTR_FUNC
 xtr::logger::~logger()
 {
+    // Additional consumers must exit before the primary consumer, as the
+    // primary consumer owns the back-end.
+    for (auto& ctl : shard_controls_)
+        ctl->close();
+    shard_consumers_.clear();
     control_.close();
 }
 
+XTR_FUNC
+std::thread::native_handle_type xtr::logger::consumer_thread_native_handle(
+    std::size_t index)
+{
+    std::scoped_lock lock{control_mutex_};
+    if (index == 0)
+        return consumer_.native_handle();
+    return shard_consumers_.at(index - 1).native_handle();
+}
+
+XTR_FUNC
+void xtr::logger::set_consumer_thread_numa_node(
+    int numa_node, std::size_t index)
+{
+    detail::bind_thread_to_numa_node(
+        consumer_thread_native_handle(index), numa_node);
+}
+
+XTR_FUNC
+void xtr::logger::add_consumer_threads(std::size_t count)
+{
+    start_shards(count, nullptr);
+}
+
+XTR_FUNC
+void xtr::logger::add_consumer_threads(std::size_t count, const char* path)
+{
+    start_shards(count, path);
+}
+
+XTR_FUNC
+void xtr::logger::start_shards(std::size_t count, const char* path)
+{
+    std::scoped_lock lock{control_mutex_};
+
+    const std::size_t first = shard_controls_.size();
+
+    // Files are opened before any consumers are created so that failing to
+    // open one leaves the logger unchanged. Files are numbered in the same
+    // way as consumer threads, see consumer_thread_native_handle.
+    const auto fclose = [](FILE* fp) { std::fclose(fp); };
+    std::vector<std::string> paths;
+    std::vector<std::unique_ptr<FILE, decltype(fclose)>> streams;
+    if (path != nullptr)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            paths.push_back(fmt::format("{}.{}", path, first + i + 1));
+            streams.emplace_back(detail::open_path(paths.back().c_str()), fclose);
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto& w = shard_waiters_.emplace_back(std::make_unique<detail::waiter>());
+        auto& ctl = shard_controls_.emplace_back(std::make_unique<sink>());
+        ctl->waiter_ = w.get();
+    }
+
+    // Additional consumers copy the state of the primary consumer, so are
+    // constructed on the primary consumer's thread.
+    std::vector<detail::consumer> shards;
+    control_.post(
+        [&](detail::consumer& c, auto&)
+        {
+            c.enable_sharding();
+            for (std::size_t i = first; i < shard_controls_.size(); ++i)
+            {
+                auto& shard =
+                    shards.emplace_back(
+                        c, shard_controls_[i].get(), shard_waiters_[i].get());
+                if (streams.empty())
+                    continue;
+                FILE* const fp = streams[i - first].get();
+                shard.set_backend(
+                    detail::make_output_func(fp),
+                    [fp](){ std::fflush(fp); },
+                    [fp](){ ::fsync(::fileno(fp)); },
+                    detail::make_reopen_func(paths[i - first], fp),
+                    [fp](){ std::fclose(fp); });
+                streams[i - first].release();
+            }
+        });
+    control_.sync();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // As with control_, passing the control sink to the consumer is
+        // equivalent to calling register_sink.
+        shard_controls_[first + i]->open_ = true;
+        shard_consumers_.emplace_back(
+            &detail::consumer::run, std::move(shards[i]), clock_);
+    }
+}
+
 XTR_FUNC
 xtr::sink xtr::logger::get_sink(std::string name)
 {
-    return sink(*this, std::move(name));
+    return get_sink(std::move(name), sink::default_capacity);
+}
+
+XTR_FUNC
+xtr::sink xtr::logger::get_sink(
+    std::string name,
+    std::size_t capacity,
+    page_type_t page_type,
+    int numa_node)
+{
+    std::string dir;
+    detail::remote_queue* q = nullptr;
+    {
+        std::scoped_lock lock{control_mutex_};
+        dir = recovery_dir_;
+        if (process_)
+            q = process_->allocate(*this, name, capacity, numa_node);
+    }
+
+    // Queues consumed by the consumer process survive the application
+    // exiting, so are not backed by recovery files. If the arena of the
+    // consumer process is exhausted then the sink is consumed by the
+    // consumer thread instead.
+    if (q != nullptr)
+        return sink(*q);
+
+    if (dir.empty())
+        return sink(*this, std::move(name), capacity, page_type, numa_node);
+
+    auto recovery = sink::make_recovery_file(dir, name, capacity, page_type);
+    return
+        sink(
+            *this,
+            std::move(name),
+            capacity,
+            page_type,
+            numa_node,
+            std::move(recovery));
+}
+
+XTR_FUNC
+xtr::shared_sink xtr::logger::get_shared_sink(
+    std::string name,
+    std::size_t capacity,
+    page_type_t page_type,
+    int numa_node)
+{
+    return shared_sink(*this, std::move(name), capacity, page_type, numa_node);
 }
 
 XTR_FUNC
 void xtr::logger::register_sink(sink& s, std::string name) noexcept
 {
     assert(!s.open_);
-    post(
+
+    std::scoped_lock lock{control_mutex_};
+
+    // Sinks are distributed across consumer threads in a round-robin
+    // fashion, index zero being the primary consumer.
+    const std::size_t index = next_consumer_++ % (shard_controls_.size() + 1);
+    sink& control = index == 0 ? control_ : *shard_controls_[index - 1];
+    s.waiter_ = control.waiter_;
+
+    control.post(
         [&s, name = std::move(name)](detail::consumer& c, auto&)
         {
             c.add_sink(s, name);
@@ -61,6 +226,27 @@ void xtr::logger::set_error_stream(FILE* stream) noexcept
     set_error_function(detail::make_error_func(stream));
 }
 
+XTR_FUNC
+void xtr::logger::set_wait_strategy(const wait_strategy& strategy) noexcept
+{
+    std::scoped_lock lock{control_mutex_};
+
+    const auto set =
+        [&](sink& control)
+        {
+            control.post(
+                [=](detail::consumer& c, auto&)
+                {
+                    c.wstrategy = strategy;
+                });
+            control.sync();
+        };
+
+    set(control_);
+    for (auto& ctl : shard_controls_)
+        set(*ctl);
+}
+
 XTR_FUNC
 void xtr::logger::set_command_path(std::string path) noexcept
 {
@@ -75,10 +261,129 @@ void xtr::logger::set_command_path(std::string path) noexcept
 XTR_FUNC
 void xtr::logger::set_log_level_style(log_level_style_t level_style) noexcept
 {
+    std::scoped_lock lock{control_mutex_};
+
+    // Shards with their own back-ends do not read the primary's style, so
+    // are updated too
+    const auto set =
+        [&](sink& control)
+        {
+            control.post(
+                [=](detail::consumer& c, auto&)
+                {
+                    c.lstyle = level_style;
+                });
+            control.sync();
+        };
+
+    set(control_);
+    for (auto& ctl : shard_controls_)
+        set(*ctl);
+}
+
+XTR_FUNC
+void xtr::logger::set_output_format(output_format_t format) noexcept
+{
+    std::scoped_lock lock{control_mutex_};
+
+    const auto set =
+        [&](sink& control)
+        {
+            control.post(
+                [=](detail::consumer& c, auto&)
+                {
+                    c.output_format = format;
+                    c.encoder.reset();
+                });
+            control.sync();
+        };
+
+    set(control_);
+    for (auto& ctl : shard_controls_)
+        set(*ctl);
+}
+
+XTR_FUNC
+void xtr::logger::set_recovery_directory(std::string path)
+{
+    // Files are created in a subdirectory that only the effective user may
+    // access, see detail/recovery.hpp
+    if (!path.empty())
+    {
+        path = detail::recovery_subdirectory(path);
+        if (!detail::open_recovery_subdirectory(path.c_str(), true))
+        {
+            detail::throw_system_error_fmt(
+                "xtr::logger::set_recovery_directory: "
+                "Failed to create directory `%s'", path.c_str());
+        }
+    }
+
+    std::scoped_lock lock{control_mutex_};
+    recovery_dir_ = std::move(path);
+}
+
+XTR_FUNC
+std::size_t xtr::logger::recover(const std::string& path)
+{
+    bool ok;
+    int errnum;
+    std::size_t nfiles = 0;
+
     post(
-        [=](detail::consumer& c, auto&)
+        [&](detail::consumer& c, auto&)
+        {
+            ok = c.recover(path, nfiles);
+            errnum = errno;
+        });
+    control_.sync();
+
+    if (!ok)
+    {
+        errno = errnum;
+        detail::throw_system_error_fmt(
+            "xtr::logger::recover: Failed to open directory `%s'", path.c_str());
+    }
+
+    return nfiles;
+}
+
+XTR_FUNC
+void xtr::logger::start_consumer_process()
+{
+    std::scoped_lock lock{control_mutex_};
+
+    if (process_)
+        return;
+
+    auto p = std::make_unique<detail::consumer_process>();
+
+    // See detail/consumer_process.hpp
+    if (!shard_consumers_.empty() || !detail::consumer_process::is_fork_safe(2))
+    {
+        detail::throw_runtime_error(
+            "xtr::logger::start_consumer_process: "
+            "Other threads exist, the consumer process must be started "
+            "before any other threads are created");
+    }
+
+    bool ok;
+    int errnum;
+
+    control_.post(
+        [&, clock = clock_](detail::consumer& c, auto&)
         {
-            c.lstyle = level_style;
+            ok = c.start_process(*p, clock);
+            errnum = errno;
         });
     control_.sync();
+
+    if (!ok)
+    {
+        errno = errnum;
+        detail::throw_system_error(
+            "xtr::logger::start_consumer_process: Failed to fork");
+    }
+
+    process_ = std::move(p);
 }
@@ -0,0 +1,260 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/mapped_file.hpp"
+#include "xtr/detail/pagesize.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/throw.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+XTR_FUNC
+xtr::detail::mapped_file::mapped_file(const char* path, std::size_t window_size)
+:
+    path_(path),
+    window_size_(align_to_page_size(window_size))
+{
+    if (window_size_ == 0)
+        throw_invalid_argument("xtr::detail::mapped_file::mapped_file: Invalid window size");
+
+    if (!open())
+    {
+        throw_system_error_fmt(
+            "xtr::detail::mapped_file::mapped_file: "
+            "Failed to open `%s'", path);
+    }
+}
+
+XTR_FUNC
+xtr::detail::mapped_file::~mapped_file()
+{
+    close();
+}
+
+XTR_FUNC
+bool xtr::detail::mapped_file::open()
+{
+    // The file must be opened for reading as well as writing in order to
+    // create a shared writable mapping of it.
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(path_.c_str(), O_RDWR|O_CREAT|O_CLOEXEC, 0666)));
+    if (!fd)
+        return false;
+
+    struct ::stat st;
+    if (::fstat(fd.get(), &st) == -1)
+        return false;
+
+    ::off_t size = st.st_size;
+
+    // If the process crashed while writing the file then the file's size
+    // may have been left rounded up to the end of a window, the remainder of
+    // the window containing zero bytes. These are removed so that appending
+    // continues from the end of the data.
+    const auto page_size = ::off_t(align_to_page_size(1));
+    if (size > 0 && size % page_size == 0)
+    {
+        char buf[4096];
+        const ::off_t limit =
+            std::max(size - ::off_t(window_size_), ::off_t(0));
+        bool done = false;
+        while (!done && size > limit)
+        {
+            const ::off_t n = std::min(::off_t(sizeof(buf)), size - limit);
+            if (XTR_TEMP_FAILURE_RETRY(
+                    ::pread(fd.get(), buf, std::size_t(n), size - n)) != n)
+            {
+                return false;
+            }
+            ::off_t i = n;
+            while (i > 0 && buf[i - 1] == '\0')
+                --i;
+            done = i > 0;
+            size -= n - i;
+        }
+        if (size != st.st_size &&
+            XTR_TEMP_FAILURE_RETRY(::ftruncate(fd.get(), size)) == -1)
+        {
+            return false;
+        }
+    }
+
+    fd_ = std::move(fd);
+    // The window is mapped by the first write, so that opening a file without
+    // writing to it does not change its size.
+    window_offset_ = offset_ = size_ = allocated_ = size;
+
+    return true;
+}
+
+XTR_FUNC
+::ssize_t xtr::detail::mapped_file::write(const char* buf, std::size_t size)
+{
+    if (!fd_)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    for (std::size_t n = 0; n < size;)
+    {
+        const ::off_t end = window_offset_ + ::off_t(window_.length());
+        if (!window_ || offset_ == end)
+        {
+            if (!advance_window())
+                return -1;
+            continue;
+        }
+
+        const std::size_t length = std::min(size - n, std::size_t(end - offset_));
+
+        std::memcpy(
+            static_cast<char*>(window_.get()) + (offset_ - window_offset_),
+            buf + n,
+            length);
+        offset_ += ::off_t(length);
+        n += length;
+    }
+
+    return ::ssize_t(size);
+}
+
+XTR_FUNC
+bool xtr::detail::mapped_file::advance_window()
+{
+    retire_window(MS_ASYNC);
+
+    // The window begins at the page containing the write offset, as mappings
+    // must begin at a page-aligned file offset.
+    const auto page_size = ::off_t(align_to_page_size(1));
+    const ::off_t start = offset_ - offset_ % page_size;
+    const ::off_t end = start + ::off_t(window_size_);
+
+    if (end > allocated_)
+    {
+        // Allocating blocks up front means that running out of disk space is
+        // reported here rather than by SIGBUS when the mapping is written to.
+        // The blocks are allocated without changing the file's size, which is
+        // extended as data is written. If the file system does not support
+        // this then blocks are allocated as the mapping is written to.
+#if defined(__linux__)
+        if (::fallocate(
+                fd_.get(),
+                FALLOC_FL_KEEP_SIZE,
+                allocated_,
+                end - allocated_) == -1 &&
+            errno != EOPNOTSUPP &&
+            errno != EINVAL)
+        {
+            return false;
+        }
+#endif
+        allocated_ = end;
+    }
+
+    // Writing to a page of the mapping that lies wholly beyond the end of the
+    // file raises SIGBUS, so the file is extended to the end of the window.
+    // Extending a window at a time means that writes do not require a system
+    // call, at the cost of zero bytes after the data being visible to
+    // readers until the file is closed.
+    if (end > size_)
+    {
+        if (XTR_TEMP_FAILURE_RETRY(::ftruncate(fd_.get(), end)) == -1)
+            return false;
+        size_ = end;
+    }
+
+    void* const mem =
+        ::mmap(
+            nullptr,
+            window_size_,
+            PROT_READ|PROT_WRITE,
+            MAP_SHARED,
+            fd_.get(),
+            start);
+    if (mem == MAP_FAILED)
+        return false;
+
+    window_.reset(mem, window_size_);
+    window_offset_ = start;
+
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::mapped_file::retire_window(int flags) noexcept
+{
+    if (!window_)
+        return;
+
+    const auto used = std::size_t(offset_ - window_offset_);
+    if (used > 0)
+        ::msync(window_.get(), used, flags);
+
+    // Unmapping the window drops its pages from the address space, the dirty
+    // pages remaining in the page cache until written back.
+    window_.reset();
+    window_offset_ = offset_;
+}
+
+XTR_FUNC
+void xtr::detail::mapped_file::sync()
+{
+    if (!fd_)
+        return;
+
+    // msync writes the pages of the window, fdatasync the file's size (which
+    // is changed when the file is extended).
+    if (window_ && offset_ > window_offset_)
+        ::msync(window_.get(), std::size_t(offset_ - window_offset_), MS_SYNC);
+    ::fdatasync(fd_.get());
+}
+
+XTR_FUNC
+bool xtr::detail::mapped_file::reopen()
+{
+    close();
+    return open();
+}
+
+XTR_FUNC
+void xtr::detail::mapped_file::close()
+{
+    if (!fd_)
+        return;
+
+    retire_window(MS_ASYNC);
+
+    // Remove the unwritten space at the end of the window, and the blocks
+    // allocated beyond it
+    if (allocated_ > offset_ || size_ > offset_)
+        (void)XTR_TEMP_FAILURE_RETRY(::ftruncate(fd_.get(), offset_));
+
+    fd_.reset();
+}
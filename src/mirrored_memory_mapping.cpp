@@ -19,12 +19,15 @@
 // SOFTWARE.
 
 #include "xtr/detail/mirrored_memory_mapping.hpp"
+#include "xtr/detail/align.hpp"
 #include "xtr/detail/file_descriptor.hpp"
+#include "xtr/detail/numa.hpp"
 #include "xtr/detail/pagesize.hpp"
 #include "xtr/detail/retry.hpp"
 #include "xtr/detail/throw.hpp"
 
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 #include <random>
 
@@ -75,6 +78,73 @@ namespace xtr::detail
 }
 #endif
 
+#if defined(__linux__) && defined(MAP_HUGETLB) && defined(MFD_HUGETLB)
+namespace xtr::detail
+{
+#if defined(MFD_HUGE_2MB)
+    inline constexpr unsigned mfd_huge_2mb = MFD_HUGE_2MB;
+#else
+    inline constexpr unsigned mfd_huge_2mb = 21U << 26; // log2(2MiB) << MFD_HUGE_SHIFT
+#endif
+
+    // Creates two adjacent mappings of length bytes backed by the same huge
+    // pages, returning nullptr if this is not possible.
+    XTR_FUNC
+    void* map_mirrored_huge_pages(std::size_t length, int flags) noexcept
+    {
+        if (length % huge_page_size != 0)
+            return nullptr;
+
+        file_descriptor fd(
+            ::memfd_create("xtr", MFD_CLOEXEC|MFD_HUGETLB|mfd_huge_2mb));
+
+        if (!fd || ::ftruncate(fd.get(), ::off_t(length)) == -1)
+            return nullptr;
+
+        // Huge page mappings must be aligned to the huge page size, so an
+        // extra huge page is reserved and the excess is trimmed
+        const std::size_t reserve_length = length * 2 + huge_page_size;
+
+        void* reserve =
+            ::mmap(
+                nullptr,
+                reserve_length,
+                PROT_NONE,
+                MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,
+                -1,
+                0);
+
+        if (reserve == MAP_FAILED)
+            return nullptr;
+
+        std::byte* const begin = static_cast<std::byte*>(reserve);
+        std::byte* const end = begin + reserve_length;
+        std::byte* const base =
+            begin +
+                (align(std::uintptr_t(begin), std::uintptr_t(huge_page_size)) -
+                    std::uintptr_t(begin));
+
+        if (base != begin)
+            ::munmap(begin, std::size_t(base - begin));
+        ::munmap(base + length * 2, std::size_t(end - (base + length * 2)));
+
+        const int prot = PROT_READ|PROT_WRITE;
+        flags |= MAP_FIXED|MAP_SHARED;
+
+        // mmap fails here (rather than at ftruncate) if there are not enough
+        // huge pages available
+        if (::mmap(base, length, prot, flags, fd.get(), 0) == MAP_FAILED ||
+            ::mmap(base + length, length, prot, flags, fd.get(), 0) == MAP_FAILED)
+        {
+            ::munmap(base, length * 2);
+            return nullptr;
+        }
+
+        return base;
+    }
+}
+#endif
+
 XTR_FUNC
 xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping(
     std::size_t length,
@@ -95,6 +165,26 @@ xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping(
             "Length argument is not page-aligned");
     }
 
+#if defined(MAP_HUGETLB)
+    if (flags & MAP_HUGETLB)
+    {
+        // MAP_HUGETLB only applies to anonymous mappings, so huge pages are
+        // obtained from a memfd instead (see map_mirrored_huge_pages)
+        flags &= ~MAP_HUGETLB;
+#if defined(__linux__) && defined(MFD_HUGETLB)
+        if (fd == -1)
+        {
+            if (void* addr = map_mirrored_huge_pages(length, flags))
+            {
+                m_.reset(addr, length);
+                huge_pages_ = true;
+                return;
+            }
+        }
+#endif
+    }
+#endif
+
     // To create two adjacent mappings without race conditions:
     // 1.) Create a mapping A of twice the requested size, L*2
     // 2.) Create a mapping of size L at A+L using MAP_FIXED
@@ -182,6 +272,71 @@ xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping(
     mirror.release(); // mirror will be recreated in ~mirrored_memory_mapping
 }
 
+XTR_FUNC
+xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping(
+    std::size_t length,
+    int fd,
+    std::size_t offset,
+    int flags,
+    int numa_node)
+:
+#if defined(MAP_POPULATE)
+    mirrored_memory_mapping(
+        length, fd, offset, numa_node == -1 ? flags : flags & ~MAP_POPULATE)
+#else
+    mirrored_memory_mapping(length, fd, offset, flags)
+#endif
+{
+    if (numa_node == -1)
+        return;
+
+    numa_node_ = numa_node;
+
+    // The policy of a shared mapping applies to the underlying object, so
+    // setting it on the first mapping also covers the mirror
+    set_preferred_numa_node(m_.get(), m_.length(), numa_node);
+
+#if defined(MAP_POPULATE)
+    if (flags & MAP_POPULATE)
+    {
+        const std::size_t page_size = align_to_page_size(1);
+        volatile std::byte* const begin = static_cast<std::byte*>(m_.get());
+        for (std::size_t i = 0; i < m_.length(); i += page_size)
+            begin[i] = std::byte{0};
+    }
+#endif
+}
+
+XTR_FUNC
+xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping(
+    void* addr,
+    std::size_t length)
+{
+    if (length != align_to_page_size(length))
+    {
+        throw_invalid_argument(
+            "xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping: "
+            "Length argument is not page-aligned");
+    }
+
+#if defined(__linux__)
+    void* const mirror = static_cast<std::byte*>(addr) + length;
+
+    if (::mremap(addr, 0, length, MREMAP_FIXED|MREMAP_MAYMOVE, mirror) != mirror)
+    {
+        throw_system_error(
+            "xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping: "
+            "mremap failed");
+    }
+
+    m_.reset(addr, length);
+#else
+    throw_runtime_error(
+        "xtr::detail::mirrored_memory_mapping::mirrored_memory_mapping: "
+        "Mirroring an existing mapping is not supported on this platform");
+#endif
+}
+
 XTR_FUNC
 xtr::detail::mirrored_memory_mapping::~mirrored_memory_mapping()
 {
@@ -0,0 +1,175 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/numa.hpp"
+#include "xtr/detail/numa.hpp"
+#include "xtr/detail/throw.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+namespace xtr::detail
+{
+    // From <numaif.h>, which is part of libnuma rather than the kernel headers
+    inline constexpr int mpol_preferred = 1;
+    inline constexpr std::size_t max_numa_nodes = 1024;
+}
+#endif
+
+XTR_FUNC
+int xtr::numa_node_of_cpu([[maybe_unused]] int cpu)
+{
+#if defined(__linux__)
+    if (cpu == -1)
+    {
+        unsigned node;
+        if (::syscall(SYS_getcpu, nullptr, &node, nullptr) == -1)
+            return no_numa_node;
+        return int(node);
+    }
+
+    // Each CPU directory contains a link named node<N> to its NUMA node
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+    DIR* dir = ::opendir(path);
+    if (dir == nullptr)
+        return no_numa_node;
+
+    int node = no_numa_node;
+    while (const ::dirent* ent = ::readdir(dir))
+    {
+        if (std::sscanf(ent->d_name, "node%d", &node) == 1)
+            break;
+    }
+
+    ::closedir(dir);
+
+    return node;
+#else
+    return no_numa_node;
+#endif
+}
+
+XTR_FUNC
+void xtr::detail::set_preferred_numa_node(
+    [[maybe_unused]] void* addr,
+    [[maybe_unused]] std::size_t length,
+    [[maybe_unused]] int node) noexcept
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node < 0 || std::size_t(node) >= max_numa_nodes)
+        return;
+
+    constexpr std::size_t bits = sizeof(unsigned long) * CHAR_BIT;
+    unsigned long mask[max_numa_nodes / bits] = {};
+    mask[std::size_t(node) / bits] = 1UL << (std::size_t(node) % bits);
+
+    // Failure is ignored, as the memory is still usable. The kernel expects
+    // maxnode to be one greater than the number of bits in the mask.
+    ::syscall(
+        SYS_mbind,
+        addr,
+        length,
+        mpol_preferred,
+        mask,
+        max_numa_nodes + 1,
+        0);
+#endif
+}
+
+XTR_FUNC
+void xtr::detail::bind_thread_to_numa_node(
+    [[maybe_unused]] std::thread::native_handle_type thread,
+    [[maybe_unused]] int node)
+{
+#if defined(__linux__)
+    if (node < 0)
+    {
+        throw_invalid_argument(
+            "xtr::detail::bind_thread_to_numa_node: "
+            "Invalid NUMA node");
+    }
+
+    char path[64];
+    std::snprintf(
+        path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+    std::FILE* fp = std::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        throw_system_error_fmt(
+            "xtr::detail::bind_thread_to_numa_node: "
+            "Failed to open %s", path);
+    }
+
+    // The CPU list has the format "0-3,8-11"
+    char buf[4096];
+    const bool ok = std::fgets(buf, sizeof(buf), fp) != nullptr;
+    std::fclose(fp);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for (char* pos = buf; ok && *pos != '\0' && *pos != '\n';)
+    {
+        const long first = std::strtol(pos, &pos, 10);
+        long last = first;
+        if (*pos == '-')
+            last = std::strtol(pos + 1, &pos, 10);
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(int(cpu), &cpus);
+        if (*pos == ',')
+            ++pos;
+        else
+            break;
+    }
+
+    if (CPU_COUNT(&cpus) == 0)
+    {
+        throw_runtime_error_fmt(
+            "xtr::detail::bind_thread_to_numa_node: "
+            "NUMA node %d has no CPUs", node);
+    }
+
+    if (const int rc = ::pthread_setaffinity_np(thread, sizeof(cpus), &cpus))
+    {
+        errno = rc;
+        throw_system_error(
+            "xtr::detail::bind_thread_to_numa_node: "
+            "pthread_setaffinity_np failed");
+    }
+#else
+    throw_runtime_error(
+        "xtr::detail::bind_thread_to_numa_node: "
+        "Not supported on this platform");
+#endif
+}
@@ -0,0 +1,754 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/recovery.hpp"
+#include "xtr/detail/consumer.hpp"
+#include "xtr/detail/pagesize.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/strzcpy.hpp"
+#include "xtr/detail/throw.hpp"
+#include "xtr/sink.hpp"
+#include "xtr/timespec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+namespace xtr::detail
+{
+    // From <elf.h>, the type of the note containing the build id
+    inline constexpr std::uint32_t nt_gnu_build_id = 3;
+
+    // Header of the frames sent by the child process created by
+    // consumer::recover_file to its parent, each followed by size bytes of
+    // data. The size of the final (end) frame is instead the number of
+    // records recovered.
+    struct recovery_frame
+    {
+        enum kind_t : unsigned char { output, error, end };
+
+        kind_t kind;
+        log_level_t level;
+        std::size_t size;
+    };
+
+    inline bool write_all(int fd, const void* buf, std::size_t size) noexcept
+    {
+        auto pos = static_cast<const char*>(buf);
+        while (size > 0)
+        {
+            const ::ssize_t n = XTR_TEMP_FAILURE_RETRY(::write(fd, pos, size));
+            if (n == -1)
+                return false;
+            pos += n;
+            size -= std::size_t(n);
+        }
+        return true;
+    }
+
+    inline bool read_all(int fd, void* buf, std::size_t size) noexcept
+    {
+        auto pos = static_cast<char*>(buf);
+        while (size > 0)
+        {
+            const ::ssize_t n = XTR_TEMP_FAILURE_RETRY(::read(fd, pos, size));
+            if (n <= 0)
+                return false;
+            pos += n;
+            size -= std::size_t(n);
+        }
+        return true;
+    }
+
+    // Log level styles are passed to the recovery process either as one of
+    // the built-in styles or, like the trampolines of log records, as an
+    // offset from the load address of the executable
+    enum class recovery_style : int { default_style, systemd_style, offset };
+
+    inline recovery_style encode_recovery_style(
+        log_level_style_t ls,
+        unsigned long long& offset) noexcept
+    {
+        offset = 0;
+        if (ls == default_log_level_style)
+            return recovery_style::default_style;
+        if (ls == systemd_log_level_style)
+            return recovery_style::systemd_style;
+        const executable_image image = get_executable_image();
+        offset = std::uintptr_t(ls) - image.base;
+        // A style outside of the executable cannot be located by the
+        // recovery process, so the default style is used instead
+        if (offset >= image.size)
+            return recovery_style::default_style;
+        return recovery_style::offset;
+    }
+
+    inline log_level_style_t decode_recovery_style(
+        recovery_style style,
+        unsigned long long offset) noexcept
+    {
+        switch (style)
+        {
+        case recovery_style::systemd_style:
+            return systemd_log_level_style;
+        case recovery_style::offset:
+            return
+                reinterpret_cast<log_level_style_t>(
+                    offset + get_executable_image().base);
+        default:
+            return default_log_level_style;
+        }
+    }
+
+    inline bool write_recovery_frame(
+        int fd,
+        const recovery_frame& rf,
+        const char* buf = nullptr) noexcept
+    {
+        return
+            write_all(fd, &rf, sizeof(rf)) &&
+            (buf == nullptr || write_all(fd, buf, rf.size));
+    }
+}
+
+XTR_FUNC
+xtr::detail::executable_image xtr::detail::get_executable_image() noexcept
+{
+    executable_image image{};
+
+    // The first object reported by dl_iterate_phdr is the executable
+    ::dl_iterate_phdr(
+        [](::dl_phdr_info* info, std::size_t, void* data)
+        {
+            auto& img = *static_cast<executable_image*>(data);
+            img.base = info->dlpi_addr;
+
+            for (std::size_t i = 0; i < info->dlpi_phnum; ++i)
+            {
+                const auto& ph = info->dlpi_phdr[i];
+
+                if (ph.p_type == PT_LOAD)
+                {
+                    img.size =
+                        std::max(img.size, std::size_t(ph.p_vaddr + ph.p_memsz));
+                }
+                else if (ph.p_type == PT_NOTE)
+                {
+                    // Notes are a header, then the name and description, each
+                    // padded to four bytes
+                    auto pos =
+                        reinterpret_cast<const unsigned char*>(
+                            info->dlpi_addr + ph.p_vaddr);
+                    const auto end = pos + ph.p_memsz;
+                    while (pos + sizeof(ElfW(Nhdr)) <= end)
+                    {
+                        ElfW(Nhdr) nhdr;
+                        std::memcpy(&nhdr, pos, sizeof(nhdr));
+                        const auto desc =
+                            pos + sizeof(nhdr) + ((nhdr.n_namesz + 3) & ~3U);
+                        if (nhdr.n_type == nt_gnu_build_id &&
+                            nhdr.n_namesz == 4 &&
+                            std::memcmp(pos + sizeof(nhdr), "GNU", 4) == 0)
+                        {
+                            img.build_id_size =
+                                std::min(
+                                    std::uint32_t(nhdr.n_descsz),
+                                    std::uint32_t(sizeof(img.build_id)));
+                            std::memcpy(img.build_id, desc, img.build_id_size);
+                        }
+                        pos = desc + ((nhdr.n_descsz + 3) & ~3U);
+                    }
+                }
+            }
+
+            return 1; // Stop after the executable
+        },
+        &image);
+
+    return image;
+}
+
+XTR_FUNC
+bool xtr::detail::same_executable(
+    const executable_image& a,
+    const executable_image& b) noexcept
+{
+    return
+        a.size == b.size &&
+        a.build_id_size == b.build_id_size &&
+        std::memcmp(a.build_id, b.build_id, a.build_id_size) == 0;
+}
+
+XTR_FUNC
+xtr::detail::recovery_file::recovery_file(
+    const std::string& dir,
+    const std::string& name,
+    std::size_t length)
+{
+    static std::atomic<unsigned> file_count{0};
+    const long pid = ::getpid();
+    char path[PATH_MAX];
+
+    std::snprintf(
+        path, sizeof(path), "%s/xtr.%ld.%u.buf", dir.c_str(), pid, file_count++);
+
+    path_ = path;
+    fd_ = file_descriptor(path, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC, S_IRUSR|S_IWUSR);
+
+    if (::ftruncate(fd_.get(), ::off_t(queue_offset() + length)) == -1)
+    {
+        const int errnum = errno;
+        ::unlink(path);
+        errno = errnum;
+        throw_system_error_fmt(
+            "xtr::detail::recovery_file::recovery_file: "
+            "Failed to ftruncate `%s'", path);
+    }
+
+    header_map_ =
+        memory_mapping(
+            nullptr,
+            queue_offset(),
+            PROT_READ|PROT_WRITE,
+            MAP_SHARED,
+            fd_.get());
+
+    header_ = new (header_map_.get()) recovery_header{};
+    header_->pid = pid;
+    header_->capacity = length;
+    header_->image = get_executable_image();
+    strzcpy(header_->name, name);
+}
+
+XTR_FUNC
+xtr::detail::recovery_file::~recovery_file()
+{
+    ::unlink(path_.c_str());
+}
+
+XTR_FUNC
+std::size_t xtr::detail::recovery_file::queue_offset() noexcept
+{
+    return align_to_page_size(sizeof(recovery_header));
+}
+
+XTR_FUNC
+void xtr::detail::recovery_file::set_address(const void* addr) noexcept
+{
+    header_->address = std::uint64_t(addr);
+    // The magic number is written last, so that a file left by a process that
+    // died while creating a sink is ignored
+    std::atomic_ref(header_->magic).store(
+        recovery_header::magic_value, std::memory_order_release);
+}
+
+XTR_FUNC
+void xtr::detail::recovery_file::consumed(
+    std::byte* begin,
+    std::byte* end) noexcept
+{
+    // The position is updated first so that if the process dies while the
+    // records are being cleared they are not recovered twice
+    std::atomic_ref(header_->nread).fetch_add(
+        std::uint64_t(end - begin), std::memory_order_release);
+    std::memset(begin, 0, std::size_t(end - begin));
+}
+
+XTR_FUNC
+std::string xtr::detail::recovery_subdirectory(const std::string& dir)
+{
+    return dir + "/xtr." + std::to_string(::geteuid()) + ".recovery";
+}
+
+XTR_FUNC
+xtr::detail::file_descriptor xtr::detail::open_recovery_subdirectory(
+    const char* path,
+    bool create) noexcept
+{
+    if (create && ::mkdir(path, S_IRWXU) == -1 && errno != EEXIST)
+        return {};
+
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(path, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC)));
+
+    if (fd && !is_owned_by_user(fd.get(), S_IFDIR, S_IRWXG|S_IRWXO))
+    {
+        errno = EACCES;
+        return {};
+    }
+
+    return fd;
+}
+
+XTR_FUNC
+bool xtr::detail::is_owned_by_user(
+    int fd,
+    ::mode_t type,
+    ::mode_t excluded) noexcept
+{
+    struct ::stat st;
+    return
+        ::fstat(fd, &st) == 0 &&
+        (st.st_mode & S_IFMT) == type &&
+        st.st_uid == ::geteuid() &&
+        (st.st_mode & excluded) == 0;
+}
+
+XTR_FUNC
+xtr::detail::file_descriptor xtr::detail::open_recovery_file(
+    const char* path,
+    recovery_header& hdr)
+{
+    // Symbolic links are not followed, and files that other users could
+    // have written are ignored, see detail/recovery.hpp
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(path, O_RDWR|O_NOFOLLOW|O_CLOEXEC)));
+
+    if (!fd ||
+        !is_owned_by_user(fd.get(), S_IFREG, S_IWGRP|S_IWOTH) ||
+        XTR_TEMP_FAILURE_RETRY(
+            ::pread(fd.get(), &hdr, sizeof(hdr), 0)) != ::ssize_t(sizeof(hdr)) ||
+        hdr.magic != recovery_header::magic_value ||
+        hdr.pid == ::getpid() ||
+        !same_executable(hdr.image, get_executable_image()))
+    {
+        return {};
+    }
+
+    // The process that wrote the file must have exited
+    if (::kill(pid_t(hdr.pid), 0) == 0 || errno != ESRCH)
+        return {};
+
+    struct ::stat st;
+    if (::fstat(fd.get(), &st) == -1 ||
+        std::uint64_t(st.st_size) !=
+            recovery_file::queue_offset() + hdr.capacity ||
+        hdr.capacity != align_to_page_size(hdr.capacity))
+    {
+        return {};
+    }
+
+    return fd;
+}
+
+XTR_FUNC
+bool xtr::detail::map_recovered_queue(
+    int fd,
+    const recovery_header& hdr) noexcept
+{
+    const std::size_t length = hdr.capacity;
+    const std::size_t offset = recovery_file::queue_offset();
+    auto addr = reinterpret_cast<std::byte*>(hdr.address);
+
+    for (auto pos : {addr, addr + length})
+    {
+        // Without MAP_FIXED the address is only a hint, so the result is
+        // checked rather than replacing any existing mapping
+        void* m =
+            ::mmap(pos, length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, ::off_t(offset));
+        if (m == MAP_FAILED)
+            return false;
+        if (m != pos)
+        {
+            ::munmap(m, length);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+XTR_FUNC
+bool xtr::detail::consumer::recover(
+    const std::string& dir,
+    std::size_t& nfiles) noexcept
+{
+    assert(primary_ == nullptr);
+
+    nfiles = 0;
+
+    const std::string subdir = recovery_subdirectory(dir);
+    file_descriptor dfd = open_recovery_subdirectory(subdir.c_str(), false);
+    if (!dfd)
+    {
+        // If the subdirectory does not exist then no recoverable sinks have
+        // been created in the directory
+        return errno == ENOENT && ::access(dir.c_str(), F_OK) == 0;
+    }
+
+    ::DIR* d = ::fdopendir(dfd.get());
+    if (d == nullptr)
+        return false;
+    dfd.release();
+
+    std::vector<std::string> paths;
+    while (const ::dirent* ent = ::readdir(d))
+    {
+        const std::string_view filename(ent->d_name);
+        if (filename.starts_with("xtr.") && filename.ends_with(".buf"))
+            paths.push_back(subdir + "/" + ent->d_name);
+    }
+    ::closedir(d);
+
+    // Files are recovered in order of process id, then of sink creation
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths)
+    {
+        recovery_header hdr;
+        if (const file_descriptor fd = open_recovery_file(path.c_str(), hdr))
+        {
+            recover_file(path.c_str(), fd.get(), hdr);
+            ++nfiles;
+        }
+    }
+
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::consumer::recover_file(
+    const char* path,
+    int fd,
+    const recovery_header& hdr) noexcept
+{
+    const std::string name(hdr.name, ::strnlen(hdr.name, sizeof(hdr.name)));
+    char ts[32] = {};
+    *detail::format_timestamp(ts, ts_) = '\0';
+    fmt::memory_buffer mbuf;
+
+    write_batch(name);
+
+    // The recovery process would ignore recovery_env_var (see
+    // recovery_process_init) and so run the program
+    if (::getauxval(AT_SECURE) != 0)
+    {
+        report_error(
+            err, lstyle, ts, name,
+            "Recovery is not supported by set-user-ID programs");
+        return;
+    }
+
+    int pipe_fds[2];
+    if (::pipe2(pipe_fds, O_CLOEXEC) == -1)
+    {
+        report_error(err, lstyle, ts, name, "Failed to create recovery pipe");
+        return;
+    }
+
+    file_descriptor rfd(pipe_fds[0]);
+    file_descriptor wfd(pipe_fds[1]);
+
+    // Everything needed by the child is prepared before forking, as only
+    // async-signal-safe functions may be called between fork and exec (see
+    // detail/recovery.hpp)
+    unsigned long long style_offset;
+    const recovery_style style = encode_recovery_style(lstyle, style_offset);
+    char var[128];
+    std::snprintf(
+        var,
+        sizeof(var),
+        "%s=%d:%d:%d:%llx:%d:%lld:%ld",
+        recovery_env_var,
+        wfd.get(),
+        fd,
+        int(style),
+        style_offset,
+        int(output_format),
+        static_cast<long long>(ts_.tv_sec),
+        static_cast<long>(ts_.tv_nsec));
+
+    std::vector<char*> envp;
+    const std::string_view prefix(var, std::strlen(recovery_env_var) + 1);
+    for (char** e = environ; *e != nullptr; ++e)
+    {
+        if (!std::string_view(*e).starts_with(prefix))
+            envp.push_back(*e);
+    }
+    envp.push_back(var);
+    envp.push_back(nullptr);
+
+    char arg0[] = "xtr-recover";
+    char* const argv[] = {arg0, nullptr};
+
+    const ::pid_t pid = ::fork();
+
+    if (pid == -1)
+    {
+        report_error(err, lstyle, ts, name, "Failed to create recovery process");
+        return;
+    }
+
+    if (pid == 0)
+    {
+        // The read end of the pipe is close-on-exec, the other descriptors
+        // are inherited by the new executable
+        if (::fcntl(wfd.get(), F_SETFD, 0) == -1 ||
+            ::fcntl(fd, F_SETFD, 0) == -1)
+        {
+            ::_exit(EXIT_FAILURE);
+        }
+        ::execve("/proc/self/exe", argv, envp.data());
+        ::_exit(EXIT_FAILURE);
+    }
+
+    wfd.reset();
+
+    recovery_frame rf;
+    std::string data;
+    std::size_t nrecords = 0;
+    bool complete = false;
+
+    while (read_all(rfd.get(), &rf, sizeof(rf)))
+    {
+        if (rf.kind == recovery_frame::end)
+        {
+            nrecords = rf.size;
+            complete = true;
+            break;
+        }
+
+        data.resize(rf.size);
+        if (!read_all(rfd.get(), data.data(), data.size()))
+            break;
+
+        if (rf.kind == recovery_frame::output)
+            output(rf.level, data.data(), data.size(), xtr::timespec{ts_}, name);
+        else
+            err(data.data(), data.size());
+    }
+
+    int status = 0;
+    XTR_TEMP_FAILURE_RETRY(::waitpid(pid, &status, 0));
+
+    // The child's encoder may have defined formats that are unknown to this
+    // encoder, so the next record is made self-describing
+    encoder.reset();
+
+    if (complete && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+    {
+        print(
+            mbuf,
+            "{}{} {}: Recovered {} log records from process {}\n",
+            log_level_t::warning,
+            ts,
+            name,
+            nrecords,
+            hdr.pid);
+    }
+    else if (WIFSIGNALED(status))
+    {
+        print(
+            mbuf,
+            "{}{} {}: Recovery of log records from process {} "
+            "terminated by signal {}\n",
+            log_level_t::error,
+            ts,
+            name,
+            hdr.pid,
+            WTERMSIG(status));
+    }
+    else
+    {
+        print(
+            mbuf,
+            "{}{} {}: Recovery of log records from process {} failed\n",
+            log_level_t::error,
+            ts,
+            name,
+            hdr.pid);
+    }
+
+    write_batch(name);
+
+    // The file is removed even if recovery failed, as it is likely to fail
+    // again
+    ::unlink(path);
+}
+
+// 101 is the highest priority that is not reserved for the implementation
+[[gnu::constructor(101), gnu::used]] XTR_FUNC
+void xtr::detail::recovery_process_init() noexcept
+{
+    const char* const value = ::secure_getenv(recovery_env_var);
+    if (value == nullptr)
+        return;
+
+#if defined(__linux__)
+    ::prctl(PR_SET_NAME, "xtr-recover", 0, 0, 0);
+#endif
+
+    int pipe_fd;
+    int fd;
+    int style;
+    unsigned long long style_offset;
+    int format;
+    long long sec;
+    long nsec;
+    if (std::sscanf(
+            value, "%d:%d:%d:%llx:%d:%lld:%ld",
+            &pipe_fd, &fd, &style, &style_offset, &format, &sec, &nsec) != 7)
+    {
+        ::_exit(EXIT_FAILURE);
+    }
+
+    // Checked by the parent, checked again here as only the descriptors are
+    // passed
+    recovery_header hdr;
+    if (!is_owned_by_user(pipe_fd, S_IFIFO, 0) ||
+        !is_owned_by_user(fd, S_IFREG, S_IWGRP|S_IWOTH) ||
+        XTR_TEMP_FAILURE_RETRY(
+            ::pread(fd, &hdr, sizeof(hdr), 0)) != ::ssize_t(sizeof(hdr)) ||
+        hdr.magic != recovery_header::magic_value)
+    {
+        ::_exit(EXIT_FAILURE);
+    }
+
+    consumer::recover_process(
+        pipe_fd,
+        fd,
+        hdr,
+        decode_recovery_style(recovery_style(style), style_offset),
+        output_format_t(format),
+        std::timespec{.tv_sec=std::time_t(sec), .tv_nsec=nsec});
+}
+
+XTR_FUNC
+void xtr::detail::consumer::recover_process(
+    int pipe_fd,
+    int fd,
+    const recovery_header& hdr,
+    log_level_style_t ls,
+    output_format_t format,
+    std::timespec ts) noexcept
+{
+    // The consumer only exists to run recover_child, so has no sinks and
+    // no back-end of its own
+    consumer c(
+        [](const char*, std::size_t size) { return ::ssize_t(size); },
+        [](const char*, std::size_t) {},
+        [](){},
+        [](){},
+        [](){ return true; },
+        [](){},
+        ls,
+        nullptr,
+        nullptr);
+    c.output_format = format;
+    c.ts_ = ts;
+    c.recover_child(pipe_fd, fd, hdr);
+}
+
+XTR_FUNC
+void xtr::detail::consumer::recover_child(
+    int pipe_fd,
+    int fd,
+    const recovery_header& hdr) noexcept
+{
+    // Log records are written to the pipe
+    recovering_ = true;
+
+    out =
+        [pipe_fd](log_level_t level, const char* buf, std::size_t size)
+        {
+            const recovery_frame rf{recovery_frame::output, level, size};
+            return
+                write_recovery_frame(pipe_fd, rf, buf) ? ::ssize_t(size) : -1;
+        };
+    out_batch = nullptr;
+    err =
+        [pipe_fd](const char* buf, std::size_t size)
+        {
+            const recovery_frame rf{
+                recovery_frame::error, log_level_t::none, size};
+            write_recovery_frame(pipe_fd, rf, buf);
+        };
+
+    std::string name(hdr.name, ::strnlen(hdr.name, sizeof(hdr.name)));
+    char ts[32] = {};
+    *detail::format_timestamp(ts, ts_) = '\0';
+    fmt::memory_buffer mbuf;
+
+    if (!map_recovered_queue(fd, hdr))
+    {
+        report_error(err, lstyle, ts, name, "Failed to map recovery file");
+        ::_exit(EXIT_FAILURE);
+    }
+
+    const executable_image image = get_executable_image();
+    const std::size_t capacity = hdr.capacity;
+    auto* const begin = reinterpret_cast<std::byte*>(hdr.address);
+    std::byte* pos = begin + hdr.nread % capacity;
+    std::size_t nrecords = 0;
+
+    // Records are read until the first zero function pointer, see
+    // detail/recovery.hpp. Function pointers are checked to be within the
+    // executable before being rebased to its current load address.
+    for (std::size_t nbytes = 0; nbytes < capacity; ++nrecords)
+    {
+        std::uintptr_t addr;
+        std::memcpy(&addr, pos, sizeof(addr));
+        if (addr == 0)
+            break;
+
+        if (addr - hdr.image.base >= hdr.image.size)
+        {
+            report_error(err, lstyle, ts, name, "Invalid log record");
+            break;
+        }
+
+        const auto fptr =
+            reinterpret_cast<sink::fptr_t>(addr - hdr.image.base + image.base);
+        std::byte* next = fptr(mbuf, pos, *this, ts, name);
+
+        nbytes += std::size_t(next - pos);
+        pos = next < begin + capacity ? next : next - capacity;
+    }
+
+    const recovery_frame rf{recovery_frame::end, log_level_t::none, nrecords};
+    write_recovery_frame(pipe_fd, rf);
+
+    // Destructors must not run, as the process exits before main
+    ::_exit(EXIT_SUCCESS);
+}
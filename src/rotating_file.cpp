@@ -0,0 +1,298 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/rotating_file.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/throw.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <utility>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+XTR_FUNC
+xtr::detail::rotating_file::rotating_file(
+    const char* path,
+    const rotation_policy& policy)
+:
+    path_(path),
+    next_path_(path_ + ".next"),
+    policy_(policy)
+{
+    if (!open())
+    {
+        throw_system_error_fmt(
+            "xtr::detail::rotating_file::rotating_file: "
+            "Failed to open `%s'", path);
+    }
+    buf_.reserve(buffer_size);
+}
+
+XTR_FUNC
+xtr::detail::rotating_file::~rotating_file()
+{
+    close();
+}
+
+XTR_FUNC
+bool xtr::detail::rotating_file::open()
+{
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(path_.c_str(), O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC, 0666)));
+    if (!fd)
+        return false;
+
+    struct ::stat st;
+    if (::fstat(fd.get(), &st) == -1)
+        return false;
+
+    fd_ = std::move(fd);
+    size_ = std::size_t(st.st_size);
+    opened_ = std::chrono::steady_clock::now();
+
+    return true;
+}
+
+XTR_FUNC
+bool xtr::detail::rotating_file::open_next() noexcept
+{
+    file_descriptor fd(
+        XTR_TEMP_FAILURE_RETRY(
+            ::open(
+                next_path_.c_str(),
+                O_WRONLY|O_CREAT|O_TRUNC|O_APPEND|O_CLOEXEC,
+                0666)));
+    if (!fd)
+        return false;
+
+#if defined(__linux__)
+    // Disk blocks are allocated without changing the file's size, so the
+    // file does not contain any padding when rotated. Failure is harmless.
+    if (policy_.max_bytes != 0)
+        (void)::fallocate(fd.get(), FALLOC_FL_KEEP_SIZE, 0, ::off_t(policy_.max_bytes));
+#endif
+
+    next_fd_ = std::move(fd);
+
+    return true;
+}
+
+XTR_FUNC
+::ssize_t xtr::detail::rotating_file::write(const char* buf, std::size_t size)
+{
+    if (!fd_)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    // Empty files are not rotated, so that a batch larger than max_bytes is
+    // written to a file of its own rather than causing repeated rotations.
+    if (size_ > 0 && rotates() && rotation_due(size)) [[unlikely]]
+    {
+        if (rotation_retry_due() && !rotate())
+        {
+            // Opening, linking and renaming files is not retried before
+            // every write while rotation is failing
+            retry_size_ = size_ + rotation_retry_bytes;
+            retry_time_ =
+                std::chrono::steady_clock::now() + rotation_retry_interval;
+        }
+    }
+
+    if (buf_.size() + size > buffer_size && !write_buffer())
+        return -1;
+
+    if (size >= buffer_size)
+    {
+        if (!write_all(buf, size))
+            return -1;
+    }
+    else
+    {
+        buf_.insert(buf_.end(), buf, buf + size);
+    }
+
+    size_ += size;
+
+    return ::ssize_t(size);
+}
+
+XTR_FUNC
+bool xtr::detail::rotating_file::rotate()
+{
+    if (!next_fd_ && !open_next())
+        return false;
+
+    // Buffered data belongs to the current file
+    if (!write_buffer())
+        return false;
+
+    release_space();
+
+    if (policy_.keep == 0)
+    {
+        // Replaces the current file, removing it
+        if (::rename(next_path_.c_str(), path_.c_str()) == -1)
+            return false;
+    }
+    else
+    {
+        // Rotated files are only shifted up if path.1 exists, as it does not
+        // after the shift, so that retrying a rotation which failed after the
+        // shift does not shift the files again (losing the oldest).
+        const std::string first = rotated_path(1);
+        if (::access(first.c_str(), F_OK) == 0)
+        {
+            for (std::size_t i = policy_.keep; i > 1; --i)
+                ::rename(rotated_path(i - 1).c_str(), rotated_path(i).c_str());
+            ::unlink(first.c_str());
+        }
+
+        // The file is linked rather than renamed so that path does not
+        // briefly cease to exist, falling back to renaming if the file
+        // system does not support hard links.
+        const bool linked = ::link(path_.c_str(), first.c_str()) == 0;
+        if (!linked && ::rename(path_.c_str(), first.c_str()) == -1)
+            return false;
+
+        if (::rename(next_path_.c_str(), path_.c_str()) == -1)
+        {
+            // Undo the link (or rename) so that path.1 does not exist when
+            // the rotation is retried
+            if (linked)
+                ::unlink(first.c_str());
+            else
+                ::rename(first.c_str(), path_.c_str());
+            return false;
+        }
+    }
+
+    using std::swap;
+    swap(fd_, next_fd_);
+    next_fd_.reset();
+    size_ = 0;
+    opened_ = std::chrono::steady_clock::now();
+    retry_size_ = 0;
+    ++nrotations_;
+
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::rotating_file::release_space() noexcept
+{
+#if defined(__linux__)
+    // Truncating the file to its own size releases the blocks allocated
+    // beyond its end by open_next. Failure is harmless.
+    struct ::stat st;
+    if (policy_.max_bytes != 0 && ::fstat(fd_.get(), &st) == 0)
+        (void)XTR_TEMP_FAILURE_RETRY(::ftruncate(fd_.get(), st.st_size));
+#endif
+}
+
+XTR_FUNC
+std::string xtr::detail::rotating_file::rotated_path(std::size_t index) const
+{
+    return path_ + "." + std::to_string(index);
+}
+
+XTR_FUNC
+bool xtr::detail::rotating_file::write_buffer() noexcept
+{
+    if (buf_.empty())
+        return true;
+
+    const bool result = write_all(buf_.data(), buf_.size());
+    // Data that could not be written is discarded, as the error is reported
+    // to the caller of write.
+    buf_.clear();
+    return result;
+}
+
+XTR_FUNC
+bool xtr::detail::rotating_file::write_all(
+    const char* buf,
+    std::size_t size) noexcept
+{
+    for (std::size_t n = 0; n < size;)
+    {
+        const ::ssize_t result =
+            XTR_TEMP_FAILURE_RETRY(::write(fd_.get(), buf + n, size - n));
+        if (result == -1)
+            return false;
+        n += std::size_t(result);
+    }
+    return true;
+}
+
+XTR_FUNC
+void xtr::detail::rotating_file::flush()
+{
+    if (!fd_)
+        return;
+
+    write_buffer();
+
+    if (rotates() && !next_fd_)
+        open_next();
+}
+
+XTR_FUNC
+void xtr::detail::rotating_file::sync()
+{
+    if (!fd_)
+        return;
+
+    write_buffer();
+    ::fdatasync(fd_.get());
+}
+
+XTR_FUNC
+bool xtr::detail::rotating_file::reopen()
+{
+    if (fd_)
+    {
+        write_buffer();
+        release_space();
+    }
+    return open();
+}
+
+XTR_FUNC
+void xtr::detail::rotating_file::close()
+{
+    if (!fd_)
+        return;
+
+    write_buffer();
+    release_space();
+    fd_.reset();
+
+    if (next_fd_)
+    {
+        next_fd_.reset();
+        ::unlink(next_path_.c_str());
+    }
+}
@@ -0,0 +1,122 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/shared_sink.hpp"
+#include "xtr/detail/consumer.hpp"
+#include "xtr/logger.hpp"
+
+XTR_FUNC
+xtr::shared_sink::shared_sink(
+    logger& owner,
+    std::string name,
+    std::size_t capacity,
+    page_type_t page_type,
+    int numa_node)
+:
+    sink_(owner, std::move(name), capacity, page_type, numa_node),
+    nreserved_(sink_.buf_.nwritten())
+{
+}
+
+XTR_FUNC
+xtr::shared_sink::~shared_sink()
+{
+    close();
+}
+
+XTR_FUNC
+void xtr::shared_sink::close()
+{
+    if (sink_.open_)
+    {
+        sync(/*destroy=*/true);
+        sink_.open_ = false;
+        sink_.buf_.clear();
+    }
+}
+
+XTR_FUNC
+void xtr::shared_sink::sync(bool destroy)
+{
+    sink::sync_state state;
+    post(sink::sync_command{&state, destroy});
+    state.wait();
+}
+
+XTR_FUNC
+void xtr::shared_sink::set_name(std::string name)
+{
+    post(
+        [name = std::move(name)](auto&, auto& oldname)
+        {
+            oldname = std::move(name);
+        });
+    sync();
+}
+
+XTR_FUNC
+void xtr::shared_sink::commit(std::byte* record, size_type size) noexcept
+{
+    // Writing the size marks the record as complete, see publish
+    std::atomic_ref(*reinterpret_cast<size_type*>(record + sizeof(fptr_t)))
+        .store(size);
+    publish();
+    // The record may have been published by another producer, so whether it
+    // made the queue non-empty is not known
+    sink_.notify();
+}
+
+XTR_FUNC
+void xtr::shared_sink::publish() noexcept
+{
+    // Records are completed in any order but must be published (made
+    // visible to the consumer) in the order that they were reserved, so
+    // each producer publishes all complete records following the last
+    // published record, stopping at the first incomplete record. The
+    // producer completing that record will then publish it.
+    //
+    // The count of bytes written, and the sizes marking records as
+    // complete, are sequentially consistent. This guarantees that if a
+    // producer finds the next record incomplete then the producer
+    // completing the record will find that the record is next to be
+    // published.
+    //
+    // The size read may be of a record that has since been published and
+    // consumed (if written is stale), in which case publishing fails and
+    // written is reloaded.
+    auto& buf = sink_.buf_;
+    size_type written = buf.nwritten();
+    while (written != nreserved_.load(std::memory_order_acquire))
+    {
+        const size_type size =
+            std::atomic_ref(
+                *reinterpret_cast<size_type*>(
+                    buf.position(written) + sizeof(fptr_t))).load();
+        if (size == 0)
+        {
+            if (buf.publish(written, written))
+                return;
+        }
+        else if (buf.publish(written, written + size))
+        {
+            written += size;
+        }
+    }
+}
@@ -20,13 +20,29 @@
 
 #include "xtr/sink.hpp"
 #include "xtr/detail/consumer.hpp"
+#include "xtr/detail/consumer_process.hpp"
+#include "xtr/detail/strzcpy.hpp"
 #include "xtr/logger.hpp"
 
-#include <condition_variable>
 #include <mutex>
 
+XTR_FUNC
+xtr::sink::sink(std::size_t capacity, page_type_t page_type, int numa_node)
+:
+    buf_(capacity, -1, 0, buffer_flags(page_type), numa_node)
+{
+}
+
 XTR_FUNC
 xtr::sink::sink(const sink& other)
+:
+    buf_(
+        other.buf_.capacity(),
+        -1,
+        0,
+        buffer_flags(
+            other.buf_.huge_pages() ? page_type_t::huge : page_type_t::normal),
+        other.buf_.numa_node())
 {
     *this = other;
 }
@@ -35,8 +51,17 @@ XTR_FUNC
 xtr::sink& xtr::sink::operator=(const sink& other)
 {
     level_ = other.level_.load(std::memory_order_relaxed);
+    if (other.remote_ != nullptr) [[unlikely]]
+    {
+        // Commands posted to a remote sink are run by the consumer process,
+        // so copies are registered with the logger's consumer thread instead
+        if (!open_)
+            other.remote_->owner->register_sink(*this, other.remote_->name);
+        return *this;
+    }
     if (!std::exchange(open_, other.open_)) // if previously closed, register
     {
+        waiter_ = other.waiter_;
         const_cast<sink&>(other).post(
             [this](detail::consumer& c, const auto& name) { c.add_sink(*this, name); });
     }
@@ -44,11 +69,63 @@ xtr::sink& xtr::sink::operator=(const sink& other)
 }
 
 XTR_FUNC
-xtr::sink::sink(logger& owner, std::string name)
+xtr::sink::sink(
+    logger& owner,
+    std::string name,
+    std::size_t capacity,
+    page_type_t page_type,
+    int numa_node,
+    std::unique_ptr<detail::recovery_file> recovery)
+:
+    buf_(
+        capacity,
+        recovery ? recovery->fd() : -1,
+        recovery ? detail::recovery_file::queue_offset() : 0,
+        buffer_flags(page_type),
+        numa_node),
+    recovery_(std::move(recovery))
 {
+    if (recovery_)
+        recovery_->set_address(buf_.begin());
     owner.register_sink(*this, std::move(name));
 }
 
+XTR_FUNC
+xtr::sink::sink(detail::remote_queue& q)
+:
+    buf_(
+        detail::mirrored_memory_mapping(
+            detail::consumer_process::queue_begin(q),
+            q.capacity),
+        q.ctl),
+    open_(true),
+    waiter_(&q.process->control().w),
+    remote_(&q)
+{
+}
+
+XTR_FUNC
+std::unique_ptr<xtr::detail::recovery_file> xtr::sink::make_recovery_file(
+    const std::string& dir,
+    const std::string& name,
+    std::size_t capacity,
+    page_type_t page_type)
+{
+    return
+        std::make_unique<detail::recovery_file>(
+            dir,
+            name,
+            ring_buffer::mapping_length(capacity, buffer_flags(page_type)));
+}
+
+XTR_FUNC
+int xtr::sink::buffer_flags(page_type_t page_type) noexcept
+{
+    return
+        detail::srb_flags |
+        (page_type == page_type_t::huge ? detail::srb_huge_pages : 0);
+}
+
 XTR_FUNC
 void xtr::sink::close()
 {
@@ -56,6 +133,16 @@ void xtr::sink::close()
     {
         sync(/*destruct=*/true);
         open_ = false;
+        // The queue is empty so the recovery file is no longer needed
+        recovery_.reset();
+        // The consumer process no longer reads the queue so its pages may be
+        // released. If the sink is registered again then it is consumed by
+        // the logger's consumer thread, the memory remaining mapped.
+        if (remote_ != nullptr)
+        {
+            detail::consumer_process::release_pages(*remote_);
+            remote_ = nullptr;
+        }
         // clear() is called here in case the sink is registered with the
         // logger again, e.g. via assignment. This is because when the
         // 'destruct' flag is received by the consumer it cannot perform any
@@ -70,53 +157,81 @@ void xtr::sink::close()
 XTR_FUNC
 void xtr::sink::sync(bool destroy)
 {
-    std::condition_variable cv;
-    std::mutex m;
-    bool notified = false; // protected by m
+    if (remote_ != nullptr) [[unlikely]]
+        return remote_sync(destroy, /*rename=*/false);
 
-    post(
-        [&cv, &m, &notified, destroy](detail::consumer& c, auto&)
-        {
-            c.destroy = destroy;
-
-            c.flush();
-            c.sync();
-
-            std::scoped_lock lock{m};
-            notified = true;
-            // Do not move this notify outside of the protection of m. The
-            // standard guarantees that a mutex may be destructed while
-            // another thread is still inside unlock (but does not hold the
-            // lock). From the mutex requirements:
-            //
-            // ``Note: After a thread A has called unlock(), releasing a
-            // mutex, it is possible for another thread B to lock the same
-            // mutex, observe that it is no longer in use, unlock it, and
-            // destroy it, before thread A appears to have returned from
-            // its unlock call. Implementations are required to handle such
-            // scenarios correctly, as long as thread A doesn't access the
-            // mutex after the unlock call returns.''
-            //
-            // No such requirement exists for condition_variable and notify,
-            // which may access memory (e.g. an internal mutex in pthreads) in
-            // the signalling thread after the waiting thread has woken up---so
-            // if the lock is not held, the condition_variable could already
-            // have been destructed at this time (due to the stack being
-            // unwound).
-            cv.notify_one();
-            // Do not access any captured variables after notifying because if
-            // the sink is destructing then the underlying storage may have
-            // been freed already.
-        });
+    sync_state state;
+    post(sync_command{&state, destroy});
+    state.wait();
+}
+
+XTR_FUNC
+void xtr::sink::remote_sync(bool destroy, bool rename)
+{
+    const std::uint32_t target = ++remote_->nsync_requests;
+    post(detail::remote_sync_command{remote_, destroy, rename});
+    remote_->process->wait_synced(*remote_, target);
+}
 
+XTR_FUNC
+void xtr::sink::sync_state::wait()
+{
     std::unique_lock lock{m};
     while (!notified)
         cv.wait(lock);
 }
 
+XTR_FUNC
+void xtr::sink::sync_command::operator()(
+    detail::consumer& c,
+    const std::string&) const noexcept
+{
+    c.destroy = destroy;
+
+    auto& backend = c.backend();
+    ++backend.nflushes;
+    backend.flush();
+    ++backend.nsyncs;
+    backend.sync();
+
+    std::scoped_lock lock{state->m};
+    state->notified = true;
+    // Do not move this notify outside of the protection of m. The
+    // standard guarantees that a mutex may be destructed while
+    // another thread is still inside unlock (but does not hold the
+    // lock). From the mutex requirements:
+    //
+    // ``Note: After a thread A has called unlock(), releasing a
+    // mutex, it is possible for another thread B to lock the same
+    // mutex, observe that it is no longer in use, unlock it, and
+    // destroy it, before thread A appears to have returned from
+    // its unlock call. Implementations are required to handle such
+    // scenarios correctly, as long as thread A doesn't access the
+    // mutex after the unlock call returns.''
+    //
+    // No such requirement exists for condition_variable and notify,
+    // which may access memory (e.g. an internal mutex in pthreads) in
+    // the signalling thread after the waiting thread has woken up---so
+    // if the lock is not held, the condition_variable could already
+    // have been destructed at this time (due to the stack being
+    // unwound).
+    state->cv.notify_one();
+    // Do not access the state after notifying because if the sink is
+    // destructing then the underlying storage may have been freed
+    // already.
+}
+
 XTR_FUNC
 void xtr::sink::set_name(std::string name)
 {
+    if (remote_ != nullptr) [[unlikely]]
+    {
+        // The name is passed via the queue's header, as the command is run by
+        // the consumer process
+        detail::strzcpy(remote_->name, name);
+        return remote_sync(/*destroy=*/false, /*rename=*/true);
+    }
+
     post(
         [name = std::move(name)](auto&, auto& oldname)
         {
@@ -125,8 +240,16 @@ void xtr::sink::set_name(std::string name)
     sync();
 }
 
+XTR_FUNC
+void xtr::sink::enable_latency_stats()
+{
+    if (stats_.load(std::memory_order_relaxed) == nullptr)
+        stats_.store(new detail::latency_stats, std::memory_order_release);
+}
+
 XTR_FUNC
 xtr::sink::~sink()
 {
     close();
+    delete stats_.load(std::memory_order_relaxed);
 }
@@ -19,14 +19,32 @@
 // SOFTWARE.
 
 #include "xtr/detail/tsc.hpp"
+#include "xtr/detail/tsc_converter.hpp"
 #include "xtr/detail/clock_ids.hpp"
 #include "xtr/detail/cpuid.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/detail/rundir.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
 #include <thread>
 
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <time.h>
+#include <unistd.h>
+
+#if defined(__FreeBSD__)
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
 
 // Crystal clock frequencies are taken from:
 // https://github.com/torvalds/linux/blob/master/tools/power/x86/turbostat/turbostat.c
@@ -95,13 +113,177 @@ std::uint64_t xtr::detail::read_tsc_hz() noexcept
     return std::uint64_t(ccc_hz) * ratio_num / ratio_den;
 }
 
+namespace xtr::detail
+{
+    XTR_FUNC std::int64_t monotonic_nanos() noexcept
+    {
+        std::timespec ts;
+        ::clock_gettime(XTR_CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000L + ts.tv_nsec;
+    }
+
+    XTR_FUNC std::uint64_t tsc_hz_since(
+        std::uint64_t tsc0, std::int64_t nanos0) noexcept
+    {
+        const std::uint64_t tsc1 = tsc::now().ticks;
+        const std::int64_t nanos1 = monotonic_nanos();
+        return
+            std::uint64_t(double(tsc1 - tsc0) * 1e9 / double(nanos1 - nanos0));
+    }
+
+    XTR_FUNC std::size_t read_file(
+        const char* path, char* buf, std::size_t size) noexcept
+    {
+        FILE* fp = std::fopen(path, "r");
+        if (fp == nullptr)
+            return 0;
+        const std::size_t n = std::fread(buf, 1, size - 1, fp);
+        std::fclose(fp);
+        buf[n] = '\0';
+        return n;
+    }
+
+#if defined(__linux__)
+    // The cache file stores the TSC frequency followed by the boot id, so
+    // that the cached frequency is discarded after a reboot (the hardware
+    // or kernel may have changed).
+    inline constexpr auto boot_id_path = "/proc/sys/kernel/random/boot_id";
+
+    // The cache file is only stored in the per-user runtime directory, as a
+    // file in a shared temporary directory could be created by another user
+    // in order to supply a bogus frequency. Returns an empty string if the
+    // runtime directory is not writable, in which case no cache is used.
+    XTR_FUNC std::string tsc_cache_path()
+    {
+        const std::string dir = get_rundir();
+        if (::access(dir.c_str(), W_OK) != 0)
+            return {};
+        return dir + "/xtr." + std::to_string(::geteuid()) + ".tsc_hz";
+    }
+
+    // As read_file, but the file is only read if it is a regular file (not a
+    // symbolic link) owned by the effective user and not writable by other
+    // users.
+    XTR_FUNC std::size_t read_owned_file(
+        const char* path, char* buf, std::size_t size) noexcept
+    {
+        const int fd =
+            XTR_TEMP_FAILURE_RETRY(
+                ::open(path, O_RDONLY|O_NOFOLLOW|O_CLOEXEC));
+        if (fd == -1)
+            return 0;
+
+        struct ::stat st;
+        ::ssize_t n = 0;
+        if (::fstat(fd, &st) == 0 &&
+            S_ISREG(st.st_mode) &&
+            st.st_uid == ::geteuid() &&
+            (st.st_mode & (S_IWGRP|S_IWOTH)) == 0)
+        {
+            n = XTR_TEMP_FAILURE_RETRY(::read(fd, buf, size - 1));
+        }
+        ::close(fd);
+
+        if (n <= 0)
+            return 0;
+        buf[n] = '\0';
+        return std::size_t(n);
+    }
+#endif
+
+    XTR_FUNC std::uint64_t read_cached_tsc_hz() noexcept
+    {
+#if defined(__linux__)
+        char boot_id[64];
+        if (read_file(boot_id_path, boot_id, sizeof(boot_id)) == 0)
+            return 0;
+
+        const std::string path = tsc_cache_path();
+        char buf[128];
+        if (path.empty() || read_owned_file(path.c_str(), buf, sizeof(buf)) == 0)
+            return 0;
+
+        char* pos;
+        const std::uint64_t hz = std::strtoull(buf, &pos, 10);
+        if (*pos != ' ' || std::strcmp(pos + 1, boot_id) != 0)
+            return 0;
+
+        return hz;
+#else
+        return 0;
+#endif
+    }
+
+    XTR_FUNC void write_cached_tsc_hz([[maybe_unused]] std::uint64_t hz)
+    {
+#if defined(__linux__)
+        char boot_id[64];
+        if (read_file(boot_id_path, boot_id, sizeof(boot_id)) == 0)
+            return;
+
+        const std::string path = tsc_cache_path();
+        if (path.empty())
+            return;
+
+        // Written to a temporary file and renamed so that other processes
+        // never read a partially written file. mkstemp creates the file
+        // exclusively (so never follows a symbolic link) with mode 0600.
+        std::string temp = path + ".XXXXXX";
+        const int fd = ::mkstemp(temp.data());
+        if (fd == -1)
+            return;
+
+        char buf[128];
+        const int len =
+            std::snprintf(buf, sizeof(buf), "%" PRIu64 " %s", hz, boot_id);
+        const bool ok =
+            len > 0 &&
+            std::size_t(len) < sizeof(buf) &&
+            XTR_TEMP_FAILURE_RETRY(::write(fd, buf, std::size_t(len))) == len;
+        ::close(fd);
+
+        if (!ok || ::rename(temp.c_str(), path.c_str()) == -1)
+            ::unlink(temp.c_str());
+#endif
+    }
+}
+
+XTR_FUNC
+std::uint64_t xtr::detail::read_kernel_tsc_hz() noexcept
+{
+#if defined(__linux__)
+    // Only present if the tsc_freq_khz module is loaded or the kernel has
+    // been patched to provide it
+    char buf[32];
+    if (read_file(
+            "/sys/devices/system/cpu/cpu0/tsc_freq_khz",
+            buf,
+            sizeof(buf)) == 0)
+    {
+        return 0;
+    }
+    return std::strtoull(buf, nullptr, 10) * 1000;
+#elif defined(__FreeBSD__)
+    std::uint64_t hz = 0;
+    std::size_t len = sizeof(hz);
+    if (::sysctlbyname("machdep.tsc_freq", &hz, &len, nullptr, 0) == -1)
+        return 0;
+    return hz;
+#else
+    return 0;
+#endif
+}
+
 XTR_FUNC
 std::uint64_t xtr::detail::estimate_tsc_hz() noexcept
 {
-    const std::uint64_t tsc0 = tsc::now().ticks;
-    std::timespec ts0;
-    ::clock_gettime(XTR_CLOCK_MONOTONIC, &ts0);
+    return estimate_tsc_hz(tsc::now().ticks, monotonic_nanos());
+}
 
+XTR_FUNC
+std::uint64_t xtr::detail::estimate_tsc_hz(
+    std::uint64_t tsc0, std::int64_t nanos0) noexcept
+{
     std::array<std::uint64_t, 5> history;
     std::size_t n = 0;
 
@@ -118,18 +300,7 @@ std::uint64_t xtr::detail::estimate_tsc_hz() noexcept
     {
         std::this_thread::sleep_for(sleep_time);
 
-        const std::uint64_t tsc1 = tsc::now().ticks;
-        std::timespec ts1;
-        ::clock_gettime(XTR_CLOCK_MONOTONIC, &ts1);
-
-        const auto elapsed_nanos =
-            std::uint64_t(ts1.tv_sec - ts0.tv_sec) * 1000000000UL +
-                std::uint64_t(ts1.tv_nsec) - std::uint64_t(ts0.tv_nsec);
-
-        const std::uint64_t elapsed_ticks = tsc1 - tsc0;
-
-        const std::uint64_t tsc_hz =
-            std::uint64_t(double(elapsed_ticks) * 1e9 / double(elapsed_nanos));
+        const std::uint64_t tsc_hz = tsc_hz_since(tsc0, nanos0);
 
         history[n++ % history.size()] = tsc_hz;
 
@@ -144,25 +315,99 @@ std::uint64_t xtr::detail::estimate_tsc_hz() noexcept
 }
 
 XTR_FUNC
-std::timespec xtr::detail::tsc::to_timespec(tsc ts)
+xtr::detail::tsc_calibration::tsc_calibration() noexcept
 {
-    thread_local tsc last_tsc{};
-    thread_local std::int64_t last_epoch_nanos;
-    static const std::uint64_t one_minute_ticks = 60 * get_tsc_hz();
-    static const double tsc_multiplier = 1e9 / double(get_tsc_hz());
+    __extension__ const std::uint64_t hz =
+        read_tsc_hz() ?: read_kernel_tsc_hz() ?: read_cached_tsc_hz();
 
-    // Sync up TSC and wall clocks every minute
-    if (ts.ticks > last_tsc.ticks + one_minute_ticks)
+    if (hz != 0)
     {
-        last_tsc = tsc::now();
-        std::timespec temp;
-        ::clock_gettime(XTR_CLOCK_WALL, &temp);
-        last_epoch_nanos = temp.tv_sec * 1000000000L + temp.tv_nsec;
+        tsc_hz.store(hz, std::memory_order_relaxed);
+        return;
     }
 
-    const auto tick_delta = std::int64_t(ts.ticks - last_tsc.ticks);
-    const auto nano_delta = std::int64_t(double(tick_delta) * tsc_multiplier);
-    const auto total_nanos = std::uint64_t(last_epoch_nanos + nano_delta);
+    tsc0 = tsc::now().ticks;
+    nanos0 = monotonic_nanos();
+
+    // The thread is detached as it may outlive every logger. Members are
+    // trivially destructible, so the thread may safely run during static
+    // destruction.
+#if __cpp_exceptions
+    try
+    {
+#endif
+        estimating.store(true, std::memory_order_relaxed);
+        std::thread(
+            [this]()
+            {
+                const std::uint64_t estimated_hz =
+                    estimate_tsc_hz(tsc0, nanos0);
+                tsc_hz.store(estimated_hz, std::memory_order_release);
+                write_cached_tsc_hz(estimated_hz);
+                estimating.store(false, std::memory_order_release);
+            }).detach();
+#if __cpp_exceptions
+    }
+    catch (const std::system_error&)
+    {
+        // get_tsc_hz will continue to refine its estimate on each call
+        estimating.store(false, std::memory_order_relaxed);
+    }
+#endif
+}
+
+XTR_FUNC
+xtr::detail::tsc_calibration& xtr::detail::tsc_calibration::instance() noexcept
+{
+    static tsc_calibration calibration;
+    return calibration;
+}
+
+XTR_FUNC
+void xtr::detail::start_tsc_calibration() noexcept
+{
+    tsc_calibration::instance();
+}
+
+XTR_FUNC
+std::uint64_t xtr::detail::calibrated_tsc_hz() noexcept
+{
+    return tsc_calibration::instance().tsc_hz.load(std::memory_order_acquire);
+}
+
+XTR_FUNC
+bool xtr::detail::estimating_tsc_hz() noexcept
+{
+    return tsc_calibration::instance().estimating.load(std::memory_order_acquire);
+}
+
+XTR_FUNC
+std::uint64_t xtr::detail::get_tsc_hz() noexcept
+{
+    const tsc_calibration& cal = tsc_calibration::instance();
+
+    if (const std::uint64_t hz = cal.tsc_hz.load(std::memory_order_acquire))
+        return hz;
+
+    // Calibration is in progress, estimate the frequency from the time
+    // elapsed since it began
+    const std::int64_t min_elapsed_nanos = 1000000;
+    const std::int64_t elapsed_nanos = monotonic_nanos() - cal.nanos0;
+    if (elapsed_nanos < min_elapsed_nanos)
+    {
+        std::this_thread::sleep_for(
+            std::chrono::nanoseconds(min_elapsed_nanos - elapsed_nanos));
+    }
+
+    return tsc_hz_since(cal.tsc0, cal.nanos0);
+}
+
+XTR_FUNC
+std::timespec xtr::detail::tsc::to_timespec(tsc ts)
+{
+    thread_local tsc_converter converter;
+
+    const auto total_nanos = std::uint64_t(converter.to_nanos(ts.ticks));
 
     std::timespec result;
     result.tv_sec = total_nanos / 1000000000UL;
@@ -170,4 +415,3 @@ std::timespec xtr::detail::tsc::to_timespec(tsc ts)
 
     return result;
 }
-
@@ -0,0 +1,150 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/tsc_converter.hpp"
+#include "xtr/detail/clock_ids.hpp"
+#include "xtr/detail/tsc.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include <time.h>
+
+XTR_FUNC
+void xtr::detail::tsc_converter::sample()
+{
+    // The wall clock is read between two reads of the TSC and paired with
+    // their midpoint. The narrowest of a few attempts is used, in case the
+    // thread was interrupted.
+    std::uint64_t window = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t ticks = 0;
+    std::int64_t nanos = 0;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const std::uint64_t tsc0 = tsc::now().ticks;
+        std::timespec ts;
+        ::clock_gettime(XTR_CLOCK_WALL, &ts);
+        const std::uint64_t tsc1 = tsc::now().ticks;
+        if (tsc1 - tsc0 < window)
+        {
+            window = tsc1 - tsc0;
+            ticks = tsc0 + window / 2;
+            nanos = ts.tv_sec * 1000000000L + ts.tv_nsec;
+        }
+    }
+
+    // Sample every 10ms while the TSC frequency is being calibrated, then
+    // every second
+    const std::uint64_t tsc_hz = get_tsc_hz();
+    const std::uint64_t interval_ticks =
+        calibrated_tsc_hz() != 0 ? tsc_hz : tsc_hz / 100;
+
+    add_sample(ticks, nanos, tsc_hz, interval_ticks);
+}
+
+XTR_FUNC
+void xtr::detail::tsc_converter::add_sample(
+    std::uint64_t ticks,
+    std::int64_t nanos,
+    std::uint64_t tsc_hz,
+    std::uint64_t interval_ticks) noexcept
+{
+    const sample_point s{ticks, nanos};
+    const double scale = double(std::uint64_t(1) << shift);
+
+    next_sample_ticks_ = ticks + interval_ticks;
+
+    if (nsamples_ == 0)
+    {
+        reset(s, 1e9 / double(tsc_hz));
+        return;
+    }
+
+    const std::int64_t current_nanos = convert(ticks);
+    const std::int64_t error = nanos - current_nanos;
+
+    if (error > max_slew_nanos || error < -max_slew_nanos)
+    {
+        // The wall clock has been stepped, or enough time has passed since
+        // the last sample that slewing would take too long
+        reset(s, double(mult_) / scale);
+        return;
+    }
+
+    samples_[nsamples_++ % max_samples] = s;
+
+    // Least-squares fit of the samples, relative to the new sample to avoid
+    // losing precision
+    const std::size_t n = sample_count();
+    double mean_x = 0;
+    double mean_y = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        mean_x += double(std::int64_t(samples_[i].ticks - ticks));
+        mean_y += double(samples_[i].nanos - nanos);
+    }
+    mean_x /= double(n);
+    mean_y /= double(n);
+
+    double sxx = 0;
+    double sxy = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const double dx =
+            double(std::int64_t(samples_[i].ticks - ticks)) - mean_x;
+        const double dy = double(samples_[i].nanos - nanos) - mean_y;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+
+    const double fitted_slope = sxx > 0 ? sxy / sxx : double(mult_) / scale;
+
+    // Choose the slope that takes the conversion from its current value at
+    // this sample to the fitted line at the next sample, limited so that the
+    // conversion remains monotonic
+    double slope = fitted_slope;
+    if (interval_ticks != 0)
+    {
+        const double x = double(interval_ticks);
+        const double fitted_y = mean_y + fitted_slope * (x - mean_x);
+        const double current_y = double(current_nanos - nanos);
+        slope =
+            std::clamp(
+                (fitted_y - current_y) / x,
+                fitted_slope * 0.9,
+                fitted_slope * 1.1);
+    }
+
+    base_ticks_ = ticks;
+    base_nanos_ = current_nanos;
+    mult_ = std::uint64_t(slope * scale);
+}
+
+XTR_FUNC
+void xtr::detail::tsc_converter::reset(
+    const sample_point& s, double nanos_per_tick) noexcept
+{
+    samples_[0] = s;
+    nsamples_ = 1;
+    base_ticks_ = s.ticks;
+    base_nanos_ = s.nanos;
+    mult_ = std::uint64_t(nanos_per_tick * double(std::uint64_t(1) << shift));
+}
@@ -0,0 +1,83 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/waiter.hpp"
+
+#include <ctime>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__FreeBSD__)
+#include <sys/types.h>
+#include <sys/umtx.h>
+#else
+#include <thread>
+#endif
+
+XTR_FUNC
+void xtr::detail::waiter::wait(std::chrono::microseconds timeout) noexcept
+{
+    using namespace std::chrono;
+    const auto sec = duration_cast<seconds>(timeout);
+    std::timespec ts{
+        .tv_sec=std::time_t(sec.count()),
+        .tv_nsec=long(duration_cast<nanoseconds>(timeout - sec).count())};
+    auto* const addr = reinterpret_cast<std::uint32_t*>(&sleeping_);
+
+    // Spurious wake-ups and errors (e.g. EAGAIN if already woken, EINTR)
+    // are harmless as the caller polls all sinks after waking
+#if defined(__linux__)
+    const int op = process_shared_ ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE;
+    ::syscall(SYS_futex, addr, op, 1, &ts, nullptr, 0);
+#elif defined(__FreeBSD__)
+    ::_umtx_op(
+        addr,
+        process_shared_ ? UMTX_OP_WAIT_UINT : UMTX_OP_WAIT_UINT_PRIVATE,
+        1,
+        reinterpret_cast<void*>(sizeof(ts)),
+        &ts);
+#else
+    (void)addr;
+    (void)ts;
+    std::this_thread::sleep_for(timeout);
+#endif
+
+    sleeping_.store(0, std::memory_order_relaxed);
+}
+
+XTR_FUNC
+void xtr::detail::waiter::wake() noexcept
+{
+    if (sleeping_.exchange(0, std::memory_order_relaxed) == 0)
+        return;
+
+    [[maybe_unused]] auto* const addr =
+        reinterpret_cast<std::uint32_t*>(&sleeping_);
+
+#if defined(__linux__)
+    const int op = process_shared_ ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE;
+    ::syscall(SYS_futex, addr, op, 1, nullptr, nullptr, 0);
+#elif defined(__FreeBSD__)
+    const int op = process_shared_ ? UMTX_OP_WAKE : UMTX_OP_WAKE_PRIVATE;
+    ::_umtx_op(addr, op, 1, nullptr, nullptr);
+#endif
+}
@@ -28,12 +28,20 @@
 #include "xtr/detail/file_descriptor.hpp"
 #include "xtr/detail/strzcpy.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <stdexcept>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 #include <getopt.h>
 
@@ -54,18 +62,39 @@ namespace
             "Available commands are:\n"
             "\n"
             "  status [pattern]             Displays sink statuses\n"
+            "  latency [pattern]            Displays sink producer latency statistics\n"
+            "  stats [pattern]              Displays sink and consumer throughput\n"
+            "                               statistics\n"
             "  level <level> [pattern]      Sets sink log levels. Valid levels are;\n"
             "                               fatal, error, warning, info, debug\n"
             "  reopen                       Reopens the log file\n"
+            "  callsites [pattern]          Displays log statements that have been\n"
+            "                               executed\n"
+            "  enable [pattern]             Enables log statements\n"
+            "  disable [pattern]            Disables log statements\n"
+            "  recover <directory>          Writes log records left in recovery files\n"
+            "                               in the given directory by processes that\n"
+            "                               have exited to the log\n"
             "\n"
-            "The pattern accepted by the status and level commands is by default a\n"
-            "regular expression. This can be modified by passing the following flags:\n"
+            "The pattern accepted by the status, latency, stats and level commands\n"
+            "is matched against sink names, and the pattern accepted by the\n"
+            "callsites, enable and disable commands is matched against log statement\n"
+            "locations in the form file:line. Patterns are by default regular\n"
+            "expressions. This can be modified by passing the following flags:\n"
             "\n"
             "  -E, --extended-regexp        Pattern is an extended regular expression\n"
             "  -G, --basic-regex            Pattern is a regular expression (the default)\n"
             "  -W, --wildcard               Pattern is a wildcard pattern\n"
             "\n"
-            "If no pattern is specified then the command applies to all sinks.\n";
+            "If no pattern is specified then the command applies to all sinks or log\n"
+            "statements. The enable and disable commands also apply to matching log\n"
+            "statements that are executed for the first time afterwards.\n"
+            "\n"
+            "The stats command also accepts the following flag:\n"
+            "\n"
+            "  -w, --watch[=<seconds>]      Display statistics every second (or every\n"
+            "                               <seconds> seconds), with rates calculated\n"
+            "                               over the interval\n";
 
         std::exit(status);
     }
@@ -99,6 +128,122 @@ namespace
             errx("Invalid frame length");
         return &static_cast<xtrd::frame<Payload>*>(buf)->payload;
     }
+
+    struct stats_sample
+    {
+        std::vector<xtrd::sink_stats> sinks;
+        xtrd::consumer_stats consumer{};
+    };
+
+    stats_sample query_stats(const char* path, const xtrd::frame<xtrd::stats>& sf)
+    {
+        const xtrd::file_descriptor fd = xtrd::command_connect(path);
+
+        if (!fd)
+            err("Failed to connect");
+
+        send(fd.get(), sf);
+
+        stats_sample sample;
+        xtrd::frame_buf buf;
+
+        while (const ::ssize_t nbytes = xtrd::command_recv(fd.get(), buf))
+        {
+            if (nbytes == -1)
+                err("Error reading from socket");
+
+            if (nbytes < ::ssize_t(sizeof(xtrd::frame_header)))
+                errx("Incomplete frame header");
+
+            switch (buf.hdr.frame_id)
+            {
+            case xtrd::sink_stats::frame_id:
+                sample.sinks.push_back(
+                    *frame_cast<xtrd::sink_stats>(&buf, std::size_t(nbytes)));
+                break;
+            case xtrd::consumer_stats::frame_id:
+                sample.consumer =
+                    *frame_cast<xtrd::consumer_stats>(&buf, std::size_t(nbytes));
+                break;
+            case xtrd::error::frame_id:
+                errx("Error: ", frame_cast<xtrd::error>(&buf, std::size_t(nbytes))->reason);
+            default:
+                errx("Invalid frame id");
+            }
+        }
+
+        std::sort(
+            sample.sinks.begin(),
+            sample.sinks.end(),
+            [](const auto& a, const auto& b)
+            {
+                return std::strcmp(a.name, b.name) < 0;
+            });
+
+        return sample;
+    }
+
+    // Rates are calculated over the interval since prev was sampled if prev
+    // is given, otherwise over the lifetime of the logger
+    void print_stats(const stats_sample& cur, const stats_sample* prev)
+    {
+        const auto delta =
+            [](std::uint64_t a, std::uint64_t b)
+            {
+                // Counts may go backwards if a sink was closed and re-opened
+                return a >= b ? a - b : a;
+            };
+
+        const xtrd::consumer_stats pc = prev ? prev->consumer : xtrd::consumer_stats{};
+        const double secs =
+            std::max(double(delta(cur.consumer.elapsed_ns, pc.elapsed_ns)) / 1e9, 1e-9);
+
+        std::cout << std::fixed << std::setprecision(1);
+
+        for (const auto& s : cur.sinks)
+        {
+            const xtrd::sink_stats* ps = nullptr;
+            if (prev != nullptr)
+            {
+                const auto pos =
+                    std::find_if(
+                        prev->sinks.begin(),
+                        prev->sinks.end(),
+                        [&](const auto& p) { return std::strcmp(p.name, s.name) == 0; });
+                if (pos != prev->sinks.end())
+                    ps = &*pos;
+            }
+
+            const std::uint64_t records =
+                delta(s.records_consumed, ps ? ps->records_consumed : 0);
+            const std::uint64_t bytes =
+                delta(s.bytes_consumed, ps ? ps->bytes_consumed : 0);
+
+            std::cout
+                << s.name << ": "
+                << s.records_consumed << " records ("
+                << double(records) / secs << "/s), "
+                << s.bytes_consumed / 1024 << "K consumed ("
+                << double(bytes) / 1024 / secs << "K/s), "
+                << s.buf_nbytes / 1024 << "K/"
+                << s.buf_capacity / 1024 << "K used ("
+                << s.peak_nbytes / 1024 << "K peak), "
+                << s.dropped_count << " dropped\n";
+        }
+
+        const auto percent =
+            [&](std::uint64_t cur_ns, std::uint64_t prev_ns)
+            {
+                return double(delta(cur_ns, prev_ns)) / 1e9 / secs * 100.0;
+            };
+
+        std::cout
+            << "Consumer: "
+            << percent(cur.consumer.format_ns, pc.format_ns) << "% formatting, "
+            << percent(cur.consumer.write_ns, pc.write_ns) << "% writing, "
+            << cur.consumer.flush_count << " flushes, "
+            << cur.consumer.sync_count << " syncs\n";
+    }
 }
 
 int main(int argc, char* argv[])
@@ -107,6 +252,7 @@ int main(int argc, char* argv[])
         {"extended-regexp", no_argument,       nullptr, 'E'},
         {"basic-regexp",    no_argument,       nullptr, 'G'},
         {"wildcard",        no_argument,       nullptr, 'W'},
+        {"watch",           optional_argument, nullptr, 'w'},
         {"help",            no_argument,       nullptr, 'h'},
         {nullptr,           0,                 nullptr,  0}};
 
@@ -114,7 +260,13 @@ int main(int argc, char* argv[])
     xtr::log_level_t log_level = xtr::log_level_t::none;
     xtrd::pattern_type_t pattern_type = xtrd::pattern_type_t::none;
     bool status = false;
+    bool latency = false;
+    bool stats = false;
+    std::optional<double> watch_interval;
     bool reopen = false;
+    bool callsites = false;
+    std::optional<bool> enable_callsites;
+    bool recover = false;
 
     std::map<std::string, xtr::log_level_t> levels_map{
         {"fatal", xtr::log_level_t::fatal},
@@ -134,10 +286,34 @@ int main(int argc, char* argv[])
     {
         status = true;
     }
+    else if (argv[1] == "latency"sv)
+    {
+        latency = true;
+    }
+    else if (argv[1] == "stats"sv)
+    {
+        stats = true;
+    }
     else if (argv[1] == "reopen"sv)
     {
         reopen = true;
     }
+    else if (argv[1] == "callsites"sv)
+    {
+        callsites = true;
+    }
+    else if (argv[1] == "enable"sv)
+    {
+        enable_callsites = true;
+    }
+    else if (argv[1] == "disable"sv)
+    {
+        enable_callsites = false;
+    }
+    else if (argv[1] == "recover"sv)
+    {
+        recover = true;
+    }
     else if (argv[1] == "level"sv)
     {
         if (argc < 3)
@@ -156,7 +332,7 @@ int main(int argc, char* argv[])
         usage(argv[0], EXIT_FAILURE, "Invalid command");
     }
 
-    while ((optc = getopt_long(argc, argv, "EGWh", long_options, nullptr)) != -1)
+    while ((optc = getopt_long(argc, argv, "EGWw::h", long_options, nullptr)) != -1)
     {
         switch (optc)
         {
@@ -169,6 +345,13 @@ int main(int argc, char* argv[])
         case 'W':
             pattern_type = xtrd::pattern_type_t::wildcard;
             break;
+        case 'w':
+            if (!stats)
+                usage(argv[0], EXIT_FAILURE, "Watch is only valid for the stats command");
+            watch_interval = optarg != nullptr ? std::strtod(optarg, nullptr) : 1.0;
+            if (!(*watch_interval > 0.0))
+                usage(argv[0], EXIT_FAILURE, "Invalid watch interval");
+            break;
         case 'h':
             usage(argv[0], EXIT_SUCCESS);
         case '?':
@@ -195,12 +378,41 @@ int main(int argc, char* argv[])
         path = argv[optind];
     }
 
+    if (recover && pattern == nullptr)
+        usage(argv[0], EXIT_FAILURE, "Please specify a recovery directory");
+
     if (pattern_type != xtrd::pattern_type_t::none && pattern == nullptr)
         usage(argv[0], EXIT_FAILURE, "Pattern type specified, but no pattern given");
 
     if (pattern != nullptr && pattern_type == xtrd::pattern_type_t::none)
         pattern_type = xtrd::pattern_type_t::basic_regex;
 
+    if (stats)
+    {
+        xtrd::frame<xtrd::stats> sf;
+        if (pattern != nullptr)
+        {
+            sf->pattern.type = pattern_type;
+            xtrd::strzcpy(sf->pattern.text, std::string_view{pattern});
+        }
+
+        std::optional<stats_sample> prev;
+
+        for (;;)
+        {
+            stats_sample sample = query_stats(path, sf);
+            print_stats(sample, prev ? &*prev : nullptr);
+
+            if (!watch_interval)
+                return EXIT_SUCCESS;
+
+            std::cout << std::endl;
+            prev = std::move(sample);
+            std::this_thread::sleep_for(
+                std::chrono::duration<double>(*watch_interval));
+        }
+    }
+
     const xtrd::file_descriptor fd = xtrd::command_connect(path);
 
     if (!fd)
@@ -218,6 +430,16 @@ int main(int argc, char* argv[])
         if (nwritten != sizeof(st))
             err("Error writing to socket");
     }
+    else if (latency)
+    {
+        xtrd::frame<xtrd::latency> lt;
+        if (pattern != nullptr)
+        {
+            lt->pattern.type = pattern_type;
+            xtrd::strzcpy(lt->pattern.text, std::string_view{pattern});
+        }
+        send(fd.get(), lt);
+    }
     else if (log_level != xtr::log_level_t::none)
     {
         xtrd::frame<xtrd::set_level> sl;
@@ -234,8 +456,43 @@ int main(int argc, char* argv[])
         xtrd::frame<xtrd::reopen> rot;
         send(fd.get(), rot);
     }
+    else if (callsites)
+    {
+        xtrd::frame<xtrd::callsites> cs;
+        if (pattern != nullptr)
+        {
+            cs->pattern.type = pattern_type;
+            xtrd::strzcpy(cs->pattern.text, std::string_view{pattern});
+        }
+        send(fd.get(), cs);
+    }
+    else if (enable_callsites)
+    {
+        xtrd::frame<xtrd::set_callsite> sc;
+        sc->enabled = *enable_callsites;
+        if (pattern != nullptr)
+        {
+            sc->pattern.type = pattern_type;
+            xtrd::strzcpy(sc->pattern.text, std::string_view{pattern});
+        }
+        send(fd.get(), sc);
+    }
+    else if (recover)
+    {
+        // The directory is opened by the logged process, so is made absolute
+        char dir[PATH_MAX];
+        if (::realpath(pattern, dir) == nullptr)
+            err("Failed to resolve `", pattern, "'");
+        if (std::strlen(dir) >= sizeof(xtrd::recover::path))
+            errx("Recovery directory path is too long");
+        xtrd::frame<xtrd::recover> rc;
+        xtrd::strzcpy(rc->path, std::string_view{dir});
+        send(fd.get(), rc);
+    }
 
     std::vector<xtrd::sink_info> infos;
+    std::vector<xtrd::callsite_info> callsite_infos;
+    std::vector<xtrd::sink_latency> latencies;
     xtrd::frame_buf buf;
 
     while (const ::ssize_t nbytes = xtrd::command_recv(fd.get(), buf))
@@ -251,6 +508,14 @@ int main(int argc, char* argv[])
         case xtrd::sink_info::frame_id:
             infos.push_back(*frame_cast<xtrd::sink_info>(&buf, std::size_t(nbytes)));
             break;
+        case xtrd::sink_latency::frame_id:
+            latencies.push_back(
+                *frame_cast<xtrd::sink_latency>(&buf, std::size_t(nbytes)));
+            break;
+        case xtrd::callsite_info::frame_id:
+            callsite_infos.push_back(
+                *frame_cast<xtrd::callsite_info>(&buf, std::size_t(nbytes)));
+            break;
         case xtrd::success::frame_id:
             std::cout << "Success\n";
             break;
@@ -261,17 +526,33 @@ int main(int argc, char* argv[])
         }
     }
 
-    std::sort(
-        infos.begin(),
-        infos.end(),
+    const auto by_name =
         [](const auto& a, const auto& b)
         {
             return std::strcmp(a.name, b.name) < 0;
+        };
+
+    std::sort(infos.begin(), infos.end(), by_name);
+    std::sort(latencies.begin(), latencies.end(), by_name);
+
+    std::sort(
+        callsite_infos.begin(),
+        callsite_infos.end(),
+        [](const auto& a, const auto& b)
+        {
+            const int cmp = std::strcmp(a.file, b.file);
+            return cmp < 0 || (cmp == 0 && a.line < b.line);
         });
 
     for (const auto& info : infos)
         std::cout << info << "\n";
 
+    for (const auto& lat : latencies)
+        std::cout << lat << "\n";
+
+    for (const auto& ci : callsite_infos)
+        std::cout << ci << "\n";
+
     return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,178 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/binary_decoder.hpp"
+#include "xtr/detail/file_descriptor.hpp"
+#include "xtr/detail/retry.hpp"
+#include "xtr/log_level.hpp"
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    [[noreturn]] void usage(
+        const char* progname,
+        int status,
+        const char* reason = nullptr)
+    {
+        if (reason != nullptr)
+            std::cout << reason << "\n\n";
+
+        (status ? std::cerr : std::cout)
+            << "Usage: " << progname << " [--help] [options] [file...]\n"
+            "Decodes binary log files written by the xtr logger, writing the\n"
+            "decoded log to standard output. If no files are given, or if a\n"
+            "file is -, standard input is decoded.\n"
+            "\n"
+            "  -s, --systemd                Use the systemd log level style\n"
+            "  -h, --help                   Displays this help message\n";
+
+        std::exit(status);
+    }
+
+    template<typename... Args>
+    [[noreturn]] void errx(Args&&... args)
+    {
+        (std::cerr << ... << args) << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    template<typename... Args>
+    [[noreturn]] void err(Args&&... args)
+    {
+        const int errnum = errno;
+        errx(std::forward<Args>(args)..., ": ", std::strerror(errnum));
+    }
+
+    void decode(int fd, const char* path, xtr::log_level_style_t lstyle)
+    {
+        xtrd::binary_decoder decoder(lstyle);
+        std::vector<char> buf(64 * 1024);
+        std::size_t nbuffered = 0;
+        fmt::memory_buffer mbuf;
+
+        for (;;)
+        {
+            // Grow the buffer if a single record does not fit into it
+            if (nbuffered == buf.size())
+                buf.resize(buf.size() * 2);
+
+            const ::ssize_t nread =
+                XTR_TEMP_FAILURE_RETRY(
+                    ::read(fd, buf.data() + nbuffered, buf.size() - nbuffered));
+
+            if (nread == -1)
+                err(path, ": Error reading file");
+
+            if (nread == 0)
+                break;
+
+            nbuffered += std::size_t(nread);
+
+            std::size_t nconsumed = 0;
+#if __cpp_exceptions
+            try
+            {
+#endif
+                nconsumed = decoder.decode(buf.data(), nbuffered, mbuf);
+#if __cpp_exceptions
+            }
+            catch (const std::runtime_error& e)
+            {
+                errx(path, ": ", e.what());
+            }
+#endif
+
+            std::memmove(buf.data(), buf.data() + nconsumed, nbuffered - nconsumed);
+            nbuffered -= nconsumed;
+
+            if (std::fwrite(mbuf.data(), 1, mbuf.size(), stdout) != mbuf.size())
+                err("Error writing to standard output");
+            mbuf.clear();
+        }
+
+        if (nbuffered != 0)
+            errx(path, ": File ends with an incomplete record");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const struct option long_options[] = {
+        {"systemd", no_argument,       nullptr, 's'},
+        {"help",    no_argument,       nullptr, 'h'},
+        {nullptr,   0,                 nullptr,  0}};
+
+    int optc;
+    xtr::log_level_style_t lstyle = xtr::default_log_level_style;
+
+    while ((optc = getopt_long(argc, argv, "sh", long_options, nullptr)) != -1)
+    {
+        switch (optc)
+        {
+        case 's':
+            lstyle = xtr::systemd_log_level_style;
+            break;
+        case 'h':
+            usage(argv[0], EXIT_SUCCESS);
+        case '?':
+            usage(argv[0], EXIT_FAILURE);
+        }
+    }
+
+    using namespace std::literals::string_view_literals;
+
+    if (optind == argc)
+        decode(STDIN_FILENO, "-", lstyle);
+
+    for (int i = optind; i < argc; ++i)
+    {
+        if (argv[i] == "-"sv)
+        {
+            decode(STDIN_FILENO, argv[i], lstyle);
+            continue;
+        }
+
+        const xtrd::file_descriptor fd(
+            XTR_TEMP_FAILURE_RETRY(::open(argv[i], O_RDONLY)));
+
+        if (!fd)
+            err(argv[i], ": Failed to open file");
+
+        decode(fd.get(), argv[i], lstyle);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/binary_decoder.hpp"
+#include "xtr/detail/binary_encoder.hpp"
+#include "xtr/timespec.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    struct fixture
+    {
+        fixture()
+        {
+            std::timespec ts;
+            ts.tv_sec = 946688523;
+            ts.tv_nsec = 123456789;
+            encode(
+                "{}{} {}: {} {}\n",
+                xtr::log_level_t::warning,
+                xtr::timespec(ts),
+                42,
+                std::string_view("Test"));
+        }
+
+        // Appends a record to encoded_, returning the size of the record
+        template<typename... Args>
+        std::size_t encode(
+            std::string_view fmt,
+            xtr::log_level_t level,
+            xtr::timespec ts,
+            const Args&... args)
+        {
+            fmt::memory_buffer mbuf;
+            encoder_.encode(mbuf, fmt, level, ts, name_, args...);
+            encoded_.append(mbuf.data(), mbuf.size());
+            return mbuf.size();
+        }
+
+        std::size_t decode(std::string_view buf)
+        {
+            return decoder_.decode(buf.data(), buf.size(), decoded_);
+        }
+
+        std::string decoded() const
+        {
+            return std::string(decoded_.data(), decoded_.size());
+        }
+
+        const std::string name_ = "Name";
+        xtrd::binary_encoder encoder_;
+        xtrd::binary_decoder decoder_;
+        std::string encoded_;
+        fmt::memory_buffer decoded_;
+    };
+}
+
+TEST_CASE_METHOD(fixture, "binary_decoder decode test", "[binary_decoder]")
+{
+    REQUIRE(decode(encoded_) == encoded_.size());
+    REQUIRE(decoded() == "W 2000-01-01 01:02:03.123456 Name: 42 Test\n");
+}
+
+TEST_CASE_METHOD(fixture, "binary_decoder incomplete record test", "[binary_decoder]")
+{
+    for (std::size_t n = 0; n < encoded_.size(); ++n)
+    {
+        xtrd::binary_decoder decoder;
+        REQUIRE(decoder.decode(encoded_.data(), n, decoded_) <= n);
+        REQUIRE(decoded_.size() == 0);
+    }
+}
+
+TEST_CASE_METHOD(fixture, "binary_decoder reset test", "[binary_decoder]")
+{
+    // Format records are only written the first time a format is used
+    const char* const fmt = "Other {}{} {}\n";
+    const std::size_t size = encode(fmt, xtr::log_level_t::info, {});
+    REQUIRE(encode(fmt, xtr::log_level_t::info, {}) < size);
+
+    // Following a reset the header and format records are written again
+    encoder_.reset();
+    REQUIRE(encode(fmt, xtr::log_level_t::info, {}) > size);
+
+    REQUIRE(decode(encoded_) == encoded_.size());
+    REQUIRE(
+        decoded() ==
+            "W 2000-01-01 01:02:03.123456 Name: 42 Test\n"
+            "Other I 1970-01-01 00:00:00.000000 Name\n"
+            "Other I 1970-01-01 00:00:00.000000 Name\n"
+            "Other I 1970-01-01 00:00:00.000000 Name\n");
+}
+
+#if __cpp_exceptions
+TEST_CASE_METHOD(fixture, "binary_decoder invalid record test", "[binary_decoder]")
+{
+    encoded_[0] = 'Q';
+    REQUIRE_THROWS_WITH(decode(encoded_), "Invalid record type");
+}
+
+TEST_CASE_METHOD(fixture, "binary_decoder invalid version test", "[binary_decoder]")
+{
+    encoded_[4] = char(0xFF);
+    REQUIRE_THROWS_WITH(decode(encoded_), "Unsupported version or byte order");
+}
+
+TEST_CASE_METHOD(fixture, "binary_decoder undefined format test", "[binary_decoder]")
+{
+    const char* const fmt = "{}{} {}\n";
+    encode(fmt, xtr::log_level_t::info, {});
+    const std::size_t size = encode(fmt, xtr::log_level_t::info, {});
+    // The last record refers to a format that has not been read
+    REQUIRE_THROWS_WITH(
+        decode(std::string_view(encoded_).substr(encoded_.size() - size)),
+        "Undefined format id");
+}
+
+TEST_CASE_METHOD(fixture, "binary_decoder format error test", "[binary_decoder]")
+{
+    encode("{}{} {}: {:s}\n", xtr::log_level_t::info, {}, 42);
+    REQUIRE(decode(encoded_) == encoded_.size());
+    REQUIRE_THAT(
+        decoded(),
+        Catch::Matchers::StartsWith("W 2000-01-01 01:02:03.123456 Name: 42 Test\n"
+            "E 1970-01-01 00:00:00.000000 Name: Error: "));
+}
+#endif
@@ -0,0 +1,156 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/callsite.hpp"
+#include "xtr/detail/callsite_registry.hpp"
+#include "xtr/detail/commands/pattern.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <string_view>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    xtrd::pattern make_pattern(xtrd::pattern_type_t type, const char* text)
+    {
+        xtrd::pattern pat{};
+        pat.type = type;
+        std::strcpy(pat.text, text);
+        return pat;
+    }
+
+    bool is_registered(const xtrd::callsite& cs)
+    {
+        bool found = false;
+        xtrd::for_each_callsite(
+            [&](const xtrd::callsite& c)
+            {
+                found = found || &c == &cs;
+            });
+        return found;
+    }
+}
+
+TEST_CASE("callsite registration test", "[callsite]")
+{
+    static constinit xtrd::callsite cs{
+        "dir/registration.cpp", 10, xtr::log_level_t::info, "Test {}"};
+
+    REQUIRE(!is_registered(cs));
+    REQUIRE(cs.enabled());
+    REQUIRE(is_registered(cs));
+    REQUIRE(!cs.disabled());
+    REQUIRE(cs.enabled());
+
+    REQUIRE(cs.file() == std::string_view{"dir/registration.cpp"});
+    REQUIRE(cs.line() == 10);
+    REQUIRE(cs.level() == xtr::log_level_t::info);
+    REQUIRE(cs.format() == std::string_view{"Test {}"});
+}
+
+TEST_CASE("callsite set enabled test", "[callsite]")
+{
+    static constinit xtrd::callsite cs1{
+        "dir/set_enabled.cpp", 1, xtr::log_level_t::info, "Test"};
+    static constinit xtrd::callsite cs2{
+        "dir/set_enabled.cpp", 2, xtr::log_level_t::error, "Test"};
+
+    REQUIRE(cs1.enabled());
+    REQUIRE(cs2.enabled());
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/set_enabled.cpp:1"),
+        false);
+    REQUIRE(!cs1.enabled());
+    REQUIRE(cs1.disabled());
+    REQUIRE(cs2.enabled());
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/set_enabled.cpp:*"),
+        false);
+    REQUIRE(!cs1.enabled());
+    REQUIRE(!cs2.enabled());
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::basic_regex, "set_enabled\\.cpp:2$"),
+        true);
+    REQUIRE(!cs1.enabled());
+    REQUIRE(cs2.enabled());
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/set_enabled.cpp:*"),
+        true);
+    REQUIRE(cs1.enabled());
+    REQUIRE(cs2.enabled());
+}
+
+TEST_CASE("callsite set enabled before registration test", "[callsite]")
+{
+    static constinit xtrd::callsite cs1{
+        "dir/unregistered.cpp", 1, xtr::log_level_t::info, "Test"};
+    static constinit xtrd::callsite cs2{
+        "dir/unregistered.cpp", 2, xtr::log_level_t::info, "Test"};
+    static constinit xtrd::callsite cs3{
+        "dir/unregistered.cpp", 3, xtr::log_level_t::info, "Test"};
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/unregistered.cpp:*"),
+        false);
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/unregistered.cpp:2"),
+        true);
+
+    // The most recent matching pattern takes effect on registration
+    REQUIRE(!cs1.enabled());
+    REQUIRE(cs2.enabled());
+    REQUIRE(is_registered(cs1));
+    REQUIRE(is_registered(cs2));
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/unregistered.cpp:*"),
+        true);
+    REQUIRE(cs1.enabled());
+    REQUIRE(cs3.enabled());
+}
+
+TEST_CASE("callsite repeated pattern test", "[callsite]")
+{
+    static constinit xtrd::callsite cs1{
+        "dir/repeated.cpp", 1, xtr::log_level_t::info, "Test"};
+    static constinit xtrd::callsite cs2{
+        "dir/repeated.cpp", 2, xtr::log_level_t::info, "Test"};
+
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/repeated.cpp:*"),
+        false);
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/repeated.cpp:1"),
+        true);
+    xtrd::set_callsites_enabled(
+        make_pattern(xtrd::pattern_type_t::wildcard, "*/repeated.cpp:*"),
+        false);
+
+    // The repeated pattern replaces the original, becoming the most recent
+    REQUIRE(!cs1.enabled());
+    REQUIRE(!cs2.enabled());
+}
@@ -0,0 +1,129 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/compiled_format.hpp"
+#include "xtr/detail/string.hpp"
+#include "xtr/detail/string_ref.hpp"
+#include "xtr/timespec.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    struct custom {};
+
+    constexpr auto plain = xtr::detail::string{"{} {}"};
+    constexpr auto specs = xtr::detail::string{"{:>4} {{:}} {}"};
+    constexpr auto escaped = xtr::detail::string{"{{:}} {}"};
+
+    using plain_format = xtr::detail::compiled_format<&plain>;
+    using specs_format = xtr::detail::compiled_format<&specs>;
+
+    using str_ref = xtr::detail::string_ref<const char*>;
+}
+
+template<>
+struct fmt::formatter<custom>
+{
+    template<typename ParseContext>
+    constexpr auto parse(ParseContext& ctx)
+    {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(custom, FormatContext& ctx)
+    {
+        return fmt::format_to(ctx.out(), "custom");
+    }
+};
+
+TEST_CASE("compiled_format has_format_specs test", "[compiled_format]")
+{
+    static_assert(!xtr::detail::has_format_specs(plain));
+    static_assert(xtr::detail::has_format_specs(specs));
+    static_assert(!xtr::detail::has_format_specs(escaped));
+    static_assert(xtr::detail::has_format_specs("{0:x}"));
+    static_assert(!xtr::detail::has_format_specs("{0}"));
+}
+
+#if defined(XTR_USE_COMPILED_FORMAT)
+TEST_CASE("compiled_format selection test", "[compiled_format]")
+{
+    using xtr::detail::use_compiled_format_v;
+
+    // Run-time format strings are never compiled
+    static_assert(!use_compiled_format_v<std::string_view, int, int>);
+
+    // Built-in types are always compiled
+    static_assert(use_compiled_format_v<plain_format, int, const char*>);
+    static_assert(use_compiled_format_v<specs_format, int, std::string>);
+
+    // XTR's own types are compiled unless the format string has specs
+    static_assert(use_compiled_format_v<plain_format, int, str_ref>);
+    static_assert(use_compiled_format_v<plain_format, xtr::timespec, int>);
+    static_assert(!use_compiled_format_v<specs_format, int, str_ref>);
+
+    // User defined types are formatted at run time
+    static_assert(!use_compiled_format_v<plain_format, int, custom>);
+}
+
+TEST_CASE("compiled_format builtin types test", "[compiled_format]")
+{
+    using xtr::detail::is_builtin_format_arg_v;
+
+    static_assert(is_builtin_format_arg_v<int>);
+    static_assert(is_builtin_format_arg_v<const double&>);
+    static_assert(is_builtin_format_arg_v<bool>);
+    static_assert(is_builtin_format_arg_v<char>);
+    static_assert(is_builtin_format_arg_v<const char*>);
+    static_assert(is_builtin_format_arg_v<std::string>);
+    static_assert(is_builtin_format_arg_v<std::string_view>);
+    static_assert(is_builtin_format_arg_v<const void*>);
+
+    static_assert(!is_builtin_format_arg_v<wchar_t>);
+    static_assert(!is_builtin_format_arg_v<custom>);
+    static_assert(!is_builtin_format_arg_v<str_ref>);
+    static_assert(!is_builtin_format_arg_v<xtr::timespec>);
+}
+
+TEST_CASE("compiled_format format test", "[compiled_format]")
+{
+    fmt::memory_buffer mbuf;
+    fmt::format_to(std::back_inserter(mbuf), plain_format{}, 42, str_ref{"str"});
+    REQUIRE(std::string(mbuf.data(), mbuf.size()) == "42 str");
+
+    mbuf.clear();
+    fmt::format_to(std::back_inserter(mbuf), specs_format{}, 42, "str");
+    REQUIRE(std::string(mbuf.data(), mbuf.size()) == "  42 {:} str");
+}
+#endif
+
+TEST_CASE("compiled_format conversion test", "[compiled_format]")
+{
+    REQUIRE(std::string_view(plain_format{}) == "{} {}");
+    REQUIRE(std::string_view(plain_format{}).data() == plain.str);
+}
@@ -0,0 +1,237 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if defined(XTR_ENABLE_ZLIB)
+
+#include "xtr/detail/gzip_file.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    struct decompressed
+    {
+        std::string data;
+        bool complete; // True if the last gzip member is finished
+    };
+
+    struct fixture
+    {
+        fixture()
+        {
+            const int fd = ::mkstemp(path_);
+            REQUIRE(fd != -1);
+            ::close(fd);
+        }
+
+        ~fixture()
+        {
+            ::unlink(path_);
+        }
+
+        std::string contents() const
+        {
+            std::ifstream ifs(path_);
+            return
+                std::string(
+                    std::istreambuf_iterator<char>(ifs),
+                    std::istreambuf_iterator<char>());
+        }
+
+        // Decompresses the file, which may contain multiple gzip members
+        decompressed decompress() const
+        {
+            std::string in = contents();
+            decompressed result{{}, false};
+
+            ::z_stream zs{};
+            REQUIRE(::inflateInit2(&zs, MAX_WBITS + 16) == Z_OK);
+            zs.next_in = reinterpret_cast<Bytef*>(in.data());
+            zs.avail_in = uInt(in.size());
+
+            for (;;)
+            {
+                char out[4096];
+                zs.next_out = reinterpret_cast<Bytef*>(out);
+                zs.avail_out = sizeof(out);
+                const int ret = ::inflate(&zs, Z_NO_FLUSH);
+                result.data.append(out, sizeof(out) - zs.avail_out);
+                if (ret == Z_STREAM_END)
+                {
+                    if (zs.avail_in == 0)
+                    {
+                        result.complete = true;
+                        break;
+                    }
+                    REQUIRE(::inflateReset(&zs) == Z_OK);
+                    continue;
+                }
+                // Input exhausted part way through a member
+                if (ret == Z_BUF_ERROR || (zs.avail_in == 0 && zs.avail_out != 0))
+                    break;
+                REQUIRE(ret == Z_OK);
+            }
+
+            ::inflateEnd(&zs);
+            return result;
+        }
+
+        char path_[32] = "/tmp/xtr.test.XXXXXX";
+    };
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file write test", "[gzip_file]")
+{
+    std::string expected;
+
+    {
+        xtrd::gzip_file f(path_);
+
+        for (std::size_t i = 0; i < 1000; ++i)
+        {
+            const std::string s = "Test " + std::to_string(i) + "\n";
+            REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+            expected += s;
+            if (i % 100 == 0)
+                f.flush();
+            if (i % 500 == 0)
+                f.sync();
+        }
+    }
+
+    const decompressed d = decompress();
+    REQUIRE(d.data == expected);
+    REQUIRE(d.complete);
+    REQUIRE(contents().size() < expected.size());
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file large write test", "[gzip_file]")
+{
+    // Compresses to more than one output buffer
+    std::string s;
+    for (std::size_t i = 0; s.size() < 4 * xtrd::gzip_file::buffer_size; ++i)
+        s += std::to_string(i * 7919 % 104729);
+
+    {
+        xtrd::gzip_file f(path_);
+        REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+    }
+
+    REQUIRE(decompress().data == s);
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file flush test", "[gzip_file]")
+{
+    xtrd::gzip_file f(path_);
+
+    REQUIRE(f.write("Hello\n", 6) == 6);
+    // Compressed data is buffered until flushed
+    REQUIRE(contents().empty());
+
+    f.flush();
+    // After a flush all data written can be decompressed, although the
+    // member is unfinished
+    decompressed d = decompress();
+    REQUIRE(d.data == "Hello\n");
+    REQUIRE(!d.complete);
+
+    // Flushing again without writing does not change the file
+    const std::size_t size = contents().size();
+    f.flush();
+    REQUIRE(contents().size() == size);
+
+    f.sync();
+    d = decompress();
+    REQUIRE(d.data == "Hello\n");
+    REQUIRE(d.complete);
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file append test", "[gzip_file]")
+{
+    {
+        xtrd::gzip_file f(path_);
+        REQUIRE(f.write("Hello ", 6) == 6);
+    }
+
+    {
+        xtrd::gzip_file f(path_);
+        REQUIRE(f.write("world", 5) == 5);
+    }
+
+    const decompressed d = decompress();
+    REQUIRE(d.data == "Hello world");
+    REQUIRE(d.complete);
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file reopen test", "[gzip_file]")
+{
+    xtrd::gzip_file f(path_);
+    REQUIRE(f.write("Before", 6) == 6);
+    REQUIRE(::unlink(path_) == 0);
+    REQUIRE(f.reopen());
+    REQUIRE(f.write("After", 5) == 5);
+    f.close();
+
+    const decompressed d = decompress();
+    REQUIRE(d.data == "After");
+    REQUIRE(d.complete);
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file close test", "[gzip_file]")
+{
+    xtrd::gzip_file f(path_);
+    REQUIRE(f.write("Test", 4) == 4);
+    f.close();
+    REQUIRE(decompress().data == "Test");
+
+    errno = 0;
+    REQUIRE(f.write("Test", 4) == -1);
+    REQUIRE(errno == EBADF);
+}
+
+#if __cpp_exceptions
+TEST_CASE("gzip_file open error test", "[gzip_file]")
+{
+    REQUIRE_THROWS_AS(
+        xtrd::gzip_file("/nonexistent/xtr.test"),
+        std::system_error);
+}
+
+TEST_CASE_METHOD(fixture, "gzip_file level error test", "[gzip_file]")
+{
+    REQUIRE_THROWS_AS(xtrd::gzip_file(path_, 10), std::invalid_argument);
+}
+#endif
+
+#endif
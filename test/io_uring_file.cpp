@@ -0,0 +1,143 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/io_uring_file.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    struct fixture
+    {
+        fixture()
+        {
+            const int fd = ::mkstemp(path_);
+            REQUIRE(fd != -1);
+            ::close(fd);
+        }
+
+        ~fixture()
+        {
+            ::unlink(path_);
+        }
+
+        std::string contents(const char* path = nullptr) const
+        {
+            std::ifstream ifs(path == nullptr ? path_ : path);
+            return
+                std::string(
+                    std::istreambuf_iterator<char>(ifs),
+                    std::istreambuf_iterator<char>());
+        }
+
+        char path_[32] = "/tmp/xtr.test.XXXXXX";
+    };
+}
+
+TEST_CASE_METHOD(fixture, "io_uring_file write test", "[io_uring_file]")
+{
+    std::string expected;
+
+    {
+        // Small buffers so that writes are split and buffers are reused
+        xtrd::io_uring_file f(path_, 4, 16);
+
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            const std::string s(i, char('a' + i % 26));
+            REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+            expected += s;
+            if (i % 10 == 0)
+                f.sync();
+            f.flush();
+        }
+    }
+
+    REQUIRE(contents() == expected);
+}
+
+TEST_CASE_METHOD(fixture, "io_uring_file append test", "[io_uring_file]")
+{
+    {
+        xtrd::io_uring_file f(path_);
+        REQUIRE(f.write("Hello ", 6) == 6);
+    }
+
+    {
+        xtrd::io_uring_file f(path_);
+        REQUIRE(f.write("world", 5) == 5);
+    }
+
+    REQUIRE(contents() == "Hello world");
+}
+
+TEST_CASE_METHOD(fixture, "io_uring_file reopen test", "[io_uring_file]")
+{
+    char rotated_path[64];
+    std::snprintf(rotated_path, sizeof(rotated_path), "%s.1", path_);
+
+    {
+        xtrd::io_uring_file f(path_);
+        REQUIRE(f.write("Before", 6) == 6);
+        f.sync();
+        // Rename while the write may still be in progress
+        REQUIRE(::rename(path_, rotated_path) == 0);
+        REQUIRE(f.reopen());
+        REQUIRE(f.write("After", 5) == 5);
+    }
+
+    REQUIRE(contents(rotated_path) == "Before");
+    REQUIRE(contents() == "After");
+
+    ::unlink(rotated_path);
+}
+
+TEST_CASE_METHOD(fixture, "io_uring_file close test", "[io_uring_file]")
+{
+    xtrd::io_uring_file f(path_);
+    REQUIRE(f.write("Test", 4) == 4);
+    f.close();
+    REQUIRE(contents() == "Test");
+
+    errno = 0;
+    REQUIRE(f.write("Test", 4) == -1);
+    REQUIRE(errno == EBADF);
+}
+
+#if __cpp_exceptions
+TEST_CASE("io_uring_file open error test", "[io_uring_file]")
+{
+    REQUIRE_THROWS_AS(
+        xtrd::io_uring_file("/nonexistent/xtr.test"),
+        std::system_error);
+}
+#endif
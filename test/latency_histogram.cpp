@@ -0,0 +1,115 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/latency_histogram.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <limits>
+
+namespace xtrd = xtr::detail;
+
+TEST_CASE("latency_histogram bucket bounds", "[latency_histogram]")
+{
+    using h = xtrd::latency_histogram;
+
+    // Buckets are contiguous and cover the full range of values
+    REQUIRE(h::bucket_lowest(0) == 0);
+    for (std::size_t i = 1; i < h::bucket_count; ++i)
+        REQUIRE(h::bucket_lowest(i) == h::bucket_highest(i - 1) + 1);
+    REQUIRE(
+        h::bucket_highest(h::bucket_count - 1) ==
+        std::numeric_limits<std::uint64_t>::max());
+
+    // Values are placed into the bucket that covers them
+    for (std::size_t i = 0; i < h::bucket_count; ++i)
+    {
+        REQUIRE(h::bucket_index(h::bucket_lowest(i)) == i);
+        REQUIRE(h::bucket_index(h::bucket_highest(i)) == i);
+    }
+}
+
+TEST_CASE("latency_histogram precision", "[latency_histogram]")
+{
+    using h = xtrd::latency_histogram;
+
+    for (std::size_t i = 0; i < h::bucket_count; ++i)
+    {
+        const std::uint64_t width = h::bucket_highest(i) - h::bucket_lowest(i);
+        REQUIRE(width <= h::bucket_lowest(i) / h::sub_bucket_count);
+    }
+}
+
+TEST_CASE("latency_histogram empty", "[latency_histogram]")
+{
+    xtrd::latency_histogram h;
+
+    REQUIRE(h.count() == 0);
+    REQUIRE(h.max() == 0);
+    REQUIRE(h.value_at_percentile(50.0) == 0);
+    REQUIRE(h.value_at_percentile(100.0) == 0);
+}
+
+TEST_CASE("latency_histogram percentiles", "[latency_histogram]")
+{
+    xtrd::latency_histogram h;
+
+    for (std::uint64_t i = 1; i <= 10000; ++i)
+        h.record(i);
+
+    REQUIRE(h.count() == 10000);
+    REQUIRE(h.max() == 10000);
+
+    // Percentiles are accurate to within the bucket precision
+    const auto check =
+        [&](double percentile, std::uint64_t expected)
+        {
+            const std::uint64_t value = h.value_at_percentile(percentile);
+            REQUIRE(value >= expected);
+            REQUIRE(value <= expected + expected / h.sub_bucket_count);
+        };
+
+    check(0.0, 1);
+    check(1.0, 100);
+    check(50.0, 5000);
+    check(90.0, 9000);
+    check(99.0, 9900);
+    check(99.9, 9990);
+    check(100.0, 10000);
+
+    // The highest percentile never exceeds the largest recorded value
+    REQUIRE(h.value_at_percentile(100.0) == 10000);
+}
+
+TEST_CASE("latency_histogram outlier", "[latency_histogram]")
+{
+    xtrd::latency_histogram h;
+
+    for (std::size_t i = 0; i < 999; ++i)
+        h.record(100);
+    h.record(std::numeric_limits<std::uint64_t>::max());
+
+    REQUIRE(h.count() == 1000);
+    REQUIRE(
+        h.value_at_percentile(99.0) ==
+        h.bucket_highest(h.bucket_index(100)));
+    REQUIRE(h.value_at_percentile(100.0) == std::numeric_limits<std::uint64_t>::max());
+}
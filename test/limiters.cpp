@@ -0,0 +1,95 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/limiters.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+
+namespace xtrd = xtr::detail;
+
+TEST_CASE("every_n_limiter test", "[limiters]")
+{
+    xtrd::every_n_limiter l;
+    for (std::size_t i = 0; i < 20; ++i)
+        REQUIRE(l.allow(5) == (i % 5 == 0));
+    REQUIRE(l.suppressed() == 0);
+
+    xtrd::every_n_limiter l1;
+    for (std::size_t i = 0; i < 5; ++i)
+        REQUIRE(l1.allow(1));
+}
+
+TEST_CASE("first_n_limiter test", "[limiters]")
+{
+    xtrd::first_n_limiter l;
+    for (std::size_t i = 0; i < 20; ++i)
+        REQUIRE(l.allow(3) == (i < 3));
+    REQUIRE(l.suppressed() == 0);
+
+    xtrd::first_n_limiter l0;
+    REQUIRE(!l0.allow(0));
+}
+
+TEST_CASE("rate_limiter burst test", "[limiters]")
+{
+    constexpr std::int64_t second = 1000000000;
+    std::int64_t now = 1000 * second;
+
+    xtrd::rate_limiter l;
+
+    // A burst of up to the rate is allowed
+    for (std::size_t i = 0; i < 10; ++i)
+        REQUIRE(l.allow(10, now));
+    REQUIRE(!l.allow(10, now));
+    REQUIRE(!l.allow(10, now));
+    REQUIRE(l.suppressed() == 2);
+    REQUIRE(l.suppressed() == 0);
+
+    // After one interval one more statement is allowed
+    now += second / 10;
+    REQUIRE(l.allow(10, now));
+    REQUIRE(!l.allow(10, now));
+    REQUIRE(l.suppressed() == 1);
+
+    // After a second of inactivity the full burst is allowed again
+    now += second;
+    for (std::size_t i = 0; i < 10; ++i)
+        REQUIRE(l.allow(10, now));
+    REQUIRE(!l.allow(10, now));
+}
+
+TEST_CASE("rate_limiter sustained rate test", "[limiters]")
+{
+    constexpr std::int64_t second = 1000000000;
+    std::int64_t now = 1000 * second;
+
+    xtrd::rate_limiter l;
+
+    // Statements made every millisecond for ten seconds at a limit of 100
+    // per second: the initial burst of 100 plus 100 per second thereafter
+    std::size_t allowed = 0;
+    for (std::size_t i = 0; i < 10000; ++i, now += second / 1000)
+        allowed += l.allow(100, now);
+    REQUIRE(allowed >= 1000);
+    REQUIRE(allowed <= 1100);
+    REQUIRE(l.suppressed() == 10000 - allowed);
+}
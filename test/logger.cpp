@@ -20,11 +20,13 @@
 
 #include "xtr/logger.hpp"
 
+#include "xtr/detail/binary_decoder.hpp"
 #include "xtr/detail/commands/frame.hpp"
 #include "xtr/detail/commands/message_id.hpp"
 #include "xtr/detail/commands/requests.hpp"
 #include "xtr/detail/commands/responses.hpp"
 #include "xtr/detail/config.hpp"
+#include "xtr/detail/strzcpy.hpp"
 
 #include "command_client.hpp"
 
@@ -33,6 +35,7 @@
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <chrono>
@@ -44,27 +47,37 @@
 #include <cstdint>
 #include <cstring>
 #include <ctime>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <set>
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <thread>
 #include <vector>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <sys/wait.h>
+#include <dirent.h>
 #include <err.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(XTR_ENABLE_ZLIB)
+#include <zlib.h>
+#endif
+
 namespace xtrd = xtr::detail;
 
 namespace
@@ -235,6 +248,50 @@ namespace
         }
     };
 
+    struct binary_fixture_base
+    {
+    protected:
+        std::string bytes_;
+    };
+
+    // Writes binary output, decoding it when synchronized so that
+    // tests can compare decoded lines in the same way as text lines.
+    struct binary_fixture : binary_fixture_base, fixture
+    {
+        binary_fixture()
+        :
+            fixture(
+                [this](xtr::log_level_t, const char* buf, std::size_t length)
+                {
+                    std::scoped_lock lock{m_};
+                    bytes_.append(buf, length);
+                    return length;
+                },
+                [this](const char* buf, std::size_t length)
+                {
+                    std::scoped_lock lock{m_};
+                    errors_.push_back(std::string(buf, length - 1));
+                },
+                test_clock{&clock_nanos_},
+                xtr::null_command_path)
+        {
+            log_.set_output_format(xtr::output_format_t::binary);
+        }
+
+        void sync() override
+        {
+            fixture::sync();
+            std::scoped_lock lock{m_};
+            fmt::memory_buffer mbuf;
+            bytes_.erase(0, decoder_.decode(bytes_.data(), bytes_.size(), mbuf));
+            const std::string_view text(mbuf.data(), mbuf.size());
+            for (std::size_t pos = 0, nl; (nl = text.find('\n', pos)) != text.npos; pos = nl + 1)
+                lines_.emplace_back(text.substr(pos, nl - pos));
+        }
+
+        xtrd::binary_decoder decoder_;
+    };
+
     FILE* fmktemp(char* path)
     {
         const int fd = ::mkstemp(path);
@@ -261,6 +318,35 @@ namespace
         xtr::sink s_ = log_.get_sink("Name");
     };
 
+    std::vector<std::string> read_lines(const char* path)
+    {
+        std::ifstream ifs(path);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(ifs, line);)
+            lines.push_back(std::move(line));
+        return lines;
+    }
+
+    // Output is written to a file so that records written by the consumer
+    // process can be read. s_ is created before the consumer process is
+    // started, so remains consumed by the consumer thread.
+    struct process_fixture : path_fixture
+    {
+        process_fixture()
+        {
+            log_.start_consumer_process();
+        }
+
+        std::string last_file_line() const
+        {
+            const auto lines = read_lines(path_);
+            REQUIRE(!lines.empty());
+            return lines.back();
+        }
+
+        int line_;
+    };
+
     template<typename Fixture = fixture>
     struct command_fixture : xtrd::command_client, Fixture
     {
@@ -272,6 +358,111 @@ namespace
         }
     };
 
+    // Temporary directory for recovery files, which are created in a
+    // subdirectory of it
+    struct recovery_dir
+    {
+        recovery_dir()
+        {
+            REQUIRE(::mkdtemp(path_) != nullptr);
+        }
+
+        ~recovery_dir()
+        {
+            for (const auto& file : files())
+                ::unlink((subdir() + "/" + file).c_str());
+            ::rmdir(subdir().c_str());
+            ::unlink((std::string(path_) + "/target").c_str());
+            ::rmdir(path_);
+        }
+
+        std::string subdir() const
+        {
+            return
+                std::string(path_) + "/xtr." +
+                std::to_string(::geteuid()) + ".recovery";
+        }
+
+        std::vector<std::string> files() const
+        {
+            std::vector<std::string> result;
+            if (DIR* d = ::opendir(subdir().c_str()))
+            {
+                while (const dirent* ent = ::readdir(d))
+                {
+                    if (ent->d_name[0] != '.')
+                        result.push_back(ent->d_name);
+                }
+                ::closedir(d);
+            }
+            return result;
+        }
+
+        char path_[32] = "/tmp/xtr.test.XXXXXX";
+    };
+
+    // Logs to a recoverable sink in a child process, which then exits
+    // without the records written by the second function being consumed,
+    // as the output function never returns once they are written. Returns
+    // the pid of the child.
+    template<typename Before, typename After>
+    ::pid_t log_and_exit(
+        const char* dir,
+        std::size_t capacity,
+        Before&& before,
+        After&& after)
+    {
+        const ::pid_t pid = ::fork();
+        REQUIRE(pid != -1);
+
+        if (pid == 0)
+        {
+            std::atomic<bool> blocked{false};
+            std::atomic<bool> waiting{false};
+            xtr::logger log(
+                [&](xtr::log_level_t, const char*, std::size_t size) -> ::ssize_t
+                {
+                    if (blocked)
+                    {
+                        waiting = true;
+                        for (;;)
+                            ::pause();
+                    }
+                    return ::ssize_t(size);
+                },
+                [](const char*, std::size_t) {},
+                std::chrono::system_clock(),
+                xtr::null_command_path);
+            log.set_recovery_directory(dir);
+            xtr::sink s = log.get_sink("Recovered", capacity);
+            before(s);
+            s.sync();
+            blocked = true;
+            after(s);
+            while (!waiting)
+                std::this_thread::yield();
+            ::_exit(EXIT_SUCCESS);
+        }
+
+        int status;
+        REQUIRE(::waitpid(pid, &status, 0) == pid);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+
+        return pid;
+    }
+
+    template<typename Func>
+    ::pid_t log_and_exit(const char* dir, Func&& func)
+    {
+        return
+            log_and_exit(
+                dir,
+                xtr::sink::default_capacity,
+                [](xtr::sink&) {},
+                std::forward<Func>(func));
+    }
+
 #if __cpp_exceptions
     struct thrower {};
 
@@ -391,6 +582,29 @@ namespace
         copy_thrower(copy_thrower&&) noexcept;
         copy_thrower(const copy_thrower&);
     };
+
+    // Formatted as the id of the process formatting it
+    struct formatting_pid {};
+
+    // Formatted as the name of the process formatting it
+    struct formatting_comm {};
+
+    const char* custom_log_level_style(xtr::log_level_t)
+    {
+        return "Custom ";
+    }
+
+    // Copies succeed but moves throw, so that a log call taking an lvalue
+    // throws only once space has been reserved in the queue
+    struct late_thrower
+    {
+        late_thrower() = default;
+        late_thrower(const late_thrower&) {}
+        late_thrower(late_thrower&&)
+        {
+            throw std::runtime_error("Exception error text");
+        }
+    };
 }
 
 namespace fmt
@@ -427,6 +641,57 @@ namespace fmt
             return format_to(ctx.out(), "<blocker>");
         }
     };
+
+    template<>
+    struct formatter<formatting_pid>
+    {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext &ctx)
+        {
+            return ctx.begin();
+        }
+
+        template<typename FormatContext>
+        auto format(const formatting_pid&, FormatContext &ctx)
+        {
+            return format_to(ctx.out(), "{}", ::getpid());
+        }
+    };
+
+    template<>
+    struct formatter<formatting_comm>
+    {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext &ctx)
+        {
+            return ctx.begin();
+        }
+
+        template<typename FormatContext>
+        auto format(const formatting_comm&, FormatContext &ctx)
+        {
+            std::ifstream comm("/proc/self/comm");
+            std::string name;
+            std::getline(comm, name);
+            return format_to(ctx.out(), "{}", name);
+        }
+    };
+
+    template<>
+    struct formatter<late_thrower>
+    {
+        template<typename ParseContext>
+        constexpr auto parse(ParseContext &ctx)
+        {
+            return ctx.begin();
+        }
+
+        template<typename FormatContext>
+        auto format(const late_thrower&, FormatContext &ctx)
+        {
+            return format_to(ctx.out(), "late_thrower");
+        }
+    };
 }
 
 using namespace fmt::literals;
@@ -742,6 +1007,18 @@ TEST_CASE_METHOD(fixture, "logger string table test", "[logger]")
         "Test foo bar baz blep blop  slightly longer string"_format(line_));
 }
 
+TEST_CASE_METHOD(fixture, "logger string table lengths test", "[logger]")
+{
+    // Short strings are copied by different code for each range of lengths
+    std::string s;
+    for (std::size_t i = 0; i <= 130; ++i)
+    {
+        XTR_LOG(s_, "Test {} {}", s, s.c_str()), line_ = __LINE__;
+        REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {} {}"_format(line_, s, s));
+        s += char('a' + i % 26);
+    }
+}
+
 TEST_CASE_METHOD(fixture, "logger string overflow test", "[logger]")
 {
     // Three pointers are for the formatter pointer, string pointer and record
@@ -912,6 +1189,18 @@ TEST_CASE_METHOD(fixture, "tsc estimation test", "[logger]")
     }
 }
 
+TEST_CASE_METHOD(fixture, "tsc calibration test", "[logger]")
+{
+    // Calibration is started by the fixture's logger, so get_tsc_hz returns
+    // an estimate immediately even if calibration has not yet completed
+    const auto hz = xtrd::get_tsc_hz();
+    REQUIRE(hz > 0);
+    if (const auto cpuid_hz = xtrd::read_tsc_hz())
+        REQUIRE(xtrd::calibrated_tsc_hz() == cpuid_hz);
+    else
+        REQUIRE(hz == Approx(xtrd::estimate_tsc_hz()).epsilon(0.05));
+}
+
 #if __cpp_exceptions
 TEST_CASE_METHOD(fixture, "logger error handling test", "[logger]")
 {
@@ -1053,152 +1342,545 @@ TEST_CASE_METHOD(fixture, "logger short write test", "[logger]")
     REQUIRE(last_err() == "E 2000-01-01 01:02:03.123456 Name: Error: Short write"_format(line_));
 }
 
-TEST_CASE_METHOD(fixture, "logger sink change name test", "[logger]")
-{
-    XTR_LOG(s_, "Test"), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
-
-    s_.set_name("A new name");
-    XTR_LOG(s_, "Test"), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 A new name logger.cpp:{}: Test"_format(line_));
-
-    s_.set_name("An even newer name");
-    XTR_LOG(s_, "Test"), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 An even newer name logger.cpp:{}: Test"_format(line_));
-}
-
-TEST_CASE_METHOD(fixture, "logger no macro test", "[logger]")
+TEST_CASE_METHOD(fixture, "logger batched output test", "[logger]")
 {
-    static constexpr xtrd::string test1{"{}{} {} Test\n"};
-    s_.log<&test1, xtr::log_level_t::info>();
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name Test"_format(line_));
-
-    static constexpr xtrd::string test2{"{}{} {} Test {}\n"};
-    s_.log<&test2, xtr::log_level_t::info>(42);
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name Test 42"_format(line_));
-}
+    std::vector<std::string> batches;
+    std::atomic<bool> blocked{false};
+    std::atomic<bool> released{false};
 
-TEST_CASE_METHOD(fixture, "logger alignment test", "[logger]")
-{
-    XTR_LOG(s_, "Test {}", align_format<4>{42}), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+    log_.set_output_function(
+        [&](const char* buf, std::size_t size)
+        {
+            // Block while writing the first batch, so that the remaining
+            // log statements are read by the consumer in one pass
+            if (batches.empty())
+            {
+                blocked = true;
+                while (!released)
+                    std::this_thread::yield();
+            }
+            batches.emplace_back(buf, size);
+            return ::ssize_t(size);
+        });
 
-    XTR_LOG(s_, "Test {}", align_format<8>{42}), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+    XTR_LOG(s_, "Test {}", 0), line_ = __LINE__;
 
-    XTR_LOG(s_, "Test {}", align_format<16>{42}), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+    while (!blocked)
+        std::this_thread::yield();
 
-    XTR_LOG(s_, "Test {}", align_format<32>{42}), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+    for (int i = 1; i <= 10; ++i)
+        XTR_LOG(s_, "Test {}", i);
 
-    XTR_LOG(s_, "Test {}", align_format<64>{42}), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
-}
+    released = true;
+    sync();
 
-TEST_CASE_METHOD(fixture, "logger argument move test", "[logger]")
-{
-    non_copyable nc(42);
-    XTR_LOG(s_, "Test {}", std::move(nc)), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
-}
+    REQUIRE(batches.size() == 2);
+    REQUIRE(batches[0] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 0\n"_format(line_));
 
-TEST_CASE_METHOD(fixture, "logger non-blocking test", "[logger]")
-{
-    XTR_TRY_LOG(s_, "Test"), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+    std::string expected;
+    for (int i = 1; i <= 10; ++i)
+        expected += "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}\n"_format(line_ + 6, i);
+    REQUIRE(batches[1] == expected);
 }
 
-TEST_CASE_METHOD(fixture, "logger non-blocking drop test", "[logger]")
+TEST_CASE_METHOD(fixture, "logger batched output flush test", "[logger]")
 {
-    // 64kb default size buffer, 8 bytes per log record, 16 bytes taken
-    // by blocker.
-    const std::size_t n_dropped = 100;
-    const std::size_t blocker_sz = 16;
-    const std::size_t msg_sz = 8;
-    const std::size_t n = (64 * 1024 - blocker_sz) / msg_sz + n_dropped;
-
-    auto next_sink = log_.get_sink("next");
-
-    blocker b;
-
-    XTR_LOG(s_, "{}", b);
+    std::string output;
+    std::string flushed;
 
-    for (std::size_t i = 0; i < n; ++i)
-        XTR_TRY_LOG(s_, "Test");
+    log_.set_output_function(
+        [&](const char* buf, std::size_t size)
+        {
+            output.append(buf, size);
+            return ::ssize_t(size);
+        });
+    log_.set_flush_function([&](){ flushed = output; });
 
-    b.release();
+    // The batch is written before the flush function is invoked by sync
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
     sync();
 
-    // At this point it is not guaranteed that the dropped count has been
-    // printed, because the consumer thread could have read the sync request
-    // in the same 'batch' of messages as the log requests. Instead sync must
-    // be called on the next sink, which ensures that the consumer has
-    // processed the dropped count of s_, as it must do so before moving on to
-    // the next sink.
-    next_sink.sync();
+    REQUIRE(flushed == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test\n"_format(line_));
 
-    REQUIRE(last_line() == "W 2000-01-01 01:02:03.123456 Name: {} messages dropped"_format(n_dropped));
+    // The logger flushes when the fixture destructs, after output and flushed
+    // have been destroyed
+    log_.set_flush_function([](){});
 }
 
-// Calling these tests `soak' tests is stretching things but I can't think
-// of a better name.
-
-TEST_CASE_METHOD(fixture, "logger soak test", "[logger]")
+TEST_CASE_METHOD(fixture, "logger batched output error test", "[logger]")
 {
-    constexpr std::size_t n = 100000;
+    log_.set_output_function(
+        [](const char*, std::size_t)
+        {
+            return ::ssize_t(-1);
+        });
 
-    for (std::size_t i = 0; i < n; ++i)
-    {
-        XTR_LOG(s_, "Test {}", i), line_ = __LINE__;
-        XTR_LOG(s_, "Test {}", i);
-    }
+    XTR_LOG(s_, "Test");
+    REQUIRE(last_err() == "E 2000-01-01 01:02:03.123456 Name: Error: Write error");
 
-    sync();
-    REQUIRE(line_count() == n * 2);
+    log_.set_output_function(
+        [](const char*, std::size_t size)
+        {
+            return ::ssize_t(size - 1);
+        });
 
-    for (std::size_t i = 0; i < n * 2; i += 2)
-    {
-        REQUIRE(lines_[i] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_, i / 2));
-        REQUIRE(lines_[i + 1] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_ + 1, i / 2));
-    }
+    XTR_LOG(s_, "Test");
+    REQUIRE(last_err() == "E 2000-01-01 01:02:03.123456 Name: Error: Short write");
+    REQUIRE(lines_.empty());
 }
 
-TEST_CASE_METHOD(fixture, "logger multiple sink soak test", "[logger]")
+TEST_CASE_METHOD(fixture, "logger multiple consumer threads test", "[logger]")
 {
-    constexpr std::size_t n = 100000;
-    constexpr std::size_t n_sinks = 1024;
+    log_.add_consumer_threads(2);
 
-    std::vector<xtr::sink> sinks;
+    const auto h0 = log_.consumer_thread_native_handle(0);
+    const auto h1 = log_.consumer_thread_native_handle(1);
+    const auto h2 = log_.consumer_thread_native_handle(2);
+    REQUIRE(h0 == log_.consumer_thread_native_handle());
+    REQUIRE(h0 != h1);
+    REQUIRE(h1 != h2);
+
+    constexpr std::size_t n_sinks = 6;
+    constexpr std::size_t n_records = 1000;
 
+    std::vector<xtr::sink> sinks;
+    sinks.reserve(n_sinks);
     for (std::size_t i = 0; i < n_sinks; ++i)
-        sinks.push_back(log_.get_sink("Name"));
+        sinks.push_back(log_.get_sink("Sink{}"_format(i)));
 
-    for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t i = 0; i < n_records; ++i)
     {
-        auto& p = sinks[i & (n_sinks - 1)];
-        XTR_LOG(p, "Test"), line_ = __LINE__;
+        for (auto& s : sinks)
+            XTR_LOG(s, "Test {}", i), line_ = __LINE__;
     }
 
-    for (std::size_t i = 0; i < n; ++i)
-    {
-        auto& p = sinks[i & (n_sinks - 1)];
-        p.sync();
-    }
+    for (auto& s : sinks)
+        s.sync();
 
-    REQUIRE(line_count() == n);
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == n_sinks * n_records);
 
-    for (std::size_t i = 0; i < n; ++i)
-        REQUIRE(lines_[i] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+    // Records from different sinks may be interleaved, but records from
+    // the same sink are written in order
+    std::vector<std::size_t> next(n_sinks);
+    for (const auto& line : lines_)
+    {
+        const std::size_t i = std::size_t(line[33] - '0');
+        REQUIRE(i < n_sinks);
+        REQUIRE(line == "I 2000-01-01 01:02:03.123456 Sink{} logger.cpp:{}: Test {}"_format(i, line_, next[i]));
+        ++next[i];
+    }
 }
 
-TEST_CASE_METHOD(fixture, "logger string soak test", "[logger]")
+TEST_CASE_METHOD(fixture, "logger shared sink test", "[logger]")
 {
-    constexpr std::size_t n = 100000;
-    const char* s = "A string to be copied into the logger buffer";
+    auto p = log_.get_shared_sink("Shared");
 
-    for (std::size_t i = 0; i < n; ++i)
-    {
+    XTR_LOG(p, "Test"), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test"_format(line_));
+
+    XTR_LOG(p, "Test {} {}", 42, 4.2), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test 42 4.2"_format(line_));
+
+    const std::string str{"std::string"};
+    XTR_LOG(p, "Test {} {} {} {}", "C string", str, std::string_view{"string_view"}, 42), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test C string std::string string_view 42"_format(line_));
+
+    XTR_TRY_LOG(p, "Test {}", 43), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test 43"_format(line_));
+
+    p.set_level(xtr::log_level_t::error);
+    XTR_LOGL(info, p, "Test {}", 44);
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test 43"_format(line_));
+    p.set_level(xtr::log_level_t::info);
+
+    p.set_name("Renamed");
+    XTR_LOG(p, "Test {}", 45), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Renamed logger.cpp:{}: Test 45"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger shared sink string overflow test", "[logger]")
+{
+    auto p = log_.get_shared_sink("Shared", 4096);
+
+    // Two pointers are for the record header, three pointers are for the
+    // formatter pointer, string pointer and record size, -1 is for the
+    // terminating nul on the string.
+    std::string s(4096UL - sizeof(void*) * 5 - 1, char('X'));
+    XTR_LOG(p, "Test {}", s), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test {}"_format(line_, s));
+
+    s += 'Y';
+
+    XTR_LOG(p, "Test {}", s), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test <truncated>"_format(line_));
+}
+
+#if __cpp_exceptions
+TEST_CASE_METHOD(fixture, "logger shared sink exception test", "[logger]")
+{
+    auto p = log_.get_shared_sink("Shared");
+
+    // The space reserved for the record must be committed even though the
+    // record could not be written, otherwise later records are never read
+    late_thrower lt;
+    REQUIRE_THROWS_AS(XTR_LOG(p, "Test {}", lt), std::runtime_error);
+
+    XTR_LOG(p, "Test"), line_ = __LINE__;
+    p.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Shared logger.cpp:{}: Test"_format(line_));
+}
+#endif
+
+TEST_CASE_METHOD(fixture, "logger shared sink multiple producers test", "[logger]")
+{
+    // A small queue is used so that producers wait for space and records
+    // wrap around the end of the queue
+    auto p = log_.get_shared_sink("Shared", 4096);
+
+    constexpr std::size_t n_threads = 4;
+    constexpr std::size_t n_records = 10000;
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < n_threads; ++t)
+    {
+        threads.emplace_back(
+            [&p, t]()
+            {
+                const std::string str(t * 10, char('a' + t));
+                for (std::size_t i = 0; i < n_records; ++i)
+                {
+                    if (i % 2 == 0)
+                        XTR_LOG(p, "Test {} {}", t, i);
+                    else
+                        XTR_LOG(p, "Test {} {} {}", t, i, str);
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    p.sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == n_threads * n_records);
+
+    // Records from different threads may be interleaved, but records from
+    // the same thread are written in order
+    std::vector<std::size_t> next(n_threads);
+    for (const auto& line : lines_)
+    {
+        const std::size_t pos = line.find(": Test ");
+        REQUIRE(pos != std::string::npos);
+        const std::size_t t = std::size_t(line[pos + 7] - '0');
+        REQUIRE(t < n_threads);
+        const std::size_t i = next[t]++;
+        if (i % 2 == 0)
+            REQUIRE(line.substr(pos) == ": Test {} {}"_format(t, i));
+        else
+            REQUIRE(line.substr(pos) == ": Test {} {} {}"_format(t, i, std::string(t * 10, char('a' + t))));
+    }
+}
+
+TEST_CASE_METHOD(fixture, "logger multiple consumer threads batched output test", "[logger]")
+{
+    std::atomic<bool> writing{false};
+    std::atomic<bool> concurrent{false};
+    std::string output;
+
+    log_.set_output_function(
+        [&](const char* buf, std::size_t size)
+        {
+            // The back-end must never be invoked concurrently
+            if (writing.exchange(true))
+                concurrent = true;
+            output.append(buf, size);
+            writing = false;
+            return ::ssize_t(size);
+        });
+
+    log_.add_consumer_threads(3);
+
+    std::vector<xtr::sink> sinks;
+    for (std::size_t i = 0; i < 4; ++i)
+        sinks.push_back(log_.get_sink("Sink{}"_format(i)));
+
+    for (std::size_t i = 0; i < 500; ++i)
+    {
+        for (auto& s : sinks)
+            XTR_LOG(s, "Test {}", i);
+    }
+
+    // Sync flushes and syncs the shared back-end from any consumer thread
+    for (auto& s : sinks)
+        s.sync();
+
+    REQUIRE(!concurrent);
+    REQUIRE(std::count(output.begin(), output.end(), '\n') == 4 * 500);
+
+    // The logger writes when the fixture destructs, after output has been
+    // destroyed
+    log_.set_output_function([](const char*, std::size_t size) { return ::ssize_t(size); });
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger multiple consumer threads binary test", "[logger]")
+{
+    log_.add_consumer_threads(1);
+
+    xtr::sink s0 = log_.get_sink("Sink0");
+    xtr::sink s1 = log_.get_sink("Sink1");
+
+    XTR_LOG(s0, "Test {}", 0), line_ = __LINE__;
+    s0.sync();
+    XTR_LOGL(warning, s1, "Test {}", 1);
+    s1.sync();
+    sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 2);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Sink0 logger.cpp:{}: Test 0"_format(line_));
+    REQUIRE(lines_[1] == "W 2000-01-01 01:02:03.123456 Sink1 logger.cpp:{}: Test 1"_format(line_ + 2));
+}
+
+TEST_CASE_METHOD(fixture, "logger adaptive wait strategy test", "[logger]")
+{
+    using namespace std::literals::chrono_literals;
+
+    // A long maximum sleep, so that the test only passes if the consumer is
+    // woken by the sink
+    log_.set_wait_strategy({10, 10, std::chrono::minutes{1}});
+
+    ::clockid_t cid;
+    REQUIRE(::pthread_getcpuclockid(log_.consumer_thread_native_handle(), &cid) == 0);
+
+    const auto cpu_time =
+        [cid]()
+        {
+            std::timespec ts;
+            REQUIRE(::clock_gettime(cid, &ts) == 0);
+            return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+        };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const auto start_cpu = cpu_time();
+        std::this_thread::sleep_for(200ms);
+        // The consumer thread should have been asleep for almost all of
+        // the idle period
+        REQUIRE(cpu_time() - start_cpu < 100ms);
+
+        const auto start = std::chrono::steady_clock::now();
+        XTR_LOG(s_, "Test {}", i), line_ = __LINE__;
+        REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_, i));
+        REQUIRE(std::chrono::steady_clock::now() - start < 30s);
+    }
+
+    log_.set_wait_strategy(xtr::busy_wait_strategy);
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger adaptive wait strategy wake latency test", "[logger]")
+{
+    using namespace std::literals::chrono_literals;
+
+    // The consumer sleeps as soon as the sink is empty, and writes are made
+    // at varying intervals so that some land while the consumer is going to
+    // sleep. A missed wake would delay a line by the maximum sleep.
+    log_.set_wait_strategy({0, 0, std::chrono::minutes{1}});
+
+    std::chrono::steady_clock::duration max_latency{};
+    for (std::size_t i = 0; i < 1000; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(i % 100));
+        const auto start = std::chrono::steady_clock::now();
+        XTR_LOG(s_, "Test {}", i);
+        while (line_count() != i + 1)
+            std::this_thread::yield();
+        max_latency =
+            std::max(max_latency, std::chrono::steady_clock::now() - start);
+    }
+
+    REQUIRE(max_latency < 10s);
+}
+
+TEST_CASE_METHOD(fixture, "logger adaptive wait strategy multiple consumer threads test", "[logger]")
+{
+    log_.set_wait_strategy({0, 0, std::chrono::minutes{1}});
+    log_.add_consumer_threads(2);
+
+    std::vector<xtr::sink> sinks;
+    for (std::size_t i = 0; i < 3; ++i)
+        sinks.push_back(log_.get_sink("Sink{}"_format(i)));
+
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        for (auto& s : sinks)
+        {
+            XTR_LOG(s, "Test {}", i);
+            s.sync();
+        }
+    }
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 300);
+}
+
+TEST_CASE_METHOD(fixture, "logger sink change name test", "[logger]")
+{
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+
+    s_.set_name("A new name");
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 A new name logger.cpp:{}: Test"_format(line_));
+
+    s_.set_name("An even newer name");
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 An even newer name logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger no macro test", "[logger]")
+{
+    static constexpr xtrd::string test1{"{}{} {} Test\n"};
+    s_.log<&test1, xtr::log_level_t::info>();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name Test"_format(line_));
+
+    static constexpr xtrd::string test2{"{}{} {} Test {}\n"};
+    s_.log<&test2, xtr::log_level_t::info>(42);
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name Test 42"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger alignment test", "[logger]")
+{
+    XTR_LOG(s_, "Test {}", align_format<4>{42}), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+
+    XTR_LOG(s_, "Test {}", align_format<8>{42}), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+
+    XTR_LOG(s_, "Test {}", align_format<16>{42}), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+
+    XTR_LOG(s_, "Test {}", align_format<32>{42}), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+
+    XTR_LOG(s_, "Test {}", align_format<64>{42}), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger argument move test", "[logger]")
+{
+    non_copyable nc(42);
+    XTR_LOG(s_, "Test {}", std::move(nc)), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger non-blocking test", "[logger]")
+{
+    XTR_TRY_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger non-blocking drop test", "[logger]")
+{
+    // 64kb default size buffer, 8 bytes per log record, 16 bytes taken
+    // by blocker.
+    const std::size_t n_dropped = 100;
+    const std::size_t blocker_sz = 16;
+    const std::size_t msg_sz = 8;
+    const std::size_t n = (64 * 1024 - blocker_sz) / msg_sz + n_dropped;
+
+    auto next_sink = log_.get_sink("next");
+
+    blocker b;
+
+    XTR_LOG(s_, "{}", b);
+
+    for (std::size_t i = 0; i < n; ++i)
+        XTR_TRY_LOG(s_, "Test");
+
+    b.release();
+    sync();
+
+    // At this point it is not guaranteed that the dropped count has been
+    // printed, because the consumer thread could have read the sync request
+    // in the same 'batch' of messages as the log requests. Instead sync must
+    // be called on the next sink, which ensures that the consumer has
+    // processed the dropped count of s_, as it must do so before moving on to
+    // the next sink.
+    next_sink.sync();
+
+    REQUIRE(last_line() == "W 2000-01-01 01:02:03.123456 Name: {} messages dropped"_format(n_dropped));
+}
+
+// Calling these tests `soak' tests is stretching things but I can't think
+// of a better name.
+
+TEST_CASE_METHOD(fixture, "logger soak test", "[logger]")
+{
+    constexpr std::size_t n = 100000;
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        XTR_LOG(s_, "Test {}", i), line_ = __LINE__;
+        XTR_LOG(s_, "Test {}", i);
+    }
+
+    sync();
+    REQUIRE(line_count() == n * 2);
+
+    for (std::size_t i = 0; i < n * 2; i += 2)
+    {
+        REQUIRE(lines_[i] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_, i / 2));
+        REQUIRE(lines_[i + 1] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_ + 1, i / 2));
+    }
+}
+
+TEST_CASE_METHOD(fixture, "logger multiple sink soak test", "[logger]")
+{
+    constexpr std::size_t n = 100000;
+    constexpr std::size_t n_sinks = 1024;
+
+    std::vector<xtr::sink> sinks;
+
+    for (std::size_t i = 0; i < n_sinks; ++i)
+        sinks.push_back(log_.get_sink("Name"));
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto& p = sinks[i & (n_sinks - 1)];
+        XTR_LOG(p, "Test"), line_ = __LINE__;
+    }
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto& p = sinks[i & (n_sinks - 1)];
+        p.sync();
+    }
+
+    REQUIRE(line_count() == n);
+
+    for (std::size_t i = 0; i < n; ++i)
+        REQUIRE(lines_[i] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger string soak test", "[logger]")
+{
+    constexpr std::size_t n = 100000;
+    const char* s = "A string to be copied into the logger buffer";
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
         XTR_LOG(s_, "Test {}", s), line_ = __LINE__;
         XTR_LOG(s_, "Test {}", s);
     }
@@ -1561,12 +2243,174 @@ TEST_CASE_METHOD(command_fixture<>, "logger status command test", "[logger]")
     REQUIRE(infos[4].dropped_count == 0);
 }
 
-TEST_CASE_METHOD(command_fixture<>, "logger status command dropped count test", "[logger]")
+TEST_CASE_METHOD(command_fixture<>, "logger status command sink capacity test", "[logger]")
 {
-    // 64kb default size buffer, 8 bytes per log record, 16 bytes taken
-    // by blocker.
-    const std::size_t n_dropped = 100;
-    const std::size_t blocker_sz = 16;
+    auto p0 = log_.get_sink("Producer0", 8 * 1024 * 1024);
+    auto p1 = log_.get_sink("Producer1", 1);
+    auto p2 = p0;
+    xtr::sink p3(100000);
+    log_.register_sink(p3, "Producer3");
+
+    p0.sync();
+    p1.sync();
+    p2.sync();
+    p3.sync();
+
+    xtrd::frame<xtrd::status> st;
+
+    st->pattern.type = xtrd::pattern_type_t::none;
+
+    const auto infos = send_frame<xtrd::sink_info>(st);
+
+    const std::size_t page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+
+    // Copied sinks are registered via the source sink, so the order in
+    // which sinks are registered is not deterministic
+    std::vector<std::size_t> capacities;
+    for (const auto& info : infos)
+        capacities.push_back(info.buf_capacity);
+    std::ranges::sort(capacities);
+
+    REQUIRE(
+        capacities ==
+        std::vector<std::size_t>{
+            page_size,
+            xtr::sink::default_capacity,
+            std::max(page_size, std::size_t(128 * 1024)),
+            8 * 1024 * 1024,
+            8 * 1024 * 1024});
+}
+
+TEST_CASE_METHOD(fixture, "logger sink capacity test", "[logger]")
+{
+    xtr::sink s = log_.get_sink("Name", 1024 * 1024);
+
+    // Block the consumer, then write more than the default capacity without
+    // any statements being dropped
+    blocker b;
+    XTR_LOG(s, "{}", b);
+
+    constexpr std::size_t n = 2 * xtr::sink::default_capacity / 16;
+    for (std::size_t i = 0; i < n; ++i)
+        XTR_TRY_LOG(s, "Test {}", i), line_ = __LINE__;
+
+    b.release();
+    s.sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == n + 1);
+    REQUIRE(lines_.back() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_, n - 1));
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger huge page sink test", "[logger]")
+{
+    auto p0 = log_.get_sink("Producer0", 4096, xtr::page_type_t::huge);
+    auto p1 = p0;
+
+    XTR_LOG(p0, "Test {}", 0), line_ = __LINE__;
+    p0.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Producer0 logger.cpp:{}: Test 0"_format(line_));
+
+    XTR_LOG(p1, "Test {}", 1), line_ = __LINE__;
+    p1.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Producer0 logger.cpp:{}: Test 1"_format(line_));
+
+    xtrd::frame<xtrd::status> st;
+    st->pattern.type = xtrd::pattern_type_t::wildcard;
+    std::strcpy(st->pattern.text, "Producer*");
+
+    // Capacity is rounded up to the huge page size whether or not huge pages
+    // are available, and copied sinks use the same capacity
+    const auto infos = send_frame<xtrd::sink_info>(st);
+    REQUIRE(infos.size() == 2);
+    REQUIRE(infos[0].buf_capacity == xtrd::huge_page_size);
+    REQUIRE(infos[1].buf_capacity == xtrd::huge_page_size);
+}
+
+#if defined(__linux__)
+TEST_CASE_METHOD(fixture, "logger numa node test", "[logger]")
+{
+    if (::access("/sys/devices/system/node", F_OK) != 0)
+        return; // Kernel built without NUMA support
+
+    const int node = xtr::numa_node_of_cpu();
+    log_.set_consumer_thread_numa_node(node);
+
+    auto p0 = log_.get_sink("Producer0", 4096, xtr::page_type_t::normal, node);
+    xtr::sink p1(4096, xtr::page_type_t::normal, node);
+    log_.register_sink(p1, "Producer1");
+
+    XTR_LOG(p0, "Test {}", 0), line_ = __LINE__;
+    p0.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Producer0 logger.cpp:{}: Test 0"_format(line_));
+
+    XTR_LOG(p1, "Test {}", 1), line_ = __LINE__;
+    p1.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Producer1 logger.cpp:{}: Test 1"_format(line_));
+
+    // Copies are bound to the same node as the source sink
+    xtr::sink p2(p1);
+    XTR_LOG(p2, "Test {}", 2), line_ = __LINE__;
+    p2.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Producer1 logger.cpp:{}: Test 2"_format(line_));
+}
+#endif
+
+TEST_CASE_METHOD(command_fixture<>, "logger status command multiple consumer threads test", "[logger]")
+{
+    log_.add_consumer_threads(2);
+
+    auto p0 = log_.get_sink("Producer0");
+    auto p1 = log_.get_sink("Producer1");
+    auto p2 = log_.get_sink("Producer2");
+
+    p0.sync();
+    p1.sync();
+    p2.sync();
+
+    xtrd::frame<xtrd::set_level> sl;
+
+    sl->level = xtr::log_level_t::error;
+    sl->pattern.type = xtrd::pattern_type_t::wildcard;
+    std::strcpy(sl->pattern.text, "Producer*");
+
+    send_frame<xtrd::success>(sl);
+
+    reconnect();
+
+    xtrd::frame<xtrd::status> st;
+    st->pattern.type = xtrd::pattern_type_t::none;
+
+    auto infos = send_frame<xtrd::sink_info>(st);
+
+    // Sinks are reported by consumer thread, rather than in order of
+    // registration
+    std::ranges::sort(
+        infos,
+        [](const auto& a, const auto& b)
+        {
+            return std::strcmp(a.name, b.name) < 0;
+        });
+
+    using namespace std::literals::string_view_literals;
+
+    REQUIRE(infos.size() == 4);
+    REQUIRE(infos[0].name == "Name"sv);
+    REQUIRE(infos[0].level == xtr::log_level_t::info);
+    REQUIRE(infos[1].name == "Producer0"sv);
+    REQUIRE(infos[1].level == xtr::log_level_t::error);
+    REQUIRE(infos[2].name == "Producer1"sv);
+    REQUIRE(infos[2].level == xtr::log_level_t::error);
+    REQUIRE(infos[3].name == "Producer2"sv);
+    REQUIRE(infos[3].level == xtr::log_level_t::error);
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger status command dropped count test", "[logger]")
+{
+    // 64kb default size buffer, 8 bytes per log record, 16 bytes taken
+    // by blocker.
+    const std::size_t n_dropped = 100;
+    const std::size_t blocker_sz = 16;
     const std::size_t msg_sz = 8;
     const std::size_t n = (64 * 1024 - blocker_sz) / msg_sz + n_dropped;
 
@@ -1594,6 +2438,163 @@ TEST_CASE_METHOD(command_fixture<>, "logger status command dropped count test",
     REQUIRE(infos[0].dropped_count == n_dropped);
 }
 
+TEST_CASE_METHOD(command_fixture<>, "logger latency command test", "[logger]")
+{
+    auto p0 = log_.get_sink("Producer0");
+    auto p1 = log_.get_sink("Producer1");
+
+    p0.enable_latency_stats();
+
+    // 64kb default size buffer, 8 bytes per log record, 16 bytes taken
+    // by blocker, so the producer blocks until the blocker is released.
+    const std::size_t n = (64 * 1024 - 16) / 8 + 100;
+
+    blocker b;
+
+    XTR_LOG(p0, "{}", b);
+
+    std::thread t(
+        [&]
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            b.release();
+        });
+
+    for (std::size_t i = 0; i < n; ++i)
+        XTR_LOG(p0, "Test");
+
+    t.join();
+
+    XTR_LOG(p1, "Test");
+
+    p0.sync();
+    p1.sync();
+
+    xtrd::frame<xtrd::latency> lt;
+
+    lt->pattern.type = xtrd::pattern_type_t::none;
+
+    const auto lats = send_frame<xtrd::sink_latency>(lt);
+
+    using namespace std::literals::string_view_literals;
+
+    // Only sinks with latency statistics enabled are reported
+    REQUIRE(lats.size() == 1);
+
+    REQUIRE(lats[0].name == "Producer0"sv);
+    REQUIRE(lats[0].enqueue.count == n + 1);
+    REQUIRE(lats[0].enqueue.p50 <= lats[0].enqueue.p90);
+    REQUIRE(lats[0].enqueue.p90 <= lats[0].enqueue.p99);
+    REQUIRE(lats[0].enqueue.p99 <= lats[0].enqueue.p999);
+    REQUIRE(lats[0].enqueue.p999 <= lats[0].enqueue.p9999);
+    REQUIRE(lats[0].enqueue.p9999 <= lats[0].enqueue.max);
+    REQUIRE(lats[0].blocked.count >= 1);
+    REQUIRE(lats[0].blocked.count < lats[0].enqueue.count);
+    // The blocked producer waited for roughly 10ms
+    REQUIRE(lats[0].blocked.max >= 1000000);
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger latency command invalid regex test", "[logger]")
+{
+    xtrd::frame<xtrd::latency> lt;
+
+    lt->pattern.type = xtrd::pattern_type_t::basic_regex;
+    std::strcpy(lt->pattern.text, "***");
+
+    const auto errors = send_frame<xtrd::error>(lt);
+
+    REQUIRE(errors.size() == 1);
+    REQUIRE_THAT(
+        errors[0].reason,
+        Catch::Matchers::Contains("invalid", Catch::CaseSensitive::No));
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger stats command test", "[logger]")
+{
+    auto p0 = log_.get_sink("Producer0");
+
+    for (std::size_t i = 0; i < 100; ++i)
+        XTR_LOG(p0, "Test {}", i);
+
+    p0.sync();
+
+    xtrd::frame<xtrd::stats> sf;
+
+    sf->pattern.type = xtrd::pattern_type_t::none;
+
+    send_frame(sf);
+
+    std::vector<xtrd::sink_stats> sinks;
+    std::vector<xtrd::consumer_stats> cstats;
+    xtrd::frame_buf buf;
+    ::ssize_t nread;
+
+    while ((nread = xtrd::command_recv(fd_.get(), buf)) > 0)
+    {
+        if (buf.hdr.frame_id == xtrd::sink_stats::frame_id)
+        {
+            REQUIRE(nread == sizeof(xtrd::frame<xtrd::sink_stats>));
+            sinks.push_back(
+                reinterpret_cast<xtrd::frame<xtrd::sink_stats>&>(buf).payload);
+        }
+        else
+        {
+            REQUIRE(buf.hdr.frame_id == xtrd::consumer_stats::frame_id);
+            REQUIRE(nread == sizeof(xtrd::frame<xtrd::consumer_stats>));
+            cstats.push_back(
+                reinterpret_cast<xtrd::frame<xtrd::consumer_stats>&>(buf).payload);
+        }
+    }
+
+    REQUIRE(nread == 0);
+
+    std::sort(
+        sinks.begin(),
+        sinks.end(),
+        [](const auto& a, const auto& b)
+        {
+            return std::strcmp(a.name, b.name) < 0;
+        });
+
+    using namespace std::literals::string_view_literals;
+
+    REQUIRE(sinks.size() == 2);
+
+    REQUIRE(sinks[0].name == "Name"sv);
+
+    REQUIRE(sinks[1].name == "Producer0"sv);
+    // 100 log records and one sync command
+    REQUIRE(sinks[1].records_consumed == 101);
+    REQUIRE(sinks[1].bytes_consumed > 100 * sizeof(void*));
+    REQUIRE(sinks[1].peak_nbytes > 0);
+    REQUIRE(sinks[1].peak_nbytes <= sinks[1].bytes_consumed);
+    REQUIRE(sinks[1].buf_capacity == 64 * 1024);
+    REQUIRE(sinks[1].buf_nbytes == 0);
+    REQUIRE(sinks[1].dropped_count == 0);
+
+    REQUIRE(cstats.size() == 1);
+    REQUIRE(cstats[0].sync_count >= 1);
+    REQUIRE(cstats[0].flush_count >= cstats[0].sync_count);
+    REQUIRE(cstats[0].format_ns > 0);
+    REQUIRE(cstats[0].write_ns > 0);
+    REQUIRE(cstats[0].format_ns + cstats[0].write_ns <= cstats[0].elapsed_ns);
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger stats command invalid regex test", "[logger]")
+{
+    xtrd::frame<xtrd::stats> sf;
+
+    sf->pattern.type = xtrd::pattern_type_t::basic_regex;
+    std::strcpy(sf->pattern.text, "***");
+
+    const auto errors = send_frame<xtrd::error>(sf);
+
+    REQUIRE(errors.size() == 1);
+    REQUIRE_THAT(
+        errors[0].reason,
+        Catch::Matchers::Contains("invalid", Catch::CaseSensitive::No));
+}
+
 TEST_CASE_METHOD(command_fixture<>, "logger set_level command test", "[logger]")
 {
     xtrd::frame<xtrd::set_level> sl;
@@ -2067,112 +3068,426 @@ TEST_CASE_METHOD(command_fixture<>, "logger reopen command error test", "[logger
     REQUIRE(errors[0].reason == "Bad file descriptor"sv);
 }
 
-TEST_CASE_METHOD(command_fixture<path_fixture>, "logger reopen command path test", "[logger]")
+TEST_CASE_METHOD(command_fixture<>, "logger callsites command test", "[logger]")
 {
-    ::unlink(path_);
+    XTR_LOGL(warning, s_, "Callsite {}", 42), line_ = __LINE__;
+    sync();
 
-    struct stat sb;
+    xtrd::frame<xtrd::callsites> cs;
 
-    REQUIRE(::stat(path_, &sb) == -1);
+    cs->pattern.type = xtrd::pattern_type_t::basic_regex;
+    xtrd::strzcpy(cs->pattern.text, "logger\\.cpp:{}$"_format(line_));
 
-    xtrd::frame<xtrd::reopen> ro;
-    send_frame<xtrd::success>(ro);
+    const auto infos = send_frame<xtrd::callsite_info>(cs);
 
-    REQUIRE(::stat(path_, &sb) == 0);
+    using namespace std::literals::string_view_literals;
+
+    REQUIRE(infos.size() == 1);
+    REQUIRE_THAT(infos[0].file, Catch::Matchers::EndsWith("logger.cpp"));
+    REQUIRE(infos[0].line == unsigned(line_));
+    REQUIRE(infos[0].level == xtr::log_level_t::warning);
+    REQUIRE(infos[0].enabled);
+    REQUIRE(infos[0].format == "Callsite {}"sv);
 }
 
-TEST_CASE_METHOD(fixture, "logger socket path too long test", "[logger]")
+TEST_CASE_METHOD(command_fixture<>, "logger callsites command invalid regex test", "[logger]")
 {
-    constexpr std::size_t path_size =
-        sizeof(static_cast<sockaddr_un*>(nullptr)->sun_path);
-
-    std::string path(path_size, 'X');
+    xtrd::frame<xtrd::callsites> cs;
 
-    {
-        capture_cerr capture;
-
-        log_.set_command_path(path);
+    cs->pattern.type = xtrd::pattern_type_t::basic_regex;
+    std::strcpy(cs->pattern.text, "***");
 
-        const std::string expected =
-            "Error: Command path '" + path + "' is too long\n";
+    const auto errors = send_frame<xtrd::error>(cs);
 
-        REQUIRE(capture.buf_.str() == expected);
-    }
+    REQUIRE(errors.size() == 1);
+    REQUIRE_THAT(
+        errors[0].reason,
+        Catch::Matchers::Contains("invalid", Catch::CaseSensitive::No));
 }
 
-TEST_CASE_METHOD(fixture, "logger socket bind error test", "[logger]")
+TEST_CASE_METHOD(command_fixture<>, "logger set_callsite command test", "[logger]")
 {
-    std::string path = "/hopefully/this/path/does/not/exist/6aJ^JwK2+E7fgL*5q";
+    const auto log =
+        [this](int i)
+        {
+            XTR_LOG(s_, "Test {}", i), line_ = __LINE__;
+        };
 
-    {
-        capture_cerr capture;
+    log(1);
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 1"_format(line_));
 
-        log_.set_command_path(path);
+    xtrd::frame<xtrd::set_callsite> sc;
 
-        const std::string expected =
-            "Error: Failed to bind command socket to path '" + path +
-            "': No such file or directory\n";
+    sc->enabled = false;
+    sc->pattern.type = xtrd::pattern_type_t::basic_regex;
+    xtrd::strzcpy(sc->pattern.text, "logger\\.cpp:{}$"_format(line_));
 
-        REQUIRE(capture.buf_.str() == expected);
-    }
-}
+    send_frame<xtrd::success>(sc);
 
-TEST_CASE("logger open path test", "[logger]")
-{
-    xtr::logger log("/dev/null");
+    log(2);
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 1"_format(line_));
 
-    auto p = log.get_sink("Name");
+    reconnect();
 
-    XTR_LOG(p, "Test");
-}
+    sc->enabled = true;
+    send_frame<xtrd::success>(sc);
 
-TEST_CASE_METHOD(fixture, "logger noexcept test", "[logger]")
-{
-    static_assert(noexcept(XTR_LOG(s_, "Hello world")));
-    static_assert(noexcept(XTR_LOG(s_, "Hello world {}", 123)));
-    static_assert(noexcept(XTR_LOG(s_, "Hello {}", "world")));
+    log(3);
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 3"_format(line_));
 
-    std::string s1("world");
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s1)));
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s1))));
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 2);
+}
 
-    std::string_view s2("world");
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s2)));
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s2))));
+TEST_CASE_METHOD(command_fixture<>, "logger set_callsite command unexecuted test", "[logger]")
+{
+    // Callsites that have not yet been executed are disabled when executed
+    xtrd::frame<xtrd::set_callsite> sc;
 
-    const char* s3 = "world";
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s3)));
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s3))));
+    sc->enabled = false;
+    sc->pattern.type = xtrd::pattern_type_t::wildcard;
+    xtrd::strzcpy(sc->pattern.text, "*logger.cpp:{}"_format(__LINE__ + 4));
 
-    const char s4[] = "world";
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s4)));
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s4))));
+    send_frame<xtrd::success>(sc);
 
-    move_thrower mt;
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", mt)));
-    CHECK(!noexcept(XTR_LOG(s_, "Hello {}", std::move(mt))));
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    sync();
 
-    copy_thrower ct;
-    CHECK(!noexcept(XTR_LOG(s_, "Hello {}", ct)));
-    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(ct))));
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 1);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
 }
 
-TEST_CASE_METHOD(fixture, "logger re-register sink test", "[logger]")
+TEST_CASE_METHOD(command_fixture<>, "logger set_callsite command invalid regex test", "[logger]")
 {
-    s_.close();
-    log_.register_sink(s_, "Reregistered");
-    XTR_LOG(s_, "Test"), line_ = __LINE__;
-    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Reregistered logger.cpp:{}: Test"_format(line_));
-}
+    xtrd::frame<xtrd::set_callsite> sc;
 
-TEST_CASE_METHOD(fixture, "logger macro test", "[logger]")
-{
-    xtr::timespec ts{};
+    sc->enabled = false;
+    sc->pattern.type = xtrd::pattern_type_t::basic_regex;
+    std::strcpy(sc->pattern.text, "***");
 
-    // This test just exists to check if clang emits warnings for ``must
-    // specify at least one argument'' in a variadic macro.
+    const auto errors = send_frame<xtrd::error>(sc);
 
-    // XTR_LOG and variants
+    REQUIRE(errors.size() == 1);
+    REQUIRE_THAT(
+        errors[0].reason,
+        Catch::Matchers::Contains("invalid", Catch::CaseSensitive::No));
+}
+
+TEST_CASE("logger io_uring test", "[logger]")
+{
+    char path[32] = "/tmp/xtr.test.XXXXXX";
+    ::close(::mkstemp(path));
+
+    std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+    int line;
+
+    {
+        xtr::logger log(
+            xtr::io_uring_tag{},
+            path,
+            test_clock{&clock_nanos},
+            xtr::null_command_path);
+        xtr::sink s = log.get_sink("Name");
+        XTR_LOG(s, "Test {}", 42), line = __LINE__;
+        s.sync();
+        XTR_LOG(s, "Test {}", 43);
+    }
+
+    std::ifstream ifs(path);
+    const std::string contents{
+        std::istreambuf_iterator<char>(ifs),
+        std::istreambuf_iterator<char>()};
+    ::unlink(path);
+
+    REQUIRE(
+        contents ==
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42\n"
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 43\n"_format(line, line + 2));
+}
+
+TEST_CASE("logger memory-mapped file test", "[logger]")
+{
+    char path[32] = "/tmp/xtr.test.XXXXXX";
+    ::close(::mkstemp(path));
+
+    std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+    int line;
+
+    {
+        xtr::logger log(
+            xtr::mmap_tag{},
+            path,
+            test_clock{&clock_nanos},
+            xtr::null_command_path);
+        xtr::sink s = log.get_sink("Name");
+        XTR_LOG(s, "Test {}", 42), line = __LINE__;
+        s.sync();
+        XTR_LOG(s, "Test {}", 43);
+    }
+
+    std::ifstream ifs(path);
+    const std::string contents{
+        std::istreambuf_iterator<char>(ifs),
+        std::istreambuf_iterator<char>()};
+    ::unlink(path);
+
+    REQUIRE(
+        contents ==
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42\n"
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 43\n"_format(line, line + 2));
+}
+
+TEST_CASE("logger rotation test", "[logger]")
+{
+    char dir[32] = "/tmp/xtr.test.XXXXXX";
+    REQUIRE(::mkdtemp(dir) != nullptr);
+    const std::string path = std::string(dir) + "/log";
+
+    std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+    int line;
+
+    {
+        // Each record is 59 bytes, so the file is rotated before the third
+        xtr::logger log(
+            xtr::rotation_policy{.max_bytes = 120, .keep = 1},
+            path.c_str(),
+            test_clock{&clock_nanos},
+            xtr::null_command_path);
+        xtr::sink s = log.get_sink("Name");
+        XTR_LOG(s, "Test {}", 42), line = __LINE__;
+        s.sync();
+        XTR_LOG(s, "Test {}", 43);
+        s.sync();
+        XTR_LOG(s, "Test {}", 44);
+    }
+
+    const auto read_file =
+        [](const std::string& p)
+        {
+            std::ifstream ifs(p);
+            std::string contents{
+                std::istreambuf_iterator<char>(ifs),
+                std::istreambuf_iterator<char>()};
+            ::unlink(p.c_str());
+            return contents;
+        };
+
+    const std::string contents = read_file(path);
+    const std::string rotated = read_file(path + ".1");
+    ::rmdir(dir);
+
+    REQUIRE(
+        rotated ==
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42\n"
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 43\n"_format(line, line + 2));
+    REQUIRE(
+        contents ==
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 44\n"_format(line + 4));
+}
+
+TEST_CASE("logger multiple consumer threads output files test", "[logger]")
+{
+    char dir[32] = "/tmp/xtr.test.XXXXXX";
+    REQUIRE(::mkdtemp(dir) != nullptr);
+    const std::string path = std::string(dir) + "/log";
+
+    std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+
+    {
+        xtr::logger log(
+            path.c_str(),
+            std::fopen(path.c_str(), "a"),
+            stderr,
+            test_clock{&clock_nanos},
+            xtr::null_command_path);
+        log.add_consumer_threads(2, path.c_str());
+
+        std::vector<xtr::sink> sinks;
+        for (std::size_t i = 0; i < 3; ++i)
+            sinks.push_back(log.get_sink("Sink{}"_format(i)));
+
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            for (auto& s : sinks)
+                XTR_LOG(s, "Test {}", i);
+        }
+
+        for (auto& s : sinks)
+            s.sync();
+    }
+
+    // Each sink is read by a different consumer thread, so each file holds
+    // every record of exactly one sink, in order
+    std::set<std::string> names;
+    for (const std::string& p : {path, path + ".1", path + ".2"})
+    {
+        std::ifstream ifs(p);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(ifs, line);)
+            lines.push_back(line);
+        ::unlink(p.c_str());
+
+        REQUIRE(lines.size() == 100);
+        const std::string name = lines[0].substr(29, 5);
+        names.insert(name);
+        for (std::size_t i = 0; i < lines.size(); ++i)
+        {
+            INFO(lines[i]);
+            REQUIRE(lines[i].starts_with("I 2000-01-01 01:02:03.123456 " + name + " logger.cpp:"));
+            REQUIRE(lines[i].ends_with(": Test {}"_format(i)));
+        }
+    }
+    ::rmdir(dir);
+
+    REQUIRE(names == std::set<std::string>{"Sink0", "Sink1", "Sink2"});
+}
+
+#if defined(XTR_ENABLE_ZLIB)
+TEST_CASE("logger gzip test", "[logger]")
+{
+    char path[32] = "/tmp/xtr.test.XXXXXX";
+    ::close(::mkstemp(path));
+
+    std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+    int line;
+
+    {
+        xtr::logger log(
+            xtr::gzip_tag{},
+            path,
+            test_clock{&clock_nanos},
+            xtr::null_command_path);
+        xtr::sink s = log.get_sink("Name");
+        XTR_LOG(s, "Test {}", 42), line = __LINE__;
+        s.sync();
+        XTR_LOG(s, "Test {}", 43);
+    }
+
+    // gzread decompresses concatenated gzip members
+    ::gzFile gz = ::gzopen(path, "rb");
+    REQUIRE(gz != nullptr);
+    std::string contents;
+    char buf[256];
+    for (int n; (n = ::gzread(gz, buf, sizeof(buf))) > 0;)
+        contents.append(buf, std::size_t(n));
+    ::gzclose(gz);
+    ::unlink(path);
+
+    REQUIRE(
+        contents ==
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42\n"
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 43\n"_format(line, line + 2));
+}
+#endif
+
+TEST_CASE_METHOD(command_fixture<path_fixture>, "logger reopen command path test", "[logger]")
+{
+    ::unlink(path_);
+
+    struct stat sb;
+
+    REQUIRE(::stat(path_, &sb) == -1);
+
+    xtrd::frame<xtrd::reopen> ro;
+    send_frame<xtrd::success>(ro);
+
+    REQUIRE(::stat(path_, &sb) == 0);
+}
+
+TEST_CASE_METHOD(fixture, "logger socket path too long test", "[logger]")
+{
+    constexpr std::size_t path_size =
+        sizeof(static_cast<sockaddr_un*>(nullptr)->sun_path);
+
+    std::string path(path_size, 'X');
+
+    {
+        capture_cerr capture;
+
+        log_.set_command_path(path);
+
+        const std::string expected =
+            "Error: Command path '" + path + "' is too long\n";
+
+        REQUIRE(capture.buf_.str() == expected);
+    }
+}
+
+TEST_CASE_METHOD(fixture, "logger socket bind error test", "[logger]")
+{
+    std::string path = "/hopefully/this/path/does/not/exist/6aJ^JwK2+E7fgL*5q";
+
+    {
+        capture_cerr capture;
+
+        log_.set_command_path(path);
+
+        const std::string expected =
+            "Error: Failed to bind command socket to path '" + path +
+            "': No such file or directory\n";
+
+        REQUIRE(capture.buf_.str() == expected);
+    }
+}
+
+TEST_CASE("logger open path test", "[logger]")
+{
+    xtr::logger log("/dev/null");
+
+    auto p = log.get_sink("Name");
+
+    XTR_LOG(p, "Test");
+}
+
+TEST_CASE_METHOD(fixture, "logger noexcept test", "[logger]")
+{
+    static_assert(noexcept(XTR_LOG(s_, "Hello world")));
+    static_assert(noexcept(XTR_LOG(s_, "Hello world {}", 123)));
+    static_assert(noexcept(XTR_LOG(s_, "Hello {}", "world")));
+
+    std::string s1("world");
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s1)));
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s1))));
+
+    std::string_view s2("world");
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s2)));
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s2))));
+
+    const char* s3 = "world";
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s3)));
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s3))));
+
+    const char s4[] = "world";
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", s4)));
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(s4))));
+
+    move_thrower mt;
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", mt)));
+    CHECK(!noexcept(XTR_LOG(s_, "Hello {}", std::move(mt))));
+
+    copy_thrower ct;
+    CHECK(!noexcept(XTR_LOG(s_, "Hello {}", ct)));
+    CHECK(noexcept(XTR_LOG(s_, "Hello {}", std::move(ct))));
+}
+
+TEST_CASE_METHOD(fixture, "logger re-register sink test", "[logger]")
+{
+    s_.close();
+    log_.register_sink(s_, "Reregistered");
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Reregistered logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger macro test", "[logger]")
+{
+    xtr::timespec ts{};
+
+    // This test just exists to check if clang emits warnings for ``must
+    // specify at least one argument'' in a variadic macro.
+
+    // XTR_LOG and variants
     XTR_LOG(s_, "Test");
     if (true == false)
         XTR_LOGL(fatal, s_, "Test");
@@ -2245,6 +3560,119 @@ TEST_CASE_METHOD(fixture, "logger macro test", "[logger]")
     XTR_TRY_LOGL_TSC(debug, s_, "Test");
 }
 
+TEST_CASE_METHOD(fixture, "logger every n test", "[logger]")
+{
+    for (std::size_t i = 0; i < 10; ++i)
+        XTR_LOG_EVERY_N(s_, 4, "Test {}", i), line_ = __LINE__;
+    sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 3);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 0"_format(line_));
+    REQUIRE(lines_[1] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 4"_format(line_));
+    REQUIRE(lines_[2] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 8"_format(line_));
+}
+
+TEST_CASE_METHOD(fixture, "logger first n test", "[logger]")
+{
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+        XTR_LOG_FIRST_N(s_, 2, "Test {}", i), line_ = __LINE__;
+        // Statements dropped due to the log level are not counted
+        XTR_LOGL_FIRST_N(debug, s_, 1, "Debug {}", i);
+    }
+    s_.set_level(xtr::log_level_t::debug);
+    XTR_LOGL_FIRST_N(debug, s_, 1, "Debug"); // not the same call site
+    sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 3);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 0"_format(line_));
+    REQUIRE(lines_[1] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 1"_format(line_));
+    REQUIRE(lines_[2] == "D 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Debug"_format(line_ + 5));
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger limited disabled callsite test", "[logger]")
+{
+    const auto every_n =
+        [this](int i)
+        {
+            XTR_LOG_EVERY_N(s_, 3, "Every {}", i), line_ = __LINE__;
+        };
+    const auto first_n =
+        [this](int i)
+        {
+            XTR_LOG_FIRST_N(s_, 1, "First {}", i);
+        };
+
+    const auto set_enabled =
+        [this](int line, bool enabled)
+        {
+            xtrd::frame<xtrd::set_callsite> sc;
+            sc->enabled = enabled;
+            sc->pattern.type = xtrd::pattern_type_t::basic_regex;
+            xtrd::strzcpy(sc->pattern.text, "logger\\.cpp:{}$"_format(line));
+            send_frame<xtrd::success>(sc);
+            reconnect();
+        };
+
+    every_n(0);
+    const int every_n_line = line_;
+    const int first_n_line = line_ + 5;
+
+    // Statements are not counted by the limiter while their callsite is
+    // disabled
+    set_enabled(every_n_line, false);
+    set_enabled(first_n_line, false);
+    for (int i = 1; i < 3; ++i)
+    {
+        every_n(i);
+        first_n(i);
+    }
+    set_enabled(every_n_line, true);
+    set_enabled(first_n_line, true);
+    for (int i = 3; i < 7; ++i)
+    {
+        every_n(i);
+        first_n(i);
+    }
+    sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 3);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Every 0"_format(every_n_line));
+    REQUIRE(lines_[1] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: First 3"_format(first_n_line));
+    REQUIRE(lines_[2] == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Every 5"_format(every_n_line));
+}
+
+TEST_CASE_METHOD(fixture, "logger rate limited test", "[logger]")
+{
+    const auto log =
+        [this](std::size_t i)
+        {
+            XTR_LOGL_RATE_LIMITED(warning, s_, 2, "Test {}", i), line_ = __LINE__;
+        };
+
+    // The first two statements are allowed as a burst
+    for (std::size_t i = 0; i < 5; ++i)
+        log(i);
+    sync();
+    REQUIRE(line_count() == 2);
+
+    // After half a second another statement is allowed, preceded by the
+    // count of suppressed statements
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    log(5);
+    sync();
+
+    std::scoped_lock lock{m_};
+    REQUIRE(lines_.size() == 4);
+    REQUIRE(lines_[0] == "W 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 0"_format(line_));
+    REQUIRE(lines_[1] == "W 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 1"_format(line_));
+    REQUIRE(lines_[2] == "W 2000-01-01 01:02:03.123456 Name logger.cpp:{}: 3 messages suppressed"_format(line_));
+    REQUIRE(lines_[3] == "W 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 5"_format(line_));
+}
+
 TEST_CASE("default_command_path fallback test", "[logger]")
 {
     std::string rundir;
@@ -2392,3 +3820,598 @@ TEST_CASE_METHOD(fixture, "logger fatal test", "[logger]")
     REQUIRE(abort_handler_signo == SIGABRT);
 }
 #endif
+
+TEST_CASE_METHOD(binary_fixture, "logger binary output test", "[logger]")
+{
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+
+    XTR_LOG(s_, "Test {} {} {} {}", (short)-42, 42U, -42LL, 42ULL), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test -42 42 -42 42"_format(line_));
+
+    XTR_LOG(s_, "Test {} {} {:#x}", true, 'c', 255), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test true c 0xff"_format(line_));
+
+    XTR_LOG(s_, "Test {} {:.2f} {}", 42.42f, 42.42f, 42.42), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 42.42 42.42 42.42"_format(line_));
+
+    XTR_LOG(s_, "Test {}", static_cast<const void*>(nullptr)), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 0x0"_format(line_));
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger binary string test", "[logger]")
+{
+    const char* s = "C string";
+    const std::string str = "std::string";
+    const std::string_view sv = "std::string_view";
+
+    XTR_LOG(s_, "Test {} {} {}", s, str, sv), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test C string std::string std::string_view"_format(line_));
+
+    XTR_LOG(s_, "Test {} {} {}", nocopy(s), nocopy(str), nocopy(sv)), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test C string std::string std::string_view"_format(line_));
+
+    const char* u = "\nTest\r\nTest";
+    XTR_LOG(s_, "{}", u), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: \\x0ATest\\x0D\\x0ATest"_format(line_));
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger binary custom formatter test", "[logger]")
+{
+    custom_format c{10, 20};
+    XTR_LOG(s_, "Custom {} {:>10}", c, c), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Custom (10, 20)   (10, 20)"_format(line_));
+
+    streams_format s{10, 20};
+    XTR_LOG(s_, "Streams {}", s), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Streams (10, 20)"_format(line_));
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger binary timestamp test", "[logger]")
+{
+    clock_nanos_ = 4858113906123456000;
+    sync();
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2123-12-13 04:05:06.123456 Name logger.cpp:{}: Test"_format(line_));
+
+    std::timespec ts;
+    ts.tv_sec = 631155723;
+    ts.tv_nsec = 654321000;
+
+    XTR_LOG_TS(s_, xtr::timespec(ts), "Test {}", 42), line_ = __LINE__;
+    REQUIRE(last_line() == "I 1990-01-01 01:02:03.654321 Name logger.cpp:{}: Test 42"_format(line_));
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger binary level and name test", "[logger]")
+{
+    log_.set_log_level_style(xtr::systemd_log_level_style);
+    s_.set_name("Renamed");
+    XTR_LOGL(error, s_, "Test"), line_ = __LINE__;
+    // The level style is applied by the decoder
+    REQUIRE(last_line() == "E 2000-01-01 01:02:03.123456 Renamed logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger binary output function test", "[logger]")
+{
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    sync();
+
+    std::string output;
+    log_.set_output_function(
+        [&](xtr::log_level_t, const char* buf, std::size_t size)
+        {
+            output.append(buf, size);
+            return size;
+        });
+
+    // The header and format records are written again to the new output
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    sync();
+
+    fmt::memory_buffer mbuf;
+    xtrd::binary_decoder decoder;
+    REQUIRE(decoder.decode(output.data(), output.size(), mbuf) == output.size());
+    REQUIRE(std::string(mbuf.data(), mbuf.size()) == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test\n"_format(line_));
+}
+
+TEST_CASE_METHOD(binary_fixture, "logger binary batched output test", "[logger]")
+{
+    std::string output;
+    log_.set_output_function(
+        [&](const char* buf, std::size_t size)
+        {
+            output.append(buf, size);
+            return ::ssize_t(size);
+        });
+
+    XTR_LOG(s_, "Test {}", 1), line_ = __LINE__;
+    XTR_LOGL(warning, s_, "Test {}", 2);
+    sync();
+
+    fmt::memory_buffer mbuf;
+    xtrd::binary_decoder decoder;
+    REQUIRE(decoder.decode(output.data(), output.size(), mbuf) == output.size());
+    REQUIRE(
+        std::string(mbuf.data(), mbuf.size()) ==
+        "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 1\n"
+        "W 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test 2\n"_format(line_, line_ + 1));
+}
+
+#if __cpp_exceptions
+TEST_CASE_METHOD(binary_fixture, "logger binary error handling test", "[logger]")
+{
+    XTR_LOG(s_, "Test {}", thrower{}), line_ = __LINE__;
+    REQUIRE(last_err() == "E 2000-01-01 01:02:03.123456 Name: Error: Exception error text");
+    REQUIRE(lines_.empty());
+
+    // The encoder is reset, so subsequent records remain decodable
+    XTR_LOG(s_, "Test"), line_ = __LINE__;
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test"_format(line_));
+}
+#endif
+
+TEST_CASE_METHOD(fixture, "logger recover test", "[logger]")
+{
+    recovery_dir dir;
+
+    line_ = __LINE__ + 6;
+    const ::pid_t pid =
+        log_and_exit(
+            dir.path_,
+            [](xtr::sink& s)
+            {
+                XTR_LOG(s, "Test");
+                XTR_LOGL(warning, s, "Test {}", 42);
+                XTR_LOG(s, "Test {} {}", std::string("string"), 42.42);
+            });
+
+    REQUIRE(dir.files().size() == 1);
+
+    REQUIRE(log_.recover(dir.path_) == 1);
+    sync();
+
+    REQUIRE(lines_.size() == 4);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test"_format(line_));
+    REQUIRE(lines_[1] == "W 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test 42"_format(line_ + 1));
+    REQUIRE(lines_[2] == "I 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test string 42.42"_format(line_ + 2));
+    REQUIRE(lines_[3] == "W 2000-01-01 01:02:03.123456 Recovered: Recovered 3 log records from process {}"_format(pid));
+
+    // The file is removed after recovery
+    REQUIRE(dir.files().empty());
+    REQUIRE(log_.recover(dir.path_) == 0);
+}
+
+TEST_CASE_METHOD(fixture, "logger recover process test", "[logger]")
+{
+    recovery_dir dir;
+
+    line_ = __LINE__ + 6;
+    const ::pid_t pid =
+        log_and_exit(
+            dir.path_,
+            [](xtr::sink& s)
+            {
+                XTR_LOG(s, "Test {}", formatting_comm{});
+            });
+
+    // Records are formatted by a new instance of the executable, which is
+    // given the logger's log level style
+    log_.set_log_level_style(custom_log_level_style);
+    REQUIRE(log_.recover(dir.path_) == 1);
+    sync();
+
+    REQUIRE(lines_.size() == 2);
+    REQUIRE(lines_[0] == "Custom 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test xtr-recover"_format(line_));
+    REQUIRE(lines_[1] == "Custom 2000-01-01 01:02:03.123456 Recovered: Recovered 1 log records from process {}"_format(pid));
+}
+
+TEST_CASE_METHOD(fixture, "logger recover wrapped queue test", "[logger]")
+{
+    recovery_dir dir;
+
+    // Records are consumed until the queue has wrapped several times, so the
+    // records to be recovered do not begin at the start of the queue
+    line_ = __LINE__ + 13;
+    const ::pid_t pid =
+        log_and_exit(
+            dir.path_,
+            4096,
+            [](xtr::sink& s)
+            {
+                for (int i = 0; i < 1000; ++i)
+                    XTR_LOG(s, "Test {}", i);
+            },
+            [](xtr::sink& s)
+            {
+                for (int i = 1000; i < 1100; ++i)
+                    XTR_LOG(s, "Test {}", i);
+            });
+
+    REQUIRE(log_.recover(dir.path_) == 1);
+    sync();
+
+    REQUIRE(lines_.size() == 101);
+    for (std::size_t i = 0; i < 100; ++i)
+        REQUIRE(lines_[i] == "I 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test {}"_format(line_, 1000 + i));
+    REQUIRE(lines_[100] == "W 2000-01-01 01:02:03.123456 Recovered: Recovered 100 log records from process {}"_format(pid));
+}
+
+TEST_CASE_METHOD(fixture, "logger recovery file removed on close test", "[logger]")
+{
+    recovery_dir dir;
+
+    log_.set_recovery_directory(dir.path_);
+    xtr::sink s = log_.get_sink("Recoverable");
+    REQUIRE(dir.files().size() == 1);
+
+    // Files belonging to running processes are not recovered
+    REQUIRE(log_.recover(dir.path_) == 0);
+    REQUIRE(dir.files().size() == 1);
+
+    XTR_LOG(s, "Test"), line_ = __LINE__;
+    s.sync();
+    REQUIRE(last_line() == "I 2000-01-01 01:02:03.123456 Recoverable logger.cpp:{}: Test"_format(line_));
+
+    s.close();
+    REQUIRE(dir.files().empty());
+
+    // Sinks are not recoverable once the recovery directory is cleared
+    log_.set_recovery_directory("");
+    xtr::sink s2 = log_.get_sink("Unrecoverable");
+    REQUIRE(dir.files().empty());
+}
+
+TEST_CASE_METHOD(fixture, "logger recover untrusted file test", "[logger]")
+{
+    recovery_dir dir;
+
+    line_ = __LINE__ + 6;
+    const ::pid_t pid =
+        log_and_exit(
+            dir.path_,
+            [](xtr::sink& s)
+            {
+                XTR_LOG(s, "Test");
+            });
+
+    REQUIRE(dir.files().size() == 1);
+    const std::string path = dir.subdir() + "/" + dir.files()[0];
+    const std::string target = std::string(dir.path_) + "/target";
+
+    // Symbolic links are not followed
+    REQUIRE(::rename(path.c_str(), target.c_str()) == 0);
+    REQUIRE(::symlink(target.c_str(), path.c_str()) == 0);
+    REQUIRE(log_.recover(dir.path_) == 0);
+    REQUIRE(::unlink(path.c_str()) == 0);
+    REQUIRE(::rename(target.c_str(), path.c_str()) == 0);
+
+    // Files writable by other users are ignored
+    REQUIRE(::chmod(path.c_str(), 0660) == 0);
+    REQUIRE(log_.recover(dir.path_) == 0);
+    REQUIRE(::chmod(path.c_str(), 0606) == 0);
+    REQUIRE(log_.recover(dir.path_) == 0);
+
+    // Files owned by other users are ignored, which can only be tested if
+    // running as root
+    if (::geteuid() == 0)
+    {
+        REQUIRE(::chown(path.c_str(), 1, ::getegid()) == 0);
+        REQUIRE(::chmod(path.c_str(), 0600) == 0);
+        REQUIRE(log_.recover(dir.path_) == 0);
+        REQUIRE(::chown(path.c_str(), 0, ::getegid()) == 0);
+    }
+
+    // Nothing has been written, and the untrusted file was left in place
+    sync();
+    REQUIRE(lines_.empty());
+    REQUIRE(dir.files().size() == 1);
+
+    REQUIRE(::chmod(path.c_str(), 0600) == 0);
+    REQUIRE(log_.recover(dir.path_) == 1);
+    sync();
+
+    REQUIRE(lines_.size() == 2);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test"_format(line_));
+    REQUIRE(lines_[1] == "W 2000-01-01 01:02:03.123456 Recovered: Recovered 1 log records from process {}"_format(pid));
+}
+
+#if __cpp_exceptions
+TEST_CASE_METHOD(fixture, "logger recovery directory permissions test", "[logger]")
+{
+    recovery_dir dir;
+
+    // The subdirectory is created with mode 0700
+    log_.set_recovery_directory(dir.path_);
+    struct ::stat st;
+    REQUIRE(::lstat(dir.subdir().c_str(), &st) == 0);
+    REQUIRE(S_ISDIR(st.st_mode));
+    REQUIRE((st.st_mode & 0777) == 0700);
+
+    // A subdirectory that other users may access is rejected
+    REQUIRE(::chmod(dir.subdir().c_str(), 0755) == 0);
+    REQUIRE_THROWS_AS(log_.set_recovery_directory(dir.path_), std::system_error);
+    REQUIRE_THROWS_AS(log_.recover(dir.path_), std::system_error);
+
+    // As is a symbolic link to a directory
+    REQUIRE(::chmod(dir.subdir().c_str(), 0700) == 0);
+    const std::string target = std::string(dir.path_) + "/target";
+    REQUIRE(::rename(dir.subdir().c_str(), target.c_str()) == 0);
+    REQUIRE(::symlink(target.c_str(), dir.subdir().c_str()) == 0);
+    REQUIRE_THROWS_AS(log_.set_recovery_directory(dir.path_), std::system_error);
+    REQUIRE_THROWS_AS(log_.recover(dir.path_), std::system_error);
+    REQUIRE(::unlink(dir.subdir().c_str()) == 0);
+    REQUIRE(::rmdir(target.c_str()) == 0);
+
+    // A directory without a subdirectory has no files to recover
+    REQUIRE(log_.recover(dir.path_) == 0);
+}
+
+TEST_CASE_METHOD(fixture, "logger recover invalid directory test", "[logger]")
+{
+    REQUIRE_THROWS_AS(log_.recover("/xtr/no/such/directory"), std::system_error);
+}
+#endif
+
+TEST_CASE_METHOD(command_fixture<>, "logger recover command test", "[logger]")
+{
+    recovery_dir dir;
+
+    line_ = __LINE__ + 5;
+    log_and_exit(
+        dir.path_,
+        [](xtr::sink& s)
+        {
+            XTR_LOG(s, "Test {}", 42);
+        });
+
+    xtrd::frame<xtrd::recover> rc;
+    xtrd::strzcpy(rc->path, std::string_view{dir.path_});
+    send_frame<xtrd::success>(rc);
+
+    sync();
+    REQUIRE(lines_.size() == 2);
+    REQUIRE(lines_[0] == "I 2000-01-01 01:02:03.123456 Recovered logger.cpp:{}: Test 42"_format(line_));
+    REQUIRE(dir.files().empty());
+}
+
+TEST_CASE_METHOD(command_fixture<>, "logger recover command error test", "[logger]")
+{
+    xtrd::frame<xtrd::recover> rc;
+    xtrd::strzcpy(rc->path, std::string_view{"/xtr/no/such/directory"});
+    const auto errors = send_frame<xtrd::error>(rc);
+
+    using namespace std::literals::string_view_literals;
+
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0].reason == "No such file or directory"sv);
+}
+
+TEST_CASE_METHOD(process_fixture, "logger consumer process test", "[logger]")
+{
+    xtr::sink s = log_.get_sink("Remote");
+
+    XTR_LOG(s, "Test {} {}", std::string("string"), 42), line_ = __LINE__;
+    s.sync();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test string 42"_format(line_));
+
+    // Records are formatted by the consumer process
+    XTR_LOG(s, "Test {}", formatting_pid{}), line_ = __LINE__;
+    s.sync();
+    const std::string prefix =
+        "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test "_format(line_);
+    const std::string line = last_file_line();
+    REQUIRE(line.starts_with(prefix));
+    const std::string pid = line.substr(prefix.size());
+    REQUIRE(pid != std::to_string(::getpid()));
+
+    std::ifstream comm("/proc/" + pid + "/comm");
+    std::string name;
+    std::getline(comm, name);
+    REQUIRE(name == "xtrd");
+
+    // Sinks created before the consumer process was started are unaffected
+    XTR_LOG(s_, "Test {}", formatting_pid{}), line_ = __LINE__;
+    s_.sync();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Name logger.cpp:{}: Test {}"_format(line_, ::getpid()));
+}
+
+TEST_CASE_METHOD(process_fixture, "logger consumer process set_name test", "[logger]")
+{
+    xtr::sink s = log_.get_sink("Remote");
+
+    s.set_name("Renamed");
+    XTR_LOG(s, "Test"), line_ = __LINE__;
+    s.sync();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Renamed logger.cpp:{}: Test"_format(line_));
+}
+
+TEST_CASE_METHOD(process_fixture, "logger consumer process copy and close test", "[logger]")
+{
+    xtr::sink s = log_.get_sink("Remote");
+
+    // Copies of remote sinks are consumed by the consumer thread
+    xtr::sink copy = s;
+    XTR_LOG(copy, "Test {}", formatting_pid{}), line_ = __LINE__;
+    copy.sync();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test {}"_format(line_, ::getpid()));
+
+    XTR_LOG(s, "Test"), line_ = __LINE__;
+    s.close();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test"_format(line_));
+
+    // As are closed remote sinks that are registered again
+    log_.register_sink(s, "Local");
+    XTR_LOG(s, "Test {}", formatting_pid{}), line_ = __LINE__;
+    s.sync();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Local logger.cpp:{}: Test {}"_format(line_, ::getpid()));
+}
+
+TEST_CASE_METHOD(command_fixture<process_fixture>, "logger consumer process reopen command test", "[logger]")
+{
+    xtr::sink s = log_.get_sink("Remote");
+
+    ::unlink(path_);
+
+    xtrd::frame<xtrd::reopen> ro;
+    send_frame<xtrd::success>(ro);
+
+    // The consumer process reopens its back-end before it next reads the
+    // sink after the first record has been consumed
+    XTR_LOG(s, "Test");
+    s.sync();
+    XTR_LOG(s, "Test {}", 42), line_ = __LINE__;
+    s.sync();
+    REQUIRE(last_file_line() == "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test 42"_format(line_));
+}
+
+TEST_CASE_METHOD(path_fixture, "logger consumer process other threads test", "[logger]")
+{
+    // Forking while another thread exists is refused
+    std::atomic<bool> stop{false};
+    std::thread t(
+        [&]()
+        {
+            while (!stop)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    REQUIRE_THROWS_AS(log_.start_consumer_process(), std::runtime_error);
+    stop = true;
+    t.join();
+
+    log_.start_consumer_process();
+    xtr::sink s = log_.get_sink("Remote");
+    int line;
+    XTR_LOG(s, "Test {}", 42), line = __LINE__;
+    s.sync();
+    REQUIRE(read_lines(path_).back() == "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test 42"_format(line));
+}
+
+#if __cpp_exceptions
+TEST_CASE("logger consumer process startup order test", "[logger]")
+{
+    char path[] = "/tmp/xtr.test.XXXXXX";
+    ::close(::mkstemp(path));
+
+    // The supported order: the consumer process is started immediately after
+    // constructing the logger (while the TSC may still be being calibrated),
+    // then other threads are started, which use sinks as usual
+    const int line = __LINE__ + 19;
+    const ::pid_t pid = ::fork();
+    REQUIRE(pid != -1);
+
+    if (pid == 0)
+    {
+        std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+        xtr::logger log(
+            path, test_clock{&clock_nanos}, xtr::null_command_path);
+        log.start_consumer_process();
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back(
+                [&log, i]()
+                {
+                    xtr::sink s = log.get_sink("Thread" + std::to_string(i));
+                    for (int j = 0; j < 100; ++j)
+                        XTR_LOG(s, "Test {}", j);
+                });
+        }
+        for (auto& t : threads)
+            t.join();
+
+        // A pool of threads now exists, so a second logger cannot start a
+        // consumer process
+        std::atomic<bool> stop{false};
+        std::thread pool(
+            [&]()
+            {
+                while (!stop)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            });
+        bool refused = false;
+        try
+        {
+            xtr::logger other(
+                "/dev/null", test_clock{&clock_nanos}, xtr::null_command_path);
+            other.start_consumer_process();
+        }
+        catch (const std::runtime_error&)
+        {
+            refused = true;
+        }
+        stop = true;
+        pool.join();
+
+        ::_exit(refused ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    int status;
+    REQUIRE(::waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == EXIT_SUCCESS);
+
+    // The consumer process writes the remaining records then exits
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000 && lines.size() < 400; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        lines = read_lines(path);
+    }
+    ::unlink(path);
+
+    REQUIRE(lines.size() == 400);
+    for (int i = 0; i < 4; ++i)
+    {
+        const std::string prefix =
+            "I 2000-01-01 01:02:03.123456 Thread{} logger.cpp:{}: Test "_format(i, line);
+        int j = 0;
+        for (const auto& l : lines)
+        {
+            if (l.starts_with(prefix))
+                REQUIRE(l == prefix + std::to_string(j++));
+        }
+        REQUIRE(j == 100);
+    }
+}
+#endif
+
+TEST_CASE("logger consumer process application exit test", "[logger]")
+{
+    char path[] = "/tmp/xtr.test.XXXXXX";
+    ::close(::mkstemp(path));
+
+    const int line = __LINE__ + 12;
+    const ::pid_t pid = ::fork();
+    REQUIRE(pid != -1);
+
+    if (pid == 0)
+    {
+        std::atomic<std::int64_t> clock_nanos{946688523123456789L};
+        xtr::logger log(
+            path, test_clock{&clock_nanos}, xtr::null_command_path);
+        log.start_consumer_process();
+        xtr::sink s = log.get_sink("Remote");
+        for (int i = 0; i < 1000; ++i)
+            XTR_LOG(s, "Test {}", i);
+        // Exit without closing the sink or destroying the logger
+        ::_exit(EXIT_SUCCESS);
+    }
+
+    int status;
+    REQUIRE(::waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+
+    // The consumer process writes the remaining records then exits
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000 && lines.size() < 1000; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        lines = read_lines(path);
+    }
+    ::unlink(path);
+
+    REQUIRE(lines.size() == 1000);
+    for (std::size_t i = 0; i < lines.size(); ++i)
+        REQUIRE(lines[i] == "I 2000-01-01 01:02:03.123456 Remote logger.cpp:{}: Test {}"_format(line, i));
+}
@@ -0,0 +1,240 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/mapped_file.hpp"
+#include "xtr/detail/pagesize.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    struct fixture
+    {
+        fixture()
+        {
+            const int fd = ::mkstemp(path_);
+            REQUIRE(fd != -1);
+            ::close(fd);
+        }
+
+        ~fixture()
+        {
+            ::unlink(path_);
+        }
+
+        std::string contents(const char* path = nullptr) const
+        {
+            std::ifstream ifs(path == nullptr ? path_ : path);
+            return
+                std::string(
+                    std::istreambuf_iterator<char>(ifs),
+                    std::istreambuf_iterator<char>());
+        }
+
+        ::off_t file_size() const
+        {
+            struct ::stat st;
+            REQUIRE(::stat(path_, &st) == 0);
+            return st.st_size;
+        }
+
+        char path_[32] = "/tmp/xtr.test.XXXXXX";
+    };
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file write test", "[mapped_file]")
+{
+    std::string expected;
+
+    {
+        // Single page window so that the window is advanced many times
+        xtrd::mapped_file f(path_, 1);
+
+        for (std::size_t i = 0; i < 500; ++i)
+        {
+            const std::string s(i, char('a' + i % 26));
+            REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+            expected += s;
+            if (i % 100 == 0)
+                f.sync();
+            f.flush();
+        }
+    }
+
+    REQUIRE(contents() == expected);
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file large write test", "[mapped_file]")
+{
+    const std::size_t page_size = xtrd::align_to_page_size(1);
+    // Spans several windows in a single write
+    const std::string s(page_size * 5 + 7, 'x');
+
+    {
+        xtrd::mapped_file f(path_, page_size * 2);
+        REQUIRE(f.write("Hi", 2) == 2);
+        REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+    }
+
+    REQUIRE(contents() == "Hi" + s);
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file size test", "[mapped_file]")
+{
+    const std::size_t page_size = xtrd::align_to_page_size(1);
+
+    xtrd::mapped_file f(path_, page_size * 4);
+    // Opening the file does not change its size
+    REQUIRE(file_size() == 0);
+
+    REQUIRE(f.write("Test", 4) == 4);
+    // While open the file is extended to the end of the window, so that
+    // writes within the window do not change its size
+    REQUIRE(file_size() == ::off_t(page_size * 4));
+
+    const std::string s(page_size, 'x');
+    REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+    REQUIRE(file_size() == ::off_t(page_size * 4));
+
+    f.close();
+    REQUIRE(file_size() == ::off_t(page_size + 4));
+    REQUIRE(contents() == "Test" + s);
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file append test", "[mapped_file]")
+{
+    {
+        xtrd::mapped_file f(path_);
+        REQUIRE(f.write("Hello ", 6) == 6);
+    }
+
+    {
+        xtrd::mapped_file f(path_);
+        REQUIRE(f.write("world", 5) == 5);
+    }
+
+    REQUIRE(contents() == "Hello world");
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file crash padding test", "[mapped_file]")
+{
+    const std::size_t page_size = xtrd::align_to_page_size(1);
+
+    // Simulates a file left by a crash, padded to the end of a window
+    {
+        std::string padded(page_size * 4, '\0');
+        padded.replace(0, page_size + 5, page_size + 5, 'x');
+        std::ofstream ofs(path_);
+        ofs << padded;
+    }
+
+    {
+        xtrd::mapped_file f(path_, page_size * 4);
+        REQUIRE(file_size() == ::off_t(page_size + 5));
+        REQUIRE(f.write("Test", 4) == 4);
+    }
+
+    REQUIRE(contents() == std::string(page_size + 5, 'x') + "Test");
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file crash padding whole window test", "[mapped_file]")
+{
+    const std::size_t page_size = xtrd::align_to_page_size(1);
+
+    // Only the last window may contain padding, so zero bytes before it are
+    // preserved
+    {
+        std::string padded(page_size * 3, '\0');
+        padded[0] = 'x';
+        std::ofstream ofs(path_);
+        ofs << padded;
+    }
+
+    {
+        xtrd::mapped_file f(path_, page_size * 2);
+        REQUIRE(file_size() == ::off_t(page_size));
+    }
+
+    std::string expected(page_size, '\0');
+    expected[0] = 'x';
+    REQUIRE(contents() == expected);
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file reopen test", "[mapped_file]")
+{
+    char rotated_path[64];
+    std::snprintf(rotated_path, sizeof(rotated_path), "%s.1", path_);
+
+    {
+        xtrd::mapped_file f(path_);
+        REQUIRE(f.write("Before", 6) == 6);
+        REQUIRE(::rename(path_, rotated_path) == 0);
+        REQUIRE(f.reopen());
+        REQUIRE(f.write("After", 5) == 5);
+    }
+
+    // The rotated file is trimmed when the back-end is reopened
+    REQUIRE(contents(rotated_path) == "Before");
+    REQUIRE(contents() == "After");
+
+    ::unlink(rotated_path);
+}
+
+TEST_CASE_METHOD(fixture, "mapped_file close test", "[mapped_file]")
+{
+    xtrd::mapped_file f(path_);
+    REQUIRE(f.write("Test", 4) == 4);
+    f.close();
+    REQUIRE(contents() == "Test");
+
+    errno = 0;
+    REQUIRE(f.write("Test", 4) == -1);
+    REQUIRE(errno == EBADF);
+}
+
+#if __cpp_exceptions
+TEST_CASE("mapped_file open error test", "[mapped_file]")
+{
+    REQUIRE_THROWS_AS(
+        xtrd::mapped_file("/nonexistent/xtr.test"),
+        std::system_error);
+}
+
+TEST_CASE("mapped_file window size test", "[mapped_file]")
+{
+    REQUIRE_THROWS_AS(
+        xtrd::mapped_file("/tmp/xtr.test", 0),
+        std::invalid_argument);
+}
+#endif
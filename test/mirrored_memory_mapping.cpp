@@ -23,6 +23,7 @@
 
 #include <catch2/catch.hpp>
 
+#include <cstdint>
 #include <stdexcept>
 #include <utility>
 
@@ -102,6 +103,48 @@ TEST_CASE("mirrored_memory_mapping file mapping", "[mirrored_memory_mapping]")
     ::close(fd);
 }
 
+#if defined(MAP_HUGETLB)
+TEST_CASE("mirrored_memory_mapping huge page mapping", "[mirrored_memory_mapping]")
+{
+    // Huge pages may not be available, in which case normal pages are used
+    xtrd::mirrored_memory_mapping m(xtrd::huge_page_size, -1, 0, MAP_HUGETLB);
+
+    if (m.huge_pages())
+    {
+        REQUIRE(
+            reinterpret_cast<std::uintptr_t>(m.get()) %
+                xtrd::huge_page_size == 0);
+    }
+
+    test_mirroring(m);
+}
+
+TEST_CASE("mirrored_memory_mapping huge page mapping fallback", "[mirrored_memory_mapping]")
+{
+    // Lengths that are not a multiple of the huge page size use normal pages
+    const std::size_t len = xtrd::align_to_page_size(1);
+
+    xtrd::mirrored_memory_mapping m(len, -1, 0, MAP_HUGETLB);
+
+    REQUIRE(!m.huge_pages());
+    test_mirroring(m);
+}
+#endif
+
+TEST_CASE("mirrored_memory_mapping numa node", "[mirrored_memory_mapping]")
+{
+    const std::size_t len = xtrd::align_to_page_size(1);
+
+#if defined(MAP_POPULATE)
+    xtrd::mirrored_memory_mapping m(len, -1, 0, MAP_POPULATE, 0);
+#else
+    xtrd::mirrored_memory_mapping m(len, -1, 0, 0, 0);
+#endif
+
+    REQUIRE(m.numa_node() == 0);
+    test_mirroring(m);
+}
+
 #if __cpp_exceptions
 TEST_CASE("mirrored_memory_mapping size not page aligned", "[mirrored_memory_mapping]")
 {
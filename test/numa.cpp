@@ -0,0 +1,80 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/numa.hpp"
+#include "xtr/detail/numa.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+#include <system_error>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace xtrd = xtr::detail;
+
+#if defined(__linux__)
+TEST_CASE("numa_node_of_cpu test", "[numa]")
+{
+    if (::access("/sys/devices/system/node", F_OK) != 0)
+        return; // Kernel built without NUMA support
+
+    REQUIRE(xtr::numa_node_of_cpu() >= 0);
+    REQUIRE(xtr::numa_node_of_cpu(0) >= 0);
+    REQUIRE(xtr::numa_node_of_cpu(1 << 20) == xtr::no_numa_node);
+}
+
+TEST_CASE("bind_thread_to_numa_node test", "[numa]")
+{
+    if (::access("/sys/devices/system/node", F_OK) != 0)
+        return;
+
+    cpu_set_t saved;
+    REQUIRE(::pthread_getaffinity_np(::pthread_self(), sizeof(saved), &saved) == 0);
+
+    const int node = xtr::numa_node_of_cpu(0);
+    xtrd::bind_thread_to_numa_node(::pthread_self(), node);
+
+    // The thread may only run on CPUs belonging to the node
+    cpu_set_t cpus;
+    REQUIRE(::pthread_getaffinity_np(::pthread_self(), sizeof(cpus), &cpus) == 0);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &cpus))
+            REQUIRE(xtr::numa_node_of_cpu(cpu) == node);
+    }
+
+    REQUIRE(::pthread_setaffinity_np(::pthread_self(), sizeof(saved), &saved) == 0);
+}
+
+#if __cpp_exceptions
+TEST_CASE("bind_thread_to_numa_node invalid node test", "[numa]")
+{
+    REQUIRE_THROWS_AS(
+        xtrd::bind_thread_to_numa_node(::pthread_self(), -1),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        xtrd::bind_thread_to_numa_node(::pthread_self(), 1 << 20),
+        std::system_error);
+}
+#endif
+#endif
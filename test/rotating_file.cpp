@@ -0,0 +1,351 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/rotating_file.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace xtrd = xtr::detail;
+
+using namespace std::literals::chrono_literals;
+
+namespace
+{
+    struct fixture
+    {
+        fixture()
+        {
+            REQUIRE(::mkdtemp(dir_) != nullptr);
+            path_ = std::string(dir_) + "/log";
+        }
+
+        ~fixture()
+        {
+            for (const char* suffix : {"", ".1", ".2", ".3", ".next"})
+                ::unlink((path_ + suffix).c_str());
+            ::rmdir(dir_);
+        }
+
+        std::string contents(const char* suffix = "") const
+        {
+            std::ifstream ifs(path_ + suffix);
+            return
+                std::string(
+                    std::istreambuf_iterator<char>(ifs),
+                    std::istreambuf_iterator<char>());
+        }
+
+        bool exists(const char* suffix) const
+        {
+            return ::access((path_ + suffix).c_str(), F_OK) == 0;
+        }
+
+        char dir_[32] = "/tmp/xtr.test.XXXXXX";
+        std::string path_;
+    };
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file size test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 10, .keep = 2});
+
+        for (const char* s : {"aaaa\n", "bbbb\n", "cccc\n", "dddd\n", "eeee\n"})
+        {
+            REQUIRE(f.write(s, 5) == 5);
+            f.flush();
+        }
+
+        REQUIRE(f.rotation_count() == 2);
+    }
+
+    REQUIRE(contents() == "eeee\n");
+    REQUIRE(contents(".1") == "cccc\ndddd\n");
+    REQUIRE(contents(".2") == "aaaa\nbbbb\n");
+    REQUIRE(!exists(".3"));
+    // The next file is removed when the file is closed
+    REQUIRE(!exists(".next"));
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file keep test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 5, .keep = 1});
+
+        for (const char* s : {"aaaa\n", "bbbb\n", "cccc\n"})
+            REQUIRE(f.write(s, 5) == 5);
+
+        REQUIRE(f.rotation_count() == 2);
+    }
+
+    REQUIRE(contents() == "cccc\n");
+    REQUIRE(contents(".1") == "bbbb\n");
+    REQUIRE(!exists(".2"));
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file keep none test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 5});
+
+        REQUIRE(f.write("aaaa\n", 5) == 5);
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+
+        REQUIRE(f.rotation_count() == 1);
+    }
+
+    REQUIRE(contents() == "bbbb\n");
+    REQUIRE(!exists(".1"));
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file failed rotation test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 5, .keep = 2});
+
+        REQUIRE(f.write("aaaa\n", 5) == 5);
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+
+        // Rotation fails after shifting the rotated files, as the next file
+        // cannot be renamed over the current file
+        f.flush();
+        REQUIRE(::unlink((path_ + ".next").c_str()) == 0);
+
+        REQUIRE(f.write("cccc\n", 5) == 5);
+        REQUIRE(f.write("dddd\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+
+        // Retrying the rotation does not shift the rotated files again
+        std::this_thread::sleep_for(xtrd::rotating_file::rotation_retry_interval);
+        REQUIRE(f.write("eeee\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+    }
+
+    REQUIRE(contents() == "bbbb\ncccc\ndddd\neeee\n");
+    REQUIRE(!exists(".1"));
+    REQUIRE(contents(".2") == "aaaa\n");
+    REQUIRE(!exists(".3"));
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file failed rotation backoff test", "[rotating_file]")
+{
+    const std::string next = path_ + ".next";
+    const std::string s(xtrd::rotating_file::rotation_retry_bytes, 'x');
+
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 5, .keep = 1});
+
+        // The next file cannot be created while a directory is in its place
+        REQUIRE(::mkdir(next.c_str(), 0700) == 0);
+        REQUIRE(f.write("aaaa\n", 5) == 5);
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 0);
+        REQUIRE(::rmdir(next.c_str()) == 0);
+
+        // Rotation is not retried until enough data has been written
+        REQUIRE(f.write("cccc\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 0);
+        REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+        REQUIRE(f.rotation_count() == 0);
+        REQUIRE(f.write("dddd\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+
+        // Or until enough time has passed
+        REQUIRE(::mkdir(next.c_str(), 0700) == 0);
+        REQUIRE(f.write("eeee\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+        REQUIRE(::rmdir(next.c_str()) == 0);
+        REQUIRE(f.write("ffff\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+        std::this_thread::sleep_for(xtrd::rotating_file::rotation_retry_interval);
+        REQUIRE(f.write("gggg\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 2);
+    }
+
+    REQUIRE(contents() == "gggg\n");
+    REQUIRE(contents(".1") == "dddd\neeee\nffff\n");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file release space test", "[rotating_file]")
+{
+    constexpr std::size_t max_bytes = 1024 * 1024;
+
+    {
+        xtrd::rotating_file f(
+            path_.c_str(),
+            {.max_bytes = max_bytes, .max_age = 50ms, .keep = 1});
+
+        // The second file is allocated max_bytes in advance (if supported
+        // by the file system) when the first file is flushed
+        REQUIRE(f.write("aaaa\n", 5) == 5);
+        f.flush();
+        std::this_thread::sleep_for(100ms);
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+        std::this_thread::sleep_for(100ms);
+        REQUIRE(f.write("cccc\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 2);
+    }
+
+    // Blocks allocated beyond the end of the rotated and closed files have
+    // been released
+    for (const char* suffix : {"", ".1"})
+    {
+        struct ::stat st;
+        REQUIRE(::stat((path_ + suffix).c_str(), &st) == 0);
+        REQUIRE(std::size_t(st.st_blocks) * 512 < max_bytes);
+    }
+    REQUIRE(contents(".1") == "bbbb\n");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file large write test", "[rotating_file]")
+{
+    // Larger than both max_bytes and the buffer
+    const std::string s(xtrd::rotating_file::buffer_size + 1, 'x');
+
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 10, .keep = 2});
+
+        REQUIRE(f.write("aaaa\n", 5) == 5);
+        REQUIRE(f.write(s.data(), s.size()) == ::ssize_t(s.size()));
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+
+        REQUIRE(f.rotation_count() == 2);
+    }
+
+    REQUIRE(contents() == "bbbb\n");
+    REQUIRE(contents(".1") == s);
+    REQUIRE(contents(".2") == "aaaa\n");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file age test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {.max_age = 50ms, .keep = 1});
+
+        REQUIRE(f.write("aaaa\n", 5) == 5);
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 0);
+
+        std::this_thread::sleep_for(100ms);
+
+        REQUIRE(f.write("cccc\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+    }
+
+    REQUIRE(contents() == "cccc\n");
+    REQUIRE(contents(".1") == "aaaa\nbbbb\n");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file next file test", "[rotating_file]")
+{
+    xtrd::rotating_file f(path_.c_str(), {.max_bytes = 10, .keep = 1});
+
+    REQUIRE(!exists(".next"));
+    REQUIRE(f.write("aaaa\n", 5) == 5);
+    // The next file is created ahead of rotation when flushed
+    f.flush();
+    REQUIRE(exists(".next"));
+    REQUIRE(contents() == "aaaa\n");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file no policy test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {});
+        REQUIRE(f.write("Hello ", 6) == 6);
+        f.flush();
+        REQUIRE(!exists(".next"));
+    }
+
+    {
+        xtrd::rotating_file f(path_.c_str(), {});
+        REQUIRE(f.write("world", 5) == 5);
+        REQUIRE(f.rotation_count() == 0);
+    }
+
+    REQUIRE(contents() == "Hello world");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file existing file test", "[rotating_file]")
+{
+    {
+        std::ofstream ofs(path_);
+        ofs << "aaaa\n";
+    }
+
+    {
+        // The size of the existing file counts towards max_bytes
+        xtrd::rotating_file f(path_.c_str(), {.max_bytes = 8, .keep = 1});
+        REQUIRE(f.write("bbbb\n", 5) == 5);
+        REQUIRE(f.rotation_count() == 1);
+    }
+
+    REQUIRE(contents() == "bbbb\n");
+    REQUIRE(contents(".1") == "aaaa\n");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file reopen test", "[rotating_file]")
+{
+    {
+        xtrd::rotating_file f(path_.c_str(), {});
+        REQUIRE(f.write("Before", 6) == 6);
+        REQUIRE(::rename(path_.c_str(), (path_ + ".3").c_str()) == 0);
+        REQUIRE(f.reopen());
+        REQUIRE(f.write("After", 5) == 5);
+    }
+
+    REQUIRE(contents(".3") == "Before");
+    REQUIRE(contents() == "After");
+}
+
+TEST_CASE_METHOD(fixture, "rotating_file close test", "[rotating_file]")
+{
+    xtrd::rotating_file f(path_.c_str(), {});
+    REQUIRE(f.write("Test", 4) == 4);
+    f.close();
+    REQUIRE(contents() == "Test");
+
+    errno = 0;
+    REQUIRE(f.write("Test", 4) == -1);
+    REQUIRE(errno == EBADF);
+}
+
+#if __cpp_exceptions
+TEST_CASE("rotating_file open error test", "[rotating_file]")
+{
+    REQUIRE_THROWS_AS(
+        xtrd::rotating_file("/nonexistent/xtr.test", {}),
+        std::system_error);
+}
+#endif
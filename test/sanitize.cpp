@@ -0,0 +1,97 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/sanitize.hpp"
+#include "xtr/detail/string_ref.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <string>
+#include <string_view>
+
+namespace
+{
+    std::string sanitize_reference(std::string_view s)
+    {
+        std::string result;
+        auto pos = std::back_inserter(result);
+        for (const char c : s)
+            xtr::detail::sanitize_char_to(pos, c);
+        return result;
+    }
+
+    std::string sanitize(std::string_view s)
+    {
+        return fmt::format("{}", xtr::detail::string_ref(s));
+    }
+}
+
+TEST_CASE("find_unsafe_char all characters", "[sanitize]")
+{
+    // Place each character at every offset within a string long enough to
+    // exercise the vector loops and the scalar tail
+    for (int c = 0; c < 256; ++c)
+    {
+        for (std::size_t len = 1; len <= 70; ++len)
+        {
+            for (std::size_t off = 0; off < len; ++off)
+            {
+                std::string s(len, 'a');
+                s[off] = char(c);
+                const bool safe = xtr::detail::is_safe_char(char(c));
+                const char* p =
+                    xtr::detail::find_unsafe_char(s.data(), s.data() + len);
+                if (safe)
+                    REQUIRE(p == s.data() + len);
+                else
+                    REQUIRE(p == s.data() + off);
+            }
+        }
+    }
+}
+
+TEST_CASE("find_unsafe_char empty", "[sanitize]")
+{
+    const char* s = "";
+    REQUIRE(xtr::detail::find_unsafe_char(s, s) == s);
+}
+
+TEST_CASE("sanitize string_view", "[sanitize]")
+{
+    std::string s;
+    for (int i = 0; i < 1024; ++i)
+    {
+        // Mixture of long safe runs and unsafe characters
+        s += char(i * 7919 % 256);
+        if (i % 5 == 0)
+            s += std::string(std::size_t(i % 67), 'x');
+        REQUIRE(sanitize(s) == sanitize_reference(s));
+    }
+}
+
+TEST_CASE("sanitize C string", "[sanitize]")
+{
+    const char* s = "foo\\bar\x7F\x01\xFF baz quux, the quick brown fox";
+    REQUIRE(
+        fmt::format("{}", xtr::detail::string_ref(s)) ==
+        "foo\\x5Cbar\\x7F\\x01\\xFF baz quux, the quick brown fox");
+}
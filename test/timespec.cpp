@@ -0,0 +1,73 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/timespec.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <string>
+
+namespace
+{
+    std::string format(std::time_t sec, long nsec)
+    {
+        std::timespec ts;
+        ts.tv_sec = sec;
+        ts.tv_nsec = nsec;
+        return fmt::format("{}", xtr::timespec{ts});
+    }
+}
+
+TEST_CASE("timespec format test", "[timespec]")
+{
+    REQUIRE(format(0, 0) == "1970-01-01 00:00:00.000000");
+    REQUIRE(format(946688523, 123456789) == "2000-01-01 01:02:03.123456");
+    REQUIRE(format(4858113906, 999999999) == "2123-12-13 04:05:06.999999");
+}
+
+TEST_CASE("timespec cached format test", "[timespec]")
+{
+    // Same second, only the microseconds change
+    REQUIRE(format(946688523, 0) == "2000-01-01 01:02:03.000000");
+    REQUIRE(format(946688523, 1000) == "2000-01-01 01:02:03.000001");
+    REQUIRE(format(946688523, 999) == "2000-01-01 01:02:03.000000");
+    REQUIRE(format(946688523, 100000000) == "2000-01-01 01:02:03.100000");
+
+    // Second, day and year changes
+    REQUIRE(format(946688524, 100000000) == "2000-01-01 01:02:04.100000");
+    REQUIRE(format(946684799, 999999000) == "1999-12-31 23:59:59.999999");
+    REQUIRE(format(946684800, 0) == "2000-01-01 00:00:00.000000");
+
+    // Moving backwards
+    REQUIRE(format(946688523, 5000) == "2000-01-01 01:02:03.000005");
+}
+
+TEST_CASE("timespec format_timestamp test", "[timespec]")
+{
+    std::timespec ts;
+    ts.tv_sec = 946688523;
+    ts.tv_nsec = 123456789;
+
+    char buf[32] = {};
+    char* end = xtr::detail::format_timestamp(buf, ts);
+    REQUIRE(std::string(buf, end) == "2000-01-01 01:02:03.123456");
+}
@@ -0,0 +1,96 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/tsc_converter.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+
+namespace xtrd = xtr::detail;
+
+namespace
+{
+    constexpr std::uint64_t hz = 1000000000; // 1 tick per nanosecond
+    constexpr std::int64_t epoch = 1600000000L * 1000000000L;
+}
+
+TEST_CASE("tsc_converter constant rate test", "[tsc_converter]")
+{
+    xtrd::tsc_converter conv;
+
+    for (std::uint64_t ticks = 1000; ticks < 10 * hz; ticks += hz)
+    {
+        conv.add_sample(ticks, epoch + std::int64_t(ticks), hz, hz);
+        REQUIRE(conv.convert(ticks) == epoch + std::int64_t(ticks));
+        REQUIRE(conv.convert(ticks + 123) == epoch + std::int64_t(ticks) + 123);
+    }
+}
+
+TEST_CASE("tsc_converter drift correction test", "[tsc_converter]")
+{
+    // The wall clock runs 100ppm faster than the given TSC frequency
+    const auto wall =
+        [](std::uint64_t ticks)
+        {
+            return epoch + std::int64_t(double(ticks) * 1.0001);
+        };
+
+    xtrd::tsc_converter conv;
+
+    std::int64_t last = 0;
+    for (std::uint64_t ticks = 0; ticks < 60 * hz; ticks += hz / 10)
+    {
+        // Conversion is continuous across samples
+        const std::int64_t before = conv.convert(ticks);
+        conv.add_sample(ticks, wall(ticks), hz, hz);
+        if (ticks != 0)
+            REQUIRE(conv.convert(ticks) == before);
+
+        // Conversion is monotonic between samples
+        for (std::uint64_t t = ticks; t < ticks + hz / 10; t += hz / 100)
+        {
+            const std::int64_t nanos = conv.convert(t);
+            REQUIRE(nanos >= last);
+            last = nanos;
+        }
+    }
+
+    // The error has converged
+    const std::uint64_t ticks = 60 * hz;
+    conv.add_sample(ticks, wall(ticks), hz, hz);
+    REQUIRE(std::abs(conv.convert(ticks + hz) - wall(ticks + hz)) < 100);
+}
+
+TEST_CASE("tsc_converter clock step test", "[tsc_converter]")
+{
+    xtrd::tsc_converter conv;
+
+    conv.add_sample(0, epoch, hz, hz);
+    conv.add_sample(hz, epoch + std::int64_t(hz), hz, hz);
+    REQUIRE(conv.sample_count() == 2);
+
+    // The wall clock is stepped forward by 10 seconds
+    const std::int64_t step = 10L * 1000000000L;
+    conv.add_sample(2 * hz, epoch + std::int64_t(2 * hz) + step, hz, hz);
+    REQUIRE(conv.sample_count() == 1);
+    REQUIRE(conv.convert(2 * hz) == epoch + std::int64_t(2 * hz) + step);
+    REQUIRE(conv.convert(3 * hz) == epoch + std::int64_t(3 * hz) + step);
+}
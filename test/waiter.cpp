@@ -0,0 +1,80 @@
+// Copyright 2022 Chris E. Holloway
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xtr/detail/waiter.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std::literals::chrono_literals;
+
+TEST_CASE("waiter timeout test", "[waiter]")
+{
+    xtr::detail::waiter w;
+
+    const auto start = std::chrono::steady_clock::now();
+    w.prepare_wait();
+    w.wait(20ms);
+    REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+
+    // The sleeping flag is cleared after waking, so notify is a no-op
+    w.notify();
+}
+
+TEST_CASE("waiter notify test", "[waiter]")
+{
+    xtr::detail::waiter w;
+    std::atomic<bool> woken{false};
+
+    w.prepare_wait();
+
+    std::thread t(
+        [&]()
+        {
+            w.wait(std::chrono::minutes{1});
+            woken = true;
+        });
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!woken)
+    {
+        w.notify();
+        std::this_thread::yield();
+    }
+    REQUIRE(std::chrono::steady_clock::now() - start < 30s);
+
+    t.join();
+}
+
+TEST_CASE("waiter cancel test", "[waiter]")
+{
+    xtr::detail::waiter w;
+    w.prepare_wait();
+    w.cancel_wait();
+
+    // The consumer has cancelled the wait so the flag is clear, and waiting
+    // with a cleared flag returns immediately
+    const auto start = std::chrono::steady_clock::now();
+    w.wait(std::chrono::minutes{1});
+    REQUIRE(std::chrono::steady_clock::now() - start < 30s);
+}